@@ -1,73 +1,241 @@
 #include "bootloader_custom.h"
 #include "esp_log.h"
-#include "esp_partition.h"
 #include "bootloader_utility.h"
 #include "soc/lp_system_reg.h"
 #include "soc/soc.h"  // For REG_READ and REG_WRITE macros
+#include "bootloader_flash_priv.h"
+#include "esp_flash_partitions.h"
+#include "esp_rom_crc.h"
+#include "esp_rom_sys.h"
+#include "esp_cpu.h"
+#include "config_log_format.h"
+#include "boot_request_format.h"
+#include "image_digest_format.h"
+#include "esp_image_format.h"
+#include "bootloader_common.h"
+#include "sdkconfig.h"
+#include <string.h>
 
 #define TAG "bootloader_custom"
 
-// RTC store register for boot requests (STORE0 is reserved in ESP32-P4)
-#define BOOT_REQUEST_RTC_REG     LP_SYSTEM_REG_LP_STORE0_REG
-#define BOOT_REQUEST_MAGIC_RTC   0x00544551  // 'BOOT' magic in ASCII
-
-typedef struct {
-    uint32_t magic;
-    uint32_t partition_type;  // 0=Factory, 1=OTA_0, 2=OTA_1
-} rtc_boot_request_t;
-
-// Dynamic OTA partition mapping structure
+// Partition map built from the bootloader_state_t loaded by the IDF bootloader
 typedef struct {
-    const esp_partition_t* factory;
-    const esp_partition_t* ota_partitions[16];  // Support up to 16 OTA partitions
+    esp_partition_pos_t factory;
+    esp_partition_pos_t ota_partitions[MAX_OTA_SLOTS];  // Contiguous from OTA_0
     int ota_count;
+    bool has_factory;
 } ota_partition_map_t;
 
 static ota_partition_map_t g_ota_map = {0};
 
-// Function to dynamically map available partitions
+// Function to map available partitions in one pass over the loaded partition table
 esp_err_t bootloader_map_partitions(const bootloader_state_t* state)
 {
-    ESP_LOGI(TAG, "=== Mapping Available Partitions ===");
+    if (!state) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
 
-    // Initialize the mapping structure
     memset(&g_ota_map, 0, sizeof(g_ota_map));
 
-    // Find factory partition
-    g_ota_map.factory = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
-                                                   ESP_PARTITION_SUBTYPE_APP_FACTORY,
-                                                   NULL);
-    if (g_ota_map.factory) {
-        ESP_LOGI(TAG, "Found factory partition: %s at 0x%x (size: 0x%x)",
-                 g_ota_map.factory->label ? g_ota_map.factory->label : "unknown",
-                 g_ota_map.factory->address,
-                 g_ota_map.factory->size);
-    }
-
-    // Find all OTA partitions dynamically
-    for (int i = 0; i < 16; i++) {
-        esp_partition_subtype_t subtype = ESP_PARTITION_SUBTYPE_APP_OTA_MIN + i;
-        const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, subtype, NULL);
-
-        if (partition) {
-            if (g_ota_map.ota_count < 16) {
-                g_ota_map.ota_partitions[g_ota_map.ota_count] = partition;
-                ESP_LOGI(TAG, "Found OTA partition %d: %s at 0x%x (size: 0x%x)",
-                         g_ota_map.ota_count,
-                         partition->label ? partition->label : "unknown",
-                         partition->address,
-                         partition->size);
-                g_ota_map.ota_count++;
-            }
-        } else {
-            break;  // No more OTA partitions found
-        }
+    // bootloader_utility_load_partition_table() already slotted every APP
+    // partition by subtype; no further flash reads are needed here
+    if (state->factory.size > 0) {
+        g_ota_map.factory = state->factory;
+        g_ota_map.has_factory = true;
     }
 
-    ESP_LOGI(TAG, "Partition mapping complete: %d OTA partitions available", g_ota_map.ota_count);
+    // OTA indices are contiguous from OTA_0; stop at the first missing subtype
+    for (int i = 0; i < MAX_OTA_SLOTS && state->ota[i].size > 0; i++) {
+        g_ota_map.ota_partitions[g_ota_map.ota_count++] = state->ota[i];
+    }
+
+    uint32_t elapsed_us = (esp_cpu_get_cycle_count() - start_cycles) / esp_rom_get_cpu_ticks_per_us();
+
+    if (g_ota_map.has_factory) {
+        ESP_LOGI(TAG, "Factory partition at 0x%x (size: 0x%x)",
+                 g_ota_map.factory.offset, g_ota_map.factory.size);
+    }
+    for (int i = 0; i < g_ota_map.ota_count; i++) {
+        ESP_LOGI(TAG, "OTA partition %d at 0x%x (size: 0x%x)",
+                 i, g_ota_map.ota_partitions[i].offset, g_ota_map.ota_partitions[i].size);
+    }
+
+    ESP_LOGI(TAG, "Partition mapping complete: %d OTA partitions available (%u us)",
+             g_ota_map.ota_count, (unsigned)elapsed_us);
     return ESP_OK;
 }
 
+// ROM flash reads need word-aligned length; the shared parser reads at most 64 bytes at a time
+static int config_log_flash_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    uint32_t words[17];
+    size_t aligned_len = (len + 3) & ~(size_t)3;
+
+    (void)ctx;
+    if (aligned_len > sizeof(words) || (addr & 3) != 0) {
+        return -1;
+    }
+    if (bootloader_flash_read(addr, words, aligned_len, false) != ESP_OK) {
+        return -1;
+    }
+    memcpy(buf, words, len);
+    return 0;
+}
+
+static uint32_t config_log_crc32(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    return esp_rom_crc32_le(crc, buf, len);
+}
+
+// Location of the bootloader_config partition, looked up once per boot
+static uint32_t s_config_log_base;
+static uint32_t s_config_log_sectors;
+static bool s_config_log_located;
+
+static esp_err_t config_log_locate(void)
+{
+    if (s_config_log_located) {
+        return s_config_log_sectors ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+
+    // Locate the bootloader_config partition in the raw table
+    const esp_partition_info_t *table = bootloader_mmap(ESP_PARTITION_TABLE_OFFSET, ESP_PARTITION_TABLE_MAX_LEN);
+    if (!table) {
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < ESP_PARTITION_TABLE_MAX_ENTRIES && table[i].magic == ESP_PARTITION_MAGIC; i++) {
+        if (strncmp((const char *)table[i].label, CONFIG_LOG_PARTITION_LABEL, sizeof(table[i].label)) == 0) {
+            s_config_log_base = table[i].pos.offset;
+            s_config_log_sectors = table[i].pos.size / CONFIG_LOG_SECTOR_SIZE;
+            break;
+        }
+    }
+    bootloader_munmap(table);
+
+    s_config_log_located = true;
+    return s_config_log_sectors ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Read the newest record of a key; the payload must be exactly len bytes
+static esp_err_t config_log_read_key(uint16_t key, void *buf, size_t len)
+{
+    esp_err_t ret = config_log_locate();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    const config_log_reader_t reader = {
+        .read = config_log_flash_read,
+        .crc32 = config_log_crc32,
+        .ctx = NULL,
+    };
+
+    uint32_t payload_addr = 0;
+    uint16_t length = 0;
+    int found = config_log_find(&reader, s_config_log_base, s_config_log_sectors,
+                                key, &payload_addr, &length);
+    if (found < 0) {
+        return ESP_FAIL;
+    }
+    if (found > 0 || length != len) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return config_log_flash_read(NULL, payload_addr, buf, len) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// Check whether the image at part may be loaded without re-hashing it (see image_digest_format.h)
+static bool image_digest_trusted(const esp_partition_pos_t *part)
+{
+    int slot = -1;
+    for (int i = 0; i < g_ota_map.ota_count && i < IMAGE_DIGEST_MAX_SLOTS; i++) {
+        if (g_ota_map.ota_partitions[i].offset == part->offset) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return false;  // Factory app or unmapped partition
+    }
+
+    image_digest_record_t record;
+    if (config_log_read_key(CONFIG_LOG_KEY_IMAGE_DIGEST(slot), &record, sizeof(record)) != ESP_OK ||
+        record.magic != IMAGE_DIGEST_MAGIC || record.version != IMAGE_DIGEST_FORMAT_VERSION) {
+        return false;
+    }
+
+    // The newest record is unverified while the slot is being rewritten
+    if (!(record.flags & IMAGE_DIGEST_FLAG_VERIFIED) || record.offset != part->offset ||
+        record.length < IMAGE_DIGEST_LEN || record.length > part->size) {
+        ESP_LOGI(TAG, "OTA slot %d: no verified digest (generation %u)", slot, record.generation);
+        return false;
+    }
+
+    // Without the appended hash a flash change could go unnoticed
+    if (!(record.flags & IMAGE_DIGEST_FLAG_HASH_APPENDED)) {
+        return false;
+    }
+
+    uint32_t tail[IMAGE_DIGEST_LEN / sizeof(uint32_t)];
+    if (bootloader_flash_read(part->offset + record.length - IMAGE_DIGEST_LEN, tail, sizeof(tail), true) != ESP_OK ||
+        memcmp(tail, record.sha256, IMAGE_DIGEST_LEN) != 0) {
+        ESP_LOGW(TAG, "OTA slot %d: appended digest differs from the cached one", slot);
+        return false;
+    }
+
+    return true;
+}
+
+esp_err_t __real_bootloader_load_image(const esp_partition_pos_t *part, esp_image_metadata_t *data);
+esp_err_t __wrap_bootloader_load_image(const esp_partition_pos_t *part, esp_image_metadata_t *data);
+
+// Linked in place of bootloader_load_image() (-Wl,--wrap, see CMakeLists.txt)
+esp_err_t __wrap_bootloader_load_image(const esp_partition_pos_t *part, esp_image_metadata_t *data)
+{
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    bool fast = false;
+    esp_err_t ret = ESP_FAIL;
+
+#if !CONFIG_SECURE_SIGNED_ON_BOOT
+    // Signature checks are never skipped
+    if (part && data && image_digest_trusted(part)) {
+        ret = bootloader_load_image_no_verify(part, data);
+        fast = (ret == ESP_OK);
+        if (!fast) {
+            ESP_LOGW(TAG, "Fast load failed (0x%x), validating fully", ret);
+        }
+    }
+#endif
+
+    if (!fast) {
+        ret = __real_bootloader_load_image(part, data);
+    }
+
+    uint32_t elapsed_us = (esp_cpu_get_cycle_count() - start_cycles) / esp_rom_get_cpu_ticks_per_us();
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Image at 0x%x loaded (%s): %u bytes in %u us (%u us/MB)",
+                 part->offset, fast ? "cached digest" : "full validation",
+                 data->image_len, (unsigned)elapsed_us,
+                 data->image_len ? (unsigned)((uint64_t)elapsed_us * 1024 * 1024 / data->image_len) : 0);
+
+        // The loader jumps to this image next, so the record now covers the load
+        bootloader_timing_mark(BOOT_STAGE_BL_IMAGE_LOAD);
+        bootloader_timing_publish();
+    }
+    return ret;
+}
+
+static void boot_request_read_words(uint32_t words[BOOT_REQUEST_WORDS])
+{
+    words[0] = REG_READ(BOOT_REQUEST_REG_WORD0);
+    words[1] = REG_READ(BOOT_REQUEST_REG_WORD1);
+    words[2] = REG_READ(BOOT_REQUEST_REG_WORD2);
+    words[3] = REG_READ(BOOT_REQUEST_REG_WORD3);
+}
+
 esp_err_t bootloader_read_boot_request(boot_request_t *request)
 {
     ESP_LOGI(TAG, "=== Custom Bootloader Active (RTC-based) ===");
@@ -76,99 +244,143 @@ esp_err_t bootloader_read_boot_request(boot_request_t *request)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Read RTC store register for boot request
-    uint32_t rtc_value = REG_READ(BOOT_REQUEST_RTC_REG);
-    ESP_LOGI(TAG, "RTC store register value: 0x%08x", rtc_value);
-
-    // Check if we have a valid boot request in RTC register
-    // Extract magic from lower 24 bits and partition type from upper 8 bits
-    uint32_t magic = rtc_value & 0x00FFFFFF;
-    uint32_t partition_type = (rtc_value >> 24) & 0xFF;
+    uint32_t words[BOOT_REQUEST_WORDS];
+    boot_request_read_words(words);
+    ESP_LOGI(TAG, "RTC store registers: 0x%08x 0x%08x 0x%08x 0x%08x",
+             words[0], words[1], words[2], words[3]);
 
-    if (magic != BOOT_REQUEST_MAGIC_RTC) {
-        ESP_LOGI(TAG, "No valid boot request found in RTC register. Magic: 0x%06x (expected 0x%06x)", magic, BOOT_REQUEST_MAGIC_RTC);
+    boot_request_data_t data;
+    boot_request_decode_result_t result = boot_request_decode(words, &data);
+    if (result == BOOT_REQUEST_DECODE_CORRUPT) {
+        ESP_LOGW(TAG, "Corrupt v2 boot request (version/CRC mismatch), ignoring");
+        bootloader_clear_boot_request();
         return ESP_ERR_NOT_FOUND;
     }
-
-    ESP_LOGI(TAG, "RTC boot request found: magic=0x%06x, partition_index=%d", magic, partition_type);
-
-    // Validate partition index (0=Factory, 1-N=OTA)
-    if (partition_type > g_ota_map.ota_count) {
-        ESP_LOGW(TAG, "Invalid partition index %d (max: %d), defaulting to factory", partition_type, g_ota_map.ota_count);
-        partition_type = 0;
+    if (result != BOOT_REQUEST_DECODE_OK) {
+        ESP_LOGI(TAG, "No valid boot request found in RTC registers");
+        return ESP_ERR_NOT_FOUND;
     }
 
     // Fill our request structure
     request->magic = BOOT_REQUEST_MAGIC;
-    request->version = BOOT_REQUEST_VERSION;
-    request->reserved = 0;
-    request->boot_count = 1;
+    request->version = data.version;
+    request->next_partition_type = data.target;
+    request->flags = data.flags;
+    request->boot_count = data.attempts;
+    request->max_attempts = data.max_attempts;
     request->timestamp = 0;
-    request->next_partition_type = partition_type;
 
-    ESP_LOGI(TAG, "Boot request loaded from RTC: index=%d, will reset to factory after this boot", request->next_partition_type);
+    ESP_LOGI(TAG, "Boot request v%u: index=%u, %s, attempts=%u/%u",
+             data.version, data.target,
+             (data.flags & BOOT_REQUEST_FLAG_STICKY) ? "sticky" : "one-time",
+             data.attempts, data.max_attempts);
+    return ESP_OK;
+}
+
+esp_err_t bootloader_consume_boot_request(boot_request_t *request)
+{
+    if (!request) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const boot_request_data_t data = {
+        .version = request->version,
+        .flags = request->flags,
+        .target = request->next_partition_type,
+        .attempts = request->boot_count,
+        .max_attempts = request->max_attempts,
+    };
+    boot_request_data_t next;
+    bool keep = boot_request_step(&data, &next);
+
+    if (next.target != data.target) {
+        ESP_LOGW(TAG, "Sticky request for index %u used %u/%u attempts, falling back to factory",
+                 data.target, data.attempts, data.max_attempts);
+    }
+    request->next_partition_type = next.target;
+    request->boot_count = next.attempts;
+
+    if (!keep) {
+        return bootloader_clear_boot_request();
+    }
+
+    uint32_t words[BOOT_REQUEST_WORDS];
+    boot_request_encode(&next, words);
+    REG_WRITE(BOOT_REQUEST_REG_WORD1, words[1]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD2, words[2]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD3, words[3]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD0, words[0]);
+
+    ESP_LOGI(TAG, "Sticky boot request kept (attempt %u/%u)", next.attempts, next.max_attempts);
     return ESP_OK;
 }
 
 esp_err_t bootloader_clear_boot_request(void)
 {
-    ESP_LOGI(TAG, "Boot request clear called - clearing RTC register");
+    ESP_LOGI(TAG, "Boot request clear called - clearing RTC registers");
 
-    // Clear the RTC store register to remove the boot request
-    REG_WRITE(BOOT_REQUEST_RTC_REG, 0);
+    // Word 0 first so a partially cleared request never decodes as valid
+    REG_WRITE(BOOT_REQUEST_REG_WORD0, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD1, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD2, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD3, 0);
 
     ESP_LOGI(TAG, "RTC boot request cleared - will default to factory next time");
     return ESP_OK;
 }
 
-const esp_partition_t* bootloader_get_boot_partition(const boot_request_t *request,
-                                                      const bootloader_state_t *state)
+int bootloader_get_boot_index(const boot_request_t *request)
 {
-    ESP_LOGI(TAG, "=== Custom Bootloader Partition Selection (Dynamic) ===");
-
     // Default to factory partition if no request
-    if (!request) {
-        ESP_LOGI(TAG, "No boot request, defaulting to factory application");
-        return g_ota_map.factory;
+    if (!request || request->next_partition_type == 0) {
+        ESP_LOGI(TAG, "Selected factory partition");
+        return FACTORY_INDEX;
     }
 
-    ESP_LOGI(TAG, "Processing boot request: index=%d, boot_count=%d",
-             request->next_partition_type, request->boot_count);
-
-    const esp_partition_t *selected_partition = NULL;
+    // OTA partition (1-based indexing from RTC, 0-based bootloader index)
     int partition_index = request->next_partition_type;
+    if (partition_index > g_ota_map.ota_count) {
+        ESP_LOGW(TAG, "Invalid partition index %d (max: %d), defaulting to factory",
+                 partition_index, g_ota_map.ota_count);
+        return FACTORY_INDEX;
+    }
 
-    // Dynamic partition mapping based on request index
-    if (partition_index == 0) {
-        // Factory partition
-        ESP_LOGI(TAG, "Selected factory partition");
-        selected_partition = g_ota_map.factory;
-    } else if (partition_index > 0 && partition_index <= g_ota_map.ota_count) {
-        // OTA partition (1-based indexing from RTC)
-        selected_partition = g_ota_map.ota_partitions[partition_index - 1];
-        ESP_LOGI(TAG, "Selected OTA partition %d: %s at 0x%x (size: 0x%x) - one-time boot",
-                 partition_index,
-                 selected_partition->label ? selected_partition->label : "unknown",
-                 selected_partition->address,
-                 selected_partition->size);
-    } else {
-        // Invalid index, fallback to factory
-        ESP_LOGW(TAG, "Invalid partition index %d, defaulting to factory", partition_index);
-        selected_partition = g_ota_map.factory;
-    }
-
-    // Fallback to factory if requested partition is not available
-    if (!selected_partition) {
-        ESP_LOGW(TAG, "Requested partition not available, falling back to factory");
-        selected_partition = g_ota_map.factory;
-    }
-
-    if (selected_partition) {
-        ESP_LOGI(TAG, "Selected partition: %s at offset 0x%x (size: 0x%x)",
-                 selected_partition->label ? selected_partition->label : "unknown",
-                 selected_partition->address,
-                 selected_partition->size);
-    }
-
-    return selected_partition;
-}
\ No newline at end of file
+    const esp_partition_pos_t *pos = &g_ota_map.ota_partitions[partition_index - 1];
+    ESP_LOGI(TAG, "Selected OTA partition %d at 0x%x (size: 0x%x) - one-time boot",
+             partition_index, pos->offset, pos->size);
+    return partition_index - 1;
+}
+
+bool bootloader_has_factory_partition(void)
+{
+    return g_ota_map.has_factory;
+}
+
+static uint32_t s_stage_us[BOOT_STAGE_BL_COUNT];
+
+void bootloader_timing_mark(boot_stage_t stage)
+{
+    if (stage < BOOT_STAGE_BL_COUNT) {
+        s_stage_us[stage] = esp_cpu_get_cycle_count() / esp_rom_get_cpu_ticks_per_us();
+    }
+}
+
+void bootloader_timing_publish(void)
+{
+#if CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC
+    _Static_assert(sizeof(boot_timing_rtc_t) <= CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE,
+                   "CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE too small for boot timing");
+
+    boot_timing_rtc_t record = { .magic = BOOT_TIMING_RTC_MAGIC };
+    memcpy(record.stamp_us, s_stage_us, sizeof(record.stamp_us));
+
+    // Custom area of the reserved RTC memory; the update recomputes its CRC
+    rtc_retain_mem_t *rtc = bootloader_common_get_rtc_retain_mem();
+    memcpy(rtc->custom, &record, sizeof(record));
+    bootloader_common_update_rtc_retain_mem(NULL, false);
+#endif
+
+    ESP_LOGI(TAG, "BOOT_TIMING_BL bl_init=%u bl_ptable=%u bl_request=%u bl_load=%u",
+             s_stage_us[BOOT_STAGE_BL_INIT], s_stage_us[BOOT_STAGE_BL_PARTITION_TABLE],
+             s_stage_us[BOOT_STAGE_BL_REQUEST], s_stage_us[BOOT_STAGE_BL_IMAGE_LOAD]);
+}
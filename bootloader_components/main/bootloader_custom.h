@@ -2,9 +2,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "esp_partition.h"
 #include "esp_err.h"
 #include "bootloader_config.h"
+#include "boot_timing_format.h"
 
 #define BOOT_REQUEST_MAGIC  0x50415445  // "PETE"
 #define BOOT_REQUEST_VERSION 1
@@ -14,17 +14,18 @@ extern "C" {
 #endif
 
 /**
- * @brief Boot request structure stored in NVS
+ * @brief Boot request decoded from the LP store registers
  *
- * This structure is used to store the next boot partition information
- * that applications can set before rebooting.
+ * This structure holds the next boot partition information that
+ * applications set before rebooting (see boot_request_format.h).
  */
 typedef struct {
     uint32_t magic;              ///< Magic number for validation (BOOT_REQUEST_MAGIC)
-    uint8_t version;             ///< Structure version
+    uint8_t version;             ///< Register format version (1 or 2)
     uint8_t next_partition_type; ///< Next boot partition type (0=factory, 1=ota_0, 2=ota_1)
-    uint8_t reserved;            ///< Reserved for future use
-    uint8_t boot_count;          ///< Number of times this request has been processed
+    uint8_t flags;               ///< BOOT_REQUEST_FLAG_* (v2 only)
+    uint8_t boot_count;          ///< Boots of a sticky request since it was written or confirmed
+    uint8_t max_attempts;        ///< Unconfirmed boots before falling back to factory (0 = no limit)
     uint32_t timestamp;          ///< Timestamp when request was created
 } boot_request_t;
 
@@ -38,7 +39,7 @@ typedef struct {
 esp_err_t bootloader_custom_init(void);
 
 /**
- * @brief Read boot request from NVS
+ * @brief Read boot request from the LP store registers (v1 or v2 format)
  *
  * @param request Pointer to store the boot request
  * @return ESP_OK if request found and valid, ESP_ERR_NOT_FOUND if no request
@@ -46,14 +47,29 @@ esp_err_t bootloader_custom_init(void);
 esp_err_t bootloader_read_boot_request(boot_request_t *request);
 
 /**
- * @brief Clear boot request from NVS
+ * @brief Account for the boot about to happen and update the registers
+ *
+ * One-time requests are cleared. Sticky requests get their attempt counter
+ * bumped and are written back, or are cleared with next_partition_type set
+ * to factory once they have used up their attempts.
+ *
+ * @param request Request returned by bootloader_read_boot_request(), updated in place
+ * @return ESP_OK on success
+ */
+esp_err_t bootloader_consume_boot_request(boot_request_t *request);
+
+/**
+ * @brief Clear boot request from the LP store registers
  *
  * @return ESP_OK on success
  */
 esp_err_t bootloader_clear_boot_request(void);
 
 /**
- * @brief Map available partitions dynamically from partition table
+ * @brief Map available partitions from the loaded partition table
+ *
+ * Builds the map in a single pass over the bootloader_state_t filled by
+ * bootloader_utility_load_partition_table() and logs the time it took.
  *
  * @param state Bootloader state information (ESP-IDF's bootloader_state_t)
  * @return ESP_OK on success
@@ -61,14 +77,36 @@ esp_err_t bootloader_clear_boot_request(void);
 esp_err_t bootloader_map_partitions(const bootloader_state_t *state);
 
 /**
- * @brief Get the partition to boot based on request and default behavior
+ * @brief Resolve a boot request to a bootloader_utility_load_boot_image() index
+ *
+ * Uses the map built by bootloader_map_partitions(); no partition lookups.
  *
  * @param request Pointer to boot request (can be NULL for no request)
- * @param state Bootloader state information (ESP-IDF's bootloader_state_t)
- * @return Pointer to partition to boot from
+ * @return FACTORY_INDEX, or the 0-based OTA index of the requested partition
+ */
+int bootloader_get_boot_index(const boot_request_t *request);
+
+/**
+ * @brief Check whether bootloader_map_partitions() found a factory partition
+ *
+ * @return true if a factory partition is present
+ */
+bool bootloader_has_factory_partition(void);
+
+/**
+ * @brief Stamp a bootloader stage with the microseconds since CPU reset
+ *
+ * @param stage One of the BOOT_STAGE_BL_* stages
+ */
+void bootloader_timing_mark(boot_stage_t stage);
+
+/**
+ * @brief Log the stage stamps and hand them to the app through RTC memory
+ *
+ * The record goes into the custom area of the reserved RTC memory when
+ * CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC is enabled; otherwise it is only logged.
  */
-const esp_partition_t* bootloader_get_boot_partition(const boot_request_t *request,
-                                                      const bootloader_state_t *state);
+void bootloader_timing_publish(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,568 @@
+/**
+ * @file block_crc.c
+ * @brief Per-64 KiB block CRC table of installed OTA slots
+ */
+
+#include "block_crc.h"
+#include "image_digest_cache.h"
+#include "ota_preerase.h"
+#include "partition_cache.h"
+#include "config_log.h"
+#include "esp_log.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "block_crc";
+
+#define TABLE_MAGIC       0x4342  // "BC"
+#define TABLE_VERSION     1
+#define READ_CHUNK        FLASH_IO_SECTOR_SIZE
+#define IMAGE_MAGIC       0xE9
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;        // TABLE_MAGIC
+    uint8_t version;       // TABLE_VERSION
+    uint8_t block_shift;   // BLOCK_CRC_SHIFT
+    uint32_t generation;   // Image digest generation of the slot
+    uint32_t offset;       // Slot flash offset
+    uint32_t length;       // Image bytes covered
+    uint32_t table_crc;    // CRC32 of the block CRCs
+    uint32_t crcs[BLOCK_CRC_MAX_BLOCKS];  // Stored up to block_count()
+} block_table_t;
+
+#define TABLE_HEADER_SIZE offsetof(block_table_t, crcs)
+
+_Static_assert(sizeof(block_table_t) <= BLOCK_CRC_MAX_PARTS * CONFIG_LOG_MAX_PAYLOAD,
+               "Block table must fit its config log records");
+
+// Last table loaded or stored per slot, so scrub steps do not re-read the log
+typedef struct {
+    bool loaded;          // `generation` below is known
+    uint32_t generation;  // Generation the entry was loaded for
+    block_table_t* table; // NULL if the slot had no current table
+} table_cache_t;
+
+static SemaphoreHandle_t g_mutex = NULL;  // Guards g_cache
+static table_cache_t g_cache[IMAGE_DIGEST_MAX_SLOTS];
+
+// Fails until block_crc_init() has created the mutex
+static bool lock(void)
+{
+    return g_mutex && xSemaphoreTake(g_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(g_mutex);
+}
+
+static uint32_t block_count(uint32_t length)
+{
+    return (length + BLOCK_CRC_SIZE - 1) >> BLOCK_CRC_SHIFT;
+}
+
+static uint32_t block_length(const block_table_t* table, uint32_t block)
+{
+    uint32_t start = block << BLOCK_CRC_SHIFT;
+    return table->length - start < BLOCK_CRC_SIZE ? table->length - start : BLOCK_CRC_SIZE;
+}
+
+static uint32_t slot_generation(uint32_t slot)
+{
+    image_digest_record_t record;
+    return image_digest_cache_get(slot, &record) == ESP_OK ? record.generation : 0;
+}
+
+static uint32_t table_size(const block_table_t* table)
+{
+    return TABLE_HEADER_SIZE + block_count(table->length) * sizeof(uint32_t);
+}
+
+// Record parts the table bytes are split into; part 0 holds the header
+static uint32_t table_parts(uint32_t size)
+{
+    return (size + CONFIG_LOG_MAX_PAYLOAD - 1) / CONFIG_LOG_MAX_PAYLOAD;
+}
+
+static void delete_parts(uint32_t slot, uint32_t first_part)
+{
+    for (uint32_t part = first_part; part < BLOCK_CRC_MAX_PARTS; part++) {
+        config_log_delete(CONFIG_LOG_KEY_BLOCK_CRC(slot, part));
+    }
+}
+
+// Caller holds the lock
+static void cache_set(uint32_t slot, const block_table_t* table)
+{
+    table_cache_t* entry = &g_cache[slot];
+    if (table && !entry->table) {
+        entry->table = malloc(sizeof(*entry->table));
+    }
+    if (table && entry->table) {
+        memcpy(entry->table, table, table_size(table));
+        entry->generation = table->generation;
+        entry->loaded = true;
+        return;
+    }
+    free(entry->table);
+    entry->table = NULL;
+    entry->loaded = false;
+}
+
+// Writes the header part last, so a torn update fails the table CRC. With
+// `header_only` the block CRCs are unchanged and only part 0 is rewritten
+static esp_err_t store_table(uint32_t slot, block_table_t* table, bool header_only)
+{
+    uint32_t size = table_size(table);
+    uint32_t parts = table_parts(size);
+    table->table_crc = esp_crc32_le(0, (const uint8_t*)table->crcs, size - TABLE_HEADER_SIZE);
+
+    if (!config_log_is_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!header_only) {
+        // The old table is stale anyway; free its room in the log first
+        delete_parts(slot, 0);
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (uint32_t part = header_only ? 1 : parts; part-- > 0 && ret == ESP_OK;) {
+        uint32_t start = part * CONFIG_LOG_MAX_PAYLOAD;
+        uint32_t length = size - start < CONFIG_LOG_MAX_PAYLOAD ? size - start : CONFIG_LOG_MAX_PAYLOAD;
+        ret = config_log_append(CONFIG_LOG_KEY_BLOCK_CRC(slot, part), (const uint8_t*)table + start, length);
+    }
+    if (ret != ESP_OK) {
+        delete_parts(slot, 0);
+    }
+
+    if (lock()) {
+        cache_set(slot, ret == ESP_OK ? table : NULL);
+        unlock();
+    }
+    return ret;
+}
+
+static esp_err_t read_table(uint32_t slot, block_table_t* table)
+{
+    size_t size = 0;
+    for (uint32_t part = 0; part < BLOCK_CRC_MAX_PARTS; part++) {
+        size_t length = CONFIG_LOG_MAX_PAYLOAD;
+        if (config_log_read(CONFIG_LOG_KEY_BLOCK_CRC(slot, part), (uint8_t*)table + size, &length) != ESP_OK) {
+            break;
+        }
+        size += length;
+        if (length < CONFIG_LOG_MAX_PAYLOAD) {
+            break;
+        }
+    }
+
+    if (size < TABLE_HEADER_SIZE ||
+        table->magic != TABLE_MAGIC || table->version != TABLE_VERSION ||
+        table->block_shift != BLOCK_CRC_SHIFT || table->length == 0 ||
+        table->length > BLOCK_CRC_MAX_BLOCKS * BLOCK_CRC_SIZE || size != table_size(table) ||
+        table->table_crc != esp_crc32_le(0, (const uint8_t*)table->crcs, size - TABLE_HEADER_SIZE)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+// Copies the table of a slot if it belongs to the image currently in it.
+// Only the slot's generation is read from the log while the cache is current
+static esp_err_t load_table(uint32_t slot, block_table_t* table)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !lock()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t generation = slot_generation(slot);
+    table_cache_t* entry = &g_cache[slot];
+    if (!entry->loaded || entry->generation != generation) {
+        bool found = read_table(slot, table) == ESP_OK && table->generation == generation;
+        cache_set(slot, found ? table : NULL);
+        if (!found) {
+            // Remember the miss too
+            ESP_LOGD(TAG, "Slot %" PRIu32 " has no table for its current image", slot);
+            entry->generation = generation;
+            entry->loaded = true;
+        } else if (!entry->loaded) {
+            unlock();
+            return ESP_OK;  // No memory to cache it; the copy just read is current
+        }
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (entry->table) {
+        memcpy(table, entry->table, table_size(entry->table));
+        ret = ESP_OK;
+    }
+    unlock();
+    return ret;
+}
+
+// Partition of a slot, if it still starts where the table says
+static const esp_partition_t* slot_partition(uint32_t slot, uint32_t offset)
+{
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + slot, NULL);
+    return partition && partition->address == offset ? partition : NULL;
+}
+
+// CRC a block in place through the flash cache; without a mapping, copy it
+// through `*buf`, allocated on first use
+static esp_err_t block_flash_crc(const block_table_t* table, const esp_partition_t* partition, uint32_t block,
+                                flash_io_priority_t priority, uint8_t** buf, uint32_t* crc)
+{
+    uint32_t start = block << BLOCK_CRC_SHIFT;
+    uint32_t length = block_length(table, block);
+
+    flash_io_map_t map;
+    if (partition && flash_io_map(partition, start, length, &map) == ESP_OK) {
+        *crc = esp_crc32_le(0, map.data, length);
+        flash_io_unmap(&map);
+        return ESP_OK;
+    }
+
+    if (!*buf && !(*buf = malloc(READ_CHUNK))) {
+        return ESP_ERR_NO_MEM;
+    }
+    *crc = 0;
+    for (uint32_t pos = 0; pos < length; pos += READ_CHUNK) {
+        uint32_t n = length - pos < READ_CHUNK ? length - pos : READ_CHUNK;
+        esp_err_t ret = flash_io_read(priority, *buf, table->offset + start + pos, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        *crc = esp_crc32_le(*crc, *buf, n);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t verify_blocks(const block_table_t* table, const esp_partition_t* partition,
+                               uint32_t first_block, uint32_t count,
+                               flash_io_priority_t priority, uint8_t* bad, block_crc_result_t* result)
+{
+    uint8_t* buf = NULL;
+    uint32_t blocks = block_count(table->length);
+    esp_err_t ret = ESP_OK;
+    for (uint32_t i = 0; i < count && first_block + i < blocks; i++) {
+        uint32_t crc;
+        esp_err_t read_ret = block_flash_crc(table, partition, first_block + i, priority, &buf, &crc);
+        if (read_ret != ESP_OK) {
+            ret = read_ret;
+            break;
+        }
+        result->blocks_checked++;
+        if (crc != table->crcs[first_block + i]) {
+            result->blocks_bad++;
+            if (bad) {
+                bad[i / 8] |= 1u << (i % 8);
+            }
+            ret = ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+esp_err_t block_crc_init(void)
+{
+    if (g_mutex) {
+        return ESP_OK;
+    }
+    g_mutex = xSemaphoreCreateMutex();
+    return g_mutex ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t block_crc_begin(block_crc_builder_t* builder, uint32_t slot, uint32_t offset)
+{
+    if (!builder || slot >= IMAGE_DIGEST_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(builder, 0, sizeof(*builder));
+    builder->slot = slot;
+    builder->offset = offset;
+    builder->crcs = malloc(BLOCK_CRC_MAX_BLOCKS * sizeof(uint32_t));
+    if (!builder->crcs) {
+        builder->failed = true;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void block_crc_update(block_crc_builder_t* builder, const void* data, size_t size)
+{
+    if (!builder || builder->failed) {
+        return;
+    }
+    const uint8_t* p = data;
+    while (size > 0) {
+        uint32_t room = BLOCK_CRC_SIZE - builder->length % BLOCK_CRC_SIZE;
+        uint32_t n = size < room ? (uint32_t)size : room;
+        builder->crc = esp_crc32_le(builder->crc, p, n);
+        builder->length += n;
+        p += n;
+        size -= n;
+
+        if (builder->length % BLOCK_CRC_SIZE == 0) {
+            uint32_t block = (builder->length >> BLOCK_CRC_SHIFT) - 1;
+            if (block >= BLOCK_CRC_MAX_BLOCKS) {
+                builder->failed = true;
+                return;
+            }
+            builder->crcs[block] = builder->crc;
+            builder->crc = 0;
+        }
+    }
+}
+
+esp_err_t block_crc_finish(block_crc_builder_t* builder, bool commit)
+{
+    if (!builder) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint32_t count = block_count(builder->length);
+    if (!commit || !builder->crcs || builder->length == 0) {
+        ret = ESP_OK;
+    } else if (builder->failed || count > BLOCK_CRC_MAX_BLOCKS) {
+        ESP_LOGW(TAG, "Slot %" PRIu32 ": image too large for a block table", builder->slot);
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        block_table_t* table = malloc(sizeof(*table));
+        if (!table) {
+            ret = ESP_ERR_NO_MEM;
+        } else {
+            memcpy(table->crcs, builder->crcs, count * sizeof(uint32_t));
+            if (builder->length % BLOCK_CRC_SIZE) {
+                table->crcs[count - 1] = builder->crc;
+            }
+            table->magic = TABLE_MAGIC;
+            table->version = TABLE_VERSION;
+            table->block_shift = BLOCK_CRC_SHIFT;
+            table->generation = slot_generation(builder->slot);
+            table->offset = builder->offset;
+            table->length = builder->length;
+
+            ret = store_table(builder->slot, table, false);
+            if (ret == ESP_OK) {
+                ESP_LOGI(TAG, "Slot %" PRIu32 ": %" PRIu32 " block CRCs stored", builder->slot, count);
+            } else {
+                ESP_LOGW(TAG, "Slot %" PRIu32 ": block table not stored: %s",
+                         builder->slot, esp_err_to_name(ret));
+            }
+            free(table);
+        }
+    }
+
+    free(builder->crcs);
+    builder->crcs = NULL;
+    return ret;
+}
+
+bool block_crc_available(uint32_t slot, uint32_t* length)
+{
+    block_table_t* table = malloc(sizeof(*table));
+    if (!table) {
+        return false;
+    }
+    bool ok = load_table(slot, table) == ESP_OK;
+    if (ok && length) {
+        *length = table->length;
+    }
+    free(table);
+    return ok;
+}
+
+esp_err_t block_crc_verify(uint32_t slot, uint32_t first_block, uint32_t count,
+                           flash_io_priority_t priority, uint8_t* bad, block_crc_result_t* result)
+{
+    block_crc_result_t local = {0};
+    block_crc_result_t* r = result ? result : &local;
+    memset(r, 0, sizeof(*r));
+    if (bad) {
+        memset(bad, 0, (count + 7) / 8);
+    }
+
+    block_table_t* table = malloc(sizeof(*table));
+    if (!table) {
+        return ESP_ERR_NO_MEM;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = load_table(slot, table);
+    if (ret == ESP_OK) {
+        ret = verify_blocks(table, slot_partition(slot, table->offset), first_block, count, priority, bad, r);
+    }
+    r->elapsed_us = esp_timer_get_time() - start;
+    free(table);
+    return ret;
+}
+
+static uint32_t slot_size(uint32_t offset)
+{
+    uint32_t count = partition_cache_get_count();
+    for (uint32_t i = 0; i < count; i++) {
+        partition_cache_entry_t entry;
+        if (partition_cache_get_entry(i, &entry) == ESP_OK && entry.offset == offset) {
+            return entry.size;
+        }
+    }
+    return 0;
+}
+
+// Erase one block and program it from the source, then check it again.
+// `truncated`: the flasher cut the image short and cleared the header
+// checksum (bytes 24..27), so block 0 must get the same patch
+static esp_err_t rewrite_block(const block_table_t* table, const esp_partition_t* partition, uint32_t block,
+                               FILE* source, bool truncated, uint8_t* buf)
+{
+    uint32_t start = block << BLOCK_CRC_SHIFT;
+    uint32_t length = block_length(table, block);
+    uint32_t erase_length = (length + FLASH_IO_SECTOR_SIZE - 1) & ~(FLASH_IO_SECTOR_SIZE - 1);
+
+    esp_err_t ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, table->offset + start, erase_length);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (fseek(source, start, SEEK_SET) != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (uint32_t pos = 0; pos < length; pos += READ_CHUNK) {
+        uint32_t n = length - pos < READ_CHUNK ? length - pos : READ_CHUNK;
+        if (fread(buf, 1, n, source) != n) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (truncated && start + pos == 0 && n >= 28) {
+            uint32_t magic;
+            memcpy(&magic, buf, sizeof(magic));
+            if (magic == IMAGE_MAGIC) {
+                memset(buf + 24, 0, 4);
+            }
+        }
+        ret = flash_io_write(FLASH_IO_PRIORITY_BULK, buf, table->offset + start + pos, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    uint32_t crc;
+    ret = block_flash_crc(table, partition, block, FLASH_IO_PRIORITY_BULK, &buf, &crc);
+    if (ret == ESP_OK && crc != table->crcs[block]) {
+        ret = ESP_ERR_INVALID_CRC;
+    }
+    return ret;
+}
+
+esp_err_t block_crc_repair(uint32_t slot, const char* source_path, block_crc_result_t* result)
+{
+    block_crc_result_t local = {0};
+    block_crc_result_t* r = result ? result : &local;
+    memset(r, 0, sizeof(*r));
+    if (!source_path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t start = esp_timer_get_time();
+    block_table_t* table = malloc(sizeof(*table));
+    uint8_t* bad = calloc(BLOCK_CRC_MAX_BLOCKS / 8, 1);
+    uint8_t* buf = malloc(READ_CHUNK);
+    FILE* source = NULL;
+    bool claimed = false;
+    uint32_t size = 0;
+    esp_err_t ret = ESP_OK;
+
+    if (!table || !bad || !buf) {
+        ret = ESP_ERR_NO_MEM;
+        goto done;
+    }
+    ret = load_table(slot, table);
+    if (ret != ESP_OK) {
+        goto done;
+    }
+
+    uint32_t count = block_count(table->length);
+    const esp_partition_t* partition = slot_partition(slot, table->offset);
+    ret = verify_blocks(table, partition, 0, count, FLASH_IO_PRIORITY_BULK, bad, r);
+    if (ret != ESP_ERR_INVALID_CRC) {
+        goto done;  // Intact, or a read error
+    }
+
+    source = fopen(source_path, "rb");
+    if (!source) {
+        ESP_LOGE(TAG, "Repair source not found: %s", source_path);
+        ret = ESP_ERR_NOT_FOUND;
+        goto done;
+    }
+    // Same rule as the flasher: a source longer than the image was truncated
+    bool truncated = fseek(source, 0, SEEK_END) == 0 && ftell(source) > (long)table->length;
+
+    size = slot_size(table->offset);
+    ret = ota_preerase_claim(slot, table->offset, size);
+    if (ret != ESP_OK) {
+        goto done;
+    }
+    claimed = true;
+
+    // A repaired slot holds the same image again, so its digest still applies
+    image_digest_record_t digest;
+    bool had_digest = image_digest_cache_get(slot, &digest) == ESP_OK &&
+                      (digest.flags & IMAGE_DIGEST_FLAG_VERIFIED) && digest.offset == table->offset;
+
+    // The slot is inconsistent until every bad block is back
+    ret = image_digest_cache_invalidate(slot, table->offset);
+    if (ret != ESP_OK) {
+        goto done;
+    }
+
+    for (uint32_t b = 0; b < count; b++) {
+        if (!(bad[b / 8] & (1u << (b % 8)))) {
+            continue;
+        }
+        esp_err_t block_ret = rewrite_block(table, partition, b, source, truncated, buf);
+        if (block_ret == ESP_OK) {
+            r->blocks_repaired++;
+        } else {
+            ESP_LOGE(TAG, "Slot %" PRIu32 ": block %" PRIu32 " not repaired: %s",
+                     slot, b, esp_err_to_name(block_ret));
+        }
+    }
+    ret = r->blocks_repaired == r->blocks_bad ? ESP_OK : ESP_ERR_INVALID_CRC;
+
+    // Same image as before under the new generation
+    table->generation = slot_generation(slot);
+    esp_err_t store_ret = store_table(slot, table, true);
+    if (store_ret != ESP_OK) {
+        ESP_LOGW(TAG, "Slot %" PRIu32 ": block table not restamped: %s", slot, esp_err_to_name(store_ret));
+    }
+    if (ret == ESP_OK && had_digest) {
+        esp_err_t digest_ret = image_digest_cache_record(slot, table->offset, digest.length, digest.sha256,
+                                                         digest.flags & IMAGE_DIGEST_FLAG_HASH_APPENDED);
+        if (digest_ret != ESP_OK) {
+            ESP_LOGW(TAG, "Digest not cached for slot %" PRIu32 ", bootloader will validate it fully", slot);
+        }
+    }
+
+done:
+    if (claimed) {
+        ota_preerase_release(slot, table->length);
+    }
+    if (source) {
+        fclose(source);
+    }
+    r->elapsed_us = esp_timer_get_time() - start;
+    if (r->blocks_bad > 0) {
+        ESP_LOGI(TAG, "Slot %" PRIu32 ": %" PRIu32 " of %" PRIu32 " blocks bad, %" PRIu32 " repaired in %" PRIu64 " ms",
+                 slot, r->blocks_bad, r->blocks_checked, r->blocks_repaired, r->elapsed_us / 1000);
+    }
+    free(buf);
+    free(bad);
+    free(table);
+    return ret;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file block_crc.h
+ * @brief Per-64 KiB block CRC table of installed OTA slots
+ *
+ * Installs compute a CRC32 for every 64 KiB block of the image as it is
+ * streamed to flash and store the table in the config log, split over up to
+ * BLOCK_CRC_MAX_PARTS records (a 16 MiB slot needs 1 KiB). Each table is
+ * stamped with the slot's image digest generation, which every write to the
+ * slot bumps, so a table from before a rewrite is ignored. The table last
+ * loaded for each slot is kept in RAM.
+ *
+ * With a table any block range can be verified on its own, and a damaged
+ * slot can be repaired by re-programming only the blocks that fail from the
+ * source image, instead of a full reflash.
+ */
+
+#ifndef BLOCK_CRC_H
+#define BLOCK_CRC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "flash_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCK_CRC_SHIFT      16                     // 64 KiB blocks
+#define BLOCK_CRC_SIZE       (1u << BLOCK_CRC_SHIFT)
+#define BLOCK_CRC_MAX_BLOCKS 256                    // Slots up to 16 MiB
+#define BLOCK_CRC_MAX_PARTS  5                      // Config log records per table
+
+// Config log key of part p of the block table of OTA slot i
+#define CONFIG_LOG_KEY_BLOCK_CRC(i, p) (0x0500 + (i) * 8 + (p))
+
+/**
+ * @brief Table being built while an image is written
+ */
+typedef struct {
+    uint32_t slot;
+    uint32_t offset;       // Slot flash offset
+    uint32_t length;       // Bytes added so far
+    uint32_t crc;          // Running CRC of the current block
+    uint32_t* crcs;        // One entry per finished block
+    bool failed;           // Image larger than BLOCK_CRC_MAX_BLOCKS blocks or out of memory
+} block_crc_builder_t;
+
+/**
+ * @brief Outcome of a verify or repair
+ */
+typedef struct {
+    uint32_t blocks_checked;
+    uint32_t blocks_bad;       // Blocks whose CRC did not match
+    uint32_t blocks_repaired;  // Bad blocks re-programmed and matching again
+    uint64_t elapsed_us;
+} block_crc_result_t;
+
+/**
+ * @brief Create the table cache lock
+ *
+ * Call once at startup, before any install or scrub. Tables cannot be
+ * loaded until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the mutex cannot be created
+ */
+esp_err_t block_crc_init(void);
+
+/**
+ * @brief Start a table for an image about to be written to a slot
+ * @param builder Builder to initialise
+ * @param slot OTA slot index (0 = OTA_0)
+ * @param offset Slot flash offset
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the table cannot be allocated
+ */
+esp_err_t block_crc_begin(block_crc_builder_t* builder, uint32_t slot, uint32_t offset);
+
+/**
+ * @brief Add the next bytes of the image, exactly as programmed
+ * @param builder Builder
+ * @param data Image bytes
+ * @param size Byte count
+ */
+void block_crc_update(block_crc_builder_t* builder, const void* data, size_t size);
+
+/**
+ * @brief Store the table once the image has been written and verified
+ *
+ * Call after image_digest_cache_invalidate() so the table carries the
+ * generation of the new image. Frees the builder in every case.
+ *
+ * @param builder Builder
+ * @param commit false to drop the table (failed install)
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the image was too large,
+ *         ESP_ERR_NO_MEM if the config log has no room left for it
+ */
+esp_err_t block_crc_finish(block_crc_builder_t* builder, bool commit);
+
+/**
+ * @brief Check whether a slot has a table valid for its current image
+ * @param slot OTA slot index
+ * @param length Output image length covered by the table, may be NULL
+ * @return true if a current table exists
+ */
+bool block_crc_available(uint32_t slot, uint32_t* length);
+
+/**
+ * @brief Verify a range of blocks against the table
+ * @param slot OTA slot index
+ * @param first_block First block to check
+ * @param count Blocks to check; clipped to the image
+ * @param priority Flash I/O priority of the reads (background for idle-time checks)
+ * @param bad Output bit per checked block, set if it failed (count bits), may be NULL
+ * @param result Output counters, may be NULL
+ * @return ESP_OK if all blocks match, ESP_ERR_INVALID_CRC if any failed,
+ *         ESP_ERR_NOT_FOUND if the slot has no current table
+ */
+esp_err_t block_crc_verify(uint32_t slot, uint32_t first_block, uint32_t count,
+                           flash_io_priority_t priority, uint8_t* bad, block_crc_result_t* result);
+
+/**
+ * @brief Verify a slot and re-program the blocks that fail from the source image
+ *
+ * The slot is claimed from the background pre-erase and its digest cache
+ * invalidated while blocks are rewritten; the table is restamped afterwards.
+ *
+ * @param slot OTA slot index
+ * @param source_path Source image file (SD card), the same bytes as installed
+ * @param result Output counters, may be NULL
+ * @return ESP_OK if the slot matches its table afterwards,
+ *         ESP_ERR_NOT_FOUND if the slot has no current table or the source is missing,
+ *         ESP_ERR_INVALID_CRC if a block still fails (e.g. the source differs)
+ */
+esp_err_t block_crc_repair(uint32_t slot, const char* source_path, block_crc_result_t* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLOCK_CRC_H
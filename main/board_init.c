@@ -133,9 +133,9 @@ esp_err_t board_init_display(void)
     ESP_LOGI(TAG, "EK79007 display initialized with BALANCED anti-flickering configuration:");
     ESP_LOGI(TAG, "  - DSI Rate: 600Mbps (BALANCED - prevents flickering while maintaining image quality)");
     ESP_LOGI(TAG, "  - Framebuffer: IRAM-only (prevents PSRAM contention)");
-    ESP_LOGI(TAG, "  - SD Throttling: 256-byte chunks with 25ms display refresh");
+    ESP_LOGI(TAG, "  - SD/flash I/O: budgeted by the I/O arbiter while frames are pushed");
     ESP_LOGI(TAG, "  - Task Priority: LVGL highest, OTA very low priority");
-    ESP_LOGI(TAG, "  - Result: Stable image quality + flicker elimination through SD throttling");
+    ESP_LOGI(TAG, "  - Result: Stable image quality + no flicker while SD and flash I/O run");
 
     return ESP_OK;
 }
@@ -0,0 +1,104 @@
+/**
+ * @file boot_request.c
+ * @brief Factory-app side of the boot request protocol
+ */
+
+#include "boot_request.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "soc/lp_system_reg.h"
+
+static const char* TAG = "boot_request";
+
+static void write_words(const uint32_t words[BOOT_REQUEST_WORDS])
+{
+    // Word 0 last: the request only becomes valid once the magic is in place
+    REG_WRITE(BOOT_REQUEST_REG_WORD1, words[1]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD2, words[2]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD3, words[3]);
+    REG_WRITE(BOOT_REQUEST_REG_WORD0, words[0]);
+}
+
+static void read_words(uint32_t words[BOOT_REQUEST_WORDS])
+{
+    words[0] = REG_READ(BOOT_REQUEST_REG_WORD0);
+    words[1] = REG_READ(BOOT_REQUEST_REG_WORD1);
+    words[2] = REG_READ(BOOT_REQUEST_REG_WORD2);
+    words[3] = REG_READ(BOOT_REQUEST_REG_WORD3);
+}
+
+esp_err_t boot_request_set(uint8_t target, bool sticky)
+{
+    boot_request_data_t request = {
+        .version = BOOT_REQUEST_FORMAT_VERSION,
+        .flags = sticky ? BOOT_REQUEST_FLAG_STICKY : 0,
+        .target = target,
+        .attempts = 0,
+        .max_attempts = sticky ? BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS : 0,
+    };
+    uint32_t words[BOOT_REQUEST_WORDS];
+
+    boot_request_encode(&request, words);
+    write_words(words);
+
+    ESP_LOGI(TAG, "Boot request set: target=%u, %s, words=0x%08lx 0x%08lx 0x%08lx 0x%08lx",
+             target, sticky ? "sticky" : "one-time",
+             (unsigned long)words[0], (unsigned long)words[1],
+             (unsigned long)words[2], (unsigned long)words[3]);
+    return ESP_OK;
+}
+
+esp_err_t boot_request_get(boot_request_data_t* request)
+{
+    if (!request) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t words[BOOT_REQUEST_WORDS];
+    read_words(words);
+
+    switch (boot_request_decode(words, request)) {
+    case BOOT_REQUEST_DECODE_OK:
+        return ESP_OK;
+    case BOOT_REQUEST_DECODE_CORRUPT:
+        return ESP_ERR_INVALID_CRC;
+    default:
+        return ESP_ERR_NOT_FOUND;
+    }
+}
+
+esp_err_t boot_request_confirm(void)
+{
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (!running || running->type != ESP_PARTITION_TYPE_APP ||
+        running->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN ||
+        running->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MAX) {
+        return ESP_ERR_NOT_SUPPORTED;  // The factory app is the default target anyway
+    }
+    uint8_t target = (uint8_t)(running->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 1);
+
+    boot_request_data_t request;
+    if (boot_request_get(&request) == ESP_OK && request.version >= BOOT_REQUEST_FORMAT_VERSION &&
+        (request.flags & BOOT_REQUEST_FLAG_STICKY) && request.target == target) {
+        if (request.attempts == 0) {
+            return ESP_OK;  // Nothing to reset
+        }
+        uint32_t words[BOOT_REQUEST_WORDS];
+        boot_request_confirmed(&request);
+        boot_request_encode(&request, words);
+        write_words(words);
+        return ESP_OK;
+    }
+
+    // Launched one-time by the GUI: now that it is healthy, keep it on warm resets
+    return boot_request_set(target, true);
+}
+
+esp_err_t boot_request_clear(void)
+{
+    REG_WRITE(BOOT_REQUEST_REG_WORD0, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD1, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD2, 0);
+    REG_WRITE(BOOT_REQUEST_REG_WORD3, 0);
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file boot_request.h
+ * @brief Factory-app side of the boot request protocol
+ *
+ * Writes and reads the LP store registers described in boot_request_format.h.
+ * The bootloader consumes the request on the next reset.
+ */
+
+#ifndef BOOT_REQUEST_H
+#define BOOT_REQUEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "boot_request_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Request a boot target for the next reset
+ *
+ * @param target BOOT_REQUEST_TARGET_FACTORY or 1-based OTA index
+ * @param sticky true to keep booting the target on warm resets
+ *               (limited to BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS unconfirmed boots)
+ * @return ESP_OK on success
+ */
+esp_err_t boot_request_set(uint8_t target, bool sticky);
+
+/**
+ * @brief Read the request currently held in the registers
+ *
+ * @param request Output decoded request
+ * @return ESP_OK if present, ESP_ERR_NOT_FOUND if none,
+ *         ESP_ERR_INVALID_CRC if the registers hold a damaged v2 request
+ */
+esp_err_t boot_request_get(boot_request_data_t* request);
+
+/**
+ * @brief Confirm that the running OTA app came up healthy
+ *
+ * Not called by the factory app: an OTA app that links boot_request.c calls
+ * it on every start once it is up. The GUI launches apps one-time, so the
+ * first confirm turns that into a sticky request for the running slot; later
+ * calls reset its attempt counter. Warm resets then keep booting the app, and
+ * an app that never confirms (or stops confirming) goes back to the factory
+ * app after a reset.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if not running from an OTA slot
+ */
+esp_err_t boot_request_confirm(void);
+
+/**
+ * @brief Remove any pending request so the next reset boots the factory app
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t boot_request_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_REQUEST_H
@@ -0,0 +1,169 @@
+/**
+ * @file boot_request_format.h
+ * @brief Boot request encoding shared by the factory app and the bootloader
+ *
+ * A boot request tells the second-stage bootloader which app to start after
+ * the next reset. It lives in LP store registers, which survive software,
+ * panic and watchdog resets but are cleared on power-on.
+ *
+ * v1 (legacy, still decoded): a single word, magic 0x544551 in the low
+ * 24 bits and the partition index in the high 8 bits. Always one-time.
+ *
+ * v2: BOOT_REQUEST_WORDS words:
+ *   word 0: BOOT_REQUEST_V2_MAGIC
+ *   word 1: version | flags << 8 | target << 16
+ *   word 2: attempts | max_attempts << 8
+ *   word 3: CRC32 of words 0..2
+ *
+ * A sticky request keeps booting its target on every warm reset. Each boot
+ * counts as an attempt; once max_attempts boots have happened without the
+ * app confirming (boot_request_confirmed()), the bootloader falls back to
+ * the factory app and drops the request, so a crash-looping app cannot lock
+ * the device out of the GUI.
+ *
+ * This header only depends on the C standard library; register access is
+ * left to the caller.
+ */
+
+#ifndef BOOT_REQUEST_FORMAT_H
+#define BOOT_REQUEST_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// LP store registers holding the request (word 0 is the v1 register)
+#define BOOT_REQUEST_REG_WORD0      LP_SYSTEM_REG_LP_STORE0_REG
+#define BOOT_REQUEST_REG_WORD1      LP_SYSTEM_REG_LP_STORE13_REG
+#define BOOT_REQUEST_REG_WORD2      LP_SYSTEM_REG_LP_STORE14_REG
+#define BOOT_REQUEST_REG_WORD3      LP_SYSTEM_REG_LP_STORE15_REG
+
+#define BOOT_REQUEST_WORDS          4
+#define BOOT_REQUEST_V1_MAGIC       0x00544551  // 'BOOT' magic in ASCII, low 24 bits
+#define BOOT_REQUEST_V2_MAGIC       0x32515242  // "BRQ2"
+#define BOOT_REQUEST_FORMAT_VERSION 2
+
+#define BOOT_REQUEST_TARGET_FACTORY 0           // 1..N select OTA_0..OTA_(N-1)
+
+#define BOOT_REQUEST_FLAG_STICKY    0x01        // Keep booting the target on warm resets
+
+#define BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS 3
+
+/**
+ * @brief Decoded boot request
+ */
+typedef struct {
+    uint8_t version;         // 1 (legacy) or 2
+    uint8_t flags;           // BOOT_REQUEST_FLAG_*
+    uint8_t target;          // BOOT_REQUEST_TARGET_FACTORY or 1-based OTA index
+    uint8_t attempts;        // Boots since the request was written or last confirmed
+    uint8_t max_attempts;    // Sticky only: unconfirmed boots before falling back (0 = no limit)
+} boot_request_data_t;
+
+typedef enum {
+    BOOT_REQUEST_DECODE_OK = 0,     // Valid v1 or v2 request
+    BOOT_REQUEST_DECODE_NONE,       // No request present
+    BOOT_REQUEST_DECODE_CORRUPT,    // v2 magic present but version or CRC mismatch
+} boot_request_decode_result_t;
+
+// Plain bitwise CRC-32 (IEEE, reflected), matching esp_rom_crc32_le(0, ...)
+static inline uint32_t boot_request_crc32(const uint32_t* words, size_t count)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < count; i++) {
+        for (int b = 0; b < 4; b++) {
+            crc ^= (words[i] >> (8 * b)) & 0xFFu;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+            }
+        }
+    }
+    return ~crc;
+}
+
+static inline void boot_request_encode(const boot_request_data_t* request, uint32_t words[BOOT_REQUEST_WORDS])
+{
+    words[0] = BOOT_REQUEST_V2_MAGIC;
+    words[1] = (uint32_t)BOOT_REQUEST_FORMAT_VERSION |
+               ((uint32_t)request->flags << 8) |
+               ((uint32_t)request->target << 16);
+    words[2] = (uint32_t)request->attempts | ((uint32_t)request->max_attempts << 8);
+    words[3] = boot_request_crc32(words, 3);
+}
+
+static inline boot_request_decode_result_t boot_request_decode(const uint32_t words[BOOT_REQUEST_WORDS],
+                                                               boot_request_data_t* request)
+{
+    if (words[0] == BOOT_REQUEST_V2_MAGIC) {
+        if ((words[1] & 0xFFu) != BOOT_REQUEST_FORMAT_VERSION ||
+            words[3] != boot_request_crc32(words, 3)) {
+            return BOOT_REQUEST_DECODE_CORRUPT;
+        }
+        request->version = BOOT_REQUEST_FORMAT_VERSION;
+        request->flags = (uint8_t)(words[1] >> 8);
+        request->target = (uint8_t)(words[1] >> 16);
+        request->attempts = (uint8_t)words[2];
+        request->max_attempts = (uint8_t)(words[2] >> 8);
+        return BOOT_REQUEST_DECODE_OK;
+    }
+
+    if ((words[0] & 0x00FFFFFFu) == BOOT_REQUEST_V1_MAGIC) {
+        request->version = 1;
+        request->flags = 0;
+        request->target = (uint8_t)(words[0] >> 24);
+        request->attempts = 0;
+        request->max_attempts = 0;
+        return BOOT_REQUEST_DECODE_OK;
+    }
+
+    return BOOT_REQUEST_DECODE_NONE;
+}
+
+/**
+ * @brief Decide what to boot for a decoded request and what to leave behind
+ *
+ * @param request Request found in the registers
+ * @param next Output: request to write back when the function returns true
+ * @return true to write `next` back, false to clear the registers
+ *
+ * The target to boot now is next->target (BOOT_REQUEST_TARGET_FACTORY when a
+ * sticky request has used up its attempts), also when false is returned.
+ */
+static inline bool boot_request_step(const boot_request_data_t* request, boot_request_data_t* next)
+{
+    *next = *request;
+
+    if (!(request->flags & BOOT_REQUEST_FLAG_STICKY)) {
+        return false;  // One-time request
+    }
+
+    if (request->max_attempts != 0 && request->attempts >= request->max_attempts) {
+        next->target = BOOT_REQUEST_TARGET_FACTORY;  // Crash loop, back to the GUI
+        return false;
+    }
+
+    if (next->attempts < UINT8_MAX) {
+        next->attempts++;
+    }
+    return true;
+}
+
+/**
+ * @brief Reset the attempt counter once the app considers itself healthy
+ *
+ * @param request Request to update
+ */
+static inline void boot_request_confirmed(boot_request_data_t* request)
+{
+    request->attempts = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_REQUEST_FORMAT_H
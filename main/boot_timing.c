@@ -0,0 +1,160 @@
+/**
+ * @file boot_timing.c
+ * @brief Boot-time milestones of the bootloader and the factory app
+ */
+
+#include "boot_timing.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if !defined(__SIMULATOR_BUILD__)
+#include "sdkconfig.h"
+#if CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC
+#include "bootloader_common.h"
+#endif
+#endif
+
+static const char* TAG = "boot_timing";
+
+static uint32_t g_stamps[BOOT_STAGE_COUNT];
+static bool g_recorded[BOOT_STAGE_COUNT];
+static uint64_t g_time_base = 0;
+static bool g_logged = false;
+
+static void import_bootloader_stamps(void)
+{
+#if !defined(__SIMULATOR_BUILD__) && CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC
+    _Static_assert(sizeof(boot_timing_rtc_t) <= CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE,
+                   "CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE too small for boot timing");
+
+    const rtc_retain_mem_t* rtc = bootloader_common_get_rtc_retain_mem();
+    boot_timing_rtc_t record;
+    memcpy(&record, rtc->custom, sizeof(record));
+
+    if (record.magic != BOOT_TIMING_RTC_MAGIC) {
+        ESP_LOGW(TAG, "No bootloader timing record in RTC memory");
+        return;
+    }
+
+    for (int i = 0; i < BOOT_STAGE_BL_COUNT; i++) {
+        if (record.stamp_us[i] != 0) {
+            g_stamps[i] = record.stamp_us[i];
+            g_recorded[i] = true;
+        }
+    }
+#else
+    // The simulator has no second-stage bootloader; those stages stay empty
+#endif
+}
+
+void boot_timing_init(void)
+{
+    memset(g_stamps, 0, sizeof(g_stamps));
+    memset(g_recorded, 0, sizeof(g_recorded));
+    g_logged = false;
+
+#ifdef __SIMULATOR_BUILD__
+    // Host monotonic time has an arbitrary origin; count from process start-up
+    g_time_base = esp_timer_get_time();
+#endif
+
+    import_bootloader_stamps();
+    boot_timing_mark(BOOT_STAGE_APP_START);
+}
+
+void boot_timing_mark(boot_stage_t stage)
+{
+    if (stage < BOOT_STAGE_APP_START || stage >= BOOT_STAGE_COUNT || g_recorded[stage]) {
+        return;
+    }
+
+    g_stamps[stage] = (uint32_t)(esp_timer_get_time() - g_time_base);
+    g_recorded[stage] = true;
+
+    // Marks come from the main, LVGL and startup tasks; log once all ends are in
+    if (g_recorded[BOOT_STAGE_APP_READY] && g_recorded[BOOT_STAGE_APP_FIRST_FLUSH] &&
+        g_recorded[BOOT_STAGE_APP_INTERACTIVE] &&
+        !__atomic_exchange_n(&g_logged, true, __ATOMIC_ACQ_REL)) {
+        boot_timing_log();
+    }
+}
+
+bool boot_timing_get(boot_stage_t stage, uint32_t* us)
+{
+    if (stage >= BOOT_STAGE_COUNT || !g_recorded[stage]) {
+        return false;
+    }
+    if (us) {
+        *us = g_stamps[stage];
+    }
+    return true;
+}
+
+void boot_timing_format(char* buf, size_t size)
+{
+    size_t used = 0;
+
+    if (!buf || size == 0) {
+        return;
+    }
+    buf[0] = '\0';
+
+    for (int i = 0; i < BOOT_STAGE_COUNT && used < size; i++) {
+        if (i == BOOT_STAGE_BL_INIT || i == BOOT_STAGE_APP_START) {
+            used += snprintf(buf + used, size - used, "%s%s\n", used ? "\n" : "",
+                             i == BOOT_STAGE_BL_INIT ? "Bootloader (us since reset)" : "Factory app (us since start)");
+            if (used >= size) {
+                break;
+            }
+        }
+
+        // Deltas are taken against the previous recorded stage of the same
+        // program; parallel app stages can finish out of order and get none
+        uint32_t prev = 0;
+        for (int j = i - 1; j >= (i < BOOT_STAGE_BL_COUNT ? 0 : BOOT_STAGE_APP_START); j--) {
+            if (g_recorded[j]) {
+                prev = g_stamps[j];
+                break;
+            }
+        }
+
+        if (g_recorded[i] && g_stamps[i] >= prev) {
+            used += snprintf(buf + used, size - used, "  %-12s %9" PRIu32 "  (+%" PRIu32 ")\n",
+                             boot_stage_key((boot_stage_t)i), g_stamps[i], g_stamps[i] - prev);
+        } else if (g_recorded[i]) {
+            used += snprintf(buf + used, size - used, "  %-12s %9" PRIu32 "\n",
+                             boot_stage_key((boot_stage_t)i), g_stamps[i]);
+        } else {
+            used += snprintf(buf + used, size - used, "  %-12s %9s\n", boot_stage_key((boot_stage_t)i), "-");
+        }
+    }
+}
+
+void boot_timing_log(void)
+{
+    char line[320];
+    size_t used = snprintf(line, sizeof(line), "BOOT_TIMING v=%d", BOOT_TIMING_FORMAT_VERSION);
+
+    for (int i = 0; i < BOOT_STAGE_COUNT && used < sizeof(line); i++) {
+        if (g_recorded[i]) {
+            used += snprintf(line + used, sizeof(line) - used, " %s=%" PRIu32,
+                             boot_stage_key((boot_stage_t)i), g_stamps[i]);
+        } else {
+            used += snprintf(line + used, sizeof(line) - used, " %s=-", boot_stage_key((boot_stage_t)i));
+        }
+    }
+
+    ESP_LOGI(TAG, "%s", line);
+
+    // Headline startup metrics, in us since app start
+    uint32_t first_pixel = 0;
+    uint32_t interactive = 0;
+    if (boot_timing_get(BOOT_STAGE_APP_FIRST_FLUSH, &first_pixel) &&
+        boot_timing_get(BOOT_STAGE_APP_INTERACTIVE, &interactive)) {
+        ESP_LOGI(TAG, "BOOT_METRICS first_pixel_us=%" PRIu32 " interactive_us=%" PRIu32,
+                 first_pixel, interactive);
+    }
+}
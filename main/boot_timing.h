@@ -0,0 +1,66 @@
+/**
+ * @file boot_timing.h
+ * @brief Boot-time milestones of the bootloader and the factory app
+ *
+ * Collects the bootloader's stage stamps from RTC memory and the factory
+ * app's own milestones. Once the startup tasks are done, the first frame has
+ * been flushed and the app list is shown, two machine-readable lines are
+ * logged:
+ *
+ *   BOOT_TIMING v=1 bl_init=<us> ... app_ready=<us>
+ *   BOOT_METRICS first_pixel_us=<us> interactive_us=<us>
+ *
+ * with "-" for stages that were not recorded (e.g. bootloader stages in the
+ * simulator). The metrics count from app start.
+ */
+
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "boot_timing_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Import the bootloader stamps and record BOOT_STAGE_APP_START
+ *
+ * Call first thing in app_main().
+ */
+void boot_timing_init(void);
+
+/**
+ * @brief Record an app milestone (only the first mark of a stage counts)
+ * @param stage Stage reached
+ */
+void boot_timing_mark(boot_stage_t stage);
+
+/**
+ * @brief Get a stage timestamp
+ * @param stage Stage to query
+ * @param us Output timestamp in microseconds
+ * @return true if the stage was recorded
+ */
+bool boot_timing_get(boot_stage_t stage, uint32_t* us);
+
+/**
+ * @brief Format a human-readable report (one stage per line, with deltas)
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void boot_timing_format(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable BOOT_TIMING and BOOT_METRICS lines
+ */
+void boot_timing_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_TIMING_H
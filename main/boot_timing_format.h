@@ -0,0 +1,71 @@
+/**
+ * @file boot_timing_format.h
+ * @brief Boot stage identifiers and the bootloader-to-app timing record
+ *
+ * The second-stage bootloader stamps its stages from the CPU cycle counter
+ * and leaves them in the custom area of the reserved RTC memory
+ * (CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC). The factory app picks them up and
+ * adds its own milestones (boot_timing.h).
+ *
+ * Bootloader stamps are microseconds since CPU reset; cycles spent by the
+ * ROM before the bootloader raised the CPU clock are converted at the final
+ * clock and therefore under-counted. App stamps are esp_timer microseconds.
+ *
+ * This header only depends on the C standard library.
+ */
+
+#ifndef BOOT_TIMING_FORMAT_H
+#define BOOT_TIMING_FORMAT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_TIMING_RTC_MAGIC       0x424D4954  // "TIMB"
+#define BOOT_TIMING_FORMAT_VERSION  1
+
+typedef enum {
+    // Second-stage bootloader
+    BOOT_STAGE_BL_INIT = 0,          // bootloader_init() done
+    BOOT_STAGE_BL_PARTITION_TABLE,   // Partition table loaded and mapped
+    BOOT_STAGE_BL_REQUEST,           // Boot request decoded
+    BOOT_STAGE_BL_IMAGE_LOAD,        // Boot image loaded and validated, about to jump to it
+    BOOT_STAGE_BL_COUNT,
+
+    // Factory app, roughly in critical-path order; NVS, SD and the app list
+    // are brought up by parallel startup tasks
+    BOOT_STAGE_APP_START = BOOT_STAGE_BL_COUNT,  // app_main() entered
+    BOOT_STAGE_APP_DISPLAY,          // board_init_display() done
+    BOOT_STAGE_APP_LVGL,             // Skeleton UI created (lvgl_bootloader_init())
+    BOOT_STAGE_APP_FIRST_FLUSH,      // First LVGL refresh flushed to the display (first pixel)
+    BOOT_STAGE_APP_NVS,              // NVS and firmware metadata ready
+    BOOT_STAGE_APP_SD_OTA,           // sd_ota_init() returned
+    BOOT_STAGE_APP_INTERACTIVE,      // Installed apps listed on the main screen
+    BOOT_STAGE_APP_READY,            // All startup tasks finished
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+// Record left in the reserved RTC memory by the bootloader
+typedef struct {
+    uint32_t magic;                          // BOOT_TIMING_RTC_MAGIC
+    uint32_t stamp_us[BOOT_STAGE_BL_COUNT];  // 0 = stage not reached
+} boot_timing_rtc_t;
+
+// Keys used in the machine-readable BOOT_TIMING log line
+static inline const char* boot_stage_key(boot_stage_t stage)
+{
+    static const char* const keys[BOOT_STAGE_COUNT] = {
+        "bl_init", "bl_ptable", "bl_request", "bl_load",
+        "app_start", "app_display", "app_lvgl", "first_flush",
+        "app_nvs", "app_sd_ota", "interactive", "app_ready",
+    };
+    return stage < BOOT_STAGE_COUNT ? keys[stage] : "?";
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_TIMING_FORMAT_H
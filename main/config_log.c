@@ -0,0 +1,533 @@
+/**
+ * @file config_log.c
+ * @brief Append-only, log-structured record store on the bootloader_config partition
+ */
+
+#include "config_log.h"
+#include "partition_cache.h"
+#include "esp_log.h"
+#include "flash_io.h"
+#include "esp_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "config_log";
+
+#define NO_SECTOR UINT32_MAX
+
+typedef struct {
+    uint16_t key;
+    bool used;
+    uint32_t sector;         // Sector holding the newest record
+    uint32_t addr;           // Flash address of the record header
+    uint16_t length;         // Payload length
+} log_index_entry_t;
+
+typedef struct {
+    bool ready;
+    uint32_t base;
+    uint32_t sector_count;
+    bool sector_used[CONFIG_LOG_MAX_SECTORS];
+    uint32_t sector_seq[CONFIG_LOG_MAX_SECTORS];
+    uint32_t head;                       // NO_SECTOR until the first sector is opened
+    uint32_t head_offset;
+    uint32_t next_sector_seq;
+    uint32_t next_record_seq;
+    log_index_entry_t index[CONFIG_LOG_MAX_KEYS];
+    config_log_stats_t stats;
+} config_log_t;
+
+static config_log_t g_log = {0};
+static SemaphoreHandle_t g_log_mutex = NULL;
+
+static bool log_lock(void)
+{
+    if (!g_log_mutex) {
+        g_log_mutex = xSemaphoreCreateMutex();
+        if (!g_log_mutex) {
+            ESP_LOGE(TAG, "Failed to create config log mutex");
+            return false;
+        }
+    }
+    return xSemaphoreTake(g_log_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void log_unlock(void)
+{
+    xSemaphoreGive(g_log_mutex);
+}
+
+static int reader_read(void* ctx, uint32_t addr, void* buf, size_t len)
+{
+    (void)ctx;
+    return flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, buf, addr, len) == ESP_OK ? 0 : -1;
+}
+
+static uint32_t reader_crc32(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    return esp_crc32_le(crc, buf, len);
+}
+
+static const config_log_reader_t s_reader = {
+    .read = reader_read,
+    .crc32 = reader_crc32,
+    .ctx = NULL,
+};
+
+static uint32_t sector_addr(uint32_t sector)
+{
+    return g_log.base + sector * CONFIG_LOG_SECTOR_SIZE;
+}
+
+static log_index_entry_t* index_find(uint16_t key)
+{
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        if (g_log.index[i].used && g_log.index[i].key == key) {
+            return &g_log.index[i];
+        }
+    }
+    return NULL;
+}
+
+static log_index_entry_t* index_find_or_alloc(uint16_t key)
+{
+    log_index_entry_t* entry = index_find(key);
+    if (entry) {
+        return entry;
+    }
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        if (!g_log.index[i].used) {
+            g_log.index[i].used = true;
+            g_log.index[i].key = key;
+            return &g_log.index[i];
+        }
+    }
+    return NULL;
+}
+
+// Apply one record to the index (replay and append share this)
+static esp_err_t index_apply(uint16_t key, uint8_t flags, uint32_t sector, uint32_t addr, uint16_t length)
+{
+    if (flags & CONFIG_LOG_FLAG_TOMBSTONE) {
+        // Older copies live in older sectors, which are always erased first,
+        // so a deleted key needs no index slot
+        log_index_entry_t* entry = index_find(key);
+        if (entry) {
+            entry->used = false;
+        }
+        return ESP_OK;
+    }
+
+    log_index_entry_t* entry = index_find_or_alloc(key);
+    if (!entry) {
+        return ESP_ERR_NO_MEM;
+    }
+    entry->sector = sector;
+    entry->addr = addr;
+    entry->length = length;
+    return ESP_OK;
+}
+
+// Program one record at `sector`+`*offset` without touching the index.
+// Caller guarantees it fits.
+static esp_err_t write_record(uint32_t sector, uint32_t* offset, uint16_t key, uint8_t flags,
+                              const void* data, uint16_t length, uint32_t* addr_out)
+{
+    uint8_t buffer[sizeof(config_log_record_header_t) + CONFIG_LOG_MAX_PAYLOAD];
+    config_log_record_header_t* header = (config_log_record_header_t*)buffer;
+    uint32_t padded = config_log_padded_length(length);
+    uint32_t total = sizeof(*header) + padded;
+
+    header->magic = CONFIG_LOG_RECORD_MAGIC;
+    header->key = key;
+    header->length = length;
+    header->flags = flags;
+    header->reserved = 0xFF;
+    header->sequence = g_log.next_record_seq;
+    memset(buffer + sizeof(*header), 0xFF, padded);
+    if (length > 0) {
+        memcpy(buffer + sizeof(*header), data, length);
+    }
+    header->crc = esp_crc32_le(0, buffer, offsetof(config_log_record_header_t, crc));
+    header->crc = esp_crc32_le(header->crc, buffer + sizeof(*header), length);
+
+    uint32_t addr = sector_addr(sector) + *offset;
+    esp_err_t ret = flash_io_write(FLASH_IO_PRIORITY_BULK, buffer, addr, total);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write record 0x%04x at 0x%08" PRIx32 ": %s", key, addr, esp_err_to_name(ret));
+        return ret;
+    }
+
+    *offset += total;
+    *addr_out = addr;
+    g_log.next_record_seq++;
+    g_log.stats.appends++;
+    g_log.stats.bytes_appended += total;
+    return ESP_OK;
+}
+
+// Program one record at the head. Caller guarantees it fits.
+static esp_err_t write_record_at_head(uint16_t key, uint8_t flags, const void* data, uint16_t length)
+{
+    uint32_t addr;
+    esp_err_t ret = write_record(g_log.head, &g_log.head_offset, key, flags, data, length, &addr);
+    if (ret != ESP_OK) {
+        // The space may be partially programmed; never append there again
+        g_log.head_offset = CONFIG_LOG_SECTOR_SIZE;
+        return ret;
+    }
+    return index_apply(key, flags, g_log.head, addr, length);
+}
+
+// Header + padded payload bytes of the live records, optionally of one sector only
+static uint32_t live_bytes(uint32_t sector)
+{
+    uint32_t bytes = 0;
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        const log_index_entry_t* entry = &g_log.index[i];
+        if (entry->used && (sector == NO_SECTOR || entry->sector == sector)) {
+            bytes += sizeof(config_log_record_header_t) + config_log_padded_length(entry->length);
+        }
+    }
+    return bytes;
+}
+
+static esp_err_t erase_sector(uint32_t sector)
+{
+    esp_err_t ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, sector_addr(sector), CONFIG_LOG_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase sector %" PRIu32 ": %s", sector, esp_err_to_name(ret));
+        return ret;
+    }
+    g_log.sector_used[sector] = false;
+    g_log.stats.sectors_erased++;
+    return ESP_OK;
+}
+
+// Move the head to the spare sector after it. The live records of the sector
+// after the spare (the oldest one once the log has wrapped) are copied in
+// first and the sector header is written last, so a reset before the seal
+// leaves an unused sector behind. The oldest sector is erased only after the
+// seal; a reset before that leaves it fully superseded, and it is reused as
+// the next spare. Every key thus stays readable from a sealed sector.
+static esp_err_t open_next_sector(void)
+{
+    uint32_t next = (g_log.head == NO_SECTOR) ? 0 : (g_log.head + 1) % g_log.sector_count;
+    if (g_log.sector_used[next] && live_bytes(next) > 0) {
+        ESP_LOGE(TAG, "No spare sector after sector %" PRIu32 " (%" PRIu32 " bytes live)",
+                 g_log.head, live_bytes(next));
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // With two sectors the head itself is the oldest sector
+    uint32_t victim = (next + 1) % g_log.sector_count;
+    if (!g_log.sector_used[victim]) {
+        victim = NO_SECTOR;
+    }
+
+    // Erase unconditionally: unused sectors may hold old NVS pages or an
+    // unsealed compaction
+    esp_err_t ret = erase_sector(next);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // The live-size budget enforced by append_locked() guarantees the copies fit
+    uint32_t offset = sizeof(config_log_sector_header_t);
+    uint32_t moved[CONFIG_LOG_MAX_KEYS];
+    for (int i = 0; victim != NO_SECTOR && i < CONFIG_LOG_MAX_KEYS; i++) {
+        log_index_entry_t* entry = &g_log.index[i];
+        if (!entry->used || entry->sector != victim) {
+            continue;
+        }
+
+        uint8_t payload[CONFIG_LOG_MAX_PAYLOAD];
+        ret = flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, payload, entry->addr + sizeof(config_log_record_header_t), entry->length);
+        if (ret == ESP_OK) {
+            ret = write_record(next, &offset, entry->key, 0, payload, entry->length, &moved[i]);
+        }
+        if (ret != ESP_OK) {
+            // `next` is still unsealed and the index still points at the victim
+            return ret;
+        }
+        g_log.stats.records_relocated++;
+    }
+
+    config_log_sector_header_t header = {
+        .magic = CONFIG_LOG_SECTOR_MAGIC,
+        .sequence = g_log.next_sector_seq,
+        .version = CONFIG_LOG_FORMAT_VERSION,
+        .reserved = 0xFFFF,
+    };
+    header.header_crc = esp_crc32_le(0, (const uint8_t*)&header, offsetof(config_log_sector_header_t, header_crc));
+
+    ret = flash_io_write(FLASH_IO_PRIORITY_BULK, &header, sector_addr(next), sizeof(header));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write sector header: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    g_log.sector_used[next] = true;
+    g_log.sector_seq[next] = g_log.next_sector_seq++;
+    g_log.head = next;
+    g_log.head_offset = offset;
+
+    if (victim == NO_SECTOR) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        log_index_entry_t* entry = &g_log.index[i];
+        if (entry->used && entry->sector == victim) {
+            entry->sector = next;
+            entry->addr = moved[i];
+        }
+    }
+
+    // A failed erase is retried when the victim comes up as the spare
+    if (erase_sector(victim) == ESP_OK) {
+        g_log.stats.compactions++;
+        ESP_LOGD(TAG, "Compacted sector %" PRIu32 " into sector %" PRIu32, victim, next);
+    }
+    return ESP_OK;
+}
+
+// Replay one sector into the index; returns the end offset of its valid records
+static uint32_t replay_sector(uint32_t sector, bool* torn)
+{
+    uint32_t base = sector_addr(sector);
+    uint32_t offset = sizeof(config_log_sector_header_t);
+
+    *torn = false;
+    while (offset + sizeof(config_log_record_header_t) <= CONFIG_LOG_SECTOR_SIZE) {
+        config_log_record_header_t header;
+        if (flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, &header, base + offset, sizeof(header)) != ESP_OK) {
+            *torn = true;
+            break;
+        }
+        if (!config_log_record_valid(&s_reader, base + offset, &header)) {
+            // Anything other than erased flash is an interrupted append
+            *torn = (header.magic != 0xFFFF);
+            break;
+        }
+        if (index_apply(header.key, header.flags, sector, base + offset, header.length) != ESP_OK) {
+            ESP_LOGW(TAG, "Index full, ignoring key 0x%04x", header.key);
+        }
+        if (header.sequence >= g_log.next_record_seq) {
+            g_log.next_record_seq = header.sequence + 1;
+        }
+        offset += sizeof(header) + config_log_padded_length(header.length);
+    }
+    return offset;
+}
+
+esp_err_t config_log_init(void)
+{
+    if (!log_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    partition_cache_entry_t partition;
+    esp_err_t ret = partition_cache_find_by_label(CONFIG_LOG_PARTITION_LABEL, &partition);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Partition '%s' not found", CONFIG_LOG_PARTITION_LABEL);
+        g_log.ready = false;
+        log_unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memset(&g_log, 0, sizeof(g_log));
+    g_log.base = partition.offset;
+    g_log.sector_count = partition.size / CONFIG_LOG_SECTOR_SIZE;
+    if (g_log.sector_count > CONFIG_LOG_MAX_SECTORS) {
+        g_log.sector_count = CONFIG_LOG_MAX_SECTORS;
+    }
+    g_log.head = NO_SECTOR;
+    g_log.next_sector_seq = 1;
+    g_log.next_record_seq = 1;
+
+    // Compaction needs a spare sector besides the one being compacted
+    if (g_log.sector_count < 2) {
+        log_unlock();
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (uint32_t s = 0; s < g_log.sector_count; s++) {
+        config_log_sector_header_t header;
+        ret = flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, &header, sector_addr(s), sizeof(header));
+        if (ret != ESP_OK) {
+            log_unlock();
+            return ret;
+        }
+        if (config_log_sector_header_valid(&s_reader, &header)) {
+            g_log.sector_used[s] = true;
+            g_log.sector_seq[s] = header.sequence;
+            if (header.sequence >= g_log.next_sector_seq) {
+                g_log.next_sector_seq = header.sequence + 1;
+            }
+        }
+    }
+
+    // Replay sectors oldest first so newer records win
+    bool replayed[CONFIG_LOG_MAX_SECTORS] = {0};
+    uint32_t used_sectors = 0;
+    for (;;) {
+        uint32_t oldest = NO_SECTOR;
+        for (uint32_t s = 0; s < g_log.sector_count; s++) {
+            if (g_log.sector_used[s] && !replayed[s] &&
+                (oldest == NO_SECTOR || g_log.sector_seq[s] < g_log.sector_seq[oldest])) {
+                oldest = s;
+            }
+        }
+        if (oldest == NO_SECTOR) {
+            break;
+        }
+        replayed[oldest] = true;
+        used_sectors++;
+
+        bool torn = false;
+        uint32_t end = replay_sector(oldest, &torn);
+        g_log.head = oldest;
+        g_log.head_offset = torn ? CONFIG_LOG_SECTOR_SIZE : end;
+    }
+
+    g_log.ready = true;
+
+    // A compaction interrupted after its seal leaves a superseded sector
+    // where the spare belongs; open_next_sector() erases it when needed
+    if (g_log.head != NO_SECTOR) {
+        uint32_t spare = (g_log.head + 1) % g_log.sector_count;
+        if (g_log.sector_used[spare] && live_bytes(spare) > 0) {
+            ESP_LOGW(TAG, "Sector %" PRIu32 " after the head still holds live records, log is read-only", spare);
+        }
+    }
+
+    uint32_t live = 0;
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        live += g_log.index[i].used ? 1 : 0;
+    }
+    ESP_LOGI(TAG, "Config log @ 0x%08" PRIx32 ": %" PRIu32 " sectors, %" PRIu32 " in use, %" PRIu32 " live keys",
+             g_log.base, g_log.sector_count, used_sectors, live);
+
+    log_unlock();
+    return ESP_OK;
+}
+
+bool config_log_is_ready(void)
+{
+    return g_log.ready;
+}
+
+static esp_err_t append_locked(uint16_t key, uint8_t flags, const void* data, uint16_t length)
+{
+    if (!g_log.ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // A new key must have an index slot before anything is written
+    if (!(flags & CONFIG_LOG_FLAG_TOMBSTONE) && !index_find(key)) {
+        bool has_free = false;
+        for (int i = 0; i < CONFIG_LOG_MAX_KEYS && !has_free; i++) {
+            has_free = !g_log.index[i].used;
+        }
+        if (!has_free) {
+            ESP_LOGE(TAG, "Too many keys (max %d)", CONFIG_LOG_MAX_KEYS);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // The superseded copy still counts: it is relocated if compaction runs
+    // before this record is written. Tombstones may use the headroom the
+    // budget leaves, so a full store can still delete keys.
+    uint32_t needed = sizeof(config_log_record_header_t) + config_log_padded_length(length);
+    uint32_t budget = (flags & CONFIG_LOG_FLAG_TOMBSTONE) ? CONFIG_LOG_SECTOR_CAPACITY : CONFIG_LOG_LIVE_BUDGET;
+    if (live_bytes(NO_SECTOR) + needed > budget) {
+        ESP_LOGE(TAG, "Live records would exceed %" PRIu32 " bytes", budget);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (g_log.head == NO_SECTOR || g_log.head_offset + needed > CONFIG_LOG_SECTOR_SIZE) {
+        esp_err_t ret = open_next_sector();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    return write_record_at_head(key, flags, data, length);
+}
+
+esp_err_t config_log_append(uint16_t key, const void* data, uint16_t length)
+{
+    if ((!data && length > 0) || length > CONFIG_LOG_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!log_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = append_locked(key, 0, data, length);
+    log_unlock();
+    return ret;
+}
+
+esp_err_t config_log_delete(uint16_t key)
+{
+    if (!log_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (index_find(key)) {
+        ret = append_locked(key, CONFIG_LOG_FLAG_TOMBSTONE, NULL, 0);
+    }
+
+    log_unlock();
+    return ret;
+}
+
+esp_err_t config_log_read(uint16_t key, void* data, size_t* length)
+{
+    if (!length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!log_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    log_index_entry_t* entry = g_log.ready ? index_find(key) : NULL;
+    if (entry) {
+        if (!data) {
+            ret = ESP_OK;
+        } else if (*length < entry->length) {
+            ret = ESP_ERR_INVALID_SIZE;
+        } else {
+            ret = flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, data, entry->addr + sizeof(config_log_record_header_t), entry->length);
+        }
+        *length = entry->length;
+    }
+
+    log_unlock();
+    return ret;
+}
+
+bool config_log_has_records(void)
+{
+    for (int i = 0; i < CONFIG_LOG_MAX_KEYS; i++) {
+        if (g_log.index[i].used) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void config_log_get_stats(config_log_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    *stats = g_log.stats;
+    stats->sector_count = g_log.sector_count;
+    stats->head_sector = g_log.head;
+    stats->head_offset = g_log.head_offset;
+}
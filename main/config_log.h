@@ -0,0 +1,118 @@
+/**
+ * @file config_log.h
+ * @brief Append-only, log-structured record store on the bootloader_config partition
+ *
+ * Small keyed records are appended to the partition instead of going through
+ * the NVS key/value machinery. A RAM index maps each key to its newest record,
+ * so a lookup is a single flash read. One sector is kept erased ahead of
+ * the head; when the head fills up, the live records of the oldest sector
+ * are copied into that spare, which is sealed before the oldest sector is
+ * erased. The on-flash format is defined in config_log_format.h and can be
+ * parsed by the second-stage bootloader.
+ */
+
+#ifndef CONFIG_LOG_H
+#define CONFIG_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "config_log_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of distinct live keys
+#define CONFIG_LOG_MAX_KEYS 64
+
+// Record bytes a sector holds after its header
+#define CONFIG_LOG_SECTOR_CAPACITY (CONFIG_LOG_SECTOR_SIZE - sizeof(config_log_sector_header_t))
+
+// Live records (headers + padded payloads) must fit into one sector for
+// compaction, with room left for a tombstone: firmware metadata (~2.1 KB) +
+// image digests (~1 KB) + pre-erase blank maps (~40 bytes each for slots up
+// to 8 MB) + scrub state (~150 bytes). Block CRC tables take what is left
+// and are dropped when they do not fit.
+#define CONFIG_LOG_LIVE_BUDGET (CONFIG_LOG_SECTOR_CAPACITY - sizeof(config_log_record_header_t))
+
+/**
+ * @brief Config log statistics since init
+ */
+typedef struct {
+    uint32_t appends;            // Records appended (including tombstones)
+    uint32_t bytes_appended;     // Header + payload bytes programmed
+    uint32_t sectors_erased;     // Sectors erased (opening or compaction)
+    uint32_t compactions;        // Oldest-sector compactions
+    uint32_t records_relocated;  // Live records copied forward by compaction
+    uint32_t sector_count;       // Sectors in the log region
+    uint32_t head_sector;        // Sector currently being appended to
+    uint32_t head_offset;        // Write offset within the head sector
+} config_log_stats_t;
+
+/**
+ * @brief Locate the partition and build the RAM index
+ *
+ * Scans the sector headers and the records of every sector in use. A
+ * partition that holds no log yet (blank or old NVS pages) is adopted as-is;
+ * sectors are erased lazily when the log first needs them.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the partition is missing,
+ *         ESP_ERR_INVALID_SIZE if it is smaller than two sectors
+ */
+esp_err_t config_log_init(void);
+
+/**
+ * @brief Check whether config_log_init() succeeded
+ * @return true if the store is usable
+ */
+bool config_log_is_ready(void);
+
+/**
+ * @brief Append a record for a key, superseding any previous one
+ *
+ * @param key Record key
+ * @param data Payload
+ * @param length Payload length (at most CONFIG_LOG_MAX_PAYLOAD)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if CONFIG_LOG_MAX_KEYS or
+ *         CONFIG_LOG_LIVE_BUDGET would be exceeded
+ */
+esp_err_t config_log_append(uint16_t key, const void* data, uint16_t length);
+
+/**
+ * @brief Append a tombstone for a key
+ *
+ * @param key Record key
+ * @return ESP_OK on success (also when the key did not exist)
+ */
+esp_err_t config_log_delete(uint16_t key);
+
+/**
+ * @brief Read the newest record for a key
+ *
+ * @param key Record key
+ * @param data Output buffer (NULL to query the length only)
+ * @param length In: buffer size, out: payload length
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if absent or deleted,
+ *         ESP_ERR_INVALID_SIZE if the buffer is too small
+ */
+esp_err_t config_log_read(uint16_t key, void* data, size_t* length);
+
+/**
+ * @brief Check whether any live record exists
+ * @return true if at least one key is stored
+ */
+bool config_log_has_records(void);
+
+/**
+ * @brief Get statistics since init
+ * @param stats Output statistics
+ */
+void config_log_get_stats(config_log_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFIG_LOG_H
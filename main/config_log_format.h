@@ -0,0 +1,195 @@
+/**
+ * @file config_log_format.h
+ * @brief On-flash format of the log-structured config store
+ *
+ * Shared by the factory app (config_log.c) and the second-stage bootloader,
+ * which cannot link NVS. This header only depends on the C standard library;
+ * flash access and CRC are supplied by the caller through config_log_reader_t.
+ *
+ * Layout: the bootloader_config partition is split into 4 KB sectors. Each
+ * sector in use starts with a config_log_sector_header_t whose sequence
+ * number orders the sectors from oldest to newest. Records are appended
+ * after the header, each one a config_log_record_header_t followed by its
+ * payload padded to 4 bytes. Erased flash (0xFF) ends the records of a
+ * sector. The newest record for a key wins; a tombstone record deletes it.
+ */
+
+#ifndef CONFIG_LOG_FORMAT_H
+#define CONFIG_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONFIG_LOG_PARTITION_LABEL  "bootloader_config"
+#define CONFIG_LOG_SECTOR_SIZE      4096
+#define CONFIG_LOG_MAX_SECTORS      32          // Log region is capped at 128 KB to bound boot-time scans
+#define CONFIG_LOG_SECTOR_MAGIC     0x474F4C43  // "CLOG"
+#define CONFIG_LOG_RECORD_MAGIC     0x5243      // "CR"
+#define CONFIG_LOG_FORMAT_VERSION   1
+#define CONFIG_LOG_MAX_PAYLOAD      256
+#define CONFIG_LOG_FLAG_TOMBSTONE   0x01
+
+// Well-known keys
+#define CONFIG_LOG_KEY_FW_COUNT     0x0100      // uint32_t firmware count
+#define CONFIG_LOG_KEY_FW_RECORD(i) (0x0110 + (i))  // Firmware metadata record i
+
+// Sector header, first 16 bytes of every sector in use
+typedef struct __attribute__((packed)) {
+    uint32_t magic;          // CONFIG_LOG_SECTOR_MAGIC
+    uint32_t sequence;       // Increases by one each time a sector is opened
+    uint16_t version;        // CONFIG_LOG_FORMAT_VERSION
+    uint16_t reserved;       // 0xFFFF
+    uint32_t header_crc;     // CRC32 of the preceding fields
+} config_log_sector_header_t;
+
+// Record header, followed by `length` payload bytes padded to 4 bytes
+typedef struct __attribute__((packed)) {
+    uint16_t magic;          // CONFIG_LOG_RECORD_MAGIC
+    uint16_t key;            // Record key
+    uint16_t length;         // Payload length (0 for a tombstone)
+    uint8_t flags;           // CONFIG_LOG_FLAG_*
+    uint8_t reserved;        // 0xFF
+    uint32_t sequence;       // Global append sequence number
+    uint32_t crc;            // CRC32 of the preceding fields and the payload
+} config_log_record_header_t;
+
+/**
+ * @brief Flash access used by the shared parser
+ */
+typedef struct {
+    int (*read)(void* ctx, uint32_t addr, void* buf, size_t len);      // 0 on success
+    uint32_t (*crc32)(uint32_t crc, const uint8_t* buf, uint32_t len);  // CRC32 (little endian, ROM compatible)
+    void* ctx;
+} config_log_reader_t;
+
+static inline uint32_t config_log_padded_length(uint16_t length)
+{
+    return ((uint32_t)length + 3u) & ~3u;
+}
+
+static inline bool config_log_sector_header_valid(const config_log_reader_t* reader,
+                                                  const config_log_sector_header_t* header)
+{
+    return header->magic == CONFIG_LOG_SECTOR_MAGIC &&
+           header->version == CONFIG_LOG_FORMAT_VERSION &&
+           header->header_crc == reader->crc32(0, (const uint8_t*)header,
+                                               offsetof(config_log_sector_header_t, header_crc));
+}
+
+/**
+ * @brief Check a record's CRC, reading the payload in small chunks
+ *
+ * @return true if the header magic and CRC match
+ */
+static inline bool config_log_record_valid(const config_log_reader_t* reader, uint32_t record_addr,
+                                           const config_log_record_header_t* header)
+{
+    if (header->magic != CONFIG_LOG_RECORD_MAGIC || header->length > CONFIG_LOG_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint8_t chunk[64];
+    uint32_t crc = reader->crc32(0, (const uint8_t*)header, offsetof(config_log_record_header_t, crc));
+    uint32_t addr = record_addr + sizeof(*header);
+    uint32_t remaining = header->length;
+
+    while (remaining > 0) {
+        uint32_t n = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+        if (reader->read(reader->ctx, addr, chunk, n) != 0) {
+            return false;
+        }
+        crc = reader->crc32(crc, chunk, n);
+        addr += n;
+        remaining -= n;
+    }
+
+    return crc == header->crc;
+}
+
+/**
+ * @brief Find the newest record for a key without building an index
+ *
+ * Walks sectors from newest to oldest and returns the last valid record for
+ * the key in the first sector that has one. Intended for the bootloader,
+ * where only a handful of keys are read once.
+ *
+ * @param reader Flash access callbacks
+ * @param base Partition start address
+ * @param sector_count Number of sectors in the log region
+ * @param key Key to look up
+ * @param payload_addr Output flash address of the payload
+ * @param length Output payload length
+ * @return 0 if found, 1 if absent or deleted, -1 on read error
+ */
+static inline int config_log_find(const config_log_reader_t* reader, uint32_t base,
+                                  uint32_t sector_count, uint16_t key,
+                                  uint32_t* payload_addr, uint16_t* length)
+{
+    uint32_t sequences[CONFIG_LOG_MAX_SECTORS];
+    bool visited[CONFIG_LOG_MAX_SECTORS];
+
+    if (sector_count > CONFIG_LOG_MAX_SECTORS) {
+        sector_count = CONFIG_LOG_MAX_SECTORS;
+    }
+
+    for (uint32_t s = 0; s < sector_count; s++) {
+        config_log_sector_header_t header;
+        if (reader->read(reader->ctx, base + s * CONFIG_LOG_SECTOR_SIZE, &header, sizeof(header)) != 0) {
+            return -1;
+        }
+        visited[s] = !config_log_sector_header_valid(reader, &header);
+        sequences[s] = header.sequence;
+    }
+
+    for (;;) {
+        // Next newest sector not visited yet
+        int newest = -1;
+        for (uint32_t s = 0; s < sector_count; s++) {
+            if (!visited[s] && (newest < 0 || sequences[s] > sequences[newest])) {
+                newest = (int)s;
+            }
+        }
+        if (newest < 0) {
+            return 1;
+        }
+        visited[newest] = true;
+
+        uint32_t sector_addr = base + (uint32_t)newest * CONFIG_LOG_SECTOR_SIZE;
+        uint32_t offset = sizeof(config_log_sector_header_t);
+        bool found = false;
+        bool deleted = false;
+
+        while (offset + sizeof(config_log_record_header_t) <= CONFIG_LOG_SECTOR_SIZE) {
+            config_log_record_header_t header;
+            if (reader->read(reader->ctx, sector_addr + offset, &header, sizeof(header)) != 0) {
+                return -1;
+            }
+            // Erased space or a torn append ends the sector
+            if (!config_log_record_valid(reader, sector_addr + offset, &header)) {
+                break;
+            }
+            if (header.key == key) {
+                found = true;
+                deleted = (header.flags & CONFIG_LOG_FLAG_TOMBSTONE) != 0;
+                *payload_addr = sector_addr + offset + sizeof(header);
+                *length = header.length;
+            }
+            offset += sizeof(header) + config_log_padded_length(header.length);
+        }
+
+        if (found) {
+            return deleted ? 1 : 0;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFIG_LOG_FORMAT_H
@@ -0,0 +1,181 @@
+/**
+ * @file firmware_catalog.c
+ * @brief Preloaded catalog of installed firmwares for the boot menu
+ */
+
+#include "firmware_catalog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "fw_catalog";
+
+static firmware_catalog_entry_t g_entries[MAX_FIRMWARE_ENTRIES];
+static uint32_t g_count = 0;
+static uint32_t g_generation = 0;
+static SemaphoreHandle_t g_catalog_mutex = NULL;
+static SemaphoreHandle_t g_refresh = NULL;
+static bool g_started = false;
+
+// Only the catalog task builds, so the scratch copies can be static
+static firmware_metadata_t s_metadata[MAX_FIRMWARE_ENTRIES];
+static firmware_catalog_entry_t s_build[MAX_FIRMWARE_ENTRIES];
+
+// Fails until firmware_catalog_start() has created the mutex
+static bool catalog_lock(void)
+{
+    return g_catalog_mutex && xSemaphoreTake(g_catalog_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void catalog_unlock(void)
+{
+    xSemaphoreGive(g_catalog_mutex);
+}
+
+static void read_app_desc(firmware_catalog_entry_t* entry)
+{
+    const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, entry->metadata.partition);
+    if (!partition) {
+        ESP_LOGW(TAG, "Partition %s not found", entry->metadata.partition);
+        return;
+    }
+
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(partition, &desc) != ESP_OK) {
+        ESP_LOGD(TAG, "No app descriptor in %s", entry->metadata.partition);
+        return;
+    }
+
+    strncpy(entry->project_name, desc.project_name, sizeof(entry->project_name) - 1);
+    strncpy(entry->version, desc.version, sizeof(entry->version) - 1);
+    strncpy(entry->build_date, desc.date, sizeof(entry->build_date) - 1);
+    entry->has_app_desc = true;
+}
+
+static void catalog_build(void)
+{
+    int64_t start = esp_timer_get_time();
+
+    uint32_t count = 0;
+    esp_err_t ret = firmware_metadata_get_all(s_metadata, MAX_FIRMWARE_ENTRIES, &count);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to read firmware metadata: %s", esp_err_to_name(ret));
+        count = 0;
+    }
+
+    memset(s_build, 0, sizeof(s_build));
+    for (uint32_t i = 0; i < count; i++) {
+        s_build[i].metadata = s_metadata[i];
+        read_app_desc(&s_build[i]);
+    }
+
+    if (!catalog_lock()) {
+        return;
+    }
+    memcpy(g_entries, s_build, sizeof(g_entries));
+    g_count = count;
+    if (++g_generation == 0) {
+        g_generation = 1;  // 0 means "not built yet"
+    }
+    uint32_t generation = g_generation;
+    catalog_unlock();
+
+    ESP_LOGI(TAG, "Catalog built: %" PRIu32 " entries in %" PRId64 " us (generation %" PRIu32 ")",
+             count, esp_timer_get_time() - start, generation);
+}
+
+// Runs in the writer's task; the rebuild happens in the catalog task
+static void catalog_metadata_listener(const firmware_metadata_event_t* event, void* user_data)
+{
+    (void)event;
+    (void)user_data;
+    xSemaphoreGive(g_refresh);
+}
+
+static void catalog_task(void* arg)
+{
+    (void)arg;
+
+    while (1) {
+        xSemaphoreTake(g_refresh, portMAX_DELAY);
+        catalog_build();
+    }
+}
+
+esp_err_t firmware_catalog_start(void)
+{
+    if (g_started) {
+        return ESP_OK;
+    }
+
+    // Created before the task so readers never race to create them
+    if (!g_catalog_mutex) {
+        g_catalog_mutex = xSemaphoreCreateMutex();
+    }
+    if (!g_refresh) {
+        g_refresh = xSemaphoreCreateBinary();
+    }
+    if (!g_catalog_mutex || !g_refresh) {
+        ESP_LOGE(TAG, "Failed to create catalog semaphores");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = firmware_metadata_subscribe(catalog_metadata_listener, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to subscribe to metadata changes: %s", esp_err_to_name(ret));
+    }
+
+    // Low priority: flash reads here must not hold up the UI or OTA
+    if (xTaskCreatePinnedToCore(catalog_task, "fw_catalog", 4096, NULL, 3, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create catalog task");
+        firmware_metadata_unsubscribe(catalog_metadata_listener, NULL);
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_started = true;
+    xSemaphoreGive(g_refresh);  // Initial build
+    return ESP_OK;
+}
+
+uint32_t firmware_catalog_get_generation(void)
+{
+    if (!catalog_lock()) {
+        return 0;
+    }
+    uint32_t generation = g_generation;
+    catalog_unlock();
+    return generation;
+}
+
+esp_err_t firmware_catalog_get_all(firmware_catalog_entry_t* entries, uint32_t max_entries,
+                                   uint32_t* count, uint32_t* generation)
+{
+    if (!entries || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!catalog_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (g_generation == 0) {
+        catalog_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t n = g_count < max_entries ? g_count : max_entries;
+    memcpy(entries, g_entries, n * sizeof(*entries));
+    *count = n;
+    if (generation) {
+        *generation = g_generation;
+    }
+
+    catalog_unlock();
+    return ESP_OK;
+}
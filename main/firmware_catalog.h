@@ -0,0 +1,67 @@
+/**
+ * @file firmware_catalog.h
+ * @brief Preloaded catalog of installed firmwares for the boot menu
+ *
+ * The catalog joins the stored firmware metadata with the app descriptor
+ * (project name, version, build date) read from each OTA slot's image
+ * header. A background task builds it right after startup and rebuilds it
+ * whenever the firmware metadata changes, so the boot menu can be drawn
+ * from RAM without touching flash or NVS.
+ */
+
+#ifndef FIRMWARE_CATALOG_H
+#define FIRMWARE_CATALOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "firmware_metadata.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Installed firmware as shown in the boot menu
+ */
+typedef struct {
+    firmware_metadata_t metadata;  // Stored metadata record
+    bool has_app_desc;             // App descriptor found in the slot
+    char project_name[32];         // From the app descriptor
+    char version[32];
+    char build_date[16];
+} firmware_catalog_entry_t;
+
+/**
+ * @brief Start the background catalog task
+ *
+ * Builds the catalog once and subscribes to metadata changes to keep it
+ * current. Call after firmware_metadata_init(); later calls are no-ops.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t firmware_catalog_start(void);
+
+/**
+ * @brief Get the catalog generation
+ * @return 0 until the first build has finished, then bumped on every rebuild
+ */
+uint32_t firmware_catalog_get_generation(void);
+
+/**
+ * @brief Copy the current catalog
+ *
+ * @param entries Output array
+ * @param max_entries Capacity of the output array
+ * @param count Output parameter for the number of entries copied
+ * @param generation Output parameter for the generation of the copy (can be NULL)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before the first build
+ */
+esp_err_t firmware_catalog_get_all(firmware_catalog_entry_t* entries, uint32_t max_entries,
+                                   uint32_t* count, uint32_t* generation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FIRMWARE_CATALOG_H
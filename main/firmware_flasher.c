@@ -5,9 +5,14 @@
 
 #include "firmware_flasher.h"
 #include "partition_manager.h"
+#include "partition_cache.h"
 #include "firmware_validator.h"
 #include "firmware_selector.h"
-#include "firmware_metadata.h"
+#include "image_digest_cache.h"
+#include "ota_preerase.h"
+#include "block_crc.h"
+#include "flash_io.h"
+#include "sd_reader.h"
 #include "esp_log.h"
 #include "esp_partition.h"
 #include "esp_flash.h"
@@ -18,17 +23,22 @@
 #include "esp_flash.h"
 #include "esp_flash_partitions.h"
 #include "mbedtls/md5.h"
+#ifndef __SIMULATOR_BUILD__
+#include "mbedtls/sha256.h"
+#endif
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 static const char* TAG = "firmware_flasher";
 
 
 #define ESP_PARTITION_SUBTYPE_DATA_PARTITION_TABLE 0x01
 #define MD5_SIZE 16
+#define VERIFY_RETRIES 2  // Re-programs of a chunk whose read-back differs
 
 // Global state
 static flash_config_t g_flash_config = {0};
@@ -48,6 +58,9 @@ static esp_err_t flash_firmware_list(void);
 static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmware,
                                                      const esp_partition_t* ota_partition,
                                                      uint32_t firmware_index);
+static esp_err_t write_firmware_to_partition(const firmware_info_t* firmware,
+                                             const esp_partition_t* ota_partition,
+                                             uint32_t firmware_index);
 static esp_err_t verify_firmware_in_partition(const firmware_info_t* firmware,
                                                const esp_partition_t* ota_partition);
 // static esp_err_t firmware_flasher_create_ota_table - declared in header
@@ -331,11 +344,12 @@ static void flash_task(void* arg)
         return;
     }
 
-    // Step 4: Verify flashed firmware (always enabled)
-    g_flash_state = FLASH_STATE_VERIFYING;
-    notify_status(g_flash_state, FLASH_RESULT_SUCCESS, "Verifying flashed firmware");
-
-    ret = verify_all_firmwares();
+    // Step 4: Re-read every slot when a full pass was chosen over inline read-back
+    if (g_flash_config.enable_verification && g_flash_config.verify_full_pass) {
+        g_flash_state = FLASH_STATE_VERIFYING;
+        notify_status(g_flash_state, FLASH_RESULT_SUCCESS, "Verifying flashed firmware");
+        ret = verify_all_firmwares();
+    }
     if (ret != ESP_OK) {
         g_flash_result = FLASH_RESULT_ERROR_CRC_MISMATCH;
         g_flash_state = FLASH_STATE_ERROR;
@@ -413,6 +427,7 @@ static esp_err_t flash_firmware_list(void)
         temp_partition.type = ESP_PARTITION_TYPE_APP;
         temp_partition.subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0 + i;
         temp_partition.encrypted = assigned_part->is_encrypted;
+        temp_partition.flash_chip = esp_flash_default_chip;  // Needed by esp_partition_mmap() for verification
         strncpy(temp_partition.label, partition_name, sizeof(temp_partition.label) - 1);
 
         ESP_LOGI(TAG, "Using dynamic partition from layout: %s (offset: 0x%08x, size: %u bytes)",
@@ -448,6 +463,213 @@ static esp_err_t flash_firmware_list(void)
     return g_abort_requested ? ESP_ERR_INVALID_STATE : ESP_OK;
 }
 
+// Program one chunk; its first header_len bytes come from `header` (the
+// patched image header) instead of `data`
+static esp_err_t program_chunk(const uint8_t* header, size_t header_len, const uint8_t* data,
+                               uint32_t flash_offset, size_t len)
+{
+    esp_err_t ret = ESP_OK;
+    if (header_len > 0) {
+        ret = flash_io_write(FLASH_IO_PRIORITY_BULK, header, flash_offset, header_len);
+    }
+    if (ret == ESP_OK && len > header_len) {
+        ret = flash_io_write(FLASH_IO_PRIORITY_BULK, data + header_len, flash_offset + header_len,
+                             len - header_len);
+    }
+    return ret;
+}
+
+// Inline verification state of one install
+typedef struct {
+    const esp_partition_t* partition;  // Chunks are compared in place through a mapping of it
+    uint8_t* scratch;                  // Read-back copy where they cannot be, allocated on first use
+    size_t scratch_size;
+} readback_t;
+
+static uint8_t* readback_scratch(readback_t* rb)
+{
+    if (!rb->scratch) {
+        rb->scratch_size = SD_READER_BUFFER_SIZE;
+        rb->scratch = malloc(rb->scratch_size);
+        if (!rb->scratch) {
+            rb->scratch_size = FLASH_IO_SECTOR_SIZE;
+            rb->scratch = malloc(rb->scratch_size);
+        }
+        if (!rb->scratch) {
+            ESP_LOGE(TAG, "Failed to allocate read-back buffer");
+        }
+    }
+    return rb->scratch;
+}
+
+// Compare a programmed chunk with the source still in memory, through the
+// flash cache or, without a mapping, by reading it back
+static esp_err_t readback_chunk(const uint8_t* header, size_t header_len, const uint8_t* data,
+                                uint32_t flash_offset, size_t len, readback_t* rb)
+{
+    flash_io_map_t map;
+    if (flash_io_map(rb->partition, flash_offset - rb->partition->address, len, &map) == ESP_OK) {
+        size_t h = header_len < len ? header_len : len;
+        bool match = memcmp(map.data, header, h) == 0 && memcmp(map.data + h, data + h, len - h) == 0;
+        flash_io_unmap(&map);
+        return match ? ESP_OK : ESP_ERR_INVALID_CRC;
+    }
+
+    uint8_t* scratch = readback_scratch(rb);
+    if (!scratch) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t pos = 0; pos < len; ) {
+        size_t n = len - pos < rb->scratch_size ? len - pos : rb->scratch_size;
+        esp_err_t ret = flash_io_read(FLASH_IO_PRIORITY_BULK, scratch, flash_offset + pos, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        size_t h = pos < header_len ? (header_len - pos < n ? header_len - pos : n) : 0;
+        if (memcmp(scratch, header + pos, h) != 0 || memcmp(scratch + h, data + pos + h, n - h) != 0) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        pos += n;
+    }
+    return ESP_OK;
+}
+
+// Erase the sectors under a chunk and program it again. Bytes of the
+// previous chunk that share its first sector are read back and restored;
+// everything after the chunk is still erased
+static esp_err_t reprogram_chunk(const uint8_t* header, size_t header_len, const uint8_t* data,
+                                 uint32_t flash_offset, size_t len, readback_t* rb)
+{
+    uint32_t start = flash_offset & ~(FLASH_IO_SECTOR_SIZE - 1);
+    uint32_t end = (flash_offset + len + FLASH_IO_SECTOR_SIZE - 1) & ~(FLASH_IO_SECTOR_SIZE - 1);
+    uint32_t keep = flash_offset - start;
+
+    uint8_t* scratch = keep > 0 ? readback_scratch(rb) : NULL;
+    if (keep > 0 && !scratch) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (keep > 0) {
+        ret = flash_io_read(FLASH_IO_PRIORITY_BULK, scratch, start, keep);
+    }
+    if (ret == ESP_OK) {
+        ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, start, end - start);
+    }
+    if (ret == ESP_OK && keep > 0) {
+        ret = flash_io_write(FLASH_IO_PRIORITY_BULK, scratch, start, keep);
+    }
+    if (ret == ESP_OK) {
+        ret = program_chunk(header, header_len, data, flash_offset, len);
+    }
+    return ret;
+}
+
+// Program a chunk and, with inline verification (`rb` not NULL), check it
+// while the source is still in memory; a mismatch costs a re-program of
+// this chunk
+static esp_err_t write_chunk_verified(const uint8_t* header, size_t header_len, const uint8_t* data,
+                                      uint32_t flash_offset, size_t len, readback_t* rb)
+{
+    esp_err_t ret = program_chunk(header, header_len, data, flash_offset, len);
+    if (!rb) {
+        return ret;
+    }
+
+    for (int attempt = 0; ret == ESP_OK; attempt++) {
+        ret = readback_chunk(header, header_len, data, flash_offset, len, rb);
+        if (ret != ESP_ERR_INVALID_CRC) {
+            break;
+        }
+        if (attempt == VERIFY_RETRIES) {
+            xSemaphoreTake(g_flash_mutex, portMAX_DELAY);
+            g_flash_stats.verification_errors++;
+            xSemaphoreGive(g_flash_mutex);
+            break;
+        }
+
+        ESP_LOGW(TAG, "Read-back mismatch at 0x%08" PRIx32 " (%zu bytes), re-programming (%d/%d)",
+                 flash_offset, len, attempt + 1, VERIFY_RETRIES);
+        xSemaphoreTake(g_flash_mutex, portMAX_DELAY);
+        g_flash_stats.verify_retries++;
+        xSemaphoreGive(g_flash_mutex);
+        ret = reprogram_chunk(header, header_len, data, flash_offset, len, rb);
+    }
+    return ret;
+}
+
+// SHA-256 of an app image as it is programmed, checked against the digest
+// the image carries in its last 32 bytes
+typedef struct {
+#ifndef __SIMULATOR_BUILD__
+    mbedtls_sha256_context sha;
+#endif
+    bool active;                         // App image with an appended digest, header unchanged
+    uint32_t body;                       // Bytes the appended digest covers
+    uint32_t seen;                       // Bytes passed to image_hash_update()
+    uint8_t appended[IMAGE_DIGEST_LEN];  // The digest the image carries
+} image_hash_t;
+
+static void image_hash_begin(image_hash_t* h, const uint8_t* header, size_t header_len,
+                             uint32_t total_bytes, bool header_patched)
+{
+    memset(h, 0, sizeof(*h));
+#ifdef __SIMULATOR_BUILD__
+    (void)header;
+    (void)header_len;
+    (void)total_bytes;
+    (void)header_patched;
+#else
+    // Byte 23 of the image header is its hash_appended flag
+    h->active = header_len >= 24 && header[0] == 0xE9 && header[23] == 1 && !header_patched &&
+                total_bytes > 24 + IMAGE_DIGEST_LEN;
+    if (h->active) {
+        h->body = total_bytes - IMAGE_DIGEST_LEN;
+        mbedtls_sha256_init(&h->sha);
+        mbedtls_sha256_starts(&h->sha, 0);
+    }
+#endif
+}
+
+static void image_hash_update(image_hash_t* h, const uint8_t* data, size_t len)
+{
+    if (!h->active) {
+        return;
+    }
+#ifdef __SIMULATOR_BUILD__
+    (void)data;
+#else
+    size_t pos = 0;
+    if (h->seen < h->body) {
+        pos = h->body - h->seen < len ? h->body - h->seen : len;
+        mbedtls_sha256_update(&h->sha, data, pos);
+    }
+    uint32_t at = h->seen + pos;
+    if (pos < len && at < h->body + IMAGE_DIGEST_LEN) {
+        size_t n = h->body + IMAGE_DIGEST_LEN - at < len - pos ? h->body + IMAGE_DIGEST_LEN - at : len - pos;
+        memcpy(h->appended + (at - h->body), data + pos, n);
+    }
+#endif
+    h->seen += len;
+}
+
+// Frees the context; true if the image hashed to the digest it carries
+static bool image_hash_finish(image_hash_t* h, uint8_t digest[IMAGE_DIGEST_LEN])
+{
+    if (!h->active) {
+        return false;
+    }
+    h->active = false;
+#ifdef __SIMULATOR_BUILD__
+    (void)digest;
+    return false;
+#else
+    mbedtls_sha256_finish(&h->sha, digest);
+    mbedtls_sha256_free(&h->sha);
+    return h->seen == h->body + IMAGE_DIGEST_LEN && memcmp(digest, h->appended, IMAGE_DIGEST_LEN) == 0;
+#endif
+}
+
 static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmware,
                                                      const esp_partition_t* ota_partition,
                                                      uint32_t firmware_index)
@@ -456,20 +678,39 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
         return ESP_ERR_INVALID_ARG;
     }
 
+    // OTA slots are held against the background pre-erase while written
+    const bool is_ota_slot = ota_partition->type == ESP_PARTITION_TYPE_APP &&
+                             ota_partition->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN &&
+                             ota_partition->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MAX;
+    if (!is_ota_slot) {
+        return write_firmware_to_partition(firmware, ota_partition, firmware_index);
+    }
+
+    const uint32_t ota_slot = ota_partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN;
+    esp_err_t ret = ota_preerase_claim(ota_slot, ota_partition->address, ota_partition->size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = write_firmware_to_partition(firmware, ota_partition, firmware_index);
+    ota_preerase_release(ota_slot, firmware->size);
+    return ret;
+}
+
+static esp_err_t write_firmware_to_partition(const firmware_info_t* firmware,
+                                             const esp_partition_t* ota_partition,
+                                             uint32_t firmware_index)
+{
+
     ESP_LOGI(TAG, "Starting flash of firmware %s to partition %s",
              firmware->display_name, ota_partition->label);
 
-    // Open firmware file
-    FILE* file = fopen(firmware->file_path, "rb");
-    if (!file) {
+    // Get file size
+    struct stat st;
+    if (stat(firmware->file_path, &st) != 0) {
         ESP_LOGE(TAG, "Failed to open firmware file: %s", firmware->file_path);
         return ESP_ERR_NOT_FOUND;
     }
-
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    long file_size = (long)st.st_size;
 
     if (file_size != firmware->size) {
         ESP_LOGW(TAG, "File size mismatch: expected %d, found %ld", firmware->size, file_size);
@@ -477,17 +718,21 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
 
     esp_err_t ret;
 
-    ESP_LOGI(TAG, "Writing firmware to partition %s (with erase-on-demand)", ota_partition->label);
-
-    // Flash firmware in chunks
-    const uint32_t chunk_size = 4096; // 4KB chunks
-    uint8_t* buffer = malloc(chunk_size);
-    if (!buffer) {
-        ESP_LOGE(TAG, "Failed to allocate flash buffer");
-        fclose(file);
-        return ESP_ERR_NO_MEM;
+    // Drop any cached digest before the slot changes so the bootloader never
+    // trusts a half-written image
+    const bool is_ota_slot = ota_partition->type == ESP_PARTITION_TYPE_APP &&
+                             ota_partition->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN &&
+                             ota_partition->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MAX;
+    const uint32_t ota_slot = ota_partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN;
+    if (is_ota_slot) {
+        ret = image_digest_cache_invalidate(ota_slot, ota_partition->address);
+        if (ret != ESP_OK) {
+            return ret;
+        }
     }
 
+    ESP_LOGI(TAG, "Writing firmware to partition %s (with erase-on-demand)", ota_partition->label);
+
     uint32_t bytes_flashed = 0;
 
     // Use the (possibly truncated) firmware size, not the full file size
@@ -499,14 +744,31 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
         ESP_LOGI(TAG, "Firmware truncated from %ld to %d bytes due to space constraints", file_size, total_bytes);
     }
 
-    ESP_LOGI(TAG, "Flashing %d bytes in %d byte chunks (original file size: %ld)", total_bytes, chunk_size, file_size);
+    // Reading starts now and runs ahead while the partition is erased
+    const sd_reader_config_t read_config = { .length = total_bytes };
+    sd_reader_stream_t* stream;
+    ret = sd_reader_open(firmware->file_path, SD_READER_CLIENT_FLASHER, &read_config, &stream);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open firmware file: %s", firmware->file_path);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Flashing %d bytes (original file size: %ld)", total_bytes, file_size);
+
+    const uint8_t* chunk = NULL;
+    size_t chunk_len = 0;
+    ret = sd_reader_borrow(stream, &chunk, &chunk_len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read firmware file at offset 0");
+        sd_reader_close(stream);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
 
     // Debug: Check original file header before flashing
     uint8_t header_buffer[32];
-    fseek(file, 0, SEEK_SET);
-    size_t header_read = fread(header_buffer, 1, sizeof(header_buffer), file);
-    fseek(file, 0, SEEK_SET);
-    if (header_read == sizeof(header_buffer)) {
+    bool header_patched = false;
+    if (chunk_len >= sizeof(header_buffer)) {
+        memcpy(header_buffer, chunk, sizeof(header_buffer));
         ESP_LOGI(TAG, "Original file header (first 32 bytes):");
         ESP_LOG_BUFFER_HEX(TAG, header_buffer, 32);
 
@@ -524,6 +786,7 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
             header_buffer[25] = 0x00;
             header_buffer[26] = 0x00;
             header_buffer[27] = 0x00;
+            header_patched = true;
 
             ESP_LOGI(TAG, "Updated header checksum to 0x00000000 for truncated image");
             ESP_LOG_BUFFER_HEX(TAG, header_buffer, 32);
@@ -532,64 +795,74 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
         }
     }
 
-    // Erase the entire OTA partition before writing
+    // Erase the entire OTA partition before writing; extents the background
+    // pre-erase already blanked are skipped
     ESP_LOGI(TAG, "Erasing OTA partition at 0x%08x (size: 0x%08x)", ota_partition->address, ota_partition->size);
-    ret = esp_flash_erase_region(NULL, ota_partition->address, ota_partition->size);
+    ret = is_ota_slot ? ota_preerase_erase(ota_slot, ota_partition->address, ota_partition->size)
+                      : flash_io_erase(FLASH_IO_PRIORITY_BULK, ota_partition->address, ota_partition->size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to erase OTA partition: %s", esp_err_to_name(ret));
-        free(buffer);
-        fclose(file);
+        sd_reader_close(stream);
         return ret;
     }
     ESP_LOGI(TAG, "OTA partition erased successfully");
 
-    // If we modified the header (for truncation), write it first
-    if (total_bytes < (uint32_t)file_size && header_read == sizeof(header_buffer)) {
-        ESP_LOGI(TAG, "Writing modified header with removed checksum");
-        ret = esp_flash_write(NULL, header_buffer, ota_partition->address, sizeof(header_buffer));
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write modified header: %s", esp_err_to_name(ret));
-            free(buffer);
-            fclose(file);
-            return ret;
-        }
-        ESP_LOGI(TAG, "Modified header written successfully");
-
-        // Skip the header in the file since we already wrote it
-        fseek(file, sizeof(header_buffer), SEEK_SET);
-        bytes_flashed = sizeof(header_buffer);
-    }
+    // Inline verification compares each chunk right after programming it,
+    // instead of re-reading the whole slot afterwards
+    const bool verify_inline = g_flash_config.enable_verification && !g_flash_config.verify_full_pass;
+    readback_t readback = { .partition = ota_partition };
+    readback_t* verify = verify_inline ? &readback : NULL;
+
+    // Per-block CRCs of the bytes as programmed, for later block-level
+    // verify and repair of the slot
+    block_crc_builder_t crc_table = {0};
+    if (is_ota_slot && block_crc_begin(&crc_table, ota_slot, ota_partition->address) != ESP_OK) {
+        ESP_LOGW(TAG, "No block CRC table for %s", ota_partition->label);
+    }
+
+    // Digest for the bootloader's fast path, taken from the bytes the
+    // verification confirms instead of hashing the slot again afterwards
+    image_hash_t image_hash;
+    uint8_t digest[IMAGE_DIGEST_LEN];
+    image_hash_begin(&image_hash, chunk, chunk_len, total_bytes,
+                     header_patched || !is_ota_slot || !g_flash_config.enable_verification);
+
+    // Padding pages of 0xFF are left erased by flash_io
+    const uint64_t skipped_before = flash_io_pages_skipped_total();
+    uint32_t next_progress = 64 * 1024;
+    while (chunk_len > 0 && !g_abort_requested) {
+        uint32_t flash_offset = ota_partition->address + bytes_flashed;
 
-    while (bytes_flashed < total_bytes && !g_abort_requested) {
-        size_t bytes_to_read = chunk_size;
-        if (bytes_flashed + bytes_to_read > total_bytes) {
-            bytes_to_read = total_bytes - bytes_flashed;
+        // The borrowed chunk is written in place; a patched header goes first
+        size_t header_len = 0;
+        if (bytes_flashed == 0 && header_patched) {
+            ESP_LOGI(TAG, "Writing modified header with removed checksum");
+            header_len = sizeof(header_buffer);
         }
-
-        size_t bytes_read = fread(buffer, 1, bytes_to_read, file);
-        if (bytes_read != bytes_to_read) {
-            ESP_LOGE(TAG, "Failed to read firmware file at offset %d", bytes_flashed);
-            free(buffer);
-            fclose(file);
-            return ESP_ERR_INVALID_RESPONSE;
+        ret = write_chunk_verified(header_buffer, header_len, chunk, flash_offset, chunk_len, verify);
+        if (ret == ESP_OK && is_ota_slot) {
+            block_crc_update(&crc_table, header_buffer, header_len);
+            block_crc_update(&crc_table, chunk + header_len, chunk_len - header_len);
+            image_hash_update(&image_hash, header_buffer, header_len);
+            image_hash_update(&image_hash, chunk + header_len, chunk_len - header_len);
         }
-
-        // Use direct flash write (ESP32 flash automatically erases on write)
-        uint32_t flash_offset = ota_partition->address + bytes_flashed;
-        ret = esp_flash_write(NULL, buffer, flash_offset, bytes_read);
+        sd_reader_return(stream, chunk);
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to flash at offset 0x%08x: %s",
-                     flash_offset, esp_err_to_name(ret));
-            free(buffer);
-            fclose(file);
+            ESP_LOGE(TAG, "Failed to %s flash at offset 0x%08x: %s",
+                     ret == ESP_ERR_INVALID_CRC ? "verify" : "write to", flash_offset, esp_err_to_name(ret));
+            block_crc_finish(&crc_table, false);
+            image_hash_finish(&image_hash, digest);
+            free(readback.scratch);
+            sd_reader_close(stream);
             return ret;
         }
 
-        bytes_flashed += bytes_read;
+        bytes_flashed += chunk_len;
 
         // Update progress (every 64KB or when complete)
-        if (bytes_flashed % (64 * 1024) == 0 || bytes_flashed == total_bytes) {
-            uint8_t progress = (bytes_flashed * 100) / total_bytes;
+        if (bytes_flashed >= next_progress || bytes_flashed == total_bytes) {
+            next_progress = bytes_flashed + 64 * 1024;
+            uint8_t progress = ((uint64_t)bytes_flashed * 100) / total_bytes;
             ESP_LOGI(TAG, "Flash progress: %d%% (%d/%d bytes)", progress, bytes_flashed, total_bytes);
 
             // Update statistics
@@ -603,22 +876,43 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
             notify_progress(firmware_index + 1, progress,
                            bytes_flashed == total_bytes ? "Finalizing" : "Flashing");
         }
+
+        ret = sd_reader_borrow(stream, &chunk, &chunk_len);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read firmware file at offset %d", bytes_flashed);
+            block_crc_finish(&crc_table, false);
+            image_hash_finish(&image_hash, digest);
+            free(readback.scratch);
+            sd_reader_close(stream);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
     }
 
-    free(buffer);
-    fclose(file);
+    free(readback.scratch);
+    sd_reader_close(stream);
+
+    // Stored even if the full-pass verify below fails: the table describes
+    // the intended image, which is what a repair restores
+    block_crc_finish(&crc_table, is_ota_slot && !g_abort_requested);
+    const bool digest_valid = image_hash_finish(&image_hash, digest);
 
     if (g_abort_requested) {
         ESP_LOGW(TAG, "Flash operation aborted by user");
         return ESP_ERR_INVALID_STATE;
     }
 
-    ESP_LOGI(TAG, "Successfully flashed firmware %s to partition %s (0x%08x)",
-             firmware->display_name, ota_partition->label, ota_partition->address);
+    const uint32_t pages_skipped = (uint32_t)(flash_io_pages_skipped_total() - skipped_before);
+    xSemaphoreTake(g_flash_mutex, portMAX_DELAY);
+    g_flash_stats.pages_skipped += pages_skipped;
+    xSemaphoreGive(g_flash_mutex);
+
+    ESP_LOGI(TAG, "Successfully flashed firmware %s to partition %s (0x%08x), %" PRIu32 " blank pages skipped",
+             firmware->display_name, ota_partition->label, ota_partition->address, pages_skipped);
 
     // Debug: Hexdump first 64 bytes of flashed data to check ESP32 image header
     uint8_t flashed_header_buffer[64];
-    ret = esp_partition_read(ota_partition, 0, flashed_header_buffer, sizeof(flashed_header_buffer));
+    ret = flash_io_partition_read(FLASH_IO_PRIORITY_BULK, ota_partition, 0,
+                                  flashed_header_buffer, sizeof(flashed_header_buffer));
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Flashed image header (first 32 bytes):");
         ESP_LOG_BUFFER_HEX(TAG, flashed_header_buffer, 32);
@@ -641,8 +935,8 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
         ESP_LOGE(TAG, "Failed to read header for verification: %s", esp_err_to_name(ret));
     }
 
-    // Verify flash (if enabled)
-    if (g_flash_config.enable_verification) {
+    // Separate verification pass (if enabled and not done inline)
+    if (g_flash_config.enable_verification && g_flash_config.verify_full_pass) {
         ESP_LOGI(TAG, "Verifying flashed firmware...");
         ret = verify_firmware_in_partition(firmware, ota_partition);
         if (ret != ESP_OK) {
@@ -652,63 +946,20 @@ static esp_err_t flash_single_firmware_to_partition(const firmware_info_t* firmw
         ESP_LOGI(TAG, "Firmware verification successful");
     }
 
-    // Store firmware metadata in NVS
-    ESP_LOGI(TAG, "Storing firmware metadata in NVS...");
-    firmware_metadata_t metadata;
-    memset(&metadata, 0, sizeof(metadata));
-
-    // Extract filename from path
-    const char* filename = firmware->file_path;
-    const char* last_slash = strrchr(firmware->file_path, '/');
-    if (last_slash) {
-        filename = last_slash + 1;
-    }
-
-    // Safely copy filename with explicit truncation check
-    size_t filename_len = strlen(filename);
-    if (filename_len >= sizeof(metadata.filename)) {
-        ESP_LOGW(TAG, "Filename truncated for metadata: %s (len=%zu)", filename, filename_len);
-        filename_len = sizeof(metadata.filename) - 1;
-    }
-    memcpy(metadata.filename, filename, filename_len);
-    metadata.filename[filename_len] = '\0';
-
-    // Safely copy partition name with explicit truncation check
-    size_t partition_len = strlen(ota_partition->label);
-    if (partition_len >= sizeof(metadata.partition)) {
-        ESP_LOGW(TAG, "Partition name truncated: %s (len=%zu)", ota_partition->label, partition_len);
-        partition_len = sizeof(metadata.partition) - 1;
-    }
-    memcpy(metadata.partition, ota_partition->label, partition_len);
-    metadata.partition[partition_len] = '\0';
-
-    // Store offset and size
-    metadata.offset = ota_partition->address;
-    metadata.size = firmware->size;
-
-    // Calculate CRC32
-    ret = firmware_calculate_crc32(firmware->file_path, &metadata.crc32);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to calculate CRC32 for metadata");
-        metadata.crc32 = 0;
-    }
-
-    // Mark as valid (passed verification if enabled)
-    metadata.is_valid = true;
-
-    // Store metadata at firmware_index
-    ret = firmware_metadata_set(firmware_index, &metadata);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to store firmware metadata: %s", esp_err_to_name(ret));
-        // Continue anyway - metadata storage is not critical
-    } else {
-        // Update firmware count
-        ret = firmware_metadata_set_count(firmware_index + 1);
+    // Let the bootloader skip re-hashing this image on launch
+    if (digest_valid) {
+        ret = image_digest_cache_record(ota_slot, ota_partition->address, total_bytes, digest, true);
         if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to update firmware count: %s", esp_err_to_name(ret));
+            ESP_LOGW(TAG, "Digest not cached for %s, bootloader will validate it fully",
+                     ota_partition->label);
         }
+    } else if (is_ota_slot) {
+        ESP_LOGI(TAG, "No verified digest for %s, bootloader will validate it fully", ota_partition->label);
     }
 
+    // Metadata for the boot menu is stored once for all firmwares by
+    // firmware_selector_store_firmware_config() after verification
+
     return ESP_OK;
 }
 
@@ -726,22 +977,39 @@ static esp_err_t verify_firmware_in_partition(const firmware_info_t* firmware,
         return ESP_OK; // Not fatal
     }
 
-    // Calculate CRC32 of flashed data
+    // Calculate CRC32 of flashed data, in place through the flash cache;
+    // without a mapping, through a buffer
     uint32_t actual_crc32 = 0xFFFFFFFF;
     const uint32_t chunk_size = 4096;
-    uint8_t* buffer = malloc(chunk_size);
-    if (!buffer) {
-        ESP_LOGE(TAG, "Failed to allocate verification buffer");
-        return ESP_ERR_NO_MEM;
-    }
-
-    for (uint32_t offset = 0; offset < firmware->size; offset += chunk_size) {
-        size_t bytes_to_read = chunk_size;
-        if (offset + bytes_to_read > firmware->size) {
+    uint8_t* buffer = NULL;
+    bool mappable = true;
+
+    for (uint32_t offset = 0; offset < firmware->size; ) {
+        size_t bytes_to_read = firmware->size - offset;
+        if (mappable) {
+            if (bytes_to_read > FLASH_IO_MAP_WINDOW) {
+                bytes_to_read = FLASH_IO_MAP_WINDOW;
+            }
+            flash_io_map_t map;
+            if (flash_io_map(ota_partition, offset, bytes_to_read, &map) == ESP_OK) {
+                actual_crc32 = esp_crc32_le(actual_crc32, map.data, bytes_to_read);
+                flash_io_unmap(&map);
+                offset += bytes_to_read;
+                continue;
+            }
+            mappable = false;
             bytes_to_read = firmware->size - offset;
         }
 
-        ret = esp_partition_read(ota_partition, offset, buffer, bytes_to_read);
+        if (!buffer && !(buffer = malloc(chunk_size))) {
+            ESP_LOGE(TAG, "Failed to allocate verification buffer");
+            return ESP_ERR_NO_MEM;
+        }
+        if (bytes_to_read > chunk_size) {
+            bytes_to_read = chunk_size;
+        }
+
+        ret = flash_io_partition_read(FLASH_IO_PRIORITY_BULK, ota_partition, offset, buffer, bytes_to_read);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to read from partition at offset %d", offset);
             free(buffer);
@@ -749,6 +1017,7 @@ static esp_err_t verify_firmware_in_partition(const firmware_info_t* firmware,
         }
 
         actual_crc32 = esp_crc32_le(actual_crc32, buffer, bytes_to_read);
+        offset += bytes_to_read;
     }
 
     free(buffer);
@@ -939,6 +1208,7 @@ esp_err_t firmware_flasher_verify_single(const firmware_info_t* firmware,
     temp_partition.type = ESP_PARTITION_TYPE_APP;
     temp_partition.subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0;  // Default subtype
     temp_partition.encrypted = partition->is_encrypted;
+    temp_partition.flash_chip = esp_flash_default_chip;
     strncpy(temp_partition.label, partition->name, sizeof(temp_partition.label) - 1);
 
     ESP_LOGI(TAG, "Using direct flash access for verification: %s (offset: 0x%08x, size: %u bytes)",
@@ -962,7 +1232,7 @@ esp_err_t firmware_flasher_verify_single(const firmware_info_t* firmware,
         // Use direct flash read for temporary partition structure
         // esp_partition_read doesn't work with our temporary esp_partition_t
         uint32_t flash_offset = flash_partition->address + bytes_read;
-        ret = esp_flash_read(NULL, buffer, flash_offset, chunk_size);
+        ret = flash_io_read(FLASH_IO_PRIORITY_BULK, buffer, flash_offset, chunk_size);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to read from flash offset 0x%08x for verification", flash_offset);
             return ret;
@@ -1415,7 +1685,7 @@ static void hexdump_and_verify_partition_table(size_t expected_size, const uint8
         return;
     }
 
-    esp_err_t ret = esp_flash_read(NULL, read_buffer, 0x10000, 4096);  // ESP32-P4 partition table offset
+    esp_err_t ret = flash_io_read(FLASH_IO_PRIORITY_BULK, read_buffer, 0x10000, 4096);  // ESP32-P4 partition table offset
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read back partition table: %s", esp_err_to_name(ret));
         free(read_buffer);
@@ -1519,7 +1789,7 @@ static esp_err_t write_partition_table_data(const uint8_t* buffer, size_t size)
     ESP_LOGW(TAG, "WARNING: Dangerous write operation - do not power off device!");
 
     // Step 1: Erase the partition table region
-    esp_err_t ret = esp_flash_erase_region(NULL, PTABLE_OFFSET, aligned_size);
+    esp_err_t ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, PTABLE_OFFSET, aligned_size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to erase partition table region: %s", esp_err_to_name(ret));
         return ret;
@@ -1529,7 +1799,7 @@ static esp_err_t write_partition_table_data(const uint8_t* buffer, size_t size)
 
     // Step 2: Write the new partition table data
     ESP_LOGI(TAG, "Writing partition table data to offset 0x%08x", PTABLE_OFFSET);
-    ret = esp_flash_write(NULL, buffer, PTABLE_OFFSET, size);
+    ret = flash_io_write(FLASH_IO_PRIORITY_BULK, buffer, PTABLE_OFFSET, size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to write partition table: %s", esp_err_to_name(ret));
         return ret;
@@ -1540,7 +1810,7 @@ static esp_err_t write_partition_table_data(const uint8_t* buffer, size_t size)
     // Step 3: Verify the write
     uint8_t verify_buffer[256];
     size_t verify_size = (size > sizeof(verify_buffer)) ? sizeof(verify_buffer) : size;
-    ret = esp_flash_read(NULL, verify_buffer, PTABLE_OFFSET, verify_size);
+    ret = flash_io_read(FLASH_IO_PRIORITY_BULK, verify_buffer, PTABLE_OFFSET, verify_size);
     if (ret == ESP_OK) {
         bool match = memcmp(buffer, verify_buffer, verify_size) == 0;
         ESP_LOGI(TAG, "Write verification: %s", match ? "SUCCESS" : "FAILED");
@@ -1555,6 +1825,13 @@ static esp_err_t write_partition_table_data(const uint8_t* buffer, size_t size)
     ESP_LOGI(TAG, "Partition table update completed successfully");
     ESP_LOGI(TAG, "Note: Device will need to restart to use new partition table");
 
+    // Refresh the in-RAM table from the buffer we just wrote (bumps generation)
+    esp_err_t cache_ret = partition_cache_update(buffer, size);
+    if (cache_ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to refresh partition cache: %s", esp_err_to_name(cache_ret));
+        partition_cache_invalidate();
+    }
+
     // Step 4: Comprehensive hexdump and verification
     ESP_LOGI(TAG, "=== PARTITION TABLE VERIFY & HEXDUMP ===");
     hexdump_and_verify_partition_table(size, buffer);
@@ -1621,7 +1898,8 @@ esp_err_t firmware_flasher_create_complete_binary(const char* output_file)
         } else {
             // Read actual partition data
             ESP_LOGI(TAG, "Reading partition %s from flash", partition->name);
-            result = esp_flash_read(NULL, flash_buffer + partition->offset, partition->offset, partition->size);
+            result = flash_io_read(FLASH_IO_PRIORITY_BULK, flash_buffer + partition->offset,
+                                   partition->offset, partition->size);
             if (result != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to read partition %s: %s", partition->name, esp_err_to_name(result));
                 continue; // Continue with other partitions
@@ -66,6 +66,7 @@ typedef struct {
     partition_table_layout_t partition_layout;  // Store copy instead of pointer
     bool enable_backup;
     bool enable_verification;
+    bool verify_full_pass;      // Verify by re-reading each slot after flashing instead of chunk by chunk
     bool enable_optimized_chunking;
     uint32_t chunk_size;        // 0 = auto-detect
     flash_progress_callback_t progress_callback;
@@ -84,6 +85,8 @@ typedef struct {
     uint32_t verification_errors;
     uint32_t write_errors;
     uint32_t crc_errors;
+    uint32_t pages_skipped;     // All-0xFF pages left erased instead of programmed
+    uint32_t verify_retries;    // Chunks re-programmed after an inline read-back mismatch
     uint32_t start_time_ms;
     uint32_t elapsed_time_ms;
     float bytes_per_second;
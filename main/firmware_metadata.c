@@ -1,13 +1,18 @@
 /**
  * @file firmware_metadata.c
- * @brief Firmware metadata persistence implementation using NVS
+ * @brief Firmware metadata persistence implementation (config log or NVS)
  */
 
 #include "firmware_metadata.h"
 #include "firmware_storage.h"
+#include "config_log.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <string.h>
+#include <stddef.h>
 #include <time.h>
 #include <inttypes.h>
 
@@ -22,6 +27,10 @@
 static const char* TAG = "firmware_metadata";
 #define NVS_NAMESPACE "firmware_config"
 #define KEY_FIRMWARE_COUNT "firmware_count"
+#define KEY_SCHEMA_VERSION "fw_schema"
+#define KEY_FW_RECORD "fw_%" PRIu32
+
+// Legacy (schema 1) per-field keys, only read for migration
 #define KEY_FW_FILENAME "fw_%" PRIu32 "_filename"
 #define KEY_FW_PARTITION "fw_%" PRIu32 "_partition"
 #define KEY_FW_OFFSET "fw_%" PRIu32 "_offset"
@@ -30,6 +39,474 @@ static const char* TAG = "firmware_metadata";
 #define KEY_FW_VALID "fw_%" PRIu32 "_valid"
 #define KEY_FW_TIMESTAMP "fw_%" PRIu32 "_timestamp"
 
+// Schema 1 = seven keys per firmware, schema 2 = one blob per firmware
+#define FW_SCHEMA_VERSION 2
+#define FW_RECORD_MAGIC 0x464D   // 'FM'
+#define FW_RECORD_VERSION 1
+#define FW_RECORD_FLAG_VALID 0x01
+
+// On-flash record, one NVS blob per firmware entry
+typedef struct __attribute__((packed)) {
+    uint16_t magic;          // FW_RECORD_MAGIC
+    uint8_t version;         // FW_RECORD_VERSION
+    uint8_t flags;           // FW_RECORD_FLAG_*
+    uint32_t offset;
+    uint32_t size;
+    uint32_t crc32;
+    uint32_t timestamp;
+    char partition[16];
+    char filename[128];
+    uint32_t record_crc;     // CRC32 of all preceding fields
+} fw_metadata_record_t;
+
+// Maximum number of change listeners
+#define MAX_METADATA_LISTENERS 4
+
+// Write/commit counters since boot, see firmware_metadata_get_stats(); guarded by the cache lock
+static firmware_metadata_stats_t g_stats = {0};
+
+// Records live in the config log when the bootloader_config partition is usable
+static bool g_use_log = false;
+
+// In-RAM copy of the namespace, indexed like the NVS records
+typedef struct {
+    firmware_metadata_t entries[MAX_FIRMWARE_ENTRIES];
+    bool present[MAX_FIRMWARE_ENTRIES];  // Record exists and passed its CRC check
+    uint32_t count;                      // Stored firmware_count
+    uint32_t generation;                 // Bumped on every change
+    bool loaded;
+} metadata_cache_t;
+
+typedef struct {
+    firmware_metadata_listener_t callback;
+    void* user_data;
+} metadata_listener_t;
+
+static metadata_cache_t g_cache = {0};
+static metadata_listener_t g_listeners[MAX_METADATA_LISTENERS] = {0};
+static SemaphoreHandle_t g_cache_mutex = NULL;
+
+static bool cache_lock(void)
+{
+    if (!g_cache_mutex) {
+        g_cache_mutex = xSemaphoreCreateMutex();
+        if (!g_cache_mutex) {
+            ESP_LOGE(TAG, "Failed to create metadata cache mutex");
+            return false;
+        }
+    }
+    return xSemaphoreTake(g_cache_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void cache_unlock(void)
+{
+    xSemaphoreGive(g_cache_mutex);
+}
+
+#if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+
+// Snapshot the listener table under the lock, then call without holding it
+static void publish_event(firmware_metadata_event_type_t type)
+{
+    metadata_listener_t listeners[MAX_METADATA_LISTENERS];
+    firmware_metadata_event_t event = { .type = type };
+
+    if (!cache_lock()) {
+        return;
+    }
+    event.generation = g_cache.generation;
+    event.count = g_cache.count;
+    memcpy(listeners, g_listeners, sizeof(listeners));
+    cache_unlock();
+
+    for (int i = 0; i < MAX_METADATA_LISTENERS; i++) {
+        if (listeners[i].callback) {
+            listeners[i].callback(&event, listeners[i].user_data);
+        }
+    }
+}
+
+static esp_err_t commit_handle(nvs_handle_t handle)
+{
+    esp_err_t ret = nvs_commit(handle);
+    if (ret == ESP_OK) {
+        g_stats.commits++;
+    }
+    return ret;
+}
+
+// Backend handle: the config log needs no handle or commit, NVS does
+typedef struct {
+    bool log;
+    nvs_handle_t nvs;
+} metadata_store_t;
+
+static esp_err_t store_open(metadata_store_t* store, nvs_open_mode_t mode)
+{
+    store->log = g_use_log;
+    if (store->log) {
+        return ESP_OK;
+    }
+    return nvs_open(NVS_NAMESPACE, mode, &store->nvs);
+}
+
+static void store_close(metadata_store_t* store)
+{
+    if (!store->log) {
+        nvs_close(store->nvs);
+    }
+}
+
+// Log appends are durable on return, so only NVS needs a commit
+static esp_err_t store_commit(metadata_store_t* store)
+{
+    return store->log ? ESP_OK : commit_handle(store->nvs);
+}
+
+static esp_err_t store_get_count(metadata_store_t* store, uint32_t* count)
+{
+    if (store->log) {
+        size_t len = sizeof(*count);
+        return config_log_read(CONFIG_LOG_KEY_FW_COUNT, count, &len);
+    }
+    return nvs_get_u32(store->nvs, KEY_FIRMWARE_COUNT, count);
+}
+
+static esp_err_t store_set_count(metadata_store_t* store, uint32_t count)
+{
+    if (store->log) {
+        return config_log_append(CONFIG_LOG_KEY_FW_COUNT, &count, sizeof(count));
+    }
+    return nvs_set_u32(store->nvs, KEY_FIRMWARE_COUNT, count);
+}
+
+static esp_err_t store_get_record(metadata_store_t* store, uint32_t index, void* record, size_t* len)
+{
+    if (store->log) {
+        return config_log_read(CONFIG_LOG_KEY_FW_RECORD(index), record, len);
+    }
+    char key[16];
+    snprintf(key, sizeof(key), KEY_FW_RECORD, index);
+    return nvs_get_blob(store->nvs, key, record, len);
+}
+
+static esp_err_t store_set_record(metadata_store_t* store, uint32_t index, const void* record, size_t len)
+{
+    if (store->log) {
+        return config_log_append(CONFIG_LOG_KEY_FW_RECORD(index), record, (uint16_t)len);
+    }
+    char key[16];
+    snprintf(key, sizeof(key), KEY_FW_RECORD, index);
+    return nvs_set_blob(store->nvs, key, record, len);
+}
+
+// Returns ESP_OK only if a record existed and was removed
+static esp_err_t store_erase_record(metadata_store_t* store, uint32_t index)
+{
+    if (store->log) {
+        size_t len = 0;
+        if (config_log_read(CONFIG_LOG_KEY_FW_RECORD(index), NULL, &len) != ESP_OK) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        return config_log_delete(CONFIG_LOG_KEY_FW_RECORD(index));
+    }
+    char key[16];
+    snprintf(key, sizeof(key), KEY_FW_RECORD, index);
+    return nvs_erase_key(store->nvs, key);
+}
+
+static uint32_t record_crc(const fw_metadata_record_t* record)
+{
+    return esp_crc32_le(0, (const uint8_t*)record, offsetof(fw_metadata_record_t, record_crc));
+}
+
+static void record_from_metadata(fw_metadata_record_t* record, const firmware_metadata_t* metadata)
+{
+    memset(record, 0, sizeof(*record));
+    record->magic = FW_RECORD_MAGIC;
+    record->version = FW_RECORD_VERSION;
+    record->flags = metadata->is_valid ? FW_RECORD_FLAG_VALID : 0;
+    record->offset = metadata->offset;
+    record->size = metadata->size;
+    record->crc32 = metadata->crc32;
+    record->timestamp = metadata->timestamp ? metadata->timestamp : (uint32_t)time(NULL);
+    strncpy(record->partition, metadata->partition, sizeof(record->partition) - 1);
+    strncpy(record->filename, metadata->filename, sizeof(record->filename) - 1);
+    record->record_crc = record_crc(record);
+}
+
+static esp_err_t metadata_from_record(firmware_metadata_t* metadata, const fw_metadata_record_t* record)
+{
+    if (record->magic != FW_RECORD_MAGIC || record->version != FW_RECORD_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (record->record_crc != record_crc(record)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    memset(metadata, 0, sizeof(*metadata));
+    memcpy(metadata->filename, record->filename, sizeof(metadata->filename) - 1);
+    memcpy(metadata->partition, record->partition, sizeof(metadata->partition) - 1);
+    metadata->offset = record->offset;
+    metadata->size = record->size;
+    metadata->crc32 = record->crc32;
+    metadata->is_valid = (record->flags & FW_RECORD_FLAG_VALID) != 0;
+    metadata->timestamp = record->timestamp;
+    return ESP_OK;
+}
+
+// Read one entry stored with the legacy per-field keys
+static esp_err_t read_legacy_entry(nvs_handle_t handle, uint32_t index, firmware_metadata_t* metadata)
+{
+    char key[32];
+    size_t len;
+    uint8_t valid = 0;
+
+    memset(metadata, 0, sizeof(*metadata));
+
+    snprintf(key, sizeof(key), KEY_FW_FILENAME, index);
+    len = sizeof(metadata->filename);
+    esp_err_t ret = nvs_get_str(handle, key, metadata->filename, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    snprintf(key, sizeof(key), KEY_FW_PARTITION, index);
+    len = sizeof(metadata->partition);
+    ret = nvs_get_str(handle, key, metadata->partition, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    snprintf(key, sizeof(key), KEY_FW_OFFSET, index);
+    ret = nvs_get_u32(handle, key, &metadata->offset);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    snprintf(key, sizeof(key), KEY_FW_SIZE, index);
+    ret = nvs_get_u32(handle, key, &metadata->size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    snprintf(key, sizeof(key), KEY_FW_CRC32, index);
+    ret = nvs_get_u32(handle, key, &metadata->crc32);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // The selector never wrote valid/timestamp keys, so treat them as optional
+    snprintf(key, sizeof(key), KEY_FW_VALID, index);
+    metadata->is_valid = (nvs_get_u8(handle, key, &valid) != ESP_OK) || (valid != 0);
+
+    snprintf(key, sizeof(key), KEY_FW_TIMESTAMP, index);
+    if (nvs_get_u32(handle, key, &metadata->timestamp) != ESP_OK) {
+        metadata->timestamp = 0;
+    }
+
+    return ESP_OK;
+}
+
+static void erase_legacy_entry(nvs_handle_t handle, uint32_t index)
+{
+    static const char* const legacy_keys[] = {
+        KEY_FW_FILENAME, KEY_FW_PARTITION, KEY_FW_OFFSET, KEY_FW_SIZE,
+        KEY_FW_CRC32, KEY_FW_VALID, KEY_FW_TIMESTAMP,
+    };
+    char key[32];
+
+    for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+        snprintf(key, sizeof(key), legacy_keys[i], index);
+        nvs_erase_key(handle, key);
+    }
+}
+
+static esp_err_t read_entry(metadata_store_t* store, uint32_t index, firmware_metadata_t* metadata)
+{
+    fw_metadata_record_t record;
+    size_t len = sizeof(record);
+
+    esp_err_t ret = store_get_record(store, index, &record, &len);
+    if (ret == ESP_ERR_NVS_NOT_FOUND && !store->log) {
+        // Not migrated yet (e.g. written by an older build) - fall back to legacy keys
+        return read_legacy_entry(store->nvs, index, metadata);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (len != sizeof(record)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return metadata_from_record(metadata, &record);
+}
+
+// Stage one entry in the open handle; caller commits
+static esp_err_t write_entry(nvs_handle_t handle, uint32_t index, const firmware_metadata_t* metadata)
+{
+    char key[16];
+    fw_metadata_record_t record;
+
+    record_from_metadata(&record, metadata);
+    snprintf(key, sizeof(key), KEY_FW_RECORD, index);
+    return nvs_set_blob(handle, key, &record, sizeof(record));
+}
+
+// Stage one entry only if it differs from what is stored; caller commits
+static esp_err_t stage_entry_if_changed(metadata_store_t* store, uint32_t index,
+                                        const firmware_metadata_t* metadata, bool* written,
+                                        firmware_metadata_t* stored)
+{
+    fw_metadata_record_t current;
+    fw_metadata_record_t record;
+    size_t len = sizeof(current);
+
+    *written = false;
+
+    bool have_current = store_get_record(store, index, &current, &len) == ESP_OK &&
+                        len == sizeof(current) &&
+                        current.magic == FW_RECORD_MAGIC &&
+                        current.version == FW_RECORD_VERSION &&
+                        current.record_crc == record_crc(&current);
+
+    if (have_current) {
+        // An unstamped update inherits the stored timestamp, so unchanged content compares equal
+        firmware_metadata_t candidate = *metadata;
+        if (candidate.timestamp == 0) {
+            candidate.timestamp = current.timestamp;
+        }
+        record_from_metadata(&record, &candidate);
+        if (memcmp(&record, &current, sizeof(record)) == 0) {
+            g_stats.records_unchanged++;
+            return metadata_from_record(stored, &record);
+        }
+    }
+
+    record_from_metadata(&record, metadata);
+    esp_err_t ret = store_set_record(store, index, &record, sizeof(record));
+    if (ret == ESP_OK) {
+        *written = true;
+        g_stats.records_written++;
+        ret = metadata_from_record(stored, &record);
+    }
+    return ret;
+}
+
+// Populate the cache from NVS. Caller holds the cache lock.
+static esp_err_t cache_load_locked(void)
+{
+    if (g_cache.loaded) {
+        return ESP_OK;
+    }
+
+    memset(g_cache.present, 0, sizeof(g_cache.present));
+    g_cache.count = 0;
+
+    metadata_store_t store;
+    esp_err_t ret = store_open(&store, NVS_READONLY);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        // Namespace not created yet - nothing stored
+        g_cache.loaded = true;
+        return ESP_OK;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (store_get_count(&store, &g_cache.count) != ESP_OK) {
+        g_cache.count = 0;
+    }
+
+    // One handle, one record read per entry; unreadable entries are left out
+    for (uint32_t i = 0; i < g_cache.count && i < MAX_FIRMWARE_ENTRIES; i++) {
+        ret = read_entry(&store, i, &g_cache.entries[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Skipping metadata [%" PRIu32 "]: %s", i, esp_err_to_name(ret));
+            continue;
+        }
+        g_cache.present[i] = true;
+    }
+
+    store_close(&store);
+    g_cache.loaded = true;
+    g_cache.generation++;
+    ESP_LOGI(TAG, "Firmware metadata cached: %" PRIu32 " entries (%s)",
+             g_cache.count, g_use_log ? "config log" : "NVS");
+    return ESP_OK;
+}
+
+// Convert schema 1 keys into blobs in a single transaction
+static esp_err_t migrate_legacy_entries(void)
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t schema = 0;
+    if (nvs_get_u8(handle, KEY_SCHEMA_VERSION, &schema) == ESP_OK && schema >= FW_SCHEMA_VERSION) {
+        nvs_close(handle);
+        return ESP_OK;
+    }
+
+    uint32_t count = 0;
+    if (nvs_get_u32(handle, KEY_FIRMWARE_COUNT, &count) != ESP_OK) {
+        count = 0;
+    }
+
+    uint32_t migrated = 0;
+    for (uint32_t i = 0; i < count && i < MAX_FIRMWARE_ENTRIES; i++) {
+        firmware_metadata_t metadata;
+        if (read_legacy_entry(handle, i, &metadata) != ESP_OK) {
+            continue;
+        }
+        ret = write_entry(handle, i, &metadata);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to migrate metadata [%" PRIu32 "]: %s", i, esp_err_to_name(ret));
+            nvs_close(handle);
+            return ret;
+        }
+        erase_legacy_entry(handle, i);
+        migrated++;
+    }
+
+    ret = nvs_set_u8(handle, KEY_SCHEMA_VERSION, FW_SCHEMA_VERSION);
+    if (ret == ESP_OK) {
+        ret = commit_handle(handle);
+    }
+    nvs_close(handle);
+
+    if (ret == ESP_OK && migrated > 0) {
+        ESP_LOGI(TAG, "Migrated %" PRIu32 " firmware metadata entries to schema %d", migrated, FW_SCHEMA_VERSION);
+    }
+    return ret;
+}
+
+// Copy the NVS-backed cache into the config log on first use. Caller holds the cache lock.
+static void import_cache_into_log(void)
+{
+    uint32_t imported = 0;
+    for (uint32_t i = 0; i < g_cache.count && i < MAX_FIRMWARE_ENTRIES; i++) {
+        if (!g_cache.present[i]) {
+            continue;
+        }
+        fw_metadata_record_t record;
+        record_from_metadata(&record, &g_cache.entries[i]);
+        if (config_log_append(CONFIG_LOG_KEY_FW_RECORD(i), &record, sizeof(record)) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to import metadata [%" PRIu32 "] into config log", i);
+            continue;
+        }
+        imported++;
+    }
+    config_log_append(CONFIG_LOG_KEY_FW_COUNT, &g_cache.count, sizeof(g_cache.count));
+    ESP_LOGI(TAG, "Imported %" PRIu32 " firmware metadata entries from NVS into config log", imported);
+}
+
+#endif
+
 esp_err_t firmware_metadata_init(void) {
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
     esp_err_t ret = nvs_flash_init();
@@ -47,6 +524,36 @@ esp_err_t firmware_metadata_init(void) {
         ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(ret));
         return ret;
     }
+
+    // Load once; all later reads are served from RAM
+    if (cache_lock()) {
+        ret = migrate_legacy_entries();
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Metadata migration failed: %s (legacy entries stay readable)", esp_err_to_name(ret));
+        }
+
+        g_use_log = false;
+        g_cache.loaded = false;
+        ret = cache_load_locked();
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to load metadata cache: %s", esp_err_to_name(ret));
+        }
+
+        // Prefer the append-only config log; NVS stays as the fallback store
+        if (config_log_init() == ESP_OK) {
+            if (!config_log_has_records() && g_cache.count > 0) {
+                import_cache_into_log();
+            }
+            g_use_log = true;
+            g_cache.loaded = false;
+            ret = cache_load_locked();
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to load metadata from config log: %s", esp_err_to_name(ret));
+            }
+        }
+        cache_unlock();
+    }
+
     ESP_LOGI(TAG, "Firmware metadata initialized");
     return ESP_OK;
 #else
@@ -57,6 +564,10 @@ esp_err_t firmware_metadata_init(void) {
 
 esp_err_t firmware_metadata_deinit(void) {
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+    if (cache_lock()) {
+        g_cache.loaded = false;
+        cache_unlock();
+    }
     return nvs_flash_deinit();
 #else
     return ESP_ERR_NOT_SUPPORTED;
@@ -69,25 +580,12 @@ esp_err_t firmware_metadata_get_count(uint32_t* count) {
     }
 
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        *count = 0;
-        return ESP_OK;
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
     }
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    ret = nvs_get_u32(handle, KEY_FIRMWARE_COUNT, count);
-    nvs_close(handle);
-
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        *count = 0;
-        return ESP_OK;
-    }
-
+    esp_err_t ret = cache_load_locked();
+    *count = (ret == ESP_OK) ? g_cache.count : 0;
+    cache_unlock();
     return ret;
 #else
     *count = 0;
@@ -97,22 +595,45 @@ esp_err_t firmware_metadata_get_count(uint32_t* count) {
 
 esp_err_t firmware_metadata_set_count(uint32_t count) {
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    // Writers hold the cache lock throughout, so the store, the cache and
+    // g_stats change together
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    metadata_store_t store;
+    esp_err_t ret = store_open(&store, NVS_READWRITE);
     if (ret != ESP_OK) {
+        cache_unlock();
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    ret = nvs_set_u32(handle, KEY_FIRMWARE_COUNT, count);
+    uint32_t stored = 0;
+    if (store_get_count(&store, &stored) == ESP_OK && stored == count) {
+        store_close(&store);
+        g_stats.commits_skipped++;
+        cache_unlock();
+        return ESP_OK;
+    }
+
+    ret = store_set_count(&store, count);
     if (ret == ESP_OK) {
-        ret = nvs_commit(handle);
+        ret = store_commit(&store);
     }
-    nvs_close(handle);
+    store_close(&store);
+
+    if (ret == ESP_OK) {
+        g_cache.count = count;
+        g_cache.generation++;
+    }
+    cache_unlock();
 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set firmware count: %s", esp_err_to_name(ret));
+        return ret;
     }
+    publish_event(FIRMWARE_METADATA_EVENT_CHANGED);
 
     return ret;
 #else
@@ -126,94 +647,53 @@ esp_err_t firmware_metadata_get(uint32_t index, firmware_metadata_t* metadata) {
     }
 
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
-        return ret;
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
     }
 
-    char key[64];
-    char filename_str[128];
-    size_t len;
-
-    // Get filename
-    snprintf(key, sizeof(key), KEY_FW_FILENAME, index);
-    len = sizeof(filename_str);
-    ret = nvs_get_str(handle, key, filename_str, &len);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get filename for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
-    }
-    // Safe copy with explicit truncation
-    size_t copy_len = len;
-    if (copy_len >= sizeof(metadata->filename)) {
-        copy_len = sizeof(metadata->filename) - 1;
-    }
-    memcpy(metadata->filename, filename_str, copy_len);
-    metadata->filename[copy_len] = '\0';
-
-    // Get partition
-    snprintf(key, sizeof(key), KEY_FW_PARTITION, index);
-    len = sizeof(metadata->partition);
-    ret = nvs_get_str(handle, key, metadata->partition, &len);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get partition for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+    esp_err_t ret = cache_load_locked();
+    if (ret == ESP_OK) {
+        if (index < g_cache.count && g_cache.present[index]) {
+            *metadata = g_cache.entries[index];
+        } else {
+            ret = ESP_ERR_NOT_FOUND;
+        }
     }
+    cache_unlock();
 
-    // Get offset
-    snprintf(key, sizeof(key), KEY_FW_OFFSET, index);
-    ret = nvs_get_u32(handle, key, &metadata->offset);
     if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get offset for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+        ESP_LOGE(TAG, "Failed to get metadata for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
     }
+    return ret;
+#else
+    memset(metadata, 0, sizeof(firmware_metadata_t));
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
 
-    // Get size
-    snprintf(key, sizeof(key), KEY_FW_SIZE, index);
-    ret = nvs_get_u32(handle, key, &metadata->size);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get size for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+esp_err_t firmware_metadata_get_all(firmware_metadata_t* entries, uint32_t max_entries, uint32_t* count) {
+    if (!entries || !count) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // Get CRC32
-    snprintf(key, sizeof(key), KEY_FW_CRC32, index);
-    ret = nvs_get_u32(handle, key, &metadata->crc32);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get CRC32 for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
-    }
+    *count = 0;
 
-    // Get valid flag
-    uint8_t valid;
-    snprintf(key, sizeof(key), KEY_FW_VALID, index);
-    ret = nvs_get_u8(handle, key, &valid);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to get valid flag for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+#if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
     }
-    metadata->is_valid = (valid != 0);
 
-    // Get timestamp
-    snprintf(key, sizeof(key), KEY_FW_TIMESTAMP, index);
-    ret = nvs_get_u32(handle, key, &metadata->timestamp);
-    if (ret != ESP_OK) {
-        metadata->timestamp = 0;
+    esp_err_t ret = cache_load_locked();
+    for (uint32_t i = 0; ret == ESP_OK && i < g_cache.count && i < MAX_FIRMWARE_ENTRIES && *count < max_entries; i++) {
+        if (g_cache.present[i]) {
+            entries[(*count)++] = g_cache.entries[i];
+        }
     }
-
-    nvs_close(handle);
-    return ESP_OK;
+    cache_unlock();
+    return ret;
 #else
-    memset(metadata, 0, sizeof(firmware_metadata_t));
-    return ESP_ERR_NOT_SUPPORTED;
+    (void)max_entries;
+    return ESP_OK;
 #endif
 }
 
@@ -223,88 +703,148 @@ esp_err_t firmware_metadata_set(uint32_t index, const firmware_metadata_t* metad
     }
 
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The count is needed to tell whether the index extends it
+    metadata_store_t store;
+    esp_err_t ret = cache_load_locked();
+    if (ret == ESP_OK) {
+        ret = store_open(&store, NVS_READWRITE);
+    }
     if (ret != ESP_OK) {
+        cache_unlock();
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    char key[64];
+    bool written = false;
+    firmware_metadata_t stored;
+    ret = stage_entry_if_changed(&store, index, metadata, &written, &stored);
 
-    // Set filename
-    snprintf(key, sizeof(key), KEY_FW_FILENAME, index);
-    ret = nvs_set_str(handle, key, metadata->filename);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set filename for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+    // An entry past the end extends the count in the same commit
+    bool extends = index >= g_cache.count;
+    if (ret == ESP_OK && extends) {
+        ret = store_set_count(&store, index + 1);
     }
 
-    // Set partition
-    snprintf(key, sizeof(key), KEY_FW_PARTITION, index);
-    ret = nvs_set_str(handle, key, metadata->partition);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set partition for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+    bool dirty = written || extends;
+    if (ret == ESP_OK) {
+        if (dirty) {
+            ret = store_commit(&store);
+        } else {
+            g_stats.commits_skipped++;
+        }
     }
+    store_close(&store);
 
-    // Set offset
-    snprintf(key, sizeof(key), KEY_FW_OFFSET, index);
-    ret = nvs_set_u32(handle, key, metadata->offset);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set offset for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+    if (ret == ESP_OK && dirty) {
+        g_cache.entries[index] = stored;
+        g_cache.present[index] = true;
+        if (extends) {
+            g_cache.count = index + 1;
+        }
+        g_cache.generation++;
     }
+    cache_unlock();
 
-    // Set size
-    snprintf(key, sizeof(key), KEY_FW_SIZE, index);
-    ret = nvs_set_u32(handle, key, metadata->size);
     if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set size for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+        ESP_LOGE(TAG, "Failed to store metadata for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
+    } else if (dirty) {
+        ESP_LOGI(TAG, "✅ Stored firmware metadata [%" PRIu32 "]: %s -> %s @ 0x%08X",
+                 index, metadata->filename, metadata->partition, metadata->offset);
+        publish_event(FIRMWARE_METADATA_EVENT_CHANGED);
+    } else {
+        ESP_LOGD(TAG, "Firmware metadata [%" PRIu32 "] unchanged, nothing written", index);
     }
 
-    // Set CRC32
-    snprintf(key, sizeof(key), KEY_FW_CRC32, index);
-    ret = nvs_set_u32(handle, key, metadata->crc32);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set CRC32 for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t firmware_metadata_set_all(const firmware_metadata_t* entries, uint32_t count) {
+    if ((!entries && count > 0) || count > MAX_FIRMWARE_ENTRIES) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // Set valid flag
-    snprintf(key, sizeof(key), KEY_FW_VALID, index);
-    ret = nvs_set_u8(handle, key, metadata->is_valid ? 1 : 0);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set valid flag for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
-        return ret;
+#if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
     }
 
-    // Set timestamp (use current time)
-    snprintf(key, sizeof(key), KEY_FW_TIMESTAMP, index);
-    uint32_t timestamp = (uint32_t)time(NULL);
-    ret = nvs_set_u32(handle, key, timestamp);
+    metadata_store_t store;
+    esp_err_t ret = store_open(&store, NVS_READWRITE);
     if (ret != ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to set timestamp for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
+        cache_unlock();
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Commit all changes
-    ret = nvs_commit(handle);
-    nvs_close(handle);
+    // Only records that differ from flash are rewritten; the commit is skipped if nothing did
+    firmware_metadata_t stored[MAX_FIRMWARE_ENTRIES];
+    uint32_t written_count = 0;
+    uint32_t erased_count = 0;
+    for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+        bool written = false;
+        ret = stage_entry_if_changed(&store, i, &entries[i], &written, &stored[i]);
+        if (written) {
+            written_count++;
+        }
+    }
+
+    // Drop records beyond the new count so stale entries never resurface
+    for (uint32_t i = count; i < MAX_FIRMWARE_ENTRIES && ret == ESP_OK; i++) {
+        if (store_erase_record(&store, i) == ESP_OK) {
+            erased_count++;
+        }
+    }
+    g_stats.records_erased += erased_count;
+
+    bool count_changed = false;
+    if (ret == ESP_OK) {
+        uint32_t stored_count = 0;
+        if (store_get_count(&store, &stored_count) != ESP_OK || stored_count != count) {
+            ret = store_set_count(&store, count);
+            count_changed = true;
+        }
+    }
+
+    bool dirty = written_count > 0 || erased_count > 0 || count_changed;
+    if (ret == ESP_OK) {
+        if (dirty) {
+            ret = store_commit(&store);
+        } else {
+            g_stats.commits_skipped++;
+        }
+    }
+    store_close(&store);
+
+    if (ret == ESP_OK && dirty) {
+        memcpy(g_cache.entries, stored, count * sizeof(stored[0]));
+        for (uint32_t i = 0; i < MAX_FIRMWARE_ENTRIES; i++) {
+            g_cache.present[i] = i < count;
+        }
+        g_cache.count = count;
+        g_cache.loaded = true;
+        g_cache.generation++;
+    }
+    const firmware_metadata_stats_t stats = g_stats;
+    cache_unlock();
 
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit metadata for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to store firmware metadata set: %s", esp_err_to_name(ret));
     } else {
-        ESP_LOGI(TAG, "✅ Stored firmware metadata [%" PRIu32 "]: %s -> %s @ 0x%08X",
-                 index, metadata->filename, metadata->partition, metadata->offset);
+        ESP_LOGI(TAG, "✅ Firmware metadata: %" PRIu32 " entries, %" PRIu32 " written, %" PRIu32 " erased, %s",
+                 count, written_count, erased_count, dirty ? "1 commit" : "no commit needed");
+        ESP_LOGI(TAG, "NVS wear since boot: %" PRIu32 " commits, %" PRIu32 " skipped, %" PRIu32 " records written, %" PRIu32 " unchanged",
+                 stats.commits, stats.commits_skipped, stats.records_written, stats.records_unchanged);
+
+        if (dirty) {
+            publish_event(FIRMWARE_METADATA_EVENT_CHANGED);
+        }
     }
 
     return ret;
@@ -319,44 +859,37 @@ esp_err_t firmware_metadata_delete(uint32_t index) {
     }
 
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    metadata_store_t store;
+    esp_err_t ret = store_open(&store, NVS_READWRITE);
     if (ret != ESP_OK) {
+        cache_unlock();
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    char key[64];
-
-    // Erase all keys for this index
-    snprintf(key, sizeof(key), KEY_FW_FILENAME, index);
-    nvs_erase_key(handle, key);
-
-    snprintf(key, sizeof(key), KEY_FW_PARTITION, index);
-    nvs_erase_key(handle, key);
-
-    snprintf(key, sizeof(key), KEY_FW_OFFSET, index);
-    nvs_erase_key(handle, key);
-
-    snprintf(key, sizeof(key), KEY_FW_SIZE, index);
-    nvs_erase_key(handle, key);
-
-    snprintf(key, sizeof(key), KEY_FW_CRC32, index);
-    nvs_erase_key(handle, key);
-
-    snprintf(key, sizeof(key), KEY_FW_VALID, index);
-    nvs_erase_key(handle, key);
+    store_erase_record(&store, index);
+    if (!store.log) {
+        erase_legacy_entry(store.nvs, index);
+    }
 
-    snprintf(key, sizeof(key), KEY_FW_TIMESTAMP, index);
-    nvs_erase_key(handle, key);
+    ret = store_commit(&store);
+    store_close(&store);
 
-    ret = nvs_commit(handle);
-    nvs_close(handle);
+    if (ret == ESP_OK) {
+        g_cache.present[index] = false;
+        g_cache.generation++;
+    }
+    cache_unlock();
 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to delete metadata for index %" PRIu32 ": %s", index, esp_err_to_name(ret));
     } else {
         ESP_LOGI(TAG, "🗑️  Deleted firmware metadata [%" PRIu32 "]", index);
+        publish_event(FIRMWARE_METADATA_EVENT_CHANGED);
     }
 
     return ret;
@@ -367,24 +900,49 @@ esp_err_t firmware_metadata_delete(uint32_t index) {
 
 esp_err_t firmware_metadata_clear_all(void) {
 #if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    metadata_store_t store;
+    esp_err_t ret = store_open(&store, NVS_READWRITE);
     if (ret != ESP_OK) {
+        cache_unlock();
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    ret = nvs_erase_all(handle);
-    if (ret == ESP_OK) {
-        ret = nvs_commit(handle);
+    if (store.log) {
+        for (uint32_t i = 0; i < MAX_FIRMWARE_ENTRIES; i++) {
+            store_erase_record(&store, i);
+        }
+        ret = store_set_count(&store, 0);
+    } else {
+        ret = nvs_erase_all(store.nvs);
+        if (ret == ESP_OK) {
+            // Namespace is empty, so there is nothing left to migrate
+            ret = nvs_set_u8(store.nvs, KEY_SCHEMA_VERSION, FW_SCHEMA_VERSION);
+        }
+        if (ret == ESP_OK) {
+            ret = store_commit(&store);
+        }
     }
 
-    nvs_close(handle);
+    store_close(&store);
+
+    if (ret == ESP_OK) {
+        memset(g_cache.present, 0, sizeof(g_cache.present));
+        g_cache.count = 0;
+        g_cache.loaded = true;
+        g_cache.generation++;
+    }
+    cache_unlock();
 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to clear all metadata: %s", esp_err_to_name(ret));
     } else {
         ESP_LOGI(TAG, "🧹 Cleared all firmware metadata");
+        publish_event(FIRMWARE_METADATA_EVENT_CLEARED);
     }
 
     return ret;
@@ -393,6 +951,63 @@ esp_err_t firmware_metadata_clear_all(void) {
 #endif
 }
 
+esp_err_t firmware_metadata_subscribe(firmware_metadata_listener_t callback, void* user_data) {
+    if (!callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int free_slot = -1;
+    for (int i = 0; i < MAX_METADATA_LISTENERS; i++) {
+        if (g_listeners[i].callback == callback && g_listeners[i].user_data == user_data) {
+            cache_unlock();
+            return ESP_OK;  // Already subscribed
+        }
+        if (!g_listeners[i].callback && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (free_slot >= 0) {
+        g_listeners[free_slot].callback = callback;
+        g_listeners[free_slot].user_data = user_data;
+        ret = ESP_OK;
+    }
+    cache_unlock();
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "No free metadata listener slot");
+    }
+    return ret;
+}
+
+void firmware_metadata_unsubscribe(firmware_metadata_listener_t callback, void* user_data) {
+    if (!cache_lock()) {
+        return;
+    }
+    for (int i = 0; i < MAX_METADATA_LISTENERS; i++) {
+        if (g_listeners[i].callback == callback && g_listeners[i].user_data == user_data) {
+            g_listeners[i].callback = NULL;
+            g_listeners[i].user_data = NULL;
+        }
+    }
+    cache_unlock();
+}
+
+uint32_t firmware_metadata_get_generation(void) {
+    return g_cache.generation;
+}
+
+void firmware_metadata_get_stats(firmware_metadata_stats_t* stats) {
+    if (stats && cache_lock()) {
+        *stats = g_stats;
+        cache_unlock();
+    }
+}
+
 esp_err_t firmware_metadata_validate(uint32_t index, bool* is_valid) {
     if (!is_valid || index >= MAX_FIRMWARE_ENTRIES) {
         return ESP_ERR_INVALID_ARG;
@@ -418,33 +1033,41 @@ esp_err_t firmware_metadata_find_by_partition(const char* partition, uint32_t* i
         return ESP_ERR_INVALID_ARG;
     }
 
-    uint32_t count = 0;
-    esp_err_t ret = firmware_metadata_get_count(&count);
-    if (ret != ESP_OK) {
-        return ret;
+#if defined(__SIMULATOR_BUILD__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+    if (!cache_lock()) {
+        return ESP_ERR_NO_MEM;
     }
 
-    for (uint32_t i = 0; i < count; i++) {
-        firmware_metadata_t metadata;
-        ret = firmware_metadata_get(i, &metadata);
-        if (ret != ESP_OK) {
-            continue;
-        }
-
-        if (strcmp(metadata.partition, partition) == 0) {
-            *index = i;
-            ESP_LOGI(TAG, "Found firmware in partition '%s' at index %u", partition, i);
-            return ESP_OK;
+    // Storage index, as taken by firmware_metadata_get/update/delete; slots
+    // can have holes, so this is not the position in get_all() output
+    esp_err_t ret = cache_load_locked();
+    if (ret == ESP_OK) {
+        ret = ESP_ERR_NOT_FOUND;
+        for (uint32_t i = 0; i < g_cache.count && i < MAX_FIRMWARE_ENTRIES; i++) {
+            if (g_cache.present[i] && strcmp(g_cache.entries[i].partition, partition) == 0) {
+                *index = i;
+                ret = ESP_OK;
+                break;
+            }
         }
     }
+    cache_unlock();
 
-    ESP_LOGW(TAG, "No firmware found in partition '%s'", partition);
-    return ESP_ERR_NOT_FOUND;
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Found firmware in partition '%s' at index %" PRIu32, partition, *index);
+    } else if (ret == ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "No firmware found in partition '%s'", partition);
+    }
+    return ret;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 void firmware_metadata_print_all(void) {
+    firmware_metadata_t entries[MAX_FIRMWARE_ENTRIES];
     uint32_t count = 0;
-    if (firmware_metadata_get_count(&count) != ESP_OK || count == 0) {
+    if (firmware_metadata_get_all(entries, MAX_FIRMWARE_ENTRIES, &count) != ESP_OK || count == 0) {
         ESP_LOGI(TAG, "No firmware metadata stored");
         return;
     }
@@ -452,13 +1075,11 @@ void firmware_metadata_print_all(void) {
     ESP_LOGI(TAG, "=== Firmware Metadata (%u entries) ===", count);
 
     for (uint32_t i = 0; i < count; i++) {
-        firmware_metadata_t metadata;
-        if (firmware_metadata_get(i, &metadata) == ESP_OK) {
-            ESP_LOGI(TAG, "[%" PRIu32 "] %s -> %s @ 0x%08X, size: %" PRIu32 ", CRC32: 0x%08X, valid: %s",
-                     i, metadata.filename, metadata.partition, metadata.offset,
-                     metadata.size, metadata.crc32,
-                     metadata.is_valid ? "✅" : "❌");
-        }
+        const firmware_metadata_t* metadata = &entries[i];
+        ESP_LOGI(TAG, "[%" PRIu32 "] %s -> %s @ 0x%08X, size: %" PRIu32 ", CRC32: 0x%08X, valid: %s",
+                 i, metadata->filename, metadata->partition, metadata->offset,
+                 metadata->size, metadata->crc32,
+                 metadata->is_valid ? "✅" : "❌");
     }
 
     ESP_LOGI(TAG, "======================================");
@@ -485,10 +1106,10 @@ esp_err_t firmware_metadata_scan_and_store(void) {
 
     ESP_LOGI(TAG, "Found %u firmwares in storage, populating NVS...", firmware_count);
 
-    // Clear any existing firmware metadata
-    firmware_metadata_clear_all();
+    // Build the full entry set first, then persist it in one transaction
+    firmware_metadata_t entries[MAX_FIRMWARE_ENTRIES];
+    uint32_t stored_count = 0;
 
-    // Read each firmware entry and store in NVS
     for (uint32_t i = 0; i < firmware_count && i < MAX_FIRMWARE_ENTRIES; i++) {
         firmware_storage_entry_t entry;
         ret = firmware_storage_get_entry(i, &entry);
@@ -498,42 +1119,35 @@ esp_err_t firmware_metadata_scan_and_store(void) {
         }
 
         // Create metadata entry
-        firmware_metadata_t metadata;
-        memset(&metadata, 0, sizeof(metadata));
+        firmware_metadata_t* metadata = &entries[stored_count];
+        memset(metadata, 0, sizeof(*metadata));
 
         // Copy filename from name field
-        strncpy(metadata.filename, entry.name, sizeof(metadata.filename) - 1);
-        metadata.filename[sizeof(metadata.filename) - 1] = '\0';
+        strncpy(metadata->filename, entry.name, sizeof(metadata->filename) - 1);
+        metadata->filename[sizeof(metadata->filename) - 1] = '\0';
 
         // Assign to OTA partitions (ota_0, ota_1, ota_2, etc.)
-        snprintf(metadata.partition, sizeof(metadata.partition), "ota_%" PRIu32, i);
+        snprintf(metadata->partition, sizeof(metadata->partition), "ota_%" PRIu32, i);
 
         // Copy other fields
-        metadata.offset = entry.offset;
-        metadata.size = entry.size;
-        metadata.crc32 = entry.crc32;
-        metadata.is_valid = true;
-        metadata.timestamp = (uint32_t)time(NULL);
-
-        // Store in NVS
-        ret = firmware_metadata_set(i, &metadata);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store firmware metadata %" PRIu32 ": %s", i, esp_err_to_name(ret));
-            continue;
-        }
+        metadata->offset = entry.offset;
+        metadata->size = entry.size;
+        metadata->crc32 = entry.crc32;
+        metadata->is_valid = true;
+        metadata->timestamp = (uint32_t)time(NULL);
 
         ESP_LOGI(TAG, "  [%" PRIu32 "] %s -> %s (%" PRIu32 " bytes, CRC32: 0x%08X)",
-                 i, metadata.filename, metadata.partition, metadata.size, metadata.crc32);
+                 i, metadata->filename, metadata->partition, metadata->size, metadata->crc32);
+        stored_count++;
     }
 
-    // Set the total count
-    ret = firmware_metadata_set_count(firmware_count);
+    ret = firmware_metadata_set_all(entries, stored_count);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set firmware count: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to store firmware metadata: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    ESP_LOGI(TAG, "✓ Firmware storage scan complete: %u firmwares stored in NVS", firmware_count);
+    ESP_LOGI(TAG, "✓ Firmware storage scan complete: %u firmwares stored in NVS", stored_count);
 
     // Print what we stored for debugging
     firmware_metadata_print_all();
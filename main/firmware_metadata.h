@@ -1,6 +1,18 @@
 /**
  * @file firmware_metadata.h
- * @brief Firmware metadata persistence using NVS
+ * @brief Firmware metadata persistence
+ *
+ * Each entry is stored as a single versioned, CRC-protected record. When the
+ * bootloader_config partition holds a config log (config_log.h) the records
+ * live there and can also be read by the second-stage bootloader; otherwise
+ * they are kept as blobs ("fw_<index>") in the "firmware_config" NVS
+ * namespace. Existing NVS entries are imported into the log once, and entries
+ * written by older builds as one key per field are migrated on init.
+ *
+ * The namespace is loaded into RAM once; reads are served from that copy
+ * and writes go through to NVS before the copy is updated. Every change
+ * bumps a generation counter and is published to subscribed listeners, so
+ * readers never need to re-initialise NVS to see fresh data.
  */
 
 #ifndef FIRMWARE_METADATA_H
@@ -29,6 +41,40 @@ typedef struct {
     uint32_t timestamp;      // When firmware was flashed
 } firmware_metadata_t;
 
+/**
+ * @brief Metadata change event types
+ */
+typedef enum {
+    FIRMWARE_METADATA_EVENT_CHANGED = 0,  // One or more entries (or the count) changed
+    FIRMWARE_METADATA_EVENT_CLEARED,      // All entries were removed
+} firmware_metadata_event_type_t;
+
+/**
+ * @brief Metadata change event
+ */
+typedef struct {
+    firmware_metadata_event_type_t type;
+    uint32_t generation;     // Cache generation after the change
+    uint32_t count;          // Stored firmware count after the change
+} firmware_metadata_event_t;
+
+/**
+ * @brief Change listener, called from the task that performed the write
+ *
+ * Listeners must not call back into the write API. UI listeners should only
+ * record the event and rebuild from the LVGL task.
+ */
+typedef void (*firmware_metadata_listener_t)(const firmware_metadata_event_t* event, void* user_data);
+
+// NVS write/commit counters since boot, used to track wear on the NVS partition
+typedef struct {
+    uint32_t commits;            // NVS commits issued
+    uint32_t commits_skipped;    // Updates that changed nothing and skipped the commit
+    uint32_t records_written;    // Metadata records rewritten
+    uint32_t records_unchanged;  // Records left alone because they already matched
+    uint32_t records_erased;     // Stale records removed
+} firmware_metadata_stats_t;
+
 /**
  * @brief Initialize firmware metadata module
  * @return ESP_OK on success
@@ -63,14 +109,74 @@ esp_err_t firmware_metadata_set_count(uint32_t count);
  */
 esp_err_t firmware_metadata_get(uint32_t index, firmware_metadata_t* metadata);
 
+/**
+ * @brief Read all stored firmware metadata entries
+ *
+ * Served from the in-RAM copy, which is loaded from NVS on first use.
+ * Entries that failed their CRC or version check are skipped.
+ *
+ * @param entries Output array
+ * @param max_entries Capacity of the output array
+ * @param count Output parameter for number of entries read
+ * @return ESP_OK on success
+ */
+esp_err_t firmware_metadata_get_all(firmware_metadata_t* entries, uint32_t max_entries, uint32_t* count);
+
 /**
  * @brief Set firmware metadata entry by index
+ *
+ * Nothing is written or committed if the stored record already matches.
+ * An index at or past the stored count extends the count to index + 1 in
+ * the same commit.
+ *
  * @param index Firmware index (0 to MAX_FIRMWARE_ENTRIES-1)
- * @param metadata Firmware metadata to store
+ * @param metadata Firmware metadata to store (timestamp 0 = stamp with current time)
  * @return ESP_OK on success
  */
 esp_err_t firmware_metadata_set(uint32_t index, const firmware_metadata_t* metadata);
 
+/**
+ * @brief Replace all firmware metadata entries in a single NVS commit
+ *
+ * Compares entries[0..count-1] with the stored records and rewrites only
+ * those that differ, drops any records beyond count and updates the
+ * firmware count, all in one transaction. If nothing changed no commit is
+ * issued. An entry with timestamp 0 keeps the stored timestamp when its
+ * content is unchanged.
+ *
+ * @param entries Entries to store
+ * @param count Number of entries (at most MAX_FIRMWARE_ENTRIES)
+ * @return ESP_OK on success
+ */
+esp_err_t firmware_metadata_set_all(const firmware_metadata_t* entries, uint32_t count);
+
+/**
+ * @brief Subscribe to metadata change events
+ * @param callback Listener to call after each change
+ * @param user_data Opaque pointer passed to the listener
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if all listener slots are taken
+ */
+esp_err_t firmware_metadata_subscribe(firmware_metadata_listener_t callback, void* user_data);
+
+/**
+ * @brief Remove a listener registered with firmware_metadata_subscribe()
+ * @param callback Listener to remove
+ * @param user_data Same pointer that was passed when subscribing
+ */
+void firmware_metadata_unsubscribe(firmware_metadata_listener_t callback, void* user_data);
+
+/**
+ * @brief Get the metadata cache generation counter
+ * @return Generation, incremented every time the cached metadata changes
+ */
+uint32_t firmware_metadata_get_generation(void);
+
+/**
+ * @brief Get NVS write/commit counters accumulated since boot
+ * @param stats Output parameter for the counters
+ */
+void firmware_metadata_get_stats(firmware_metadata_stats_t* stats);
+
 /**
  * @brief Delete firmware metadata entry by index
  * @param index Firmware index to delete
@@ -95,7 +201,7 @@ esp_err_t firmware_metadata_validate(uint32_t index, bool* is_valid);
 /**
  * @brief Find firmware metadata by partition name
  * @param partition Partition name to search for
- * @param index Output parameter for found firmware index
+ * @param index Output storage index, as taken by firmware_metadata_get/set/delete
  * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not found
  */
 esp_err_t firmware_metadata_find_by_partition(const char* partition, uint32_t* index);
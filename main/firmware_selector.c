@@ -10,11 +10,11 @@
 #include "firmware_flasher.h"
 #include "lvgl_bootloader.h"
 #include "partition_visualizer.h"
+#include "firmware_metadata.h"
+#include "ui_events.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_vfs_fat.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include <sys/stat.h>
 #include <dirent.h>
 #include <string.h>
@@ -34,6 +34,9 @@ static const char* TAG = "firmware_selector";
 // Track if flashing is in progress to disable UI controls
 static bool flashing_in_progress = false;
 
+// Boot menu entry count from the latest metadata change event
+static volatile uint32_t g_boot_menu_entry_count = 0;
+
 // Global reference to currently active firmware selector for progress updates
 firmware_selector_t* g_active_firmware_selector = NULL;
 
@@ -48,6 +51,8 @@ static void fw_selector_modal_ok_cb(lv_event_t* e);
 static void fw_flash_progress_callback(uint32_t current_firmware, uint32_t total_firmwares,
                                        uint32_t current_progress, uint32_t total_progress, const char* status_message);
 static void fw_flash_status_callback(flash_state_t state, flash_result_t result, const char* status_message);
+static void fw_flash_progress_event_cb(const ui_event_t* event);
+static void fw_flash_state_event_cb(const ui_event_t* event);
 
 static void update_firmware_list_item(firmware_selector_t* selector, uint32_t index);
 static void update_buttons_state(firmware_selector_t* selector);
@@ -265,11 +270,16 @@ static void fw_selector_flash_cb(lv_event_t* e)
         flash_config.partition_layout = layout;  // Copy the layout structure
         flash_config.enable_backup = true;
         flash_config.enable_verification = true;
+        flash_config.verify_full_pass = false;  // Chunks are read back as they are written
         flash_config.enable_optimized_chunking = true;
         flash_config.chunk_size = 0;  // Auto-detect
         flash_config.progress_callback = fw_flash_progress_callback;  // LVGL progress updates
         flash_config.status_callback = fw_flash_status_callback;   // Handle completion events
 
+        // Flasher callbacks only post events; the UI is updated from the LVGL task
+        ui_events_set_handler(UI_EVENT_FLASH_PROGRESS, fw_flash_progress_event_cb);
+        ui_events_set_handler(UI_EVENT_FLASH_STATE, fw_flash_state_event_cb);
+
         // Start flashing
         ret = firmware_flasher_start(&flash_config);
         if (ret != ESP_OK) {
@@ -316,10 +326,6 @@ static void fw_selector_modal_ok_cb(lv_event_t* e)
 
         // Switch back to main screen and refresh it
         switch_screen(SCREEN_MAIN);
-
-        // Small delay to ensure NVS operations are complete
-        vTaskDelay(pdMS_TO_TICKS(100));
-
         refresh_main_screen();
 
         ESP_LOGI(TAG, "Modal closed, main screen refreshed");
@@ -328,10 +334,40 @@ static void fw_selector_modal_ok_cb(lv_event_t* e)
     }
 }
 
-// LVGL status callback for firmware flashing completion
+// Metadata listener: tracks what the boot menu will show after a flash
+static void fw_metadata_changed_callback(const firmware_metadata_event_t* event, void* user_data)
+{
+    (void)user_data;
+    g_boot_menu_entry_count = event->count;
+    ESP_LOGI(TAG, "Firmware metadata updated: %lu entries (generation %lu)",
+             (unsigned long)event->count, (unsigned long)event->generation);
+}
+
+// Flasher status, posted from the flash task; the LVGL work is done in fw_flash_state_event_cb()
 static void fw_flash_status_callback(flash_state_t state, flash_result_t result, const char* status_message)
 {
     ESP_LOGI(TAG, "Flash Status: state=%d, result=%d, message=%s", state, result, status_message ? status_message : "NULL");
+
+    ui_event_t event = {
+        .type = UI_EVENT_FLASH_STATE,
+        .flash_state = { .state = (uint8_t)state, .result = (uint8_t)result },
+    };
+    if (status_message) {
+        strncpy(event.text, status_message, sizeof(event.text) - 1);
+    }
+    esp_err_t ret = ui_events_post(&event);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Flash state %d not shown: %s", state, esp_err_to_name(ret));
+    }
+}
+
+// LVGL status handler for firmware flashing completion (LVGL task)
+static void fw_flash_state_event_cb(const ui_event_t* event)
+{
+    flash_state_t state = (flash_state_t)event->flash_state.state;
+    flash_result_t result = (flash_result_t)event->flash_state.result;
+    const char* status_message = event->text;
+
     ESP_LOGD(TAG, "Active selector: %p, completion_modal: %p, completion_label: %p",
              g_active_firmware_selector,
              g_active_firmware_selector ? g_active_firmware_selector->completion_modal : NULL,
@@ -427,8 +463,9 @@ static void fw_flash_status_callback(flash_state_t state, flash_result_t result,
 
                 ESP_LOGI(TAG, "Creating success message for modal");
                 char success_msg[256];
-                snprintf(success_msg, sizeof(success_msg), "Flashing completed successfully!\n%d firmware(s) flashed",
-                        (int)g_active_firmware_selector->selected_count);
+                snprintf(success_msg, sizeof(success_msg),
+                        "Flashing completed successfully!\n%d firmware(s) flashed\n%lu application(s) in boot menu",
+                        (int)g_active_firmware_selector->selected_count, (unsigned long)g_boot_menu_entry_count);
 
                 ESP_LOGI(TAG, "Setting modal text: %s", success_msg);
                 lv_label_set_text(g_active_firmware_selector->completion_label, success_msg);
@@ -440,21 +477,6 @@ static void fw_flash_status_callback(flash_state_t state, flash_result_t result,
                 lv_obj_move_foreground(g_active_firmware_selector->completion_modal);
 
                 ESP_LOGI(TAG, "Completion modal shown successfully");
-
-                // Force NVS reload to ensure main screen can read updated data
-                ESP_LOGI(TAG, "Forcing NVS data reload...");
-                esp_err_t nvs_err = nvs_flash_deinit();
-                if (nvs_err == ESP_OK) {
-                    vTaskDelay(pdMS_TO_TICKS(100)); // Slightly longer delay to ensure all writes complete
-                    nvs_err = nvs_flash_init();
-                    if (nvs_err != ESP_OK) {
-                        ESP_LOGW(TAG, "Failed to reinitialize NVS: %s", esp_err_to_name(nvs_err));
-                    } else {
-                        ESP_LOGI(TAG, "NVS reinitialized successfully, data should be reloaded");
-                    }
-                } else {
-                    ESP_LOGW(TAG, "Failed to deinit NVS: %s", esp_err_to_name(nvs_err));
-                }
             }
         } else {
             ESP_LOGW(TAG, "Firmware flashing completed with errors: result=%d", result);
@@ -476,7 +498,7 @@ static void fw_flash_status_callback(flash_state_t state, flash_result_t result,
     }
 }
 
-// LVGL progress callback for firmware flashing
+// Flasher progress, posted from the flash task; consecutive updates are coalesced
 static void fw_flash_progress_callback(uint32_t current_firmware, uint32_t total_firmwares,
                                    uint32_t current_progress, uint32_t total_progress, const char* status_message)
 {
@@ -484,8 +506,33 @@ static void fw_flash_progress_callback(uint32_t current_firmware, uint32_t total
              (unsigned long)current_firmware, (unsigned long)total_firmwares,
              (unsigned long)current_progress, (unsigned long)total_progress, status_message ? status_message : "NULL");
 
+    if (total_progress > 0) {
+        ui_event_t event = {
+            .type = UI_EVENT_FLASH_PROGRESS,
+            .flash_progress.percent = (uint8_t)((current_progress * 100) / total_progress),
+        };
+        ui_events_post(&event);
+    }
+
+    // Update status message
+    if (status_message) {
+        char full_status[UI_EVENT_TEXT_LEN];
+        if (total_firmwares > 1) {
+            snprintf(full_status, sizeof(full_status), "Flashing %lu/%lu: %s",
+                     (unsigned long)current_firmware, (unsigned long)total_firmwares, status_message);
+        } else {
+            snprintf(full_status, sizeof(full_status), "%s", status_message);
+        }
+        update_status(full_status);
+    }
+}
+
+// LVGL progress handler for firmware flashing (LVGL task)
+static void fw_flash_progress_event_cb(const ui_event_t* event)
+{
+    uint8_t percentage = event->flash_progress.percent;
+
     // Update firmware selector progress bar and percentage if available
-    extern firmware_selector_t* g_active_firmware_selector; // Global reference to active selector
     ESP_LOGD(TAG, "Active selector: %p, progress_bar: %p, progress_label: %p",
              g_active_firmware_selector,
              g_active_firmware_selector ? g_active_firmware_selector->progress_bar : NULL,
@@ -496,39 +543,20 @@ static void fw_flash_progress_callback(uint32_t current_firmware, uint32_t total
         lv_obj_clear_flag(g_active_firmware_selector->progress_bar, LV_OBJ_FLAG_HIDDEN);
         lv_obj_clear_flag(g_active_firmware_selector->progress_label, LV_OBJ_FLAG_HIDDEN);
 
-        if (total_progress > 0) {
-            uint8_t percentage = (uint8_t)((current_progress * 100) / total_progress);
+        ESP_LOGD(TAG, "Updating progress bar to %d%%", percentage);
 
-            ESP_LOGD(TAG, "Updating progress bar to %d%%", percentage);
+        // Update progress bar
+        lv_bar_set_value(g_active_firmware_selector->progress_bar, percentage, LV_ANIM_OFF);
 
-            // Update progress bar
-            lv_bar_set_value(g_active_firmware_selector->progress_bar, percentage, LV_ANIM_OFF);
+        // Update percentage label
+        char progress_text[16];
+        snprintf(progress_text, sizeof(progress_text), "%d%%", percentage);
+        lv_label_set_text(g_active_firmware_selector->progress_label, progress_text);
 
-            // Update percentage label
-            char progress_text[16];
-            snprintf(progress_text, sizeof(progress_text), "%d%%", percentage);
-            lv_label_set_text(g_active_firmware_selector->progress_label, progress_text);
-
-            ESP_LOGD(TAG, "Progress updated: bar=%d, text=%s", percentage, progress_text);
-        }
+        ESP_LOGD(TAG, "Progress updated: bar=%d, text=%s", percentage, progress_text);
     } else {
         // Fallback to global progress bar if firmware selector not available
-        if (total_progress > 0) {
-            uint8_t percentage = (uint8_t)((current_progress * 100) / total_progress);
-            update_progress_bar(percentage);
-        }
-    }
-
-    // Update status message
-    if (status_message) {
-        char full_status[256];
-        if (total_firmwares > 1) {
-            snprintf(full_status, sizeof(full_status), "Flashing %lu/%lu: %s",
-                     (unsigned long)current_firmware, (unsigned long)total_firmwares, status_message);
-        } else {
-            snprintf(full_status, sizeof(full_status), "%s", status_message);
-        }
-        update_status(full_status);
+        update_progress_bar(percentage);
     }
 }
 
@@ -658,6 +686,16 @@ esp_err_t firmware_selector_create_ui(firmware_selector_t* selector)
 
     ESP_LOGI(TAG, "Creating firmware selection UI");
 
+    // Seed the boot menu count and follow later changes
+    uint32_t stored_count = 0;
+    if (firmware_metadata_get_count(&stored_count) == ESP_OK) {
+        g_boot_menu_entry_count = stored_count;
+    }
+    esp_err_t sub_ret = firmware_metadata_subscribe(fw_metadata_changed_callback, NULL);
+    if (sub_ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to subscribe to metadata changes: %s", esp_err_to_name(sub_ret));
+    }
+
     // Create main screen
     selector->screen = lv_obj_create(NULL);
     lv_obj_set_size(selector->screen, FW_SELECTOR_SCREEN_WIDTH, FW_SELECTOR_SCREEN_HEIGHT);
@@ -1058,49 +1096,19 @@ esp_err_t firmware_selector_store_firmware_config(firmware_selector_t* selector)
 
     ESP_LOGI(TAG, "Storing firmware configuration in NVS for boot menu");
 
-    // Initialize NVS system first (in case not already initialized)
-    esp_err_t nvs_init_err = nvs_flash_init();
-    if (nvs_init_err == ESP_ERR_NVS_NO_FREE_PAGES || nvs_init_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_LOGW(TAG, "NVS needs to be erased, doing that...");
-        nvs_flash_erase();
-        nvs_init_err = nvs_flash_init();
-    } else if (nvs_init_err == ESP_ERR_NVS_NOT_INITIALIZED) {
-        ESP_LOGD(TAG, "NVS not initialized, trying to initialize...");
-        nvs_init_err = nvs_flash_init();
-    }
-
-    if (nvs_init_err != ESP_OK && nvs_init_err != ESP_ERR_NVS_NO_FREE_PAGES && nvs_init_err != ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_LOGE(TAG, "Error initializing NVS flash: %s", esp_err_to_name(nvs_init_err));
-        return nvs_init_err;
-    }
-
-    // Open NVS namespace
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("firmware_config", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS namespace: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    // Get selected firmwares
+    // Get selected firmwares (NVS itself is initialised once at startup by the metadata service)
     firmware_info_t* selected_firmware[MAX_FIRMWARE_COUNT];
     uint32_t selected_count = 0;
-    err = firmware_selector_get_selected(selector, selected_firmware, MAX_FIRMWARE_COUNT, &selected_count);
+    esp_err_t err = firmware_selector_get_selected(selector, selected_firmware, MAX_FIRMWARE_COUNT, &selected_count);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get selected firmware: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
         return err;
     }
 
-    // Clear existing firmware entries
-    err = nvs_erase_all(nvs_handle);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Failed to erase NVS entries: %s", esp_err_to_name(err));
-    }
-
-    // Store each selected firmware
-    char key[32];
-    for (uint32_t i = 0; i < selected_count; i++) {
+    // Build one metadata record per firmware; they are written in a single commit
+    firmware_metadata_t entries[MAX_FIRMWARE_ENTRIES];
+    uint32_t entry_count = 0;
+    for (uint32_t i = 0; i < selected_count && entry_count < MAX_FIRMWARE_ENTRIES; i++) {
         firmware_info_t* firmware = selected_firmware[i];
 
         if (!firmware->assigned_partition) {
@@ -1109,66 +1117,28 @@ esp_err_t firmware_selector_store_firmware_config(firmware_selector_t* selector)
         }
 
         partition_info_t* partition = (partition_info_t*)firmware->assigned_partition;
+        firmware_metadata_t* entry = &entries[entry_count];
+        memset(entry, 0, sizeof(*entry));
 
-        // Store filename
-        snprintf(key, sizeof(key), "fw_%d_filename", (int)i);
-        err = nvs_set_str(nvs_handle, key, firmware->display_name);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store filename for firmware %d: %s", (int)i, esp_err_to_name(err));
-            continue;
-        }
-
-        // Store OTA partition name
-        snprintf(key, sizeof(key), "fw_%d_partition", (int)i);
-        err = nvs_set_str(nvs_handle, key, partition->name);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store partition for firmware %d: %s", (int)i, esp_err_to_name(err));
-            continue;
-        }
-
-        // Store OTA partition offset
-        snprintf(key, sizeof(key), "fw_%d_offset", (int)i);
-        err = nvs_set_u32(nvs_handle, key, partition->offset);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store offset for firmware %d: %s", (int)i, esp_err_to_name(err));
-            continue;
-        }
-
-        // Store firmware size
-        snprintf(key, sizeof(key), "fw_%d_size", (int)i);
-        err = nvs_set_u32(nvs_handle, key, firmware->size);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store size for firmware %d: %s", (int)i, esp_err_to_name(err));
-            continue;
-        }
-
-        // Store CRC32 for integrity checking
-        snprintf(key, sizeof(key), "fw_%d_crc32", (int)i);
-        err = nvs_set_u32(nvs_handle, key, firmware->crc32);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store CRC32 for firmware %d: %s", (int)i, esp_err_to_name(err));
-            continue;
-        }
+        strncpy(entry->filename, firmware->display_name, sizeof(entry->filename) - 1);
+        strncpy(entry->partition, partition->name, sizeof(entry->partition) - 1);
+        entry->offset = partition->offset;
+        entry->size = firmware->size;
+        entry->crc32 = firmware->crc32;
+        entry->is_valid = true;
 
         ESP_LOGI(TAG, "Stored firmware %d: %s -> %s (0x%08x, %d bytes, CRC32: 0x%08X)",
-                 (int)i, firmware->display_name, partition->name, partition->offset, firmware->size, firmware->crc32);
-    }
-
-    // Store firmware count
-    err = nvs_set_u32(nvs_handle, "firmware_count", selected_count);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to store firmware count: %s", esp_err_to_name(err));
+                 (int)entry_count, firmware->display_name, partition->name, partition->offset, firmware->size, firmware->crc32);
+        entry_count++;
     }
 
-    // Commit changes
-    err = nvs_commit(nvs_handle);
+    err = firmware_metadata_set_all(entries, entry_count);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to commit NVS changes: %s", esp_err_to_name(err));
     } else {
-        ESP_LOGI(TAG, "Successfully stored %d firmware(s) in NVS", (int)selected_count);
+        ESP_LOGI(TAG, "Successfully stored %d firmware(s) in NVS", (int)entry_count);
     }
 
-    nvs_close(nvs_handle);
     return err;
 }
 
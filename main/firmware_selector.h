@@ -202,6 +202,8 @@ esp_err_t firmware_selector_update_size_display(firmware_selector_t* selector);
  *
  * Stores information about flashed firmware (filename, OTA partition) in NVS
  * so that the boot menu can display available applications and allow booting them.
+ * Records go through firmware_metadata_set_all(), which rewrites only entries
+ * that changed and commits at most once.
  *
  * @param selector Firmware selector with selected firmware
  * @return esp_err_t ESP_OK on success, error code otherwise
@@ -4,6 +4,7 @@
  */
 
 #include "firmware_validator.h"
+#include "sd_reader.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_crc.h"
@@ -141,34 +142,35 @@ esp_err_t firmware_validate(const char* file_path, firmware_validation_result_t*
     return ESP_OK;
 }
 
-// Use static buffer to reduce stack usage
-static uint8_t crc_buffer[1024];  // Smaller buffer to reduce stack usage
-
 esp_err_t firmware_calculate_crc32(const char* file_path, uint32_t* crc32)
 {
     if (!file_path || !crc32) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    FILE* file = fopen(file_path, "rb");
-    if (!file) {
+    sd_reader_stream_t* stream;
+    esp_err_t ret = sd_reader_open(file_path, SD_READER_CLIENT_CRC, NULL, &stream);
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open file for CRC calculation: %s", file_path);
-        return ESP_ERR_NOT_FOUND;
+        return ret;
     }
 
     // Initialize CRC32
     uint32_t calculated_crc = 0xFFFFFFFF;  // Standard CRC32 initial value
 
-    // Read file in smaller chunks and calculate CRC
-    size_t bytes_read;
-    while ((bytes_read = fread(crc_buffer, 1, sizeof(crc_buffer), file)) > 0) {
-        calculated_crc = esp_crc32_le(calculated_crc, crc_buffer, bytes_read);
-
-        // Yield to prevent task starvation
-        taskYIELD();
+    // CRC the chunks in place while the next ones are read
+    const uint8_t* data;
+    size_t size;
+    while ((ret = sd_reader_borrow(stream, &data, &size)) == ESP_OK && size > 0) {
+        calculated_crc = esp_crc32_le(calculated_crc, data, size);
+        sd_reader_return(stream, data);
     }
+    sd_reader_close(stream);
 
-    fclose(file);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Read error during CRC calculation: %s", file_path);
+        return ret;
+    }
 
     // Final CRC32 value (invert for standard CRC32)
     *crc32 = calculated_crc ^ 0xFFFFFFFF;  // Final XOR
@@ -318,51 +320,57 @@ esp_err_t firmware_get_validation_status(const firmware_validation_result_t* res
     return ESP_OK;
 }
 
+// Reads one range through the SD reader into the running CRC
+static esp_err_t crc_range(const char* file_path, uint32_t offset, uint32_t length, uint32_t* crc)
+{
+    const sd_reader_config_t config = {
+        .offset = offset,
+        .length = length,
+        .chunk_size = length,
+        .read_ahead = 1,
+    };
+    sd_reader_stream_t* stream;
+    esp_err_t ret = sd_reader_open(file_path, SD_READER_CLIENT_FAST_CRC, &config, &stream);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    while ((ret = sd_reader_borrow(stream, &data, &size)) == ESP_OK && size > 0) {
+        *crc = esp_crc32_le(*crc, data, size);
+        sd_reader_return(stream, data);
+    }
+    sd_reader_close(stream);
+    return ret;
+}
+
 esp_err_t firmware_calculate_fast_crc32(const char* file_path, uint32_t file_size, uint32_t* crc32)
 {
     if (!file_path || !crc32) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    FILE* file = fopen(file_path, "rb");
-    if (!file) {
-        return ESP_ERR_NOT_FOUND;
-    }
-
     const uint32_t SAMPLE_SIZE = 4096; // 4KB samples
     uint32_t calculated_crc = 0xFFFFFFFF;
     bool small_file = (file_size <= 2 * SAMPLE_SIZE);
+    esp_err_t ret;
 
     if (small_file) {
         // For small files (≤8KB), calculate full CRC
-        uint8_t buffer[1024];
-        size_t bytes_read;
-
-        while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-            calculated_crc = esp_crc32_le(calculated_crc, buffer, bytes_read);
-        }
+        ret = crc_range(file_path, 0, 0, &calculated_crc);
     } else {
         // For large files, sample first 4KB and last 4KB
-        uint8_t buffer[SAMPLE_SIZE];
-
-        // Sample first 4KB
-        size_t bytes_read = fread(buffer, 1, SAMPLE_SIZE, file);
-        if (bytes_read == SAMPLE_SIZE) {
-            calculated_crc = esp_crc32_le(calculated_crc, buffer, bytes_read);
-        }
-
-        // Seek to last 4KB (or start if file smaller)
-        if (file_size > SAMPLE_SIZE) {
-            fseek(file, -SAMPLE_SIZE, SEEK_END);
-            bytes_read = fread(buffer, 1, SAMPLE_SIZE, file);
-            if (bytes_read > 0) {
-                calculated_crc = esp_crc32_le(calculated_crc, buffer, bytes_read);
-            }
+        ret = crc_range(file_path, 0, SAMPLE_SIZE, &calculated_crc);
+        if (ret == ESP_OK) {
+            ret = crc_range(file_path, file_size - SAMPLE_SIZE, SAMPLE_SIZE, &calculated_crc);
         }
     }
 
-    fclose(file);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     *crc32 = calculated_crc ^ 0xFFFFFFFF; // Final XOR
 
     return ESP_OK;
-}
\ No newline at end of file
+}
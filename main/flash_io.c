@@ -0,0 +1,649 @@
+/**
+ * @file flash_io.c
+ * @brief Prioritized flash I/O service
+ */
+
+#include "flash_io.h"
+#include "io_arbiter.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_flash.h"
+#ifndef __SIMULATOR_BUILD__
+#include "esp_flash_encrypt.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "flash_io";
+
+// Longest a bulk step sleeps between asking the arbiter for bandwidth
+#define FLASH_IO_ARBITER_POLL_MS 10
+
+static const char* const priority_names[FLASH_IO_PRIORITY_COUNT] = {
+    "interactive",
+    "bulk",
+    "background",
+};
+
+typedef enum {
+    OP_READ = 0,
+    OP_WRITE,
+    OP_ERASE,
+} flash_op_t;
+
+// Lives on the caller's stack until `done` is given
+typedef struct request {
+    flash_op_t op;
+    flash_io_priority_t priority;
+    const esp_partition_t* partition;  // NULL: address is absolute
+    uint32_t address;
+    uint8_t* buf;
+    uint32_t size;
+    esp_err_t result;
+    int64_t queued_us;
+    SemaphoreHandle_t done;
+    struct request* next;
+} request_t;
+
+// FIFO per priority
+typedef struct {
+    request_t* head;
+    request_t* tail;
+} request_list_t;
+
+static SemaphoreHandle_t g_queue_mutex = NULL;
+static SemaphoreHandle_t g_stats_mutex = NULL;
+static SemaphoreHandle_t g_wake = NULL;
+static QueueHandle_t g_waiters = NULL;  // Free completion semaphores
+static bool g_started = false;
+
+static request_list_t g_lists[FLASH_IO_PRIORITY_COUNT];
+static uint32_t g_depth = 0;
+static volatile int64_t g_last_interactive_us = 0;
+static uint32_t g_pending[FLASH_IO_PRIORITY_COUNT];  // Queued or running, under g_queue_mutex
+static int64_t g_last_done_us[FLASH_IO_PRIORITY_COUNT];
+static bool g_skip_blank_pages = false;   // Off with flash encryption: 0xFF plaintext is not 0xFF on flash
+static uint64_t g_pages_skipped_total = 0;  // Under the stats lock, never reset
+static volatile bool g_map_enabled = true;
+static bool g_map_fallback_logged = false;  // Only the first fallback to queued reads is a warning
+
+static flash_io_stats_t g_stats;
+
+// Fails until flash_io_init() has created the mutex
+static bool stats_lock(void)
+{
+    return g_stats_mutex && xSemaphoreTake(g_stats_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void stats_unlock(void)
+{
+    xSemaphoreGive(g_stats_mutex);
+}
+
+static bool interactive_recent(void)
+{
+    return esp_timer_get_time() - g_last_interactive_us < FLASH_IO_INTERACTIVE_WINDOW_MS * 1000LL;
+}
+
+// Pop the oldest request of a priority
+static request_t* take_request(flash_io_priority_t priority)
+{
+    xSemaphoreTake(g_queue_mutex, portMAX_DELAY);
+    request_list_t* list = &g_lists[priority];
+    request_t* req = list->head;
+    if (req) {
+        list->head = req->next;
+        if (!list->head) {
+            list->tail = NULL;
+        }
+        req->next = NULL;
+        g_depth--;
+    }
+    xSemaphoreGive(g_queue_mutex);
+    return req;
+}
+
+bool flash_io_is_blank(const void* data, size_t size)
+{
+    const uint8_t* p = data;
+
+    // Bytes up to a word boundary, then four words per AND so the compiler
+    // can keep the loop branch-light
+    while (size > 0 && ((uintptr_t)p & 3)) {
+        if (*p++ != 0xFF) {
+            return false;
+        }
+        size--;
+    }
+    const uint32_t* w = (const uint32_t*)p;
+    for (; size >= 16; size -= 16, w += 4) {
+        if ((w[0] & w[1] & w[2] & w[3]) != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    p = (const uint8_t*)w;
+    while (size > 0) {
+        if (*p++ != 0xFF) {
+            return false;
+        }
+        size--;
+    }
+    return true;
+}
+
+static esp_err_t program(const request_t* req, const uint8_t* buf, uint32_t address, uint32_t len)
+{
+    return req->partition ? esp_partition_write(req->partition, address, buf, len)
+                          : esp_flash_write(NULL, buf, address, len);
+}
+
+// Program only the pages holding something other than 0xFF; runs of them
+// go out as one driver call. Partitions are page aligned,
+// so pages line up with the address in every address space
+static esp_err_t program_sparse(const request_t* req, const uint8_t* buf, uint32_t address, uint32_t len)
+{
+    if (!g_skip_blank_pages) {
+        return program(req, buf, address, len);
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint32_t programmed = 0;
+    uint32_t skipped = 0;
+    uint32_t run_start = 0;
+    uint32_t run_len = 0;
+
+    for (uint32_t pos = 0; pos < len && ret == ESP_OK; ) {
+        uint32_t page = FLASH_IO_PAGE_SIZE - (address + pos) % FLASH_IO_PAGE_SIZE;
+        if (page > len - pos) {
+            page = len - pos;
+        }
+        if (flash_io_is_blank(buf + pos, page)) {
+            skipped++;
+            if (run_len > 0) {
+                ret = program(req, buf + run_start, address + run_start, run_len);
+                run_len = 0;
+            }
+        } else {
+            if (run_len == 0) {
+                run_start = pos;
+            }
+            run_len += page;
+            programmed++;
+        }
+        pos += page;
+    }
+    if (ret == ESP_OK && run_len > 0) {
+        ret = program(req, buf + run_start, address + run_start, run_len);
+    }
+
+    if (stats_lock()) {
+        g_stats.pages_programmed += programmed;
+        g_stats.pages_skipped += skipped;
+        g_pages_skipped_total += skipped;
+        stats_unlock();
+    }
+    return ret;
+}
+
+static esp_err_t run_driver(const request_t* req, uint32_t offset, uint32_t len)
+{
+    uint8_t* buf = req->buf ? req->buf + offset : NULL;
+    uint32_t address = req->address + offset;
+
+    switch (req->op) {
+    case OP_READ:
+        return req->partition ? esp_partition_read(req->partition, address, buf, len)
+                              : esp_flash_read(NULL, buf, address, len);
+    case OP_WRITE:
+        return program_sparse(req, buf, address, len);
+    case OP_ERASE:
+        return esp_flash_erase_region(NULL, address, len);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+// Bytes the next step of a bulk request covers
+static uint32_t step_size(const request_t* req, uint32_t offset, uint32_t remaining)
+{
+    uint32_t step = interactive_recent() || req->priority == FLASH_IO_PRIORITY_BACKGROUND ?
+                    FLASH_IO_SECTOR_SIZE : FLASH_IO_BLOCK_SIZE;
+    if (req->op == OP_ERASE) {
+        // Stop at the next block boundary so the following step is a block erase
+        uint32_t address = req->address + offset;
+        uint32_t to_boundary = FLASH_IO_BLOCK_SIZE - address % FLASH_IO_BLOCK_SIZE;
+        if (step > to_boundary) {
+            step = to_boundary;
+        }
+    }
+    return step < remaining ? step : remaining;
+}
+
+static void run_request(request_t* req);
+
+// Serve every queued interactive request, also between the steps of a bulk one
+static void serve_interactive(bool preempting)
+{
+    request_t* req;
+    while ((req = take_request(FLASH_IO_PRIORITY_INTERACTIVE)) != NULL) {
+        if (preempting && stats_lock()) {
+            g_stats.preemptions++;
+            stats_unlock();
+        }
+        run_request(req);
+    }
+}
+
+// Get bandwidth for a step of a bulk request. Interactive requests are
+// served while the budget refills: one queued meanwhile gives g_wake and
+// ends the wait at once, and the arbiter is asked again every poll interval
+// so the end of a frame is not missed
+static void acquire_step(io_client_t client, uint32_t len)
+{
+    int64_t wait_start_us = 0;
+    uint32_t wait_ms;
+
+    while (!io_arbiter_try_acquire(client, len, &wait_start_us, &wait_ms)) {
+        if (wait_ms > FLASH_IO_ARBITER_POLL_MS) {
+            wait_ms = FLASH_IO_ARBITER_POLL_MS;
+        }
+        TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+        xSemaphoreTake(g_wake, ticks > 0 ? ticks : 1);
+        serve_interactive(true);
+    }
+}
+
+static esp_err_t run_bulk(const request_t* req, uint32_t* steps)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t offset = 0;
+
+    while (offset < req->size && ret == ESP_OK) {
+        uint32_t len = step_size(req, offset, req->size - offset);
+
+        // Display-safe pacing happens here, once for every caller
+        if (req->op == OP_READ) {
+            acquire_step(IO_CLIENT_FLASH_READ, len);
+        } else if (req->op != OP_ERASE) {
+            acquire_step(IO_CLIENT_FLASH_WRITE, len);
+        }
+
+        ret = run_driver(req, offset, len);
+        offset += len;
+        (*steps)++;
+
+        if (offset < req->size) {
+            serve_interactive(true);
+        }
+    }
+    return ret;
+}
+
+static void run_request(request_t* req)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t steps = 0;
+    esp_err_t ret;
+
+    if (req->priority == FLASH_IO_PRIORITY_INTERACTIVE) {
+        ret = run_driver(req, 0, req->size);
+    } else {
+        ret = run_bulk(req, &steps);
+    }
+    int64_t end = esp_timer_get_time();
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Flash op %d at 0x%08" PRIx32 " (%" PRIu32 " bytes) failed: %s",
+                 req->op, req->address, req->size, esp_err_to_name(ret));
+    }
+
+    if (stats_lock()) {
+        flash_io_priority_stats_t* p = &g_stats.priorities[req->priority];
+        uint32_t wait_us = (uint32_t)(start - req->queued_us);
+        uint32_t latency_us = (uint32_t)(end - req->queued_us);
+        g_stats.steps += steps;
+        p->requests++;
+        p->bytes += req->size;
+        p->wait_us_total += wait_us;
+        p->latency_us_total += latency_us;
+        if (wait_us > p->wait_us_max) {
+            p->wait_us_max = wait_us;
+        }
+        if (latency_us > p->latency_us_max) {
+            p->latency_us_max = latency_us;
+        }
+        stats_unlock();
+    }
+
+    xSemaphoreTake(g_queue_mutex, portMAX_DELAY);
+    g_pending[req->priority]--;
+    g_last_done_us[req->priority] = end;
+    xSemaphoreGive(g_queue_mutex);
+
+    // The request is gone once its caller wakes up
+    req->result = ret;
+    xSemaphoreGive(req->done);
+}
+
+static void worker_task(void* arg)
+{
+    (void)arg;
+    request_t* req;
+
+    while (1) {
+        xSemaphoreTake(g_wake, portMAX_DELAY);
+
+        // Interactive first, then one bulk request at a time, background last
+        while (1) {
+            serve_interactive(false);
+            req = take_request(FLASH_IO_PRIORITY_BULK);
+            if (!req) {
+                req = take_request(FLASH_IO_PRIORITY_BACKGROUND);
+            }
+            if (!req) {
+                break;
+            }
+            run_request(req);
+        }
+    }
+}
+
+esp_err_t flash_io_init(void)
+{
+    if (g_started) {
+        return ESP_OK;
+    }
+
+#ifdef __SIMULATOR_BUILD__
+    g_skip_blank_pages = true;
+#else
+    g_skip_blank_pages = !esp_flash_encryption_enabled();
+#endif
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (!g_stats_mutex) {
+        g_stats_mutex = xSemaphoreCreateMutex();
+    }
+    if (!g_queue_mutex) {
+        g_queue_mutex = xSemaphoreCreateMutex();
+    }
+    if (!g_wake) {
+        g_wake = xSemaphoreCreateBinary();
+    }
+    if (!g_waiters) {
+        g_waiters = xQueueCreate(FLASH_IO_MAX_WAITERS, sizeof(SemaphoreHandle_t));
+        for (int i = 0; g_waiters && i < FLASH_IO_MAX_WAITERS; i++) {
+            SemaphoreHandle_t done = xSemaphoreCreateBinary();
+            if (!done) {
+                break;
+            }
+            xQueueSend(g_waiters, &done, 0);
+        }
+    }
+
+    if (!g_stats_mutex || !g_queue_mutex || !g_wake || !g_waiters || uxQueueMessagesWaiting(g_waiters) == 0) {
+        ESP_LOGE(TAG, "Failed to create flash I/O queues");
+    } else if (xTaskCreatePinnedToCore(worker_task, "flash_io", 4096, NULL,
+                                       configMAX_PRIORITIES - 3, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create flash I/O task");
+    } else {
+        g_started = true;
+        ret = ESP_OK;
+        ESP_LOGI(TAG, "Flash I/O service ready");
+    }
+    return ret;
+}
+
+static esp_err_t submit(request_t* req)
+{
+    if (req->size == 0) {
+        return ESP_OK;
+    }
+    if (!g_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xQueueReceive(g_waiters, &req->done, portMAX_DELAY);
+    req->queued_us = esp_timer_get_time();
+    req->next = NULL;
+
+    xSemaphoreTake(g_queue_mutex, portMAX_DELAY);
+    request_list_t* list = &g_lists[req->priority];
+    if (list->tail) {
+        list->tail->next = req;
+    } else {
+        list->head = req;
+    }
+    list->tail = req;
+    g_depth++;
+    g_pending[req->priority]++;
+    uint32_t depth = g_depth;
+    if (req->priority == FLASH_IO_PRIORITY_INTERACTIVE) {
+        g_last_interactive_us = req->queued_us;
+    }
+    xSemaphoreGive(g_queue_mutex);
+
+    if (stats_lock()) {
+        if (depth > g_stats.queue_max) {
+            g_stats.queue_max = depth;
+        }
+        stats_unlock();
+    }
+
+    xSemaphoreGive(g_wake);
+    xSemaphoreTake(req->done, portMAX_DELAY);
+    xQueueSend(g_waiters, &req->done, portMAX_DELAY);
+    return req->result;
+}
+
+esp_err_t flash_io_read(flash_io_priority_t priority, void* dst, uint32_t address, size_t size)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_t req = { .op = OP_READ, .priority = priority, .address = address,
+                      .buf = dst, .size = (uint32_t)size };
+    return submit(&req);
+}
+
+esp_err_t flash_io_write(flash_io_priority_t priority, const void* src, uint32_t address, size_t size)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT || !src) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_t req = { .op = OP_WRITE, .priority = priority, .address = address,
+                      .buf = (uint8_t*)src, .size = (uint32_t)size };
+    return submit(&req);
+}
+
+esp_err_t flash_io_erase(flash_io_priority_t priority, uint32_t address, size_t size)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_t req = { .op = OP_ERASE, .priority = priority, .address = address, .size = (uint32_t)size };
+    return submit(&req);
+}
+
+esp_err_t flash_io_partition_read(flash_io_priority_t priority, const esp_partition_t* partition,
+                                  size_t offset, void* dst, size_t size)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT || !partition || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_t req = { .op = OP_READ, .priority = priority, .partition = partition,
+                      .address = (uint32_t)offset, .buf = dst, .size = (uint32_t)size };
+    return submit(&req);
+}
+
+esp_err_t flash_io_partition_write(flash_io_priority_t priority, const esp_partition_t* partition,
+                                   size_t offset, const void* src, size_t size)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT || !partition || !src) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_t req = { .op = OP_WRITE, .priority = priority, .partition = partition,
+                      .address = (uint32_t)offset, .buf = (uint8_t*)src, .size = (uint32_t)size };
+    return submit(&req);
+}
+
+esp_err_t flash_io_map(const esp_partition_t* partition, size_t offset, size_t size, flash_io_map_t* map)
+{
+    if (!map) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(map, 0, sizeof(*map));
+    if (!partition || size == 0 || size > FLASH_IO_MAP_WINDOW || offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_map_enabled) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+    const void* ptr = NULL;
+    if (!partition->encrypted) {
+        ret = esp_partition_mmap(partition, offset, size, ESP_PARTITION_MMAP_DATA, &ptr, &map->handle);
+    }
+    if (ret != ESP_OK) {
+        if (!g_map_fallback_logged) {
+            g_map_fallback_logged = true;
+            ESP_LOGW(TAG, "Cannot map %s+0x%zx (%zu bytes): %s, falling back to queued reads",
+                     partition->label, offset, size,
+                     partition->encrypted ? "partition is encrypted" : esp_err_to_name(ret));
+        } else {
+            ESP_LOGD(TAG, "mmap of %s+0x%zx (%zu bytes) failed: %s",
+                     partition->label, offset, size, esp_err_to_name(ret));
+        }
+        return ret;
+    }
+    map->data = ptr;
+    map->size = size;
+
+    if (stats_lock()) {
+        g_stats.maps++;
+        g_stats.bytes_mapped += size;
+        stats_unlock();
+    }
+    return ESP_OK;
+}
+
+void flash_io_unmap(flash_io_map_t* map)
+{
+    if (map && map->data) {
+        esp_partition_munmap(map->handle);
+        map->data = NULL;
+        map->size = 0;
+    }
+}
+
+void flash_io_set_map_enabled(bool enabled)
+{
+    g_map_enabled = enabled;
+}
+
+uint64_t flash_io_pages_skipped_total(void)
+{
+    uint64_t total = 0;
+    if (stats_lock()) {
+        total = g_pages_skipped_total;
+        stats_unlock();
+    }
+    return total;
+}
+
+uint32_t flash_io_idle_ms(flash_io_priority_t priority)
+{
+    if (priority >= FLASH_IO_PRIORITY_COUNT || !g_queue_mutex) {
+        return UINT32_MAX;
+    }
+    xSemaphoreTake(g_queue_mutex, portMAX_DELAY);
+    uint32_t pending = g_pending[priority];
+    int64_t last_done_us = g_last_done_us[priority];
+    xSemaphoreGive(g_queue_mutex);
+
+    if (pending > 0) {
+        return 0;
+    }
+    int64_t idle_us = esp_timer_get_time() - last_done_us;
+    return idle_us / 1000 > UINT32_MAX ? UINT32_MAX : (uint32_t)(idle_us / 1000);
+}
+
+void flash_io_get_stats(flash_io_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!stats_lock()) {
+        return;
+    }
+    *stats = g_stats;
+    stats_unlock();
+}
+
+void flash_io_format_stats(char* buf, size_t size)
+{
+    flash_io_stats_t stats;
+    flash_io_get_stats(&stats);
+
+    if (!buf || size == 0) {
+        return;
+    }
+
+    size_t used = snprintf(buf, size,
+                           "Flash I/O (queue max %" PRIu32 ", %" PRIu32 " steps, %" PRIu32 " preempted)\n"
+                           "  blank pages skipped %" PRIu32 " of %" PRIu32 "\n"
+                           "  mapped reads %" PRIu32 " (%" PRIu64 " KB)\n",
+                           stats.queue_max, stats.steps, stats.preemptions, stats.pages_skipped,
+                           stats.pages_programmed + stats.pages_skipped,
+                           stats.maps, stats.bytes_mapped / 1024);
+
+    for (int i = 0; i < FLASH_IO_PRIORITY_COUNT && used < size; i++) {
+        const flash_io_priority_stats_t* p = &stats.priorities[i];
+        uint32_t latency_us_avg = p->requests ? (uint32_t)(p->latency_us_total / p->requests) : 0;
+        used += snprintf(buf + used, size - used,
+                         "  %-11s %7" PRIu32 " req, %" PRIu32 " us avg (max %" PRIu32 ")\n",
+                         priority_names[i], p->requests, latency_us_avg, p->latency_us_max);
+    }
+}
+
+void flash_io_log_stats(void)
+{
+    flash_io_stats_t stats;
+    flash_io_get_stats(&stats);
+
+    char line[896];
+    size_t used = snprintf(line, sizeof(line),
+                           "FLASH_IO_STATS queue_max=%" PRIu32 " steps=%" PRIu32 " preemptions=%" PRIu32
+                           " pages_programmed=%" PRIu32 " pages_skipped=%" PRIu32
+                           " maps=%" PRIu32 " bytes_mapped=%" PRIu64,
+                           stats.queue_max, stats.steps, stats.preemptions,
+                           stats.pages_programmed, stats.pages_skipped,
+                           stats.maps, stats.bytes_mapped);
+
+    for (int i = 0; i < FLASH_IO_PRIORITY_COUNT && used < sizeof(line); i++) {
+        const flash_io_priority_stats_t* p = &stats.priorities[i];
+        const char* n = priority_names[i];
+        uint32_t wait_us_avg = p->requests ? (uint32_t)(p->wait_us_total / p->requests) : 0;
+        uint32_t latency_us_avg = p->requests ? (uint32_t)(p->latency_us_total / p->requests) : 0;
+        used += snprintf(line + used, sizeof(line) - used,
+                         " %s_requests=%" PRIu32 " %s_bytes=%" PRIu64
+                         " %s_wait_us_avg=%" PRIu32 " %s_wait_us_max=%" PRIu32
+                         " %s_latency_us_avg=%" PRIu32 " %s_latency_us_max=%" PRIu32,
+                         n, p->requests, n, p->bytes, n, wait_us_avg, n, p->wait_us_max,
+                         n, latency_us_avg, n, p->latency_us_max);
+    }
+
+    ESP_LOGI(TAG, "%s", line);
+
+    if (stats_lock()) {
+        memset(&g_stats, 0, sizeof(g_stats));
+        stats_unlock();
+    }
+}
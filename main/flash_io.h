@@ -0,0 +1,241 @@
+/**
+ * @file flash_io.h
+ * @brief Prioritized flash I/O service
+ *
+ * Every flash access of the bootloader (firmware flasher, SD OTA, partition
+ * table, visualizer, config log and the background pre-erase) is queued to
+ * one worker task instead of calling the flash driver directly. Interactive
+ * reads are served before bulk programs and erases, and background requests
+ * only when nothing else is queued. Long bulk operations run in steps (64 KiB
+ * blocks, or 4 KiB sectors while interactive requests are arriving) and
+ * queued interactive reads are served between steps, so a UI read waits
+ * for at most one step rather than a whole partition erase.
+ *
+ * Flash auto-suspend (CONFIG_SPI_FLASH_AUTO_SUSPEND) only lets instruction
+ * fetches from cache preempt an erase; esp_flash_read() still waits for the
+ * running driver call, which is what the steps bound.
+ *
+ * Writes leave out 256-byte pages that are all 0xFF: the range is erased
+ * already, so programming them would cost page program time for nothing.
+ * Read-back of a skipped page returns 0xFF like a programmed one, so
+ * verification is unaffected.
+ * Bulk data transfers ask io_arbiter for bandwidth from the worker, so
+ * callers no longer pace themselves; interactive reads are served while a
+ * step waits for it.
+ *
+ * Verification can read a partition range in place through the flash cache
+ * instead (flash_io_map()): CRC and SHA run on the mapped window, with no
+ * heap buffer and no copy. Mapped reads bypass the queue; the flash driver
+ * flushes the cache over every range it writes or erases, and cache misses
+ * wait for a running driver call like a queued read would.
+ */
+
+#ifndef FLASH_IO_H
+#define FLASH_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_IO_SECTOR_SIZE        (4 * 1024)   // Smallest erase; step while interactive
+#define FLASH_IO_BLOCK_SIZE         (64 * 1024)  // Block erase; step otherwise
+#define FLASH_IO_MAX_WAITERS        8            // Tasks that can wait on the service at once
+#define FLASH_IO_INTERACTIVE_WINDOW_MS 250       // Sector steps for this long after an interactive request
+#define FLASH_IO_PAGE_SIZE          256          // Program page; all-0xFF pages are not written
+#define FLASH_IO_MAP_WINDOW         (1024 * 1024) // Largest range mapped at once
+
+/**
+ * @brief Request priorities, highest first
+ */
+typedef enum {
+    FLASH_IO_PRIORITY_INTERACTIVE = 0,  // Reads a user is waiting for (visualizer, partition table, settings)
+    FLASH_IO_PRIORITY_BULK,             // Firmware programming, erases and verification
+    FLASH_IO_PRIORITY_BACKGROUND,       // Idle-time work (pre-erase); always sector steps
+    FLASH_IO_PRIORITY_COUNT
+} flash_io_priority_t;
+
+/**
+ * @brief Counters of one priority
+ */
+typedef struct {
+    uint32_t requests;          // Requests completed
+    uint64_t bytes;             // Bytes read, written or erased
+    uint64_t wait_us_total;     // Queued until started
+    uint32_t wait_us_max;
+    uint64_t latency_us_total;  // Queued until completed
+    uint32_t latency_us_max;
+} flash_io_priority_stats_t;
+
+/**
+ * @brief Service counters since start-up or the last reset
+ */
+typedef struct {
+    uint32_t queue_max;    // Deepest the queue has been
+    uint32_t steps;        // Driver calls made by bulk and background requests
+    uint32_t preemptions;  // Interactive requests served between the steps of a bulk one
+    uint32_t pages_programmed;  // Pages handed to the driver by writes
+    uint32_t pages_skipped;     // All-0xFF pages left erased
+    uint32_t maps;              // Ranges read in place through flash_io_map()
+    uint64_t bytes_mapped;
+    flash_io_priority_stats_t priorities[FLASH_IO_PRIORITY_COUNT];
+} flash_io_stats_t;
+
+/**
+ * @brief Partition range mapped for reading in place
+ */
+typedef struct {
+    const uint8_t* data;                  // Valid until flash_io_unmap()
+    size_t size;
+    esp_partition_mmap_handle_t handle;
+} flash_io_map_t;
+
+/**
+ * @brief Create the queues and start the worker task
+ *
+ * Call once before any task that touches flash runs; later calls are no-ops.
+ * Requests fail until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the task or its queues cannot be created
+ */
+esp_err_t flash_io_init(void);
+
+/**
+ * @brief Read from an absolute flash address (esp_flash_read)
+ * @param priority Request priority
+ * @param dst Output buffer
+ * @param address Flash address
+ * @param size Bytes to read
+ * @return Result of the driver call, or ESP_ERR_INVALID_STATE before flash_io_init()
+ */
+esp_err_t flash_io_read(flash_io_priority_t priority, void* dst, uint32_t address, size_t size);
+
+/**
+ * @brief Program an erased flash range (esp_flash_write)
+ * @param priority Request priority
+ * @param src Data to write
+ * @param address Flash address
+ * @param size Bytes to write
+ * @return Result of the driver call, or ESP_ERR_INVALID_STATE before flash_io_init()
+ */
+esp_err_t flash_io_write(flash_io_priority_t priority, const void* src, uint32_t address, size_t size);
+
+/**
+ * @brief Erase a sector-aligned flash range in steps (esp_flash_erase_region)
+ * @param priority Request priority
+ * @param address Flash address, sector aligned
+ * @param size Bytes to erase, a multiple of the sector size
+ * @return Result of the first failing step, ESP_OK, or ESP_ERR_INVALID_STATE
+ *         before flash_io_init()
+ */
+esp_err_t flash_io_erase(flash_io_priority_t priority, uint32_t address, size_t size);
+
+/**
+ * @brief Read from a partition (esp_partition_read)
+ * @param priority Request priority
+ * @param partition Partition
+ * @param offset Offset inside the partition
+ * @param dst Output buffer
+ * @param size Bytes to read
+ * @return Result of the driver call, or ESP_ERR_INVALID_STATE before flash_io_init()
+ */
+esp_err_t flash_io_partition_read(flash_io_priority_t priority, const esp_partition_t* partition,
+                                  size_t offset, void* dst, size_t size);
+
+/**
+ * @brief Write to a partition (esp_partition_write)
+ * @param priority Request priority
+ * @param partition Partition
+ * @param offset Offset inside the partition
+ * @param src Data to write
+ * @param size Bytes to write
+ * @return Result of the driver call, or ESP_ERR_INVALID_STATE before flash_io_init()
+ */
+esp_err_t flash_io_partition_write(flash_io_priority_t priority, const esp_partition_t* partition,
+                                   size_t offset, const void* src, size_t size);
+
+/**
+ * @brief Map a partition range into the data address space (esp_partition_mmap)
+ *
+ * Not available for encrypted partitions: the cache decrypts, while
+ * flash_io_read() returns the raw bytes the tables were built from.
+ * Callers fall back to queued reads on any error.
+ *
+ * @param partition Partition
+ * @param offset Offset inside the partition
+ * @param size Bytes to map, at most FLASH_IO_MAP_WINDOW
+ * @param map Output mapping, release with flash_io_unmap()
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if mapping is disabled or the
+ *         partition is encrypted, or the result of esp_partition_mmap()
+ */
+esp_err_t flash_io_map(const esp_partition_t* partition, size_t offset, size_t size, flash_io_map_t* map);
+
+/**
+ * @brief Release a mapping from flash_io_map()
+ * @param map Mapping; safe to call on one that failed
+ */
+void flash_io_unmap(flash_io_map_t* map);
+
+/**
+ * @brief Enable or disable mapped reads (on by default)
+ *
+ * With mapping off, flash_io_map() fails and callers use queued reads,
+ * for comparing both paths.
+ *
+ * @param enabled false to force queued reads
+ */
+void flash_io_set_map_enabled(bool enabled);
+
+/**
+ * @brief Check whether a buffer is all 0xFF
+ * @param data Buffer
+ * @param size Bytes to check
+ * @return true if every byte is 0xFF
+ */
+bool flash_io_is_blank(const void* data, size_t size);
+
+/**
+ * @brief Pages skipped by writes since start-up
+ *
+ * Never reset, unlike the counters; callers take the difference around
+ * a transfer.
+ *
+ * @return All-0xFF pages left erased
+ */
+uint64_t flash_io_pages_skipped_total(void);
+
+/**
+ * @brief Time since the last request of a priority finished
+ * @param priority Priority
+ * @return Milliseconds, 0 while a request of that priority is queued or running
+ */
+uint32_t flash_io_idle_ms(flash_io_priority_t priority);
+
+/**
+ * @brief Get the counters
+ * @param stats Output counters
+ */
+void flash_io_get_stats(flash_io_stats_t* stats);
+
+/**
+ * @brief Format the counters for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void flash_io_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable FLASH_IO_STATS line and reset the counters
+ */
+void flash_io_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_IO_H
@@ -0,0 +1,103 @@
+/**
+ * @file image_digest_cache.c
+ * @brief Per-slot cache of verified image digests for the bootloader fast path
+ */
+
+#include "image_digest_cache.h"
+#include "config_log.h"
+#include "esp_log.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "image_digest";
+
+esp_err_t image_digest_cache_get(uint32_t slot, image_digest_record_t* record)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !record) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t length = sizeof(*record);
+    esp_err_t ret = config_log_read(CONFIG_LOG_KEY_IMAGE_DIGEST(slot), record, &length);
+    if (ret != ESP_OK) {
+        return ret == ESP_ERR_INVALID_SIZE ? ESP_ERR_NOT_FOUND : ret;
+    }
+    if (length != sizeof(*record) || record->magic != IMAGE_DIGEST_MAGIC ||
+        record->version != IMAGE_DIGEST_FORMAT_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+static uint32_t next_generation(uint32_t slot)
+{
+    image_digest_record_t previous;
+    return image_digest_cache_get(slot, &previous) == ESP_OK ? previous.generation + 1 : 1;
+}
+
+esp_err_t image_digest_cache_invalidate(uint32_t slot, uint32_t offset)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!config_log_is_ready()) {
+        return ESP_OK;  // Nothing cached, the bootloader always validates fully
+    }
+
+    image_digest_record_t record = {
+        .magic = IMAGE_DIGEST_MAGIC,
+        .version = IMAGE_DIGEST_FORMAT_VERSION,
+        .flags = 0,
+        .generation = next_generation(slot),
+        .offset = offset,
+        .length = 0,
+    };
+
+    esp_err_t ret = config_log_append(CONFIG_LOG_KEY_IMAGE_DIGEST(slot), &record, sizeof(record));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to invalidate slot %" PRIu32 ": %s", slot, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGD(TAG, "Slot %" PRIu32 " invalidated (generation %" PRIu32 ")", slot, record.generation);
+    return ESP_OK;
+}
+
+esp_err_t image_digest_cache_record(uint32_t slot, uint32_t offset, uint32_t length,
+                                   const uint8_t sha256[IMAGE_DIGEST_LEN], bool hash_appended)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !sha256 || length < IMAGE_DIGEST_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!config_log_is_ready()) {
+        return ESP_OK;
+    }
+
+    image_digest_record_t record = {
+        .magic = IMAGE_DIGEST_MAGIC,
+        .version = IMAGE_DIGEST_FORMAT_VERSION,
+        .flags = IMAGE_DIGEST_FLAG_VERIFIED | (hash_appended ? IMAGE_DIGEST_FLAG_HASH_APPENDED : 0),
+        .offset = offset,
+        .length = length,
+    };
+    memcpy(record.sha256, sha256, sizeof(record.sha256));
+
+    // Same generation as the invalidation that preceded this write
+    image_digest_record_t previous;
+    if (image_digest_cache_get(slot, &previous) == ESP_OK && previous.offset == offset &&
+        !(previous.flags & IMAGE_DIGEST_FLAG_VERIFIED)) {
+        record.generation = previous.generation;
+    } else {
+        record.generation = next_generation(slot);
+    }
+
+    esp_err_t ret = config_log_append(CONFIG_LOG_KEY_IMAGE_DIGEST(slot), &record, sizeof(record));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to record digest for slot %" PRIu32 ": %s", slot, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Slot %" PRIu32 " digest recorded: %" PRIu32 " bytes (generation %" PRIu32 ")",
+             slot, length, record.generation);
+    return ESP_OK;
+}
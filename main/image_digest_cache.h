@@ -0,0 +1,66 @@
+/**
+ * @file image_digest_cache.h
+ * @brief Per-slot cache of verified image digests for the bootloader fast path
+ *
+ * See image_digest_format.h for the record format and the trust rules the
+ * bootloader applies.
+ */
+
+#ifndef IMAGE_DIGEST_CACHE_H
+#define IMAGE_DIGEST_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "image_digest_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mark a slot as being rewritten
+ *
+ * Must be called before the slot is erased. Appends an unverified record
+ * with the next generation so the bootloader validates the slot fully until
+ * image_digest_cache_record() succeeds.
+ *
+ * @param slot OTA slot index (0 = OTA_0)
+ * @param offset Slot flash offset
+ * @return ESP_OK on success (also when no config log is available)
+ */
+esp_err_t image_digest_cache_invalidate(uint32_t slot, uint32_t offset);
+
+/**
+ * @brief Record the digest of an image the caller has just verified
+ *
+ * Appends a verified record for the current generation. The caller must
+ * already have checked the image as written, e.g. the installer's read-back
+ * or esp_image_verify(), and passes the SHA-256 it computed there, so the
+ * slot is not hashed a second time.
+ *
+ * @param slot OTA slot index (0 = OTA_0)
+ * @param offset Slot flash offset
+ * @param length Image length including the appended digest
+ * @param sha256 SHA-256 of the image up to the appended digest
+ * @param hash_appended The image carries that digest in its last 32 bytes
+ * @return ESP_OK on success (also when no config log is available),
+ *         ESP_ERR_INVALID_ARG on a bad slot or length
+ */
+esp_err_t image_digest_cache_record(uint32_t slot, uint32_t offset, uint32_t length,
+                                   const uint8_t sha256[IMAGE_DIGEST_LEN], bool hash_appended);
+
+/**
+ * @brief Read the newest record for a slot
+ *
+ * @param slot OTA slot index
+ * @param record Output record
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if none
+ */
+esp_err_t image_digest_cache_get(uint32_t slot, image_digest_record_t* record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGE_DIGEST_CACHE_H
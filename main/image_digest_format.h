@@ -0,0 +1,50 @@
+/**
+ * @file image_digest_format.h
+ * @brief Verified-image digest records shared by the factory app and the bootloader
+ *
+ * After the factory app has fully validated an image it just wrote, it
+ * appends one record per OTA slot to the config log. Every write to a slot
+ * first appends an unverified record with the next generation, so an
+ * interrupted flash never leaves a trusted record behind. The bootloader
+ * skips re-hashing a slot only if its newest record is verified, matches
+ * the slot offset, and the SHA-256 appended to the image in flash still
+ * equals the recorded digest.
+ *
+ * This header only depends on the C standard library.
+ */
+
+#ifndef IMAGE_DIGEST_FORMAT_H
+#define IMAGE_DIGEST_FORMAT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IMAGE_DIGEST_MAGIC              0x4449      // "ID"
+#define IMAGE_DIGEST_FORMAT_VERSION     1
+#define IMAGE_DIGEST_MAX_SLOTS          16          // OTA_0 .. OTA_15
+#define IMAGE_DIGEST_LEN                32          // SHA-256
+
+#define IMAGE_DIGEST_FLAG_VERIFIED      0x01        // Full validation passed for this generation
+#define IMAGE_DIGEST_FLAG_HASH_APPENDED 0x02        // Image carries its SHA-256 in the last 32 bytes
+
+// Config log key of the record for OTA slot i
+#define CONFIG_LOG_KEY_IMAGE_DIGEST(i)  (0x0200 + (i))
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;                       // IMAGE_DIGEST_MAGIC
+    uint8_t version;                      // IMAGE_DIGEST_FORMAT_VERSION
+    uint8_t flags;                        // IMAGE_DIGEST_FLAG_*
+    uint32_t generation;                  // Bumped before every write to the slot
+    uint32_t offset;                      // Slot flash offset
+    uint32_t length;                      // Image length including the appended digest
+    uint8_t sha256[IMAGE_DIGEST_LEN];     // Image digest computed during validation
+} image_digest_record_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGE_DIGEST_FORMAT_H
@@ -0,0 +1,361 @@
+/**
+ * @file io_arbiter.c
+ * @brief Token-bucket bandwidth arbiter between the display and bulk I/O
+ */
+
+#include "io_arbiter.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "io_arbiter";
+
+// Upper bound on tasks woken at once by the end of a frame
+#define IO_ARBITER_MAX_WAITERS 8
+
+static const char* const client_names[IO_CLIENT_COUNT] = {
+    "sd_read",
+    "flash_write",
+    "flash_read",
+};
+
+static SemaphoreHandle_t g_arbiter_mutex = NULL;
+static SemaphoreHandle_t g_frame_done = NULL;
+static uint32_t g_waiters = 0;
+
+static uint32_t g_rate_kbps = IO_ARBITER_DEFAULT_RATE_KBPS;
+static uint32_t g_burst_kb = IO_ARBITER_DEFAULT_BURST_KB;
+static volatile bool g_busy = false;
+static int64_t g_tokens = IO_ARBITER_DEFAULT_BURST_KB * 1024;
+static int64_t g_last_refill_us = 0;
+static int64_t g_frame_start_us = 0;
+
+static int64_t g_window_start_us = 0;
+static uint64_t g_frame_busy_us = 0;
+static uint32_t g_frames = 0;
+static io_client_stats_t g_clients[IO_CLIENT_COUNT];
+
+// Fails until io_arbiter_init() has run; callers then let the I/O through
+static bool arbiter_lock(void)
+{
+    return g_arbiter_mutex && xSemaphoreTake(g_arbiter_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void arbiter_unlock(void)
+{
+    xSemaphoreGive(g_arbiter_mutex);
+}
+
+static int64_t burst_bytes(void)
+{
+    return (int64_t)g_burst_kb * 1024;
+}
+
+// Caller holds the lock; tokens only drain while a frame is in flight
+static void refill(int64_t now)
+{
+    if (g_busy) {
+        g_tokens += (now - g_last_refill_us) * (int64_t)g_rate_kbps * 1024 / 1000000;
+        if (g_tokens > burst_bytes()) {
+            g_tokens = burst_bytes();
+        }
+    }
+    g_last_refill_us = now;
+}
+
+esp_err_t io_arbiter_init(void)
+{
+    if (g_arbiter_mutex) {
+        return ESP_OK;
+    }
+
+    if (!g_frame_done) {
+        g_frame_done = xSemaphoreCreateCounting(IO_ARBITER_MAX_WAITERS, 0);
+    }
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    if (!mutex || !g_frame_done) {
+        ESP_LOGE(TAG, "Failed to create arbiter semaphores");
+        if (mutex) {
+            vSemaphoreDelete(mutex);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    g_window_start_us = esp_timer_get_time();
+    // Published last: a non-NULL mutex means everything else is set up
+    g_arbiter_mutex = mutex;
+    return ESP_OK;
+}
+
+esp_err_t io_arbiter_set_budget(uint32_t rate_kbps, uint32_t burst_kb)
+{
+    if (burst_kb == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!arbiter_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    refill(esp_timer_get_time());
+    g_rate_kbps = rate_kbps;
+    g_burst_kb = burst_kb;
+    if (g_tokens > burst_bytes()) {
+        g_tokens = burst_bytes();
+    }
+    arbiter_unlock();
+
+    ESP_LOGI(TAG, "Budget during frames: %" PRIu32 " KiB/s, burst %" PRIu32 " KiB", rate_kbps, burst_kb);
+    return ESP_OK;
+}
+
+void io_arbiter_frame_begin(void)
+{
+    if (!arbiter_lock()) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    refill(now);
+    g_busy = true;
+    g_frame_start_us = now;
+    g_frames++;
+    arbiter_unlock();
+}
+
+void io_arbiter_frame_end(void)
+{
+    if (!arbiter_lock()) {
+        return;
+    }
+    if (g_busy) {
+        int64_t now = esp_timer_get_time();
+        g_busy = false;
+        g_frame_busy_us += (uint64_t)(now - g_frame_start_us);
+        g_last_refill_us = now;
+    }
+
+    // The display no longer needs the bus; start the next frame with a full bucket
+    g_tokens = burst_bytes();
+    for (uint32_t i = 0; i < g_waiters; i++) {
+        xSemaphoreGive(g_frame_done);
+    }
+    arbiter_unlock();
+}
+
+bool io_arbiter_display_busy(void)
+{
+    return g_busy;
+}
+
+// Caller holds the lock; microseconds until `bytes` may go, 0 to go now.
+// Sets *forced once the request has waited IO_ARBITER_MAX_WAIT_MS since `start`
+static int64_t time_to_grant(size_t bytes, int64_t start, bool* forced)
+{
+    int64_t now = esp_timer_get_time();
+    refill(now);
+
+    if (!g_busy) {
+        return 0;
+    }
+
+    // Oversized requests go through on a full bucket and leave it in debt
+    int64_t needed = (int64_t)bytes < burst_bytes() ? (int64_t)bytes : burst_bytes();
+    if (g_tokens >= needed) {
+        return 0;
+    }
+
+    int64_t waited_us = now - start;
+    if (waited_us >= IO_ARBITER_MAX_WAIT_MS * 1000) {
+        *forced = true;
+        return 0;
+    }
+
+    // Until the bucket would hold enough, or the wait limit
+    int64_t wait_us = IO_ARBITER_MAX_WAIT_MS * 1000 - waited_us;
+    if (g_rate_kbps > 0) {
+        int64_t refill_us = (needed - g_tokens) * 1000000 / ((int64_t)g_rate_kbps * 1024);
+        if (refill_us < wait_us) {
+            wait_us = refill_us;
+        }
+    }
+    return wait_us > 0 ? wait_us : 1;
+}
+
+// Caller holds the lock; takes the tokens and counts the request
+static void grant(io_client_t client, size_t bytes, int64_t start, bool waited, bool forced)
+{
+    io_client_stats_t* stats = &g_clients[client];
+
+    if (g_busy) {
+        g_tokens -= (int64_t)bytes;
+        stats->bytes_in_frame += bytes;
+    }
+    stats->requests++;
+    stats->bytes += bytes;
+    if (waited) {
+        uint32_t wait_us = (uint32_t)(esp_timer_get_time() - start);
+        stats->waits++;
+        stats->wait_us_total += wait_us;
+        if (wait_us > stats->wait_us_max) {
+            stats->wait_us_max = wait_us;
+        }
+    }
+    if (forced) {
+        stats->forced++;
+    }
+}
+
+void io_arbiter_acquire(io_client_t client, size_t bytes)
+{
+    if (client >= IO_CLIENT_COUNT || bytes == 0) {
+        return;
+    }
+    if (!arbiter_lock()) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    bool waited = false;
+    bool forced = false;
+    int64_t wait_us;
+
+    // Sleep until the bucket would hold enough, or the frame ends first
+    while ((wait_us = time_to_grant(bytes, start, &forced)) > 0) {
+        TickType_t ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+
+        waited = true;
+        if (g_waiters < IO_ARBITER_MAX_WAITERS) {
+            g_waiters++;
+            arbiter_unlock();
+            xSemaphoreTake(g_frame_done, ticks);
+            arbiter_lock();
+            g_waiters--;
+        } else {
+            arbiter_unlock();
+            vTaskDelay(ticks);
+            arbiter_lock();
+        }
+    }
+
+    grant(client, bytes, start, waited, forced);
+    arbiter_unlock();
+}
+
+bool io_arbiter_try_acquire(io_client_t client, size_t bytes, int64_t* wait_start_us, uint32_t* wait_ms)
+{
+    if (wait_ms) {
+        *wait_ms = 0;
+    }
+    if (client >= IO_CLIENT_COUNT || bytes == 0 || !wait_start_us) {
+        return true;
+    }
+    if (!arbiter_lock()) {
+        return true;
+    }
+
+    bool waited = *wait_start_us != 0;
+    int64_t start = waited ? *wait_start_us : esp_timer_get_time();
+    bool forced = false;
+    int64_t wait_us = time_to_grant(bytes, start, &forced);
+
+    if (wait_us > 0) {
+        *wait_start_us = start;
+        arbiter_unlock();
+        if (wait_ms) {
+            *wait_ms = (uint32_t)((wait_us + 999) / 1000);
+        }
+        return false;
+    }
+
+    grant(client, bytes, start, waited, forced);
+    arbiter_unlock();
+    return true;
+}
+
+void io_arbiter_get_stats(io_arbiter_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!arbiter_lock()) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - g_window_start_us;
+    uint64_t busy_us = g_frame_busy_us + (g_busy ? (uint64_t)(now - g_frame_start_us) : 0);
+
+    stats->rate_kbps = g_rate_kbps;
+    stats->burst_kb = g_burst_kb;
+    stats->window_ms = elapsed_us > 0 ? (uint32_t)(elapsed_us / 1000) : 0;
+    stats->frames = g_frames;
+    stats->frame_busy_pct = elapsed_us > 0 ? (uint32_t)(busy_us * 100 / (uint64_t)elapsed_us) : 0;
+    memcpy(stats->clients, g_clients, sizeof(stats->clients));
+    arbiter_unlock();
+}
+
+void io_arbiter_format_stats(char* buf, size_t size)
+{
+    io_arbiter_stats_t stats;
+    io_arbiter_get_stats(&stats);
+
+    if (!buf || size == 0) {
+        return;
+    }
+
+    size_t used = snprintf(buf, size,
+                           "I/O arbiter (%" PRIu32 " KiB/s, burst %" PRIu32 " KiB)\n"
+                           "  frames       %9" PRIu32 " (%" PRIu32 " %% busy)\n",
+                           stats.rate_kbps, stats.burst_kb, stats.frames, stats.frame_busy_pct);
+
+    for (int i = 0; i < IO_CLIENT_COUNT && used < size; i++) {
+        const io_client_stats_t* c = &stats.clients[i];
+        used += snprintf(buf + used, size - used,
+                         "  %-12s %9" PRIu64 " KiB, %" PRIu32 " waits (max %" PRIu32 " us)\n",
+                         client_names[i], c->bytes / 1024, c->waits, c->wait_us_max);
+    }
+}
+
+void io_arbiter_log_stats(void)
+{
+    io_arbiter_stats_t stats;
+    io_arbiter_get_stats(&stats);
+
+    char line[768];
+    size_t used = snprintf(line, sizeof(line),
+                           "IO_STATS window_ms=%" PRIu32 " rate_kbps=%" PRIu32 " burst_kb=%" PRIu32
+                           " frames=%" PRIu32 " frame_busy_pct=%" PRIu32,
+                           stats.window_ms, stats.rate_kbps, stats.burst_kb, stats.frames, stats.frame_busy_pct);
+
+    for (int i = 0; i < IO_CLIENT_COUNT && used < sizeof(line); i++) {
+        const io_client_stats_t* c = &stats.clients[i];
+        uint32_t wait_avg = c->waits ? (uint32_t)(c->wait_us_total / c->waits) : 0;
+        used += snprintf(line + used, sizeof(line) - used,
+                         " %s_bytes=%" PRIu64 " %s_in_frame=%" PRIu64 " %s_waits=%" PRIu32
+                         " %s_wait_us_avg=%" PRIu32 " %s_wait_us_max=%" PRIu32 " %s_forced=%" PRIu32,
+                         client_names[i], c->bytes, client_names[i], c->bytes_in_frame,
+                         client_names[i], c->waits, client_names[i], wait_avg,
+                         client_names[i], c->wait_us_max, client_names[i], c->forced);
+    }
+
+    ESP_LOGI(TAG, "%s", line);
+
+    if (arbiter_lock()) {
+        int64_t now = esp_timer_get_time();
+        g_window_start_us = now;
+        g_frame_busy_us = 0;
+        if (g_busy) {
+            g_frame_start_us = now;
+        }
+        g_frames = 0;
+        memset(g_clients, 0, sizeof(g_clients));
+        arbiter_unlock();
+    }
+}
@@ -0,0 +1,152 @@
+/**
+ * @file io_arbiter.h
+ * @brief Token-bucket bandwidth arbiter between the display and bulk I/O
+ *
+ * SD card reads and flash writes compete with the display for DMA and
+ * memory bandwidth. Instead of fixed delays, bulk transfers ask the arbiter
+ * for tokens (bytes) before they run. While the display is idle every
+ * request is granted at once; while a frame is being rendered and pushed,
+ * tokens are replenished at a configurable rate and requests beyond the
+ * budget wait until the bucket has refilled or the frame has finished.
+ */
+
+#ifndef IO_ARBITER_H
+#define IO_ARBITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default bulk I/O budget while a frame is in flight
+#define IO_ARBITER_DEFAULT_RATE_KBPS 512
+#define IO_ARBITER_DEFAULT_BURST_KB  8
+
+// A request is granted after this long even if the frame never finishes
+#define IO_ARBITER_MAX_WAIT_MS 100
+
+/**
+ * @brief Bulk I/O clients, counted separately
+ */
+typedef enum {
+    IO_CLIENT_SD_READ = 0,
+    IO_CLIENT_FLASH_WRITE,
+    IO_CLIENT_FLASH_READ,
+    IO_CLIENT_COUNT
+} io_client_t;
+
+/**
+ * @brief Counters of one client
+ */
+typedef struct {
+    uint32_t requests;        // Granted requests
+    uint64_t bytes;           // Granted bytes
+    uint64_t bytes_in_frame;  // Bytes granted while a frame was in flight
+    uint32_t waits;           // Requests that had to wait
+    uint64_t wait_us_total;
+    uint32_t wait_us_max;
+    uint32_t forced;          // Granted after IO_ARBITER_MAX_WAIT_MS
+} io_client_stats_t;
+
+/**
+ * @brief Arbiter counters since start-up or the last reset
+ */
+typedef struct {
+    uint32_t rate_kbps;       // Current budget while a frame is in flight
+    uint32_t burst_kb;
+    uint32_t window_ms;       // Time covered by the counters
+    uint32_t frames;          // Frames seen
+    uint32_t frame_busy_pct;  // Share of the window with a frame in flight
+    io_client_stats_t clients[IO_CLIENT_COUNT];
+} io_arbiter_stats_t;
+
+/**
+ * @brief Create the arbiter's semaphores
+ *
+ * Call once before the render loop or any bulk I/O task starts; later calls
+ * are no-ops. Until then every request is granted at once and nothing is
+ * counted.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the semaphores cannot be created
+ */
+esp_err_t io_arbiter_init(void);
+
+/**
+ * @brief Set the bulk I/O budget used while a frame is in flight
+ *
+ * @param rate_kbps Refill rate in KiB/s (0: no bulk I/O during frames)
+ * @param burst_kb Bucket size in KiB; also the largest burst at frame start
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if burst_kb is 0,
+ *         ESP_ERR_INVALID_STATE before io_arbiter_init()
+ */
+esp_err_t io_arbiter_set_budget(uint32_t rate_kbps, uint32_t burst_kb);
+
+/**
+ * @brief A frame starts rendering; called from the render loop
+ */
+void io_arbiter_frame_begin(void);
+
+/**
+ * @brief The frame has been flushed; refills the bucket and releases waiters
+ */
+void io_arbiter_frame_end(void);
+
+/**
+ * @brief Check whether a frame is in flight
+ * @return true between io_arbiter_frame_begin() and io_arbiter_frame_end()
+ */
+bool io_arbiter_display_busy(void);
+
+/**
+ * @brief Get bandwidth for a bulk transfer, blocking if over budget
+ *
+ * Requests larger than the bucket are granted once the bucket is full and
+ * leave it in debt, so they are never starved.
+ *
+ * @param client Client making the request
+ * @param bytes Size of the transfer about to start
+ */
+void io_arbiter_acquire(io_client_t client, size_t bytes);
+
+/**
+ * @brief Get bandwidth for a bulk transfer without blocking
+ *
+ * For a caller with other work to do while over budget: on refusal it does
+ * that work and calls again within *wait_ms. The wait limit counts from the
+ * first refusal, as in io_arbiter_acquire().
+ *
+ * @param client Client making the request
+ * @param bytes Size of the transfer about to start
+ * @param wait_start_us Set to 0 before the first call; keeps the time of the first refusal
+ * @param wait_ms Output: milliseconds until the budget would allow the transfer, 0 when granted
+ * @return true if granted
+ */
+bool io_arbiter_try_acquire(io_client_t client, size_t bytes, int64_t* wait_start_us, uint32_t* wait_ms);
+
+/**
+ * @brief Get the counters
+ * @param stats Output counters
+ */
+void io_arbiter_get_stats(io_arbiter_stats_t* stats);
+
+/**
+ * @brief Format the counters for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void io_arbiter_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable IO_STATS line and reset the counters
+ */
+void io_arbiter_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IO_ARBITER_H
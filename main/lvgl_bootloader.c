@@ -8,14 +8,23 @@
 #include "lvgl_bootloader.h"
 #include "firmware_selector.h"
 #include "firmware_validator.h"
+#include "partition_cache.h"
+#include "firmware_metadata.h"
+#include "firmware_catalog.h"
 #include "board_init.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
-#include "nvs_flash.h"
-#include "nvs.h"
-#include "soc/lp_system_reg.h"
+#include "boot_request.h"
+#include "boot_timing.h"
+#include "render_loop.h"
+#include "io_arbiter.h"
+#include "sd_reader.h"
+#include "flash_io.h"
+#include "ota_preerase.h"
+#include "slot_scrub.h"
+#include "ui_events.h"
 #include "lvgl.h"
 #include "sd_ota.h"
 #include "freertos/FreeRTOS.h"
@@ -23,13 +32,10 @@
 #include "freertos/semphr.h"
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 static const char *TAG = "lvgl_bootloader";
 
-// RTC register constants for bootloader communication
-#define BOOT_REQUEST_RTC_REG     LP_SYSTEM_REG_LP_STORE0_REG
-#define BOOT_REQUEST_MAGIC_RTC   0x00544551  // 'BOOT' magic in ASCII
-
 // Display mutex for thread safety (fallback if BSP doesn't provide lock)
 static SemaphoreHandle_t lvgl_mutex = NULL;
 
@@ -41,6 +47,7 @@ static lv_obj_t *status_label = NULL;
 static lv_obj_t *progress_bar = NULL;
 static lv_obj_t *progress_label = NULL;
 static lv_obj_t *app_cont = NULL;
+static lv_obj_t *settings_content = NULL;
 
 // Firmware selectors
 static firmware_selector_t firmware_selector;  // For SD card (firmwares to flash)
@@ -62,8 +69,62 @@ static lv_style_t style_status;
 // Progress tracking
 static bool ota_in_progress = false;
 
+// Catalog generation the boot menu was built from (0 = not built yet)
+static uint32_t boot_menu_generation = 0;
+static uint32_t boot_menu_scrub_generation = 0;
+static lv_timer_t *boot_menu_timer = NULL;
+
+// Set by lvgl_bootloader_load_installed() once boot_menu_selector is filled
+static bool installed_apps_ready = false;
+static lv_timer_t *installed_apps_timer = NULL;
+
 // Forward declarations for callback functions
+static void boot_app_cb(lv_event_t *e);
 static void boot_firmware_cb(lv_event_t *e);
+static void create_main_screen(void);
+static void create_demo_screen(void);
+static void create_settings_screen(void);
+static void create_boot_menu_screen(void);
+static void destroy_settings_screen(void);
+static void destroy_boot_menu_screen(void);
+static void format_screen_stats(char *buf, size_t size);
+static void account_screen_build(screen_id_t id, void (*build)(void));
+
+// Screens other than the main one are built on first navigation and deleted
+// once left; the SCREEN_CACHE_SIZE most recently used stay built for a
+// quick return. The firmware selector owns its screen (selection and
+// flashing progress live in its widgets) and is only accounted here.
+#define SCREEN_CACHE_SIZE 1
+
+// Diagnostics text on the settings screen: boot timing and the statistics of
+// every service, about 3.8 KiB with all sections at their widest
+#define DIAGNOSTICS_TEXT_SIZE 3904
+
+typedef struct {
+    const char *name;
+    void (*create)(void);   // Builds screens[id]; NULL if not managed here
+    void (*destroy)(void);  // Drops pointers into the screen (can be NULL)
+    bool resident;          // Never torn down
+} screen_def_t;
+
+static const screen_def_t screen_defs[SCREEN_COUNT] = {
+    [SCREEN_MAIN]              = { "main",      create_main_screen,      NULL,                     true  },
+    [SCREEN_DEMO]              = { "demo",      create_demo_screen,      NULL,                     false },
+    [SCREEN_SETTINGS]          = { "settings",  create_settings_screen,  destroy_settings_screen,  false },
+    [SCREEN_FIRMWARE_SELECTOR] = { "selector",  NULL,                    NULL,                     true  },
+    [SCREEN_BOOT_MENU]         = { "boot_menu", create_boot_menu_screen, destroy_boot_menu_screen, false },
+};
+
+// LVGL heap accounting per screen, from lv_mem_monitor() around each build
+typedef struct {
+    uint32_t builds;
+    uint32_t teardowns;
+    int32_t cost_bytes;  // Heap taken by the last build
+    uint32_t last_used;  // Navigation stamp for the cache
+} screen_stats_t;
+
+static screen_stats_t screen_stats[SCREEN_COUNT];
+static uint32_t screen_use_counter = 0;
 
 // Initialize display mutex
 static void init_display_mutex(void)
@@ -126,31 +187,29 @@ static void demo_btn_event_cb(lv_event_t *e)
     }
 }
 
+// Boot buttons own a malloc'd user_data; screens are torn down, so free it with the button
+static void free_user_data_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    free(lv_obj_get_user_data(obj));
+    lv_obj_set_user_data(obj, NULL);
+}
+
 static void back_btn_event_cb(lv_event_t *e)
 {
     ESP_LOGI(TAG, "Back button pressed");
     switch_screen(SCREEN_MAIN);
 }
 
-// Screen management
-static void create_main_screen(void)
+// Fill app_cont with the installed firmwares, or a placeholder until the
+// startup scan has finished
+static void populate_app_list(void)
 {
-    screens[SCREEN_MAIN] = lv_obj_create(NULL);
-    main_screen = screens[SCREEN_MAIN];
-
-    // Create title - position higher and use smaller font
-    title_label = lv_label_create(main_screen);
-    lv_obj_add_style(title_label, &style_title, 0);
-    lv_label_set_text(title_label, "Available Applications");
-    lv_obj_align(title_label, LV_ALIGN_TOP_MID, 0, 20);
-
-    // Create scrollable container for firmware applications list
-    app_cont = lv_obj_create(main_screen);
-    lv_obj_set_size(app_cont, 900, 450); // Large area for application list
-    lv_obj_align(app_cont, LV_ALIGN_CENTER, 0, 0);
-    lv_obj_set_layout(app_cont, LV_LAYOUT_FLEX);
-    lv_obj_set_flex_flow(app_cont, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_flex_align(app_cont, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    if (!__atomic_load_n(&installed_apps_ready, __ATOMIC_ACQUIRE)) {
+        lv_obj_t *label = lv_label_create(app_cont);
+        lv_label_set_text(label, "Loading applications...");
+        return;
+    }
 
     // Use boot_menu_selector to get firmware list from firmware storage (installed firmwares)
     ESP_LOGI(TAG, "Creating firmware list from boot_menu_selector (firmware storage)...");
@@ -205,10 +264,34 @@ static void create_main_screen(void)
         lv_obj_center(label);
         lv_obj_set_style_text_font(label, &lv_font_montserrat_12, 0);
 
-        lv_obj_add_event_cb(btn, boot_firmware_cb, LV_EVENT_CLICKED, NULL);
+        lv_obj_add_event_cb(btn, boot_app_cb, LV_EVENT_CLICKED, NULL);
+        lv_obj_add_event_cb(btn, free_user_data_cb, LV_EVENT_DELETE, NULL);
 
         ESP_LOGI(TAG, "Created boot button for firmware %u: %s", i, firmware->display_name);
     }
+}
+
+// Screen management
+static void create_main_screen(void)
+{
+    screens[SCREEN_MAIN] = lv_obj_create(NULL);
+    main_screen = screens[SCREEN_MAIN];
+
+    // Create title - position higher and use smaller font
+    title_label = lv_label_create(main_screen);
+    lv_obj_add_style(title_label, &style_title, 0);
+    lv_label_set_text(title_label, "Available Applications");
+    lv_obj_align(title_label, LV_ALIGN_TOP_MID, 0, 20);
+
+    // Create scrollable container for firmware applications list
+    app_cont = lv_obj_create(main_screen);
+    lv_obj_set_size(app_cont, 900, 450); // Large area for application list
+    lv_obj_align(app_cont, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_set_layout(app_cont, LV_LAYOUT_FLEX);
+    lv_obj_set_flex_flow(app_cont, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(app_cont, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+    populate_app_list();
 
     // Create "Load from SD Card" button in lower right corner (smaller)
     demo_btns[0] = lv_btn_create(main_screen);
@@ -275,10 +358,10 @@ static void create_settings_screen(void)
     lv_label_set_text(title, "Settings");
     lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 30);
 
-    // Settings content
-    lv_obj_t *content = lv_label_create(screens[SCREEN_SETTINGS]);
-    lv_label_set_text(content, "Settings and configuration\n\nPress Back to return");
-    lv_obj_align(content, LV_ALIGN_CENTER, 0, 0);
+    // Diagnostics content, filled in each time the screen is shown
+    settings_content = lv_label_create(screens[SCREEN_SETTINGS]);
+    lv_label_set_text(settings_content, "Settings and configuration\n\nPress Back to return");
+    lv_obj_align(settings_content, LV_ALIGN_TOP_LEFT, 40, 90);
 
     // Back button
     lv_obj_t *back_btn = lv_btn_create(screens[SCREEN_SETTINGS]);
@@ -295,48 +378,158 @@ static void create_settings_screen(void)
     ESP_LOGI(TAG, "Settings screen created");
 }
 
-// Boot menu event callback
-static void boot_firmware_cb(lv_event_t *e)
+static void format_ui_event_stats(char *buf, size_t size)
+{
+    ui_events_stats_t events;
+    ui_events_get_stats(&events);
+    snprintf(buf, size,
+             "UI events\n  posted %" PRIu32 ", coalesced %" PRIu32 ", dropped %" PRIu32 ", max depth %" PRIu32 "\n",
+             events.posted, events.coalesced, events.dropped, events.high_water);
+}
+
+// Sections of the diagnostics text, in display order
+static void (*const diagnostics_sections[])(char *buf, size_t size) = {
+    boot_timing_format,
+    render_loop_format_stats,
+    io_arbiter_format_stats,
+    sd_reader_format_stats,
+    flash_io_format_stats,
+    ota_preerase_format_stats,
+    slot_scrub_format_stats,
+    format_ui_event_stats,
+    format_screen_stats,
+};
+
+static void update_diagnostics(void)
+{
+    static char text[DIAGNOSTICS_TEXT_SIZE];
+    size_t used = 0;
+
+    // Sections are separated by a blank line; the ones that no longer fit are left out
+    for (size_t i = 0; i < sizeof(diagnostics_sections) / sizeof(diagnostics_sections[0]); i++) {
+        if (i > 0) {
+            if (used + 1 >= sizeof(text)) {
+                break;
+            }
+            text[used++] = '\n';
+        }
+        diagnostics_sections[i](text + used, sizeof(text) - used);
+        used += strlen(text + used);
+    }
+    lv_label_set_text(settings_content, text);
+}
+
+// The first refresh after the main screen is loaded is the first frame on the display
+static void first_flush_cb(lv_event_t *e)
+{
+    (void)e;
+    boot_timing_mark(BOOT_STAGE_APP_FIRST_FLUSH);
+}
+
+// Runs in the LVGL task; swaps the skeleton for the app list once the scan is done
+static void installed_apps_poll_cb(lv_timer_t *timer)
+{
+    if (!__atomic_load_n(&installed_apps_ready, __ATOMIC_ACQUIRE) || !app_cont) {
+        return;
+    }
+
+    lv_obj_clean(app_cont);
+    populate_app_list();
+    boot_timing_mark(BOOT_STAGE_APP_INTERACTIVE);
+
+    lv_timer_delete(timer);
+    installed_apps_timer = NULL;
+}
+
+// Rebuild the boot menu if the catalog or a scrub verdict has moved on; no
+// flash or NVS access
+static void sync_boot_menu(void)
+{
+    uint32_t generation = firmware_catalog_get_generation();
+    if (generation == 0 || (generation == boot_menu_generation &&
+                            slot_scrub_get_generation() == boot_menu_scrub_generation)) {
+        return;
+    }
+
+    lv_obj_clean(screens[SCREEN_BOOT_MENU]);
+    account_screen_build(SCREEN_BOOT_MENU, create_boot_menu_screen);
+}
+
+// Runs in the LVGL task; keeps the boot menu built ahead of being opened
+static void boot_menu_poll_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    if (screens[SCREEN_BOOT_MENU]) {
+        sync_boot_menu();
+    }
+}
+
+// Main screen app button: user data is the index into boot_menu_selector
+static void boot_app_cb(lv_event_t *e)
 {
     lv_obj_t *btn = lv_event_get_target(e);
     uint32_t* firmware_index = (uint32_t*)lv_obj_get_user_data(btn);
 
-    if (firmware_index && boot_menu_selector_initialized) {
+    if (firmware_index && boot_menu_selector_initialized &&
+        *firmware_index < boot_menu_selector.firmware_count) {
         const firmware_info_t* firmware = &boot_menu_selector.firmware_list[*firmware_index];
-        if (firmware) {
-            ESP_LOGI(TAG, "Booting firmware %u: %s (%u bytes)",
-                     *firmware_index, firmware->display_name, firmware->size);
+        ESP_LOGI(TAG, "Booting firmware %u: %s (%u bytes)",
+                 *firmware_index, firmware->display_name, firmware->size);
 
-            // Map firmware index to partition index for bootloader
-            // Bootloader expects: 0=factory, 1=ota_0, 2=ota_1, etc.
-            // Our firmware list: 0=ota_0, 1=ota_1 (no factory in list)
-            int partition_index = (int)(*firmware_index) + 1;
+        // Map firmware index to partition index for bootloader
+        // Bootloader expects: 0=factory, 1=ota_0, 2=ota_1, etc.
+        // Our firmware list: 0=ota_0, 1=ota_1 (no factory in list)
+        int partition_index = (int)(*firmware_index) + 1;
 
-            ESP_LOGI(TAG, "Writing boot request to RTC register: magic=0x%08x, partition_index=%d",
-                     BOOT_REQUEST_MAGIC_RTC, partition_index);
+        // One-time: the app makes it sticky with boot_request_confirm() once healthy
+        boot_request_set((uint8_t)partition_index, false);
 
-            // Write boot request to RTC register for bootloader to read
-            // Combine magic and partition index: lower 24 bits = magic, upper 8 bits = partition index
-            uint32_t rtc_value = BOOT_REQUEST_MAGIC_RTC | (partition_index << 24);
-            REG_WRITE(BOOT_REQUEST_RTC_REG, rtc_value);
+        // Add delay to show booting animation
+        vTaskDelay(pdMS_TO_TICKS(2000));
 
-            ESP_LOGI(TAG, "RTC register updated successfully, value: 0x%08x", rtc_value);
+        ESP_LOGI(TAG, "Restarting now for bootloader to handle the boot request...");
+        esp_restart();
+    } else if (firmware_index) {
+        ESP_LOGE(TAG, "Firmware %u not found", *firmware_index);
+    }
+}
 
-            // Add delay to show booting animation
-            vTaskDelay(pdMS_TO_TICKS(2000));
+// Boot menu event callback: user data is the partition label
+static void boot_firmware_cb(lv_event_t *e)
+{
+    lv_obj_t *btn = lv_event_get_target(e);
+    const char *partition_name = (const char *)lv_obj_get_user_data(btn);
 
-            ESP_LOGI(TAG, "Restarting now for bootloader to handle the boot request...");
-            esp_restart();
-        } else {
-            ESP_LOGE(TAG, "Firmware %u not found", *firmware_index);
-        }
-        free(firmware_index);  // Free the allocated index
+    if (partition_name) {
+        boot_firmware_from_partition(partition_name);
+    }
+}
+
+// Scrub verdict for the slot a catalog entry lives in
+static slot_scrub_state_t entry_scrub_state(const firmware_metadata_t *entry)
+{
+    partition_cache_entry_t part;
+    if (partition_cache_find_by_label(entry->partition, &part) != ESP_OK ||
+        part.type != ESP_PARTITION_TYPE_APP || part.subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN ||
+        part.subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MAX) {
+        return SLOT_SCRUB_UNCHECKED;
     }
+    return slot_scrub_get_state(part.subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN);
 }
 
 static void create_boot_menu_screen(void)
 {
-    screens[SCREEN_BOOT_MENU] = lv_obj_create(NULL);
+    // Catalog copy, kept off the LVGL task stack
+    static firmware_catalog_entry_t entries[MAX_FIRMWARE_ENTRIES];
+    uint32_t firmware_count = 0;
+    uint32_t generation = 0;
+    esp_err_t err = firmware_catalog_get_all(entries, MAX_FIRMWARE_ENTRIES, &firmware_count, &generation);
+
+    if (!screens[SCREEN_BOOT_MENU]) {
+        screens[SCREEN_BOOT_MENU] = lv_obj_create(NULL);
+    }
+    boot_menu_generation = (err == ESP_OK) ? generation : 0;
+    boot_menu_scrub_generation = slot_scrub_get_generation();
 
     // Title
     lv_obj_t *title = lv_label_create(screens[SCREEN_BOOT_MENU]);
@@ -352,49 +545,17 @@ static void create_boot_menu_screen(void)
     lv_obj_set_flex_flow(cont, LV_FLEX_FLOW_COLUMN);
     lv_obj_set_flex_align(cont, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
 
-    // Read firmware configuration from NVS and create boot buttons
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("firmware_config", NVS_READONLY, &nvs_handle);
-    if (err == ESP_OK) {
-        uint32_t firmware_count = 0;
-        err = nvs_get_u32(nvs_handle, "firmware_count", &firmware_count);
-
-        if (err == ESP_OK && firmware_count > 0) {
+    // Create boot buttons from the preloaded catalog
+    if (err == ESP_ERR_INVALID_STATE) {
+        lv_obj_t *loading_label = lv_label_create(cont);
+        lv_label_set_text(loading_label, "Loading applications...");
+        lv_obj_set_style_text_align(loading_label, LV_TEXT_ALIGN_CENTER, 0);
+    } else if (err == ESP_OK) {
+        if (firmware_count > 0) {
             ESP_LOGI(TAG, "Found %lu firmware(s) in NVS", (unsigned long)firmware_count);
 
             for (uint32_t i = 0; i < firmware_count; i++) {
-                char key[32];
-                char filename[128];
-                char partition_name[32];
-                uint32_t offset, size, crc32;
-
-                // Read firmware data from NVS
-                snprintf(key, sizeof(key), "fw_%lu_filename", (unsigned long)i);
-                size_t filename_len = sizeof(filename);
-                if (nvs_get_str(nvs_handle, key, filename, &filename_len) != ESP_OK) {
-                    continue;
-                }
-
-                snprintf(key, sizeof(key), "fw_%lu_partition", (unsigned long)i);
-                size_t partition_len = sizeof(partition_name);
-                if (nvs_get_str(nvs_handle, key, partition_name, &partition_len) != ESP_OK) {
-                    continue;
-                }
-
-                snprintf(key, sizeof(key), "fw_%lu_offset", (unsigned long)i);
-                if (nvs_get_u32(nvs_handle, key, &offset) != ESP_OK) {
-                    continue;
-                }
-
-                snprintf(key, sizeof(key), "fw_%lu_size", (unsigned long)i);
-                if (nvs_get_u32(nvs_handle, key, &size) != ESP_OK) {
-                    continue;
-                }
-
-                snprintf(key, sizeof(key), "fw_%lu_crc32", (unsigned long)i);
-                if (nvs_get_u32(nvs_handle, key, &crc32) != ESP_OK) {
-                    continue;
-                }
+                const firmware_metadata_t *entry = &entries[i].metadata;
 
                 // Create boot button for this firmware
                 lv_obj_t *btn = lv_btn_create(cont);
@@ -403,16 +564,31 @@ static void create_boot_menu_screen(void)
                 lv_obj_set_size(btn, 800, 80);
 
                 // Store partition name for boot callback
-                char *stored_partition = malloc(strlen(partition_name) + 1);
-                strcpy(stored_partition, partition_name);
+                char *stored_partition = malloc(strlen(entry->partition) + 1);
+                strcpy(stored_partition, entry->partition);
                 lv_obj_set_user_data(btn, stored_partition);
 
                 // Create button label with firmware info
                 char btn_text[256];
                 char size_str[32];
-                firmware_format_size(size, size_str, sizeof(size_str));
-                snprintf(btn_text, sizeof(btn_text), "%s\n%s (%s, CRC: 0x%08lX)",
-                         filename, partition_name, size_str, (unsigned long)crc32);
+                firmware_format_size(entry->size, size_str, sizeof(size_str));
+                if (entries[i].has_app_desc) {
+                    snprintf(btn_text, sizeof(btn_text), "%s %s\n%s (%s, built %s)",
+                             entries[i].project_name, entries[i].version,
+                             entry->partition, size_str, entries[i].build_date);
+                } else {
+                    snprintf(btn_text, sizeof(btn_text), "%s\n%s (%s, CRC: 0x%08lX)",
+                             entry->filename, entry->partition, size_str, (unsigned long)entry->crc32);
+                }
+
+                // Flag slots the background scrub found damaged before they are launched
+                if (entry_scrub_state(entry) == SLOT_SCRUB_FAILED) {
+                    size_t len = strlen(btn_text);
+                    snprintf(btn_text + len, sizeof(btn_text) - len,
+                             "\n" LV_SYMBOL_WARNING " Integrity check failed - reflash before use");
+                    lv_obj_set_style_bg_color(btn, lv_color_hex(0xC62828), 0);
+                    ESP_LOGW(TAG, "%s failed its integrity check", entry->partition);
+                }
 
                 lv_obj_t *label = lv_label_create(btn);
                 lv_label_set_text(label, btn_text);
@@ -420,8 +596,9 @@ static void create_boot_menu_screen(void)
                 lv_obj_set_style_text_font(label, &lv_font_montserrat_12, 0);
 
                 lv_obj_add_event_cb(btn, boot_firmware_cb, LV_EVENT_CLICKED, NULL);
+                lv_obj_add_event_cb(btn, free_user_data_cb, LV_EVENT_DELETE, NULL);
 
-                ESP_LOGI(TAG, "Created boot button for %s -> %s", filename, partition_name);
+                ESP_LOGI(TAG, "Created boot button for %s -> %s", entry->filename, entry->partition);
             }
         } else {
             ESP_LOGI(TAG, "No firmware found in NVS");
@@ -429,10 +606,8 @@ static void create_boot_menu_screen(void)
             lv_label_set_text(no_fw_label, "No firmware applications found.\nFlash firmware first using the \"Select & Flash Firmware\" option.");
             lv_obj_set_style_text_align(no_fw_label, LV_TEXT_ALIGN_CENTER, 0);
         }
-
-        nvs_close(nvs_handle);
     } else {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to read firmware catalog: %s", esp_err_to_name(err));
         lv_obj_t *error_label = lv_label_create(cont);
         lv_label_set_text(error_label, "Failed to read firmware configuration.\nPlease restart the device.");
         lv_obj_set_style_text_align(error_label, LV_TEXT_ALIGN_CENTER, 0);
@@ -453,6 +628,113 @@ static void create_boot_menu_screen(void)
     ESP_LOGI(TAG, "Boot menu screen created");
 }
 
+static void destroy_settings_screen(void)
+{
+    settings_content = NULL;
+}
+
+static void destroy_boot_menu_screen(void)
+{
+    boot_menu_generation = 0;
+}
+
+static size_t lvgl_heap_used(void)
+{
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    return mon.total_size - mon.free_size;
+}
+
+// Run a screen builder and record what it took from the LVGL heap
+static void account_screen_build(screen_id_t id, void (*build)(void))
+{
+    size_t before = lvgl_heap_used();
+    build();
+    size_t after = lvgl_heap_used();
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+
+    screen_stats[id].builds++;
+    screen_stats[id].cost_bytes = (int32_t)(after - before);
+    ESP_LOGI(TAG, "Screen %s built: %ld bytes (LVGL heap %u%% used, largest free %u bytes)",
+             screen_defs[id].name, (long)screen_stats[id].cost_bytes,
+             (unsigned)mon.used_pct, (unsigned)mon.free_biggest_size);
+}
+
+static lv_obj_t *ensure_screen(screen_id_t id)
+{
+    if (!screens[id] && screen_defs[id].create) {
+        account_screen_build(id, screen_defs[id].create);
+    }
+    return screens[id];
+}
+
+static void teardown_screen(screen_id_t id)
+{
+    if (!screens[id]) {
+        return;
+    }
+
+    // Deferred: we are usually inside an event of a widget on this screen
+    lv_obj_delete_async(screens[id]);
+    screens[id] = NULL;
+    if (screen_defs[id].destroy) {
+        screen_defs[id].destroy();
+    }
+
+    screen_stats[id].teardowns++;
+    ESP_LOGI(TAG, "Screen %s released (%ld bytes)", screen_defs[id].name, (long)screen_stats[id].cost_bytes);
+}
+
+// Keep at most SCREEN_CACHE_SIZE non-resident screens besides the active one
+static void trim_screen_cache(void)
+{
+    while (1) {
+        int cached = 0;
+        int oldest = -1;
+        for (int i = 0; i < SCREEN_COUNT; i++) {
+            if (!screens[i] || screen_defs[i].resident || i == current_screen) {
+                continue;
+            }
+            cached++;
+            if (oldest < 0 || screen_stats[i].last_used < screen_stats[oldest].last_used) {
+                oldest = i;
+            }
+        }
+
+        if (cached <= SCREEN_CACHE_SIZE) {
+            return;
+        }
+        teardown_screen((screen_id_t)oldest);
+    }
+}
+
+static void mark_screen_active(screen_id_t id)
+{
+    current_screen = id;
+    screen_stats[id].last_used = ++screen_use_counter;
+    trim_screen_cache();
+}
+
+static void format_screen_stats(char *buf, size_t size)
+{
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+
+    size_t used = snprintf(buf, size, "Screens (LVGL heap %u%% of %u KiB used, largest free %u bytes)\n",
+                           (unsigned)mon.used_pct, (unsigned)(mon.total_size / 1024),
+                           (unsigned)mon.free_biggest_size);
+
+    for (int i = 0; i < SCREEN_COUNT && used < size; i++) {
+        bool built = (i == SCREEN_FIRMWARE_SELECTOR) ? firmware_selector_initialized : screens[i] != NULL;
+        used += snprintf(buf + used, size - used, "  %-10s %7ld bytes, built %lu, released %lu, %s\n",
+                         screen_defs[i].name, (long)screen_stats[i].cost_bytes,
+                         (unsigned long)screen_stats[i].builds, (unsigned long)screen_stats[i].teardowns,
+                         built ? (screen_defs[i].resident ? "resident" : "cached") : "not built");
+    }
+}
+
 void switch_screen(screen_id_t screen_id)
 {
     if (screen_id >= SCREEN_COUNT) {
@@ -460,13 +742,17 @@ void switch_screen(screen_id_t screen_id)
         return;
     }
 
-    if (!screens[screen_id]) {
+    if (!ensure_screen(screen_id)) {
         ESP_LOGE(TAG, "Screen %d not created", screen_id);
         return;
     }
 
+    if (screen_id == SCREEN_SETTINGS && settings_content) {
+        update_diagnostics();
+    }
+
     lv_screen_load(screens[screen_id]);
-    current_screen = screen_id;
+    mark_screen_active(screen_id);
     ESP_LOGI(TAG, "Switched to screen %d", screen_id);
 }
 
@@ -514,16 +800,10 @@ void refresh_main_screen(void)
 
     // Ensure the main screen is set as current screen (in case LVGL lost track)
     lv_scr_load(main_screen);
-    current_screen = SCREEN_MAIN;
+    mark_screen_active(SCREEN_MAIN);
 
+    // Called from LVGL callbacks: render_loop redraws the invalidated screen
     ESP_LOGI(TAG, "Main screen set as current screen");
-
-    // Force LVGL to refresh the display and handle any pending events
-    lv_timer_handler();
-    lv_tick_inc(lv_tick_get());
-
-    // Small delay to ensure LVGL has time to process the screen changes
-    vTaskDelay(pdMS_TO_TICKS(100));
 }
 
 // Progress bar for OTA operations
@@ -545,11 +825,15 @@ void create_progress_bar(void)
     ESP_LOGI(TAG, "Progress bar created");
 }
 
-void update_progress_bar(uint8_t percent)
+// Runs in the LVGL task; I/O tasks reach the widgets below only through ui_events
+static void apply_progress(uint8_t percent)
 {
     if (!progress_bar || !progress_label) {
         create_progress_bar();
     }
+    if (!progress_bar) {
+        return;
+    }
 
     lv_bar_set_value(progress_bar, percent, LV_ANIM_OFF);
 
@@ -557,22 +841,19 @@ void update_progress_bar(uint8_t percent)
     snprintf(progress_text, sizeof(progress_text), "%d%%", percent);
     lv_label_set_text(progress_label, progress_text);
 
-    // Update LVGL display
-    lock_display();
-    lv_timer_handler();
-    unlock_display();
-
     ESP_LOGD(TAG, "Progress updated: %d%%", percent);
 }
 
-void show_progress(bool show)
+static void apply_progress_visible(bool show)
 {
     if (show) {
         if (!progress_bar) {
             create_progress_bar();
         }
-        lv_obj_clear_flag(progress_bar, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_clear_flag(progress_label, LV_OBJ_FLAG_HIDDEN);
+        if (progress_bar) {
+            lv_obj_clear_flag(progress_bar, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_clear_flag(progress_label, LV_OBJ_FLAG_HIDDEN);
+        }
     } else {
         if (progress_bar) {
             lv_obj_add_flag(progress_bar, LV_OBJ_FLAG_HIDDEN);
@@ -581,24 +862,73 @@ void show_progress(bool show)
             lv_obj_add_flag(progress_label, LV_OBJ_FLAG_HIDDEN);
         }
     }
-
-    // Force LVGL update
-    lock_display();
-    lv_timer_handler();
-    unlock_display();
 }
 
-void update_status(const char* status)
+static void apply_status(const char* status)
 {
     if (!status_label) return;
 
     lv_label_set_text(status_label, status);
+}
 
-    // Force LVGL update
-    lock_display();
-    lv_timer_handler();
-    unlock_display();
+static void apply_ota_state(bool in_progress)
+{
+    apply_progress_visible(in_progress);
+    apply_status(in_progress ? "SD Card OTA in progress..." : "OTA completed. Select another demo or restart.");
+
+    // Buttons are disabled during OTA
+    for (int i = 0; i < 4; i++) {
+        if (!demo_btns[i]) {
+            continue;
+        }
+        if (in_progress) {
+            lv_obj_add_state(demo_btns[i], LV_STATE_DISABLED);
+        } else {
+            lv_obj_clear_state(demo_btns[i], LV_STATE_DISABLED);
+        }
+    }
+}
+
+static void ui_event_cb(const ui_event_t *event)
+{
+    switch (event->type) {
+    case UI_EVENT_STATUS:
+        apply_status(event->text);
+        break;
+    case UI_EVENT_PROGRESS:
+        apply_progress(event->progress.percent);
+        break;
+    case UI_EVENT_PROGRESS_VISIBLE:
+        apply_progress_visible(event->visibility.visible);
+        break;
+    case UI_EVENT_OTA_STATE:
+        apply_ota_state(event->visibility.visible);
+        break;
+    default:
+        break;
+    }
+}
+
+void update_progress_bar(uint8_t percent)
+{
+    ui_event_t event = { .type = UI_EVENT_PROGRESS, .progress.percent = percent };
+    ui_events_post(&event);
+}
+
+void show_progress(bool show)
+{
+    ui_event_t event = { .type = UI_EVENT_PROGRESS_VISIBLE, .visibility.visible = show };
+    esp_err_t ret = ui_events_post(&event);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Progress bar %s not applied: %s", show ? "show" : "hide", esp_err_to_name(ret));
+    }
+}
+
+void update_status(const char* status)
+{
+    if (!status) return;
 
+    ui_events_post_text(UI_EVENT_STATUS, status);
     ESP_LOGI(TAG, "Status updated: %s", status);
 }
 
@@ -606,30 +936,11 @@ void set_ota_in_progress(bool in_progress)
 {
     ota_in_progress = in_progress;
 
-    if (in_progress) {
-        show_progress(true);
-        update_status("SD Card OTA in progress...");
-        // Disable buttons during OTA
-        for (int i = 0; i < 4; i++) {
-            if (demo_btns[i]) {
-                lv_obj_add_state(demo_btns[i], LV_STATE_DISABLED);
-            }
-        }
-    } else {
-        show_progress(false);
-        update_status("OTA completed. Select another demo or restart.");
-        // Re-enable buttons after OTA
-        for (int i = 0; i < 4; i++) {
-            if (demo_btns[i]) {
-                lv_obj_clear_state(demo_btns[i], LV_STATE_DISABLED);
-            }
-        }
+    ui_event_t event = { .type = UI_EVENT_OTA_STATE, .visibility.visible = in_progress };
+    esp_err_t ret = ui_events_post(&event);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA state %d not shown: %s", in_progress, esp_err_to_name(ret));
     }
-
-    // Force LVGL update
-    lock_display();
-    lv_timer_handler();
-    unlock_display();
 }
 
 bool is_ota_in_progress(void)
@@ -676,13 +987,48 @@ esp_err_t lvgl_bootloader_init(void)
     // Initialize display mutex
     init_display_mutex();
 
+    // Status and progress from I/O tasks arrive through the event ring
+    esp_err_t ret = ui_events_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ui_events_set_handler(UI_EVENT_STATUS, ui_event_cb);
+    ui_events_set_handler(UI_EVENT_PROGRESS, ui_event_cb);
+    ui_events_set_handler(UI_EVENT_PROGRESS_VISIBLE, ui_event_cb);
+    ui_events_set_handler(UI_EVENT_OTA_STATE, ui_event_cb);
+
     // Lock display for thread-safe LVGL operations
     lock_display();
 
     // Initialize styles
     init_styles();
 
-    // Initialize boot menu selector (scans firmware storage for installed firmwares)
+    // Only the main screen is built up front, as a skeleton that is filled in
+    // by lvgl_bootloader_load_installed(); the others are built on first
+    // navigation (see screen_defs). A built boot menu is rebuilt from the
+    // firmware catalog whenever a new catalog generation is published.
+    ensure_screen(SCREEN_MAIN);
+
+    installed_apps_timer = lv_timer_create(installed_apps_poll_cb, 20, NULL);
+    boot_menu_timer = lv_timer_create(boot_menu_poll_cb, 100, NULL);
+
+    // Load main screen
+    lv_screen_load(screens[SCREEN_MAIN]);
+    mark_screen_active(SCREEN_MAIN);
+
+    lv_display_t *display = lv_display_get_default();
+    if (display) {
+        lv_display_add_event_cb(display, first_flush_cb, LV_EVENT_REFR_READY, NULL);
+    }
+
+    unlock_display();
+
+    ESP_LOGI(TAG, "LVGL bootloader initialized successfully");
+    return ESP_OK;
+}
+
+esp_err_t lvgl_bootloader_load_installed(void)
+{
     ESP_LOGI(TAG, "Initializing boot menu selector (firmware storage)...");
     esp_err_t ret = firmware_selector_init(&boot_menu_selector);
     if (ret == ESP_OK) {
@@ -698,19 +1044,9 @@ esp_err_t lvgl_bootloader_init(void)
         ESP_LOGW(TAG, "Failed to initialize boot menu selector: %s", esp_err_to_name(ret));
     }
 
-    // Create screens
-    create_main_screen();
-    create_demo_screen();
-    create_settings_screen();
-    create_boot_menu_screen();
-
-    // Load main screen
-    lv_screen_load(screens[SCREEN_MAIN]);
-
-    unlock_display();
-
-    ESP_LOGI(TAG, "LVGL bootloader initialized successfully");
-    return ESP_OK;
+    // Publish the filled selector to the LVGL task (installed_apps_poll_cb)
+    __atomic_store_n(&installed_apps_ready, true, __ATOMIC_RELEASE);
+    return ret;
 }
 
 // Firmware selector integration functions
@@ -740,7 +1076,10 @@ esp_err_t init_firmware_selector_screen(void)
             }
         }
 
+        size_t heap_before = lvgl_heap_used();
         ret = firmware_selector_create_ui(&firmware_selector);
+        screen_stats[SCREEN_FIRMWARE_SELECTOR].builds++;
+        screen_stats[SCREEN_FIRMWARE_SELECTOR].cost_bytes = (int32_t)(lvgl_heap_used() - heap_before);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to create firmware selector UI: %s", esp_err_to_name(ret));
             return ret;
@@ -760,7 +1099,11 @@ esp_err_t show_firmware_selector_screen(void)
         return ret;
     }
 
-    return firmware_selector_show(&firmware_selector);
+    ret = firmware_selector_show(&firmware_selector);
+    if (ret == ESP_OK) {
+        mark_screen_active(SCREEN_FIRMWARE_SELECTOR);
+    }
+    return ret;
 }
 
 esp_err_t hide_firmware_selector_screen(void)
@@ -774,17 +1117,17 @@ esp_err_t hide_firmware_selector_screen(void)
 
 esp_err_t show_boot_menu_screen(void)
 {
-    if (!screens[SCREEN_BOOT_MENU]) {
+    // Built from the in-RAM catalog on first use; a cached copy catches up
+    // here if a new catalog landed since boot_menu_poll_cb last ran
+    if (screens[SCREEN_BOOT_MENU]) {
+        sync_boot_menu();
+    } else if (!ensure_screen(SCREEN_BOOT_MENU)) {
         ESP_LOGE(TAG, "Boot menu screen not created");
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Refresh the boot menu each time it's shown (in case firmware list changed)
-    lv_obj_clean(screens[SCREEN_BOOT_MENU]);
-    create_boot_menu_screen();
-
     lv_screen_load(screens[SCREEN_BOOT_MENU]);
-    current_screen = SCREEN_BOOT_MENU;
+    mark_screen_active(SCREEN_BOOT_MENU);
     ESP_LOGI(TAG, "Boot menu screen shown");
     return ESP_OK;
 }
@@ -797,7 +1140,7 @@ esp_err_t hide_boot_menu_screen(void)
 
     // Return to main screen
     lv_screen_load(screens[SCREEN_MAIN]);
-    current_screen = SCREEN_MAIN;
+    mark_screen_active(SCREEN_MAIN);
     ESP_LOGI(TAG, "Boot menu screen hidden");
     return ESP_OK;
 }
@@ -811,21 +1154,17 @@ esp_err_t boot_firmware_from_partition(const char* partition_name)
 
     ESP_LOGI(TAG, "Attempting to boot firmware from partition: %s", partition_name);
 
-    // Find the OTA partition to get subtype information
-    const esp_partition_t* ota_partition = esp_partition_find_first(
-        ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, partition_name);
-
-    if (!ota_partition) {
+    // Find the OTA partition to get subtype information (label lookup in the cached table)
+    partition_cache_entry_t ota_entry;
+    if (partition_cache_find_by_label(partition_name, &ota_entry) != ESP_OK ||
+        ota_entry.type != ESP_PARTITION_TYPE_APP) {
         ESP_LOGE(TAG, "OTA partition '%s' not found", partition_name);
         return ESP_ERR_NOT_FOUND;
     }
+    const partition_cache_entry_t* ota_partition = &ota_entry;
 
     ESP_LOGI(TAG, "Found OTA partition: %s (subtype: %d, offset: 0x%08x, size: 0x%08x)",
-             ota_partition->label, ota_partition->subtype, ota_partition->address, ota_partition->size);
-
-    // RTC register constants for bootloader communication (must match bootloader_custom.c)
-    #define BOOT_REQUEST_RTC_REG     LP_SYSTEM_REG_LP_STORE0_REG
-    #define BOOT_REQUEST_MAGIC_RTC   0x00544551  // 'BOOT' magic in ASCII
+             ota_partition->label, ota_partition->subtype, ota_partition->offset, ota_partition->size);
 
     // Determine partition type from subtype
     uint32_t partition_type = 0;
@@ -844,18 +1183,12 @@ esp_err_t boot_firmware_from_partition(const char* partition_name)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Set boot partition using RTC register for one-time boot (like other demos)
-    ESP_LOGI(TAG, "Setting RTC boot request for partition type %d (%s)...",
+    // One-time boot request; the app makes it sticky with boot_request_confirm() once healthy
+    ESP_LOGI(TAG, "Setting boot request for partition type %d (%s)...",
              partition_type, partition_name);
+    boot_request_set((uint8_t)partition_type, false);
 
-    // Write boot request to RTC register for bootloader to read
-    uint32_t rtc_value = BOOT_REQUEST_MAGIC_RTC | (partition_type << 24);
-    REG_WRITE(BOOT_REQUEST_RTC_REG, rtc_value);
-
-    ESP_LOGI(TAG, "RTC register updated: 0x%08x, system will boot from %s after restart",
-             rtc_value, partition_name);
-
-    ESP_LOGI(TAG, "Boot partition set successfully using RTC mechanism. Restarting to boot from %s...", partition_name);
+    ESP_LOGI(TAG, "Boot request set. Restarting to boot from %s...", partition_name);
 
     // Give some time for the log to be printed and then restart
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -875,6 +1208,16 @@ void lvgl_bootloader_deinit(void)
         firmware_selector_initialized = false;
     }
 
+    if (installed_apps_timer) {
+        lv_timer_delete(installed_apps_timer);
+        installed_apps_timer = NULL;
+    }
+
+    if (boot_menu_timer) {
+        lv_timer_delete(boot_menu_timer);
+        boot_menu_timer = NULL;
+    }
+
     // Clean up styles
     lv_style_reset(&style_title);
     lv_style_reset(&style_btn);
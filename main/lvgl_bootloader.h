@@ -27,12 +27,25 @@ typedef enum {
 /**
  * @brief Initialize LVGL bootloader UI
  *
- * Creates all UI elements, styles, and sets up the main screen.
+ * Creates all UI elements, styles, and sets up the main screen. The
+ * application list shows a placeholder until lvgl_bootloader_load_installed()
+ * has run.
  *
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t lvgl_bootloader_init(void);
 
+/**
+ * @brief Scan firmware storage and publish the installed apps to the main screen
+ *
+ * Meant for a startup task so the skeleton UI can be shown first. The list
+ * itself is rebuilt from the LVGL timer handler once the scan is done.
+ *
+ * @return ESP_OK on success, error from the storage scan otherwise (the main
+ *         screen then shows an empty list)
+ */
+esp_err_t lvgl_bootloader_load_installed(void);
+
 /**
  * @brief Deinitialize LVGL bootloader UI
  *
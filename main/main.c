@@ -18,10 +18,19 @@
 #include "board_init.h"
 #include "lvgl_bootloader.h"
 #include "sd_ota.h"
-#include "vdma_protection.h"
+#include "io_arbiter.h"
+#include "sd_reader.h"
+#include "flash_io.h"
+#include "partition_cache.h"
+#include "ota_preerase.h"
+#include "block_crc.h"
+#include "slot_scrub.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "firmware_metadata.h"
+#include "firmware_catalog.h"
+#include "boot_timing.h"
+#include "render_loop.h"
 
 static const char *TAG = "main";
 
@@ -29,93 +38,44 @@ static const char *TAG = "main";
 static TaskHandle_t lvgl_task_handle = NULL;
 static TaskHandle_t ota_task_handle = NULL;
 
-// Display update semaphore for dual-core operation
-static SemaphoreHandle_t display_mutex = NULL;
-
-// VDMA display protection state
-static volatile bool display_protect_mode = false;
-static uint32_t display_refresh_timestamp = 0;
-
-// VDMA display protection functions (extern accessible)
-void vdma_enable_display_protection(void)
-{
-    display_protect_mode = true;
-    display_refresh_timestamp = xTaskGetTickCount();
-    ESP_LOGD(TAG, "VDMA display protection enabled - blocking intensive operations");
-}
-
-void vdma_disable_display_protection(void)
-{
-    display_protect_mode = false;
-    ESP_LOGD(TAG, "VDMA display protection disabled - allowing intensive operations");
-}
-
-bool vdma_is_display_protected(void)
-{
-    return display_protect_mode;
-}
-
-void vdma_ensure_display_refresh(uint32_t min_interval_ms)
-{
-    TickType_t current_tick = xTaskGetTickCount();
-    TickType_t elapsed = current_tick - display_refresh_timestamp;
-
-    if (elapsed < pdMS_TO_TICKS(min_interval_ms)) {
-        // Display hasn't refreshed recently, wait for it
-        TickType_t wait_time = pdMS_TO_TICKS(min_interval_ms) - elapsed;
-        ESP_LOGD(TAG, "VDMA waiting %d ms for display refresh", wait_time);
-        vTaskDelay(wait_time);
-    }
-
-    display_refresh_timestamp = xTaskGetTickCount();
-}
-
-// LVGL timer handler task
+// LVGL render task: sleeps until the next LVGL deadline, an invalidation or input
 static void lvgl_task(void *arg)
 {
     ESP_LOGI(TAG, "LVGL task started on core %d with priority %d", xPortGetCoreID(), uxTaskPriorityGet(NULL));
 
-    while (1) {
-        // VDMA PROTECTION: Enable display protection during LVGL rendering
-        vdma_enable_display_protection();
-
-        // CRITICAL: Give LVGL highest priority for display stability
-        lv_timer_handler();
-
-        // VDMA PROTECTION: Allow display refresh to complete before yielding
-        vTaskDelay(pdMS_TO_TICKS(5));  // Shorter delay for more responsive VDMA coordination
-
-        // VDMA PROTECTION: Disable protection after LVGL completes
-        vdma_disable_display_protection();
+    // Bulk I/O is budgeted only while a frame is actually rendered and flushed
+    const render_loop_hooks_t hooks = {
+        .render_begin = io_arbiter_frame_begin,
+        .render_end = io_arbiter_frame_end,
+    };
+    if (render_loop_init(&hooks) != ESP_OK) {
+        ESP_LOGW(TAG, "Render loop statistics unavailable");
+    }
 
-        // Additional small delay to ensure other tasks can run
-        vTaskDelay(pdMS_TO_TICKS(3));  // Total 8ms delay for ~125fps with VDMA safety
+    while (1) {
+        uint32_t sleep_ms = render_loop_run_once();
+        render_loop_wait(sleep_ms);
     }
 }
 
-// OTA monitoring task
+// OTA monitoring task: reports the I/O arbiter counters once an update has finished
 static void ota_monitor_task(void *arg)
 {
     ESP_LOGI(TAG, "OTA monitor task started on core %d", xPortGetCoreID());
 
+    bool was_in_progress = false;
     while (1) {
-        // Update OTA progress if operation is in progress
-        if (is_ota_in_progress()) {
-            // VDMA AWARE: Check if display is protected before doing OTA monitoring
-            if (vdma_is_display_protected()) {
-                // Display is currently protected, wait longer
-                vTaskDelay(pdMS_TO_TICKS(50));
-            } else {
-                // Display not protected, safe to do OTA monitoring
-                vTaskDelay(pdMS_TO_TICKS(20));
-            }
-
-            // VDMA COORDINATION: Ensure display has time to refresh between checks
-            vdma_ensure_display_refresh(16);  // Ensure at least 16ms between operations (~60fps)
-        } else {
-            // No OTA in progress, longer delay to save CPU
-            vTaskDelay(pdMS_TO_TICKS(100));
+        vTaskDelay(pdMS_TO_TICKS(100));
+
+        bool in_progress = is_ota_in_progress();
+        if (was_in_progress && !in_progress) {
+            io_arbiter_log_stats();
+            sd_reader_log_stats();
+            flash_io_log_stats();
+            ota_preerase_log_stats();
+            slot_scrub_log_stats();
         }
+        was_in_progress = in_progress;
     }
 }
 
@@ -131,11 +91,19 @@ static void ota_status_callback(const char *status)
     update_status(status);
 }
 
-static esp_err_t initialize_system(void)
-{
-    ESP_LOGI(TAG, "Initializing ESP32-P4 LVGL bootloader...");
+// Startup work that does not need the display; each job runs in its own task
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} startup_job_t;
 
-    // Initialize NVS first - needed for storing firmware configuration
+static SemaphoreHandle_t startup_done = NULL;
+static SemaphoreHandle_t startup_nvs_done = NULL;  // Given once NVS and firmware metadata are up
+static volatile bool sd_card_available = false;
+
+static void startup_nvs_job(void)
+{
+    // Needed for storing firmware configuration
     ESP_LOGI(TAG, "Initializing NVS...");
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -164,15 +132,74 @@ static esp_err_t initialize_system(void)
             firmware_metadata_print_all();
         }
     }
+    boot_timing_mark(BOOT_STAGE_APP_NVS);
+
+    // Preload the boot menu catalog in the background; kept current from here on
+    ret = firmware_catalog_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start firmware catalog: %s", esp_err_to_name(ret));
+    }
+    xSemaphoreGive(startup_nvs_done);
+}
+
+static void startup_apps_job(void)
+{
+    // The installed-firmware list is read from firmware metadata
+    xSemaphoreTake(startup_nvs_done, portMAX_DELAY);
+
+    // Fills the skeleton main screen with the installed firmwares
+    lvgl_bootloader_load_installed();
+}
+
+static void startup_sd_job(void)
+{
+    esp_err_t ret = sd_ota_init();
+    boot_timing_mark(BOOT_STAGE_APP_SD_OTA);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SD card OTA initialization failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    // Set OTA callbacks
+    sd_ota_set_progress_callback(ota_progress_callback);
+    sd_ota_set_status_callback(ota_status_callback);
+    sd_card_available = true;
+}
+
+static const startup_job_t startup_jobs[] = {
+    { "init_nvs",  startup_nvs_job },
+    { "init_apps", startup_apps_job },
+    { "init_sd",   startup_sd_job },
+};
+
+#define STARTUP_JOB_COUNT (sizeof(startup_jobs) / sizeof(startup_jobs[0]))
+
+static void startup_job_task(void *arg)
+{
+    const startup_job_t *job = (const startup_job_t *)arg;
+
+    job->run();
+    ESP_LOGI(TAG, "Startup job %s done", job->name);
+
+    xSemaphoreGive(startup_done);
+    vTaskDelete(NULL);
+}
+
+// Bring the display and a skeleton UI up first so the first frame does not
+// wait for NVS, firmware storage or the SD card
+static esp_err_t initialize_display(void)
+{
+    ESP_LOGI(TAG, "Initializing ESP32-P4 LVGL bootloader...");
 
     // Initialize BSP (includes LVGL initialization)
-    ret = board_init_display();
+    esp_err_t ret = board_init_display();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize display: %s", esp_err_to_name(ret));
         return ret;
     }
 
     ESP_LOGI(TAG, "Display initialized successfully");
+    boot_timing_mark(BOOT_STAGE_APP_DISPLAY);
 
     // Initialize LVGL bootloader UI
     ret = lvgl_bootloader_init();
@@ -180,32 +207,65 @@ static esp_err_t initialize_system(void)
         ESP_LOGE(TAG, "Failed to initialize LVGL bootloader: %s", esp_err_to_name(ret));
         return ret;
     }
+    boot_timing_mark(BOOT_STAGE_APP_LVGL);
 
-    // Initialize SD card OTA
-    ret = sd_ota_init();
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "SD card OTA initialization failed: %s", esp_err_to_name(ret));
-        update_status("Warning: SD card not available");
-    } else {
-        // Set OTA callbacks
-        sd_ota_set_progress_callback(ota_progress_callback);
-        sd_ota_set_status_callback(ota_status_callback);
-        update_status("Ready - SD card available");
+    return ESP_OK;
+}
+
+// Run the startup jobs in parallel and wait for all of them
+static esp_err_t initialize_system(void)
+{
+    startup_done = xSemaphoreCreateCounting(STARTUP_JOB_COUNT, 0);
+    startup_nvs_done = xSemaphoreCreateBinary();
+    if (!startup_done || !startup_nvs_done) {
+        ESP_LOGE(TAG, "Failed to create startup semaphores");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Shared by the storage scan and SD OTA; started before either job runs
+    esp_err_t reader_ret = sd_reader_init();
+    if (reader_ret != ESP_OK) {
+        ESP_LOGW(TAG, "SD reader unavailable: %s", esp_err_to_name(reader_ret));
+    }
+
+    size_t started = 0;
+    for (size_t i = 0; i < STARTUP_JOB_COUNT; i++) {
+        BaseType_t ret = xTaskCreatePinnedToCore(
+            startup_job_task,
+            startup_jobs[i].name,
+            6144,           // Stack size (NVS, FAT mount and flash scans)
+            (void *)&startup_jobs[i],
+            5,              // Below LVGL, above idle
+            NULL,
+            0               // Core 0 for I/O operations
+        );
+
+        if (ret != pdPASS) {
+            // Run it inline rather than lose it
+            ESP_LOGW(TAG, "Failed to create startup task %s, running inline", startup_jobs[i].name);
+            startup_jobs[i].run();
+            continue;
+        }
+        started++;
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        xSemaphoreTake(startup_done, portMAX_DELAY);
     }
+    vSemaphoreDelete(startup_done);
+    startup_done = NULL;
+    vSemaphoreDelete(startup_nvs_done);
+    startup_nvs_done = NULL;
+
+    update_status(sd_card_available ? "Ready - SD card available" : "Warning: SD card not available");
 
     ESP_LOGI(TAG, "System initialization complete");
+    boot_timing_mark(BOOT_STAGE_APP_READY);
     return ESP_OK;
 }
 
 static void start_tasks(void)
 {
-    // Create display mutex
-    display_mutex = xSemaphoreCreateMutex();
-    if (!display_mutex) {
-        ESP_LOGE(TAG, "Failed to create display mutex");
-        return;
-    }
-
     // Create LVGL task on Core 1 (HIGHEST priority for display stability)
     BaseType_t ret = xTaskCreatePinnedToCore(
         lvgl_task,
@@ -243,22 +303,80 @@ static void start_tasks(void)
 
 void app_main(void)
 {
+    // Pick up the bootloader's stage stamps before anything else
+    boot_timing_init();
+
     ESP_LOGI(TAG, "ESP32-P4 LVGL Graphical Bootloader starting...");
     ESP_LOGI(TAG, "Running on core %d", xPortGetCoreID());
     ESP_LOGI(TAG, "Free heap: %d bytes", esp_get_free_heap_size());
     ESP_LOGI(TAG, "Free IRAM: %d bytes", heap_caps_get_free_size(MALLOC_CAP_IRAM_8BIT));
     ESP_LOGI(TAG, "Free PSRAM: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
 
-    // Initialize system
-    esp_err_t ret = initialize_system();
+    // Every flash access goes through the flash I/O service, from the first one on
+    esp_err_t ret = flash_io_init();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "System initialization failed: %s", esp_err_to_name(ret));
+        ESP_LOGW(TAG, "Flash I/O service unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Partition lookups of every module are served from the cache
+    ret = partition_cache_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Partition cache unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Display and skeleton UI first, then start rendering
+    ret = initialize_display();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Display initialization failed: %s", esp_err_to_name(ret));
         return;
     }
 
+    // The render loop and every bulk I/O task go through the arbiter
+    ret = io_arbiter_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "I/O arbiter unavailable, bulk I/O runs unthrottled: %s", esp_err_to_name(ret));
+    }
+
+    // Installs started from the UI claim OTA slots from the pre-erase service
+    ret = ota_preerase_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Pre-erase lock unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Installs store block CRC tables, the scrub reads them
+    ret = block_crc_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Block CRC tables unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // The boot menu and diagnostics read slot states before the scrub starts
+    ret = slot_scrub_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Slot scrub unavailable: %s", esp_err_to_name(ret));
+    }
+
     // Start background tasks
     start_tasks();
 
+    // NVS, installed apps and SD card in parallel
+    ret = initialize_system();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "System initialization failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    // Idle-time erase of free OTA space; runs only once bulk flash I/O is quiet
+    ret = ota_preerase_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Background pre-erase unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Idle-time integrity check of the installed slots, under its bandwidth cap
+    ret = slot_scrub_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Background scrub unavailable: %s", esp_err_to_name(ret));
+    }
+
     ESP_LOGI(TAG, "Bootloader initialized successfully");
     ESP_LOGI(TAG, "System ready - awaiting user input");
 
@@ -277,6 +395,12 @@ void app_main(void)
                     esp_get_free_heap_size(),
                     heap_caps_get_free_size(MALLOC_CAP_IRAM_8BIT),
                     heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+            render_loop_log_stats();
+            io_arbiter_log_stats();
+            sd_reader_log_stats();
+            flash_io_log_stats();
+            ota_preerase_log_stats();
+            slot_scrub_log_stats();
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,547 @@
+/**
+ * @file ota_preerase.c
+ * @brief Background pre-erase of free OTA space and the blank extent map
+ */
+
+#include "ota_preerase.h"
+#include "flash_io.h"
+#include "config_log.h"
+#include "image_digest_cache.h"
+#include "partition_cache.h"
+#include "firmware_metadata.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "ota_preerase";
+
+#define BLANK_MAP_MAGIC        0x4D42  // "BM"
+#define BLANK_MAP_VERSION      2
+#define BLANK_MAP_HEADER_SIZE  20
+#define IMAGE_MAGIC            0xE9
+#define IMAGE_HEADER_SIZE      24
+#define IMAGE_MAX_SEGMENTS     16
+#define IDLE_POLL_MS           500
+
+// Stored as a config log record of BLANK_MAP_HEADER_SIZE + bitmap bytes
+typedef struct __attribute__((packed)) {
+    uint16_t magic;         // BLANK_MAP_MAGIC
+    uint8_t version;        // BLANK_MAP_VERSION
+    uint8_t extent_shift;   // OTA_PREERASE_EXTENT_SHIFT
+    uint32_t generation;    // Image digest generation of the slot the bits are valid for
+    uint32_t offset;        // Slot flash offset
+    uint32_t size;          // Slot size
+    uint32_t written;       // Bytes the last install wrote, every file of the job
+    uint8_t bits[OTA_PREERASE_MAP_BYTES];  // Bit i set: extent i is blank
+} blank_map_t;
+
+_Static_assert(sizeof(blank_map_t) == CONFIG_LOG_MAX_PAYLOAD, "Blank map must fit one config log record");
+
+static SemaphoreHandle_t g_mutex = NULL;  // Maps, claims and counters; held for each sector step
+static SemaphoreHandle_t g_wake = NULL;
+static bool g_started = false;
+
+static blank_map_t g_maps[IMAGE_DIGEST_MAX_SLOTS];
+static uint32_t g_claimed = 0;  // Bit per slot
+static ota_preerase_stats_t g_stats;
+
+// Task only
+static uint8_t* g_sector_buf = NULL;
+static firmware_metadata_t g_metadata[MAX_FIRMWARE_ENTRIES];
+
+// Fails until ota_preerase_init() has created the mutex
+static bool lock(void)
+{
+    return g_mutex && xSemaphoreTake(g_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(g_mutex);
+}
+
+static uint32_t map_extents(uint32_t size)
+{
+    uint32_t extents = (size + OTA_PREERASE_EXTENT_SIZE - 1) >> OTA_PREERASE_EXTENT_SHIFT;
+    return extents < OTA_PREERASE_MAP_BYTES * 8 ? extents : OTA_PREERASE_MAP_BYTES * 8;
+}
+
+static bool extent_blank(const blank_map_t* map, uint32_t extent)
+{
+    return extent < map_extents(map->size) && (map->bits[extent / 8] & (1u << (extent % 8)));
+}
+
+static uint32_t slot_generation(uint32_t slot)
+{
+    image_digest_record_t record;
+    return image_digest_cache_get(slot, &record) == ESP_OK ? record.generation : 0;
+}
+
+static bool map_matches(const blank_map_t* map, uint32_t offset, uint32_t size, uint32_t generation)
+{
+    return map->magic == BLANK_MAP_MAGIC && map->version == BLANK_MAP_VERSION &&
+           map->extent_shift == OTA_PREERASE_EXTENT_SHIFT && map->offset == offset &&
+           map->size == size && map->generation == generation;
+}
+
+// Make g_maps[slot] current: the RAM copy, the stored record or an empty map. Caller holds the lock
+static void load_map(uint32_t slot, uint32_t offset, uint32_t size)
+{
+    blank_map_t* map = &g_maps[slot];
+    uint32_t generation = slot_generation(slot);
+    if (map_matches(map, offset, size, generation)) {
+        return;
+    }
+
+    size_t length = sizeof(*map);
+    if (config_log_is_ready() &&
+        config_log_read(CONFIG_LOG_KEY_BLANK_MAP(slot), map, &length) == ESP_OK &&
+        length >= BLANK_MAP_HEADER_SIZE && map_matches(map, offset, size, generation)) {
+        memset((uint8_t*)map + length, 0, sizeof(*map) - length);
+        return;
+    }
+
+    memset(map, 0, sizeof(*map));
+    map->magic = BLANK_MAP_MAGIC;
+    map->version = BLANK_MAP_VERSION;
+    map->extent_shift = OTA_PREERASE_EXTENT_SHIFT;
+    map->generation = generation;
+    map->offset = offset;
+    map->size = size;
+}
+
+// Caller holds the lock
+static void store_map(uint32_t slot)
+{
+    if (!config_log_is_ready()) {
+        return;  // Kept in RAM for this session only
+    }
+    const blank_map_t* map = &g_maps[slot];
+    uint16_t length = BLANK_MAP_HEADER_SIZE + (map_extents(map->size) + 7) / 8;
+    esp_err_t ret = config_log_append(CONFIG_LOG_KEY_BLANK_MAP(slot), map, length);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store blank map of slot %" PRIu32 ": %s", slot, esp_err_to_name(ret));
+    }
+}
+
+// Length of the app image at the start of a slot: header, segments, the
+// checksum byte padded to 16 bytes and the optional SHA-256
+static uint32_t app_image_length(const partition_cache_entry_t* part, const uint8_t* header)
+{
+    uint32_t segments = header[1];
+    if (segments == 0 || segments > IMAGE_MAX_SEGMENTS) {
+        return part->size;
+    }
+
+    uint32_t pos = IMAGE_HEADER_SIZE;
+    for (uint32_t i = 0; i < segments; i++) {
+        uint32_t segment[2];  // load address, data length
+        if (pos + sizeof(segment) > part->size ||
+            flash_io_read(FLASH_IO_PRIORITY_BACKGROUND, segment, part->offset + pos, sizeof(segment)) != ESP_OK ||
+            segment[1] > part->size - pos - sizeof(segment)) {
+            return part->size;
+        }
+        pos += sizeof(segment) + segment[1];
+    }
+
+    pos = (pos + 16) & ~15u;
+    if (header[23]) {  // hash_appended
+        pos += 32;
+    }
+    return pos;
+}
+
+// Bytes at the start of a slot that hold data; anything after it is free
+static uint32_t occupied_length(uint32_t slot, const partition_cache_entry_t* part)
+{
+    uint8_t header[IMAGE_HEADER_SIZE];
+    if (flash_io_read(FLASH_IO_PRIORITY_BACKGROUND, header, part->offset, sizeof(header)) != ESP_OK) {
+        return part->size;
+    }
+
+    uint32_t used = header[0] == IMAGE_MAGIC ? app_image_length(part, header) : 0;
+
+    // Data images written by the flasher have no app header; trust their metadata
+    uint32_t count = 0;
+    if (firmware_metadata_get_all(g_metadata, MAX_FIRMWARE_ENTRIES, &count) == ESP_OK) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (g_metadata[i].offset == part->offset && g_metadata[i].size > used) {
+                used = g_metadata[i].size;
+            }
+        }
+    }
+
+    image_digest_record_t record;
+    if (image_digest_cache_get(slot, &record) == ESP_OK && (record.flags & IMAGE_DIGEST_FLAG_VERIFIED) &&
+        record.offset == part->offset && record.length > used) {
+        used = record.length;
+    }
+
+    // An SD install may have written more files after the image
+    if (lock()) {
+        load_map(slot, part->offset, part->size);
+        if (g_maps[slot].written > used) {
+            used = g_maps[slot].written;
+        }
+        unlock();
+    }
+    return used < part->size ? used : part->size;
+}
+
+// Check and, where needed, erase one extent a sector at a time. Returns
+// ESP_ERR_TIMEOUT as soon as foreground I/O or a claim gets in the way
+static esp_err_t blank_extent(uint32_t slot, const partition_cache_entry_t* part, uint32_t extent)
+{
+    uint32_t start = extent << OTA_PREERASE_EXTENT_SHIFT;
+    uint32_t end = start + OTA_PREERASE_EXTENT_SIZE < part->size ? start + OTA_PREERASE_EXTENT_SIZE : part->size;
+
+    for (uint32_t addr = start; addr < end; addr += FLASH_IO_SECTOR_SIZE) {
+        if (flash_io_idle_ms(FLASH_IO_PRIORITY_BULK) < OTA_PREERASE_IDLE_MS) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (!lock()) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (g_claimed & (1u << slot)) {
+            unlock();
+            return ESP_ERR_TIMEOUT;
+        }
+
+        esp_err_t ret = flash_io_read(FLASH_IO_PRIORITY_BACKGROUND, g_sector_buf, part->offset + addr,
+                                      FLASH_IO_SECTOR_SIZE);
+        g_stats.sectors_checked++;
+        if (ret == ESP_OK && !flash_io_is_blank(g_sector_buf, FLASH_IO_SECTOR_SIZE)) {
+            ret = flash_io_erase(FLASH_IO_PRIORITY_BACKGROUND, part->offset + addr, FLASH_IO_SECTOR_SIZE);
+            g_stats.sectors_erased++;
+        }
+        unlock();
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t process_slot(uint32_t slot, const partition_cache_entry_t* part)
+{
+    uint32_t used = occupied_length(slot, part);
+    uint32_t first_free = (used + OTA_PREERASE_EXTENT_SIZE - 1) >> OTA_PREERASE_EXTENT_SHIFT;
+    uint32_t extents = map_extents(part->size);
+    bool changed = false;
+
+    if (!lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (g_claimed & (1u << slot)) {
+        unlock();
+        return ESP_OK;
+    }
+    load_map(slot, part->offset, part->size);
+    blank_map_t* map = &g_maps[slot];
+    for (uint32_t e = 0; e < first_free && e < extents; e++) {
+        if (extent_blank(map, e)) {
+            map->bits[e / 8] &= ~(1u << (e % 8));
+            changed = true;
+        }
+    }
+    unlock();
+
+    esp_err_t ret = ESP_OK;
+    for (uint32_t e = first_free; e < extents && ret == ESP_OK; e++) {
+        // A claim reloads the map, so it is only read under the lock
+        if (!lock()) {
+            return ESP_ERR_NO_MEM;
+        }
+        bool claimed = (g_claimed & (1u << slot)) != 0;
+        bool blank = extent_blank(map, e);
+        unlock();
+        if (claimed) {
+            break;
+        }
+        if (blank) {
+            continue;
+        }
+        ret = blank_extent(slot, part, e);
+        if (ret == ESP_OK && lock()) {
+            if (!(g_claimed & (1u << slot))) {
+                map->bits[e / 8] |= 1u << (e % 8);
+                g_stats.extents_blank++;
+                changed = true;
+            }
+            unlock();
+        }
+    }
+
+    // Keep the progress even if the pass stops here
+    if (changed && lock()) {
+        if (!(g_claimed & (1u << slot))) {
+            store_map(slot);
+        }
+        unlock();
+    }
+    return ret;
+}
+
+// One walk over all OTA slots; returns true if it stopped for foreground I/O
+static bool run_pass(void)
+{
+    while (flash_io_idle_ms(FLASH_IO_PRIORITY_BULK) < OTA_PREERASE_IDLE_MS) {
+        vTaskDelay(pdMS_TO_TICKS(IDLE_POLL_MS));
+    }
+
+    if (lock()) {
+        g_stats.passes++;
+        unlock();
+    }
+
+    uint32_t count = partition_cache_get_count();
+    for (uint32_t i = 0; i < count; i++) {
+        partition_cache_entry_t part;
+        if (partition_cache_get_entry(i, &part) != ESP_OK || part.type != ESP_PARTITION_TYPE_APP ||
+            part.subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN ||
+            part.subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN + IMAGE_DIGEST_MAX_SLOTS) {
+            continue;
+        }
+        // The factory app never lives in an OTA slot, so no slot is the running one
+
+        uint32_t slot = part.subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN;
+        esp_err_t ret = process_slot(slot, &part);
+        if (ret == ESP_ERR_TIMEOUT) {
+            if (lock()) {
+                g_stats.yields++;
+                unlock();
+            }
+            return true;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Pre-erase of %s stopped: %s", part.label, esp_err_to_name(ret));
+        }
+    }
+    return false;
+}
+
+static void preerase_task(void* arg)
+{
+    (void)arg;
+    while (1) {
+        if (!run_pass()) {
+            // Nothing left; look again later or when an install hands a slot back
+            xSemaphoreTake(g_wake, pdMS_TO_TICKS(OTA_PREERASE_RESCAN_MS));
+        }
+    }
+}
+
+esp_err_t ota_preerase_init(void)
+{
+    if (g_mutex) {
+        return ESP_OK;
+    }
+
+    if (!g_wake) {
+        g_wake = xSemaphoreCreateBinary();
+    }
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    if (!mutex || !g_wake) {
+        ESP_LOGE(TAG, "Failed to create pre-erase semaphores");
+        if (mutex) {
+            vSemaphoreDelete(mutex);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    g_mutex = mutex;
+    return ESP_OK;
+}
+
+esp_err_t ota_preerase_start(void)
+{
+    if (!lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (g_started) {
+        unlock();
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (!g_sector_buf) {
+        g_sector_buf = malloc(FLASH_IO_SECTOR_SIZE);
+    }
+
+    if (!g_sector_buf) {
+        ESP_LOGE(TAG, "Failed to allocate pre-erase resources");
+    } else if (xTaskCreatePinnedToCore(preerase_task, "ota_preerase", 4096, NULL,
+                                       tskIDLE_PRIORITY + 1, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create pre-erase task");
+    } else {
+        g_started = true;
+        ret = ESP_OK;
+        ESP_LOGI(TAG, "Background pre-erase started");
+    }
+    unlock();
+    return ret;
+}
+
+esp_err_t ota_preerase_claim(uint32_t slot, uint32_t offset, uint32_t size)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Returns once the task's sector step, if any, has finished
+    if (!lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+    g_claimed |= 1u << slot;
+    g_stats.claims++;
+    load_map(slot, offset, size);
+    unlock();
+    return ESP_OK;
+}
+
+esp_err_t ota_preerase_erase(uint32_t slot, uint32_t offset, uint32_t length)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!(g_claimed & (1u << slot))) {
+        unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Only this task touches the slot now; the snapshot stays valid
+    blank_map_t* map = &g_maps[slot];
+    bool map_valid = map->magic == BLANK_MAP_MAGIC && map->offset == offset;
+    unlock();
+
+    length = (length + FLASH_IO_SECTOR_SIZE - 1) & ~(FLASH_IO_SECTOR_SIZE - 1);
+
+    esp_err_t ret = ESP_OK;
+    uint64_t erased = 0;
+    uint64_t skipped = 0;
+    uint32_t run_start = 0;
+    uint32_t run_len = 0;
+
+    for (uint32_t start = 0; start < length && ret == ESP_OK; start += OTA_PREERASE_EXTENT_SIZE) {
+        uint32_t len = length - start < OTA_PREERASE_EXTENT_SIZE ? length - start : OTA_PREERASE_EXTENT_SIZE;
+        if (map_valid && extent_blank(map, start >> OTA_PREERASE_EXTENT_SHIFT)) {
+            skipped += len;
+            if (run_len > 0) {
+                ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, offset + run_start, run_len);
+                run_len = 0;
+            }
+            continue;
+        }
+        // Runs of dirty extents go out as one request
+        if (run_len == 0) {
+            run_start = start;
+        }
+        run_len += len;
+        erased += len;
+    }
+    if (ret == ESP_OK && run_len > 0) {
+        ret = flash_io_erase(FLASH_IO_PRIORITY_BULK, offset + run_start, run_len);
+    }
+
+    ESP_LOGI(TAG, "Slot %" PRIu32 ": erased %" PRIu64 " KiB, %" PRIu64 " KiB already blank",
+             slot, erased / 1024, skipped / 1024);
+
+    if (lock()) {
+        g_stats.install_erased += erased;
+        g_stats.install_skipped += skipped;
+        unlock();
+    }
+    return ret;
+}
+
+void ota_preerase_release(uint32_t slot, uint32_t written)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !lock()) {
+        return;
+    }
+    if (g_claimed & (1u << slot)) {
+        blank_map_t* map = &g_maps[slot];
+        if (map->magic == BLANK_MAP_MAGIC) {
+            uint32_t dirty = (written + OTA_PREERASE_EXTENT_SIZE - 1) >> OTA_PREERASE_EXTENT_SHIFT;
+            for (uint32_t e = 0; e < dirty && e < map_extents(map->size); e++) {
+                map->bits[e / 8] &= ~(1u << (e % 8));
+            }
+            // The install bumped the generation; the remaining marks still hold
+            map->generation = slot_generation(slot);
+            map->written = written;
+            store_map(slot);
+        }
+        g_claimed &= ~(1u << slot);
+    }
+    unlock();
+
+    if (g_wake) {
+        xSemaphoreGive(g_wake);
+    }
+}
+
+bool ota_preerase_is_claimed(uint32_t slot)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !lock()) {
+        return false;
+    }
+    bool claimed = (g_claimed & (1u << slot)) != 0;
+    unlock();
+    return claimed;
+}
+
+void ota_preerase_get_stats(ota_preerase_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!lock()) {
+        return;
+    }
+    *stats = g_stats;
+    unlock();
+}
+
+void ota_preerase_format_stats(char* buf, size_t size)
+{
+    ota_preerase_stats_t stats;
+    ota_preerase_get_stats(&stats);
+
+    if (!buf || size == 0) {
+        return;
+    }
+
+    snprintf(buf, size,
+             "Pre-erase (%" PRIu32 " passes, %" PRIu32 " yields)\n"
+             "  sectors checked %7" PRIu32 ", erased %" PRIu32 "\n"
+             "  installs        %7" PRIu32 ", skipped %" PRIu64 " of %" PRIu64 " KiB\n",
+             stats.passes, stats.yields, stats.sectors_checked, stats.sectors_erased,
+             stats.claims, stats.install_skipped / 1024,
+             (stats.install_skipped + stats.install_erased) / 1024);
+}
+
+void ota_preerase_log_stats(void)
+{
+    ota_preerase_stats_t stats;
+    ota_preerase_get_stats(&stats);
+
+    ESP_LOGI(TAG, "PREERASE_STATS passes=%" PRIu32 " sectors_checked=%" PRIu32 " sectors_erased=%" PRIu32
+             " extents_blank=%" PRIu32 " yields=%" PRIu32 " claims=%" PRIu32
+             " install_erased=%" PRIu64 " install_skipped=%" PRIu64,
+             stats.passes, stats.sectors_checked, stats.sectors_erased, stats.extents_blank,
+             stats.yields, stats.claims, stats.install_erased, stats.install_skipped);
+
+    if (lock()) {
+        memset(&g_stats, 0, sizeof(g_stats));
+        unlock();
+    }
+}
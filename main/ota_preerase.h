@@ -0,0 +1,143 @@
+/**
+ * @file ota_preerase.h
+ * @brief Background pre-erase of free OTA space and the blank extent map
+ *
+ * While the device sits at the menu, a low-priority task walks the OTA
+ * slots and erases the 64 KiB extents that hold no image (past the end of
+ * the installed image, or the whole slot if it is empty). Extents found or
+ * made blank are recorded per slot in a bitmap kept in the config log. Each
+ * map is stamped with the slot's image digest generation: every write to a
+ * slot first bumps that generation (image_digest_cache_invalidate()), so a
+ * map from before the write is ignored.
+ *
+ * Installs claim the slot before invalidating its digest, erase through
+ * ota_preerase_erase(), which skips extents the map marks blank, and release
+ * the slot when done. The task only runs after bulk flash I/O has been idle
+ * for OTA_PREERASE_IDLE_MS and issues one sector at a time at background
+ * priority, so interactive and install I/O never wait for more than one
+ * sector erase.
+ */
+
+#ifndef OTA_PREERASE_H
+#define OTA_PREERASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "config_log_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_PREERASE_EXTENT_SHIFT 16                              // 64 KiB extents
+#define OTA_PREERASE_EXTENT_SIZE  (1u << OTA_PREERASE_EXTENT_SHIFT)
+#define OTA_PREERASE_MAP_BYTES    (CONFIG_LOG_MAX_PAYLOAD - 20)   // Bitmap bytes per slot record
+#define OTA_PREERASE_IDLE_MS      3000   // Bulk flash I/O must have been idle this long
+#define OTA_PREERASE_RESCAN_MS    60000  // Pause after a pass that found nothing to erase
+
+// Config log key of the blank map of OTA slot i
+#define CONFIG_LOG_KEY_BLANK_MAP(i) (0x0300 + (i))
+
+/**
+ * @brief Pre-erase counters since start-up or the last reset
+ */
+typedef struct {
+    uint32_t passes;            // Walks over all slots
+    uint32_t sectors_checked;   // Sectors read back to see whether they are blank
+    uint32_t sectors_erased;    // Sectors the task had to erase
+    uint32_t extents_blank;     // Extents marked blank
+    uint32_t yields;            // Times the task stopped for foreground I/O
+    uint32_t claims;            // Installs that claimed a slot
+    uint64_t install_erased;    // Bytes installs still had to erase
+    uint64_t install_skipped;   // Bytes installs skipped thanks to the map
+} ota_preerase_stats_t;
+
+/**
+ * @brief Create the lock guarding maps and claims
+ *
+ * Call once before any task that installs firmware or calls
+ * ota_preerase_start() runs; later calls are no-ops. Claims fail until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the semaphores cannot be created
+ */
+esp_err_t ota_preerase_init(void);
+
+/**
+ * @brief Start the background task
+ *
+ * Safe to call more than once.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before ota_preerase_init(),
+ *         ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t ota_preerase_start(void);
+
+/**
+ * @brief Take a slot away from the background task before writing it
+ *
+ * Waits for the sector step in progress, if any, and snapshots the slot's
+ * map. Call before image_digest_cache_invalidate(), which makes the stored
+ * map stale.
+ *
+ * @param slot OTA slot index (0 = OTA_0)
+ * @param offset Slot flash offset
+ * @param size Slot size
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid slot
+ */
+esp_err_t ota_preerase_claim(uint32_t slot, uint32_t offset, uint32_t size);
+
+/**
+ * @brief Erase the start of a claimed slot, skipping extents known to be blank
+ *
+ * @param slot OTA slot index
+ * @param offset Slot flash offset
+ * @param length Bytes from the start of the slot to erase (rounded up to sectors)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the slot is not claimed,
+ *         or the error of the failing erase
+ */
+esp_err_t ota_preerase_erase(uint32_t slot, uint32_t offset, uint32_t length);
+
+/**
+ * @brief Hand a slot back to the background task after writing it
+ *
+ * Extents past `written` keep their blank mark; the map is restamped with
+ * the slot's current digest generation and stored. `written` also stays in
+ * the map, so the background pass never blanks data past the first image.
+ *
+ * @param slot OTA slot index
+ * @param written Bytes from the start of the slot that may have been programmed
+ */
+void ota_preerase_release(uint32_t slot, uint32_t written);
+
+/**
+ * @brief Check whether an install currently holds a slot
+ * @param slot OTA slot index
+ * @return true between ota_preerase_claim() and ota_preerase_release()
+ */
+bool ota_preerase_is_claimed(uint32_t slot);
+
+/**
+ * @brief Get the counters
+ * @param stats Output counters
+ */
+void ota_preerase_get_stats(ota_preerase_stats_t* stats);
+
+/**
+ * @brief Format the counters for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void ota_preerase_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable PREERASE_STATS line and reset the counters
+ */
+void ota_preerase_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_PREERASE_H
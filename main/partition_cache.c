@@ -0,0 +1,297 @@
+/**
+ * @file partition_cache.c
+ * @brief Cached, generation-stamped view of the on-flash partition table
+ */
+
+#include "partition_cache.h"
+#include "partition_manager.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "flash_io.h"
+#include "esp_flash_partitions.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char* TAG = "partition_cache";
+
+// Label hash index size (power of two, larger than PARTITION_CACHE_MAX_ENTRIES)
+#define LABEL_INDEX_SIZE 64
+#define INDEX_EMPTY      0xFF
+
+typedef struct {
+    partition_cache_entry_t entries[PARTITION_CACHE_MAX_ENTRIES];
+    uint32_t count;
+    uint32_t generation;
+    bool loaded;
+    uint8_t app_index[256];                // APP subtype -> entry index
+    uint8_t data_index[256];               // DATA subtype -> entry index
+    uint8_t label_index[LABEL_INDEX_SIZE]; // Open-addressed label hash -> entry index
+} partition_cache_t;
+
+static partition_cache_t g_cache = {0};
+static SemaphoreHandle_t g_cache_mutex = NULL;
+
+// Fails until partition_cache_init() has created the mutex
+static bool cache_lock(void)
+{
+    return g_cache_mutex && xSemaphoreTake(g_cache_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void cache_unlock(void)
+{
+    xSemaphoreGive(g_cache_mutex);
+}
+
+// FNV-1a over the label, masked to the index size
+static uint32_t label_hash(const char* label)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < 16 && label[i] != '\0'; i++) {
+        hash ^= (uint8_t)label[i];
+        hash *= 16777619u;
+    }
+    return hash & (LABEL_INDEX_SIZE - 1);
+}
+
+static void rebuild_indexes(void)
+{
+    memset(g_cache.app_index, INDEX_EMPTY, sizeof(g_cache.app_index));
+    memset(g_cache.data_index, INDEX_EMPTY, sizeof(g_cache.data_index));
+    memset(g_cache.label_index, INDEX_EMPTY, sizeof(g_cache.label_index));
+
+    for (uint32_t i = 0; i < g_cache.count; i++) {
+        const partition_cache_entry_t* entry = &g_cache.entries[i];
+
+        // Keep the first match per subtype, same as esp_partition_find_first()
+        if (entry->type == ESP_PARTITION_TYPE_APP && g_cache.app_index[entry->subtype] == INDEX_EMPTY) {
+            g_cache.app_index[entry->subtype] = (uint8_t)i;
+        } else if (entry->type == ESP_PARTITION_TYPE_DATA && g_cache.data_index[entry->subtype] == INDEX_EMPTY) {
+            g_cache.data_index[entry->subtype] = (uint8_t)i;
+        }
+
+        uint32_t slot = label_hash(entry->label);
+        while (g_cache.label_index[slot] != INDEX_EMPTY) {
+            slot = (slot + 1) & (LABEL_INDEX_SIZE - 1);
+        }
+        g_cache.label_index[slot] = (uint8_t)i;
+    }
+}
+
+// Parse raw table into the cache. Caller holds the lock.
+static esp_err_t parse_table(const uint8_t* table, size_t size)
+{
+    const esp_partition_info_t* entries = (const esp_partition_info_t*)table;
+    uint32_t max_entries = size / sizeof(esp_partition_info_t);
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < max_entries && count < PARTITION_CACHE_MAX_ENTRIES; i++) {
+        const esp_partition_info_t* info = &entries[i];
+
+        // MD5 entry or erased flash terminates the table
+        if (info->magic != ESP_PARTITION_MAGIC) {
+            break;
+        }
+
+        partition_cache_entry_t* entry = &g_cache.entries[count];
+        memcpy(entry->label, info->label, 16);
+        entry->label[16] = '\0';
+        entry->type = info->type;
+        entry->subtype = info->subtype;
+        entry->offset = info->pos.offset;
+        entry->size = info->pos.size;
+        entry->flags = info->flags;
+        count++;
+    }
+
+    g_cache.count = count;
+    g_cache.loaded = true;
+    g_cache.generation++;
+    rebuild_indexes();
+
+    ESP_LOGI(TAG, "Partition table cached: %u entries, generation %u",
+             (unsigned int)count, (unsigned int)g_cache.generation);
+    return count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Caller holds the lock
+static esp_err_t ensure_loaded(void)
+{
+    if (g_cache.loaded) {
+        return ESP_OK;
+    }
+
+    uint8_t* raw_table = malloc(PARTITION_TABLE_SIZE);
+    if (!raw_table) {
+        ESP_LOGE(TAG, "Failed to allocate memory for partition table reading");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, raw_table, PARTITION_TABLE_OFFSET, PARTITION_TABLE_SIZE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read partition table from flash: %s", esp_err_to_name(ret));
+        free(raw_table);
+        return ret;
+    }
+
+    ret = parse_table(raw_table, PARTITION_TABLE_SIZE);
+    free(raw_table);
+    return ret;
+}
+
+esp_err_t partition_cache_init(void)
+{
+    if (g_cache_mutex) {
+        return ESP_OK;
+    }
+
+    g_cache_mutex = xSemaphoreCreateMutex();
+    if (!g_cache_mutex) {
+        ESP_LOGE(TAG, "Failed to create partition cache mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t partition_cache_load(void)
+{
+    if (!cache_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = ensure_loaded();
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t partition_cache_update(const uint8_t* table, size_t size)
+{
+    if (!table || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!cache_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = parse_table(table, size);
+    cache_unlock();
+    return ret;
+}
+
+void partition_cache_invalidate(void)
+{
+    if (!cache_lock()) {
+        return;
+    }
+    g_cache.loaded = false;
+    g_cache.count = 0;
+    cache_unlock();
+    ESP_LOGD(TAG, "Partition cache invalidated");
+}
+
+uint32_t partition_cache_get_generation(void)
+{
+    if (!cache_lock()) {
+        return 0;
+    }
+    uint32_t generation = g_cache.generation;
+    cache_unlock();
+    return generation;
+}
+
+uint32_t partition_cache_get_count(void)
+{
+    if (!cache_lock()) {
+        return 0;
+    }
+    ensure_loaded();
+    uint32_t count = g_cache.count;
+    cache_unlock();
+    return count;
+}
+
+esp_err_t partition_cache_get_entry(uint32_t index, partition_cache_entry_t* entry)
+{
+    if (!entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!cache_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ensure_loaded();
+    if (ret == ESP_OK) {
+        if (index < g_cache.count) {
+            *entry = g_cache.entries[index];
+        } else {
+            ret = ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t partition_cache_find_by_subtype(uint8_t type, uint8_t subtype,
+                                          partition_cache_entry_t* entry)
+{
+    if (!entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!cache_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ensure_loaded();
+    if (ret == ESP_OK) {
+        uint8_t idx = INDEX_EMPTY;
+        if (type == ESP_PARTITION_TYPE_APP) {
+            idx = g_cache.app_index[subtype];
+        } else if (type == ESP_PARTITION_TYPE_DATA) {
+            idx = g_cache.data_index[subtype];
+        }
+
+        if (idx != INDEX_EMPTY) {
+            *entry = g_cache.entries[idx];
+        } else {
+            ret = ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t partition_cache_find_by_label(const char* label, partition_cache_entry_t* entry)
+{
+    if (!label || !entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!cache_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ensure_loaded();
+    if (ret == ESP_OK) {
+        ret = ESP_ERR_NOT_FOUND;
+        uint32_t slot = label_hash(label);
+        for (uint32_t probe = 0; probe < LABEL_INDEX_SIZE; probe++) {
+            uint8_t idx = g_cache.label_index[slot];
+            if (idx == INDEX_EMPTY) {
+                break;
+            }
+            if (strncmp(g_cache.entries[idx].label, label, 16) == 0) {
+                *entry = g_cache.entries[idx];
+                ret = ESP_OK;
+                break;
+            }
+            slot = (slot + 1) & (LABEL_INDEX_SIZE - 1);
+        }
+    }
+
+    cache_unlock();
+    return ret;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file partition_cache.h
+ * @brief Cached, generation-stamped view of the on-flash partition table
+ *
+ * The partition table at 0x10000 is parsed once into RAM and served from
+ * there to every reader (layout generation, partition visualizer, boot menu).
+ * The cache is refreshed in place whenever the flasher writes a new table,
+ * and each refresh bumps a generation counter so readers can tell whether
+ * anything they derived from the table is stale.
+ */
+
+#ifndef PARTITION_CACHE_H
+#define PARTITION_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of partition entries kept in the cache
+#define PARTITION_CACHE_MAX_ENTRIES 32
+
+/**
+ * @brief Parsed partition table entry
+ */
+typedef struct {
+    char label[17];          // Partition label (NUL terminated)
+    uint8_t type;            // ESP partition type (APP, DATA, ...)
+    uint8_t subtype;         // ESP partition subtype
+    uint32_t offset;         // Flash offset in bytes
+    uint32_t size;           // Partition size in bytes
+    uint32_t flags;          // Raw partition flags
+} partition_cache_entry_t;
+
+/**
+ * @brief Create the lock guarding the cache
+ *
+ * Call once before any task that reads the partition table runs; later
+ * calls are no-ops. Lookups fail with ESP_ERR_INVALID_STATE until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the mutex cannot be created
+ */
+esp_err_t partition_cache_init(void);
+
+/**
+ * @brief Load the partition table from flash if it is not cached yet
+ *
+ * Subsequent calls are no-ops until the cache is invalidated.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t partition_cache_load(void);
+
+/**
+ * @brief Replace the cached table with a freshly written raw table
+ *
+ * Called by the flasher after a new partition table has been written to
+ * flash, so the cache never has to re-read it.
+ *
+ * @param table Raw partition table data (esp_partition_info_t entries)
+ * @param size Size of the table data in bytes
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t partition_cache_update(const uint8_t* table, size_t size);
+
+/**
+ * @brief Drop the cached table; the next reader re-reads it from flash
+ */
+void partition_cache_invalidate(void);
+
+/**
+ * @brief Get the cache generation counter
+ *
+ * The counter is incremented every time the cached table changes.
+ *
+ * @return Current generation (0 if the table was never loaded)
+ */
+uint32_t partition_cache_get_generation(void);
+
+/**
+ * @brief Get number of cached partition entries
+ *
+ * @return Number of entries (loads the table on first use)
+ */
+uint32_t partition_cache_get_count(void);
+
+/**
+ * @brief Copy a cached entry by table position
+ *
+ * @param index Entry position in the partition table
+ * @param entry Output entry
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if index is out of range
+ */
+esp_err_t partition_cache_get_entry(uint32_t index, partition_cache_entry_t* entry);
+
+/**
+ * @brief Look up the first entry with the given type and subtype in O(1)
+ *
+ * @param type ESP partition type
+ * @param subtype ESP partition subtype
+ * @param entry Output entry
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no such partition
+ */
+esp_err_t partition_cache_find_by_subtype(uint8_t type, uint8_t subtype,
+                                          partition_cache_entry_t* entry);
+
+/**
+ * @brief Look up an entry by label using the label hash index
+ *
+ * @param label Partition label
+ * @param entry Output entry
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no such partition
+ */
+esp_err_t partition_cache_find_by_label(const char* label, partition_cache_entry_t* entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PARTITION_CACHE_H
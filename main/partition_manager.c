@@ -4,6 +4,8 @@
  */
 
 #include "partition_manager.h"
+#include "partition_cache.h"
+#include "flash_io.h"
 #include "firmware_validator.h"
 #include "esp_log.h"
 #include "esp_partition.h"
@@ -573,8 +575,8 @@ esp_err_t partition_manager_backup_current(uint8_t* backup_buffer,
         return ESP_ERR_NO_MEM;
     }
 
-    esp_err_t ret = esp_partition_read(partition_table_partition, 0, backup_buffer,
-                                      partition_table_partition->size);
+    esp_err_t ret = flash_io_partition_read(FLASH_IO_PRIORITY_BULK, partition_table_partition, 0,
+                                            backup_buffer, partition_table_partition->size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read partition table: %s", esp_err_to_name(ret));
         return ret;
@@ -610,7 +612,8 @@ esp_err_t partition_manager_restore_from_backup(const uint8_t* backup_buffer,
     }
 
     // Write backup data
-    esp_err_t ret = esp_partition_write(partition_table_partition, 0, backup_buffer, backup_size);
+    esp_err_t ret = flash_io_partition_write(FLASH_IO_PRIORITY_BULK, partition_table_partition, 0,
+                                             backup_buffer, backup_size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to restore partition table: %s", esp_err_to_name(ret));
         return ret;
@@ -654,129 +657,96 @@ esp_err_t partition_manager_read_existing_table(partition_table_layout_t* layout
         return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGI(TAG, "Reading existing partition table from flash at offset 0x%08x", PARTITION_TABLE_OFFSET);
-
-    // Allocate buffer on heap to avoid stack overflow
-    uint8_t* raw_table = malloc(4096);  // One flash sector
-    if (raw_table == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for partition table reading");
-        return ESP_ERR_NO_MEM;
-    }
-
-    esp_err_t ret = esp_flash_read(NULL, raw_table, PARTITION_TABLE_OFFSET, 4096);
+    // Served from the in-RAM partition table; flash is only read on first use
+    // or after the cache has been invalidated.
+    esp_err_t ret = partition_cache_load();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read partition table from flash: %s", esp_err_to_name(ret));
-        free(raw_table);
+        ESP_LOGE(TAG, "Failed to load partition table: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    ESP_LOGI(TAG, "Successfully read partition table from flash");
+    ESP_LOGI(TAG, "Building layout from cached partition table (generation %u)",
+             (unsigned int)partition_cache_get_generation());
 
     // Initialize layout
     memset(layout, 0, sizeof(partition_table_layout_t));
     uint32_t partition_count = 0;
     uint32_t total_used_size = 0;
 
-    // Parse partition table entries
-    esp_partition_info_t* entries = (esp_partition_info_t*)raw_table;
-
-    ESP_LOGI(TAG, "=== EXISTING PARTITION TABLE DUMP ===");
-    for (uint32_t i = 0; i < MAX_PARTITIONS; i++) {
-        esp_partition_info_t* entry = &entries[i];
-
-        // Check for MD5 entry (magic 0xEBEB) - stop here
-        if (entry->magic == ESP_PARTITION_MAGIC_MD5) {
-            ESP_LOGI(TAG, "MD5 entry found at position %d", i);
-            break;
-        }
-
-        // Check for valid partition entry
-        if (entry->magic != ESP_PARTITION_MAGIC) {
-            ESP_LOGI(TAG, "Invalid magic 0x%04X at position %d, stopping", entry->magic, i);
-            break;
-        }
-
-        // Log detailed partition information
-        ESP_LOGI(TAG, "Partition %d: magic=0x%04X, type=0x%02X, subtype=0x%02X, offset=0x%08X, size=0x%08X, label='%.16s'",
-                 i, entry->magic, entry->type, entry->subtype, entry->pos.offset, entry->pos.size, entry->label);
+    partition_cache_entry_t entry;
+    for (uint32_t i = 0; partition_count < MAX_PARTITIONS &&
+                         partition_cache_get_entry(i, &entry) == ESP_OK; i++) {
+        ESP_LOGD(TAG, "Partition %d: type=0x%02X, subtype=0x%02X, offset=0x%08X, size=0x%08X, label='%s'",
+                 i, entry.type, entry.subtype, entry.offset, entry.size, entry.label);
 
         // Convert to our partition_info_t structure
-        if (partition_count < MAX_PARTITIONS) {
-            partition_info_t* part = &layout->partitions[partition_count];
-
-            // Copy name (truncate if necessary)
-            strncpy(part->name, (char*)entry->label, sizeof(part->name) - 1);
-            part->name[sizeof(part->name) - 1] = '\0';
-
-            // Determine partition type and OTA status
-            if (entry->type == ESP_PARTITION_TYPE_APP) {
-                part->type = PARTITION_TYPE_FACTORY_APP;  // Default
-
-                // Check specific OTA subtype - only OTA slots are considered OTA
-                if (entry->subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY) {
+        partition_info_t* part = &layout->partitions[partition_count];
+
+        // Copy name (truncate if necessary)
+        strncpy(part->name, entry.label, sizeof(part->name) - 1);
+        part->name[sizeof(part->name) - 1] = '\0';
+
+        // Determine partition type and OTA status
+        if (entry.type == ESP_PARTITION_TYPE_APP) {
+            part->type = PARTITION_TYPE_FACTORY_APP;  // Default
+
+            // Check specific OTA subtype - only OTA slots are considered OTA
+            if (entry.subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY) {
+                part->type = PARTITION_TYPE_FACTORY_APP;
+                part->is_ota = false;  // Factory app is NOT OTA - should be preserved
+            } else if (entry.subtype == ESP_PARTITION_SUBTYPE_APP_OTA_0) {
+                part->type = PARTITION_TYPE_OTA_0;
+                part->is_ota = true;
+            } else if (entry.subtype == ESP_PARTITION_SUBTYPE_APP_OTA_1) {
+                part->type = PARTITION_TYPE_OTA_1;
+                part->is_ota = true;
+            } else if (entry.subtype == ESP_PARTITION_SUBTYPE_APP_OTA_2) {
+                part->type = PARTITION_TYPE_OTA_2;
+                part->is_ota = true;
+            } else {
+                // Unknown APP subtype - check if it's factory_app by name
+                if (strcmp(part->name, "factory_app") == 0) {
                     part->type = PARTITION_TYPE_FACTORY_APP;
-                    part->is_ota = false;  // Factory app is NOT OTA - should be preserved
-                } else if (entry->subtype == ESP_PARTITION_SUBTYPE_APP_OTA_0) {
-                    part->type = PARTITION_TYPE_OTA_0;
-                    part->is_ota = true;
-                } else if (entry->subtype == ESP_PARTITION_SUBTYPE_APP_OTA_1) {
-                    part->type = PARTITION_TYPE_OTA_1;
-                    part->is_ota = true;
-                } else if (entry->subtype == ESP_PARTITION_SUBTYPE_APP_OTA_2) {
-                    part->type = PARTITION_TYPE_OTA_2;
-                    part->is_ota = true;
+                    part->is_ota = false;  // factory_app is NOT OTA
                 } else {
-                    // Unknown APP subtype - check if it's factory_app by name
-                    if (strcmp(part->name, "factory_app") == 0) {
-                        part->type = PARTITION_TYPE_FACTORY_APP;
-                        part->is_ota = false;  // factory_app is NOT OTA
-                    } else {
-                        part->is_ota = true;  // Other APP partitions are OTA
-                    }
-                }
-            } else if (entry->type == ESP_PARTITION_TYPE_DATA) {
-                part->is_ota = false;
-                // Map data subtypes
-                switch (entry->subtype) {
-                    case ESP_PARTITION_SUBTYPE_DATA_NVS:
-                        part->type = PARTITION_TYPE_NVS;
-                        break;
-                    case ESP_PARTITION_SUBTYPE_DATA_OTA:
-                        part->type = PARTITION_TYPE_OTA_DATA;
-                        break;
-                    default:
-                        part->type = PARTITION_TYPE_NVS;  // Default
-                        break;
+                    part->is_ota = true;  // Other APP partitions are OTA
                 }
-            } else {
-                part->is_ota = false;
-                part->type = PARTITION_TYPE_NVS;  // Default unknown type
             }
+        } else if (entry.type == ESP_PARTITION_TYPE_DATA) {
+            part->is_ota = false;
+            // Map data subtypes
+            switch (entry.subtype) {
+                case ESP_PARTITION_SUBTYPE_DATA_NVS:
+                    part->type = PARTITION_TYPE_NVS;
+                    break;
+                case ESP_PARTITION_SUBTYPE_DATA_OTA:
+                    part->type = PARTITION_TYPE_OTA_DATA;
+                    break;
+                default:
+                    part->type = PARTITION_TYPE_NVS;  // Default
+                    break;
+            }
+        } else {
+            part->is_ota = false;
+            part->type = PARTITION_TYPE_NVS;  // Default unknown type
+        }
 
-            part->subtype = entry->subtype;  // Preserve original ESP32 subtype
-            part->offset = entry->pos.offset;
-            part->size = entry->pos.size;
-            part->is_encrypted = (entry->flags & PARTITION_ENCRYPTED) != 0;
-            part->firmware = NULL;
-
-            ESP_LOGI(TAG, "Loaded partition %s: type=%d, is_ota=%d, offset=0x%08x, size=%d",
-                     part->name, part->type, part->is_ota, part->offset, part->size);
+        part->subtype = entry.subtype;  // Preserve original ESP32 subtype
+        part->offset = entry.offset;
+        part->size = entry.size;
+        part->is_encrypted = (entry.flags & PARTITION_ENCRYPTED) != 0;
+        part->firmware = NULL;
 
-            total_used_size += part->size;
-            partition_count++;
-        }
+        total_used_size += part->size;
+        partition_count++;
     }
 
     layout->partition_count = partition_count;
     layout->total_used_size = total_used_size;
 
-    ESP_LOGI(TAG, "=== END PARTITION TABLE DUMP ===");
-    ESP_LOGI(TAG, "Successfully loaded %d partitions from flash", partition_count);
-    ESP_LOGI(TAG, "Total used space: %d bytes (%.2f MB)",
-             total_used_size, (float)total_used_size / (1024 * 1024));
+    ESP_LOGI(TAG, "Loaded %d partitions, total used space: %d bytes (%.2f MB)",
+             partition_count, total_used_size, (float)total_used_size / (1024 * 1024));
 
-    // Clean up heap allocation
-    free(raw_table);
     return ESP_OK;
 }
 
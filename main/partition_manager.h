@@ -241,8 +241,8 @@ void partition_manager_print_layout(const partition_table_layout_t* layout);
 /**
  * @brief Read existing partition table from device
  *
- * Reads the current partition table from the device and populates
- * a layout with all existing partitions.
+ * Populates a layout with all existing partitions. The table is served
+ * from the partition cache, so flash is only read on first use.
  *
  * @param layout Output layout structure to populate
  * @return ESP_OK on success, error code otherwise
@@ -4,6 +4,8 @@
  */
 
 #include "partition_visualizer.h"
+#include "partition_cache.h"
+#include "flash_io.h"
 #include "lvgl_bootloader.h"
 #include "esp_log.h"
 #include "esp_partition.h"
@@ -35,6 +37,7 @@ static const char* TAG = "partition_visualizer";
 // State
 static lv_obj_t* pv_screen = NULL;
 static lv_obj_t* pv_list = NULL;
+static uint32_t pv_generation = 0;  // Partition cache generation the screen was built from
 
 // ============================================================================
 // Core Functions (work without LVGL)
@@ -49,7 +52,7 @@ int partition_visualizer_read_first_bytes(const esp_partition_t* partition,
     }
 
     // Read first 16 bytes
-    esp_err_t ret = esp_partition_read(partition, 0, buffer, 16);
+    esp_err_t ret = flash_io_partition_read(FLASH_IO_PRIORITY_INTERACTIVE, partition, 0, buffer, 16);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read partition %s: %s", partition->label, esp_err_to_name(ret));
         return -1;
@@ -112,7 +115,7 @@ int partition_visualizer_detect_content_type(const uint8_t* data, size_t size) {
 // ============================================================================
 
 // Forward declarations
-static lv_obj_t* create_partition_row(lv_obj_t* parent, const esp_partition_t* partition,
+static lv_obj_t* create_partition_row(lv_obj_t* parent, const partition_cache_entry_t* partition,
                                        uint32_t index);
 static void refresh_button_cb(lv_event_t* e);
 static void back_button_cb(lv_event_t* e);
@@ -126,7 +129,7 @@ static void async_back_to_selector(void* user_data);
 lv_obj_t* partition_visualizer_create_screen(void);
 esp_err_t partition_visualizer_refresh(lv_obj_t* screen);
 
-static const char* get_partition_type_name(esp_partition_type_t type) {
+static const char* get_partition_type_name(uint8_t type) {
     switch (type) {
         case ESP_PARTITION_TYPE_APP:
             return "APP";
@@ -137,7 +140,7 @@ static const char* get_partition_type_name(esp_partition_type_t type) {
     }
 }
 
-static const char* get_partition_subtype_name(esp_partition_subtype_t subtype) {
+static const char* get_partition_subtype_name(uint8_t subtype) {
     switch (subtype) {
         case ESP_PARTITION_SUBTYPE_APP_FACTORY:
             return "FACTORY";
@@ -167,13 +170,17 @@ static const char* format_size(uint32_t size, char* buffer, size_t buffer_size)
     return buffer;
 }
 
-static lv_obj_t* create_partition_row(lv_obj_t* parent, const esp_partition_t* partition,
+static lv_obj_t* create_partition_row(lv_obj_t* parent, const partition_cache_entry_t* partition,
                                        uint32_t index) {
     (void)index;  // Unused for now
 
     // Read first bytes and detect content BEFORE creating any UI objects
     uint8_t first_bytes[16];
-    int bytes_read = partition_visualizer_read_first_bytes(partition, first_bytes, 16);
+    int bytes_read = 16;
+    if (flash_io_read(FLASH_IO_PRIORITY_INTERACTIVE, first_bytes, partition->offset, sizeof(first_bytes)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read partition %s", partition->label);
+        bytes_read = -1;
+    }
 
     int content_type = -1;
     lv_color_t indicator_color = PV_COLOR_ERROR;
@@ -205,7 +212,7 @@ static lv_obj_t* create_partition_row(lv_obj_t* parent, const esp_partition_t* p
              get_partition_subtype_name(partition->subtype));
 
     char offset_str[32], size_str[32];
-    snprintf(offset_str, sizeof(offset_str), "Offset: 0x%08X", (unsigned int)partition->address);
+    snprintf(offset_str, sizeof(offset_str), "Offset: 0x%08X", (unsigned int)partition->offset);
     format_size(partition->size, size_str, sizeof(size_str));
 
     char size_text[64];
@@ -309,6 +316,13 @@ static void async_show_visualizer(void* user_data) {
     (void)user_data;
     ESP_LOGI(TAG, "Async: showing partition visualizer");
 
+    // Reuse the existing screen unless the partition table changed since it was built
+    if (pv_screen && pv_generation != partition_cache_get_generation()) {
+        lv_obj_del(pv_screen);
+        pv_screen = NULL;
+        pv_list = NULL;
+    }
+
     if (!pv_screen) {
         pv_screen = partition_visualizer_create_screen();
     }
@@ -369,25 +383,18 @@ lv_obj_t* partition_visualizer_create_screen(void) {
     // Enable scrolling
     lv_obj_set_scrollbar_mode(pv_list, LV_SCROLLBAR_MODE_AUTO);
 
-    // Add all partitions
-    const esp_partition_t* partition = NULL;
+    // Add all partitions from the cached partition table
+    partition_cache_entry_t partition;
     uint32_t count = 0;
 
-    // Iterate through all partitions
-    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_ANY,
-                                                     ESP_PARTITION_SUBTYPE_ANY,
-                                                     NULL);
-
-    if (it) {
-        while ((partition = esp_partition_get(it)) != NULL && count < 20) {
-            lv_obj_t* row = create_partition_row(pv_list, partition, count);
-            (void)row;  // Row is already added to parent in create_partition_row
-            ESP_LOGI(TAG, "Added partition %u: %s @ 0x%08X",
-                     count, partition->label, (unsigned int)partition->address);
-            count++;
-        }
-        esp_partition_iterator_release(it);
+    while (count < 20 && partition_cache_get_entry(count, &partition) == ESP_OK) {
+        lv_obj_t* row = create_partition_row(pv_list, &partition, count);
+        (void)row;  // Row is already added to parent in create_partition_row
+        ESP_LOGI(TAG, "Added partition %u: %s @ 0x%08X",
+                 count, partition.label, (unsigned int)partition.offset);
+        count++;
     }
+    pv_generation = partition_cache_get_generation();
 
     ESP_LOGI(TAG, "Total partitions displayed: %u", count);
 
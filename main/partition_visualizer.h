@@ -42,7 +42,8 @@ void partition_visualizer_show(void);
 /**
  * @brief Refresh partition data
  *
- * Re-reads partition information from flash and updates the display.
+ * Rebuilds the display from the cached partition table and re-reads
+ * the first bytes of each partition.
  *
  * @param screen Visualizer screen to refresh (NULL to use active screen)
  * @return ESP_OK on success, error code otherwise
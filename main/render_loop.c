@@ -0,0 +1,282 @@
+/**
+ * @file render_loop.c
+ * @brief Event-driven LVGL render loop with frame and latency statistics
+ */
+
+#include "render_loop.h"
+#include "ui_events.h"
+#include "lvgl.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "render_loop";
+
+// Pending input older than this never got a frame of its own; drop it
+#define INPUT_LATENCY_MAX_US (1000 * 1000)
+
+typedef struct {
+    int64_t start_us;
+    uint64_t busy_us;
+    uint32_t iterations;
+    uint32_t frames;
+    uint64_t frame_us_total;
+    uint32_t frame_us_max;
+    uint32_t input_events;
+    uint64_t input_latency_us_total;
+    uint32_t input_latency_us_max;
+} render_window_t;
+
+static render_loop_hooks_t g_hooks = {0};
+static SemaphoreHandle_t g_wake = NULL;
+static SemaphoreHandle_t g_stats_mutex = NULL;
+static render_window_t g_window = {0};
+
+// Only touched from the LVGL task
+static bool g_rendering = false;
+static int64_t g_render_start_us = 0;
+static int64_t g_input_pending_us = 0;
+
+// Fails until render_loop_init() has created the mutex
+static bool stats_lock(void)
+{
+    return g_stats_mutex && xSemaphoreTake(g_stats_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void stats_unlock(void)
+{
+    xSemaphoreGive(g_stats_mutex);
+}
+
+static void frame_done(int64_t now)
+{
+    uint32_t frame_us = (uint32_t)(now - g_render_start_us);
+    uint32_t latency_us = 0;
+
+    if (g_input_pending_us != 0) {
+        int64_t latency = now - g_input_pending_us;
+        latency_us = latency < INPUT_LATENCY_MAX_US ? (uint32_t)latency : 0;
+        g_input_pending_us = 0;
+    }
+
+    if (stats_lock()) {
+        g_window.frames++;
+        g_window.frame_us_total += frame_us;
+        if (frame_us > g_window.frame_us_max) {
+            g_window.frame_us_max = frame_us;
+        }
+        if (latency_us != 0) {
+            g_window.input_events++;
+            g_window.input_latency_us_total += latency_us;
+            if (latency_us > g_window.input_latency_us_max) {
+                g_window.input_latency_us_max = latency_us;
+            }
+        }
+        stats_unlock();
+    }
+}
+
+static void display_event_cb(lv_event_t* e)
+{
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_INVALIDATE_AREA:
+        // Also from other tasks (status updates); at worst one extra
+        // lv_timer_handler() pass when LVGL invalidates from its own timers
+        render_loop_wake();
+        break;
+
+    case LV_EVENT_RENDER_START:
+        if (!g_rendering) {
+            g_rendering = true;
+            g_render_start_us = esp_timer_get_time();
+            if (g_hooks.render_begin) {
+                g_hooks.render_begin();
+            }
+        }
+        break;
+
+    case LV_EVENT_REFR_READY:
+        // Sent after the last flush of the refresh has completed
+        if (g_rendering) {
+            g_rendering = false;
+            frame_done(esp_timer_get_time());
+            if (g_hooks.render_end) {
+                g_hooks.render_end();
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void indev_event_cb(lv_event_t* e)
+{
+    (void)e;
+    if (g_input_pending_us == 0) {
+        g_input_pending_us = esp_timer_get_time();
+    }
+}
+
+esp_err_t render_loop_init(const render_loop_hooks_t* hooks)
+{
+    lv_display_t* display = lv_display_get_default();
+    if (!display) {
+        ESP_LOGE(TAG, "No default display");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (hooks) {
+        g_hooks = *hooks;
+    }
+
+    if (!g_wake) {
+        g_wake = xSemaphoreCreateBinary();
+    }
+    if (!g_stats_mutex) {
+        g_stats_mutex = xSemaphoreCreateMutex();
+    }
+    if (!g_wake || !g_stats_mutex) {
+        ESP_LOGE(TAG, "Failed to create render loop semaphores");
+        return ESP_ERR_NO_MEM;
+    }
+
+    lv_display_add_event_cb(display, display_event_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    lv_display_add_event_cb(display, display_event_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(display, display_event_cb, LV_EVENT_REFR_READY, NULL);
+
+    int indev_count = 0;
+    for (lv_indev_t* indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+        lv_indev_add_event_cb(indev, indev_event_cb, LV_EVENT_PRESSED, NULL);
+        lv_indev_add_event_cb(indev, indev_event_cb, LV_EVENT_RELEASED, NULL);
+        indev_count++;
+    }
+
+    if (stats_lock()) {
+        memset(&g_window, 0, sizeof(g_window));
+        g_window.start_us = esp_timer_get_time();
+        stats_unlock();
+    }
+
+    ESP_LOGI(TAG, "Event-driven render loop ready (%d input device(s))", indev_count);
+    return ESP_OK;
+}
+
+uint32_t render_loop_run_once(void)
+{
+    int64_t start = esp_timer_get_time();
+
+    // Updates posted by I/O tasks are drawn in this pass
+    ui_events_dispatch();
+    uint32_t next_ms = lv_timer_handler();
+
+    int64_t busy = esp_timer_get_time() - start;
+    if (stats_lock()) {
+        g_window.iterations++;
+        g_window.busy_us += (uint64_t)busy;
+        stats_unlock();
+    }
+
+    // LV_NO_TIMER_READY (no timer at all) is UINT32_MAX
+    return next_ms > RENDER_LOOP_MAX_SLEEP_MS ? RENDER_LOOP_MAX_SLEEP_MS : next_ms;
+}
+
+void render_loop_wait(uint32_t timeout_ms)
+{
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+    if (ticks == 0) {
+        ticks = 1;  // Always yield; the render task runs at the highest priority
+    }
+
+    if (g_wake) {
+        xSemaphoreTake(g_wake, ticks);
+    } else {
+        vTaskDelay(ticks);
+    }
+}
+
+void render_loop_wake(void)
+{
+    if (g_wake) {
+        xSemaphoreGive(g_wake);
+    }
+    if (g_hooks.wake) {
+        g_hooks.wake();
+    }
+}
+
+void render_loop_get_stats(render_loop_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!stats_lock()) {
+        return;
+    }
+    render_window_t window = g_window;
+    stats_unlock();
+
+    int64_t elapsed_us = esp_timer_get_time() - window.start_us;
+    if (elapsed_us <= 0) {
+        return;
+    }
+
+    stats->window_ms = (uint32_t)(elapsed_us / 1000);
+    stats->iterations = window.iterations;
+    stats->frames = window.frames;
+    stats->frame_us_avg = window.frames ? (uint32_t)(window.frame_us_total / window.frames) : 0;
+    stats->frame_us_max = window.frame_us_max;
+    stats->idle_pct = window.busy_us >= (uint64_t)elapsed_us ? 0 :
+                      (uint32_t)(100 - window.busy_us * 100 / (uint64_t)elapsed_us);
+    stats->input_events = window.input_events;
+    stats->input_latency_us_avg = window.input_events ?
+                                  (uint32_t)(window.input_latency_us_total / window.input_events) : 0;
+    stats->input_latency_us_max = window.input_latency_us_max;
+}
+
+void render_loop_format_stats(char* buf, size_t size)
+{
+    render_loop_stats_t stats;
+    render_loop_get_stats(&stats);
+
+    if (!buf || size == 0) {
+        return;
+    }
+
+    snprintf(buf, size,
+             "Render loop (last %" PRIu32 " ms)\n"
+             "  wakeups      %9" PRIu32 "\n"
+             "  frames       %9" PRIu32 "\n"
+             "  frame avg    %9" PRIu32 " us (max %" PRIu32 ")\n"
+             "  idle         %9" PRIu32 " %%\n"
+             "  input->flush %9" PRIu32 " us (max %" PRIu32 ", %" PRIu32 " events)\n",
+             stats.window_ms, stats.iterations, stats.frames,
+             stats.frame_us_avg, stats.frame_us_max, stats.idle_pct,
+             stats.input_latency_us_avg, stats.input_latency_us_max, stats.input_events);
+}
+
+void render_loop_log_stats(void)
+{
+    render_loop_stats_t stats;
+    render_loop_get_stats(&stats);
+
+    ESP_LOGI(TAG, "RENDER_STATS window_ms=%" PRIu32 " wakeups=%" PRIu32 " frames=%" PRIu32
+             " frame_us_avg=%" PRIu32 " frame_us_max=%" PRIu32 " idle_pct=%" PRIu32
+             " input_events=%" PRIu32 " input_latency_us_avg=%" PRIu32 " input_latency_us_max=%" PRIu32,
+             stats.window_ms, stats.iterations, stats.frames, stats.frame_us_avg, stats.frame_us_max,
+             stats.idle_pct, stats.input_events, stats.input_latency_us_avg, stats.input_latency_us_max);
+
+    if (stats_lock()) {
+        memset(&g_window, 0, sizeof(g_window));
+        g_window.start_us = esp_timer_get_time();
+        stats_unlock();
+    }
+}
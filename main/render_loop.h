@@ -0,0 +1,102 @@
+/**
+ * @file render_loop.h
+ * @brief Event-driven LVGL render loop with frame and latency statistics
+ *
+ * Instead of calling lv_timer_handler() at a fixed rate, the render task
+ * runs it once and then sleeps until the next LVGL timer deadline, an
+ * invalidation on the display or an explicit render_loop_wake() (input,
+ * other tasks). Display and input device events are used to measure frame
+ * time, idle time and input-to-flush latency.
+ */
+
+#ifndef RENDER_LOOP_H
+#define RENDER_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest sleep when LVGL has no timer pending
+#define RENDER_LOOP_MAX_SLEEP_MS 500
+
+/**
+ * @brief Platform hooks, all optional
+ */
+typedef struct {
+    void (*render_begin)(void);  // A frame starts rendering (e.g. VDMA protection on)
+    void (*render_end)(void);    // The frame has been flushed
+    void (*wake)(void);          // Extra wake-up path for loops not blocked in render_loop_wait()
+} render_loop_hooks_t;
+
+/**
+ * @brief Render statistics for the current window
+ */
+typedef struct {
+    uint32_t window_ms;             // Length of the window
+    uint32_t iterations;            // lv_timer_handler() calls
+    uint32_t frames;                // Calls that rendered a frame
+    uint32_t frame_us_avg;          // Average render + flush time per frame
+    uint32_t frame_us_max;
+    uint32_t idle_pct;              // Share of the window spent outside lv_timer_handler()
+    uint32_t input_events;          // Presses/releases that led to a flushed frame
+    uint32_t input_latency_us_avg;  // Input event to end of the next flushed frame
+    uint32_t input_latency_us_max;
+} render_loop_stats_t;
+
+/**
+ * @brief Hook into the default display and all input devices
+ *
+ * Call once LVGL and the display are up, from the task that owns LVGL.
+ * Statistics stay empty until then.
+ *
+ * @param hooks Platform hooks (can be NULL)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if there is no display,
+ *         ESP_ERR_NO_MEM if the semaphores cannot be created
+ */
+esp_err_t render_loop_init(const render_loop_hooks_t* hooks);
+
+/**
+ * @brief Run lv_timer_handler() once with accounting
+ * @return Milliseconds until LVGL needs to run again (capped at RENDER_LOOP_MAX_SLEEP_MS)
+ */
+uint32_t render_loop_run_once(void);
+
+/**
+ * @brief Sleep until the timeout expires or render_loop_wake() is called
+ * @param timeout_ms Value returned by render_loop_run_once()
+ */
+void render_loop_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Wake the render loop early; safe from any task
+ */
+void render_loop_wake(void);
+
+/**
+ * @brief Get the statistics of the current window
+ * @param stats Output statistics
+ */
+void render_loop_get_stats(render_loop_stats_t* stats);
+
+/**
+ * @brief Format the statistics for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void render_loop_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable RENDER_STATS line and start a new window
+ */
+void render_loop_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RENDER_LOOP_H
@@ -1,15 +1,31 @@
 #include "sd_ota.h"
-#include "vdma_protection.h"
+#include "io_arbiter.h"
+#include "sd_reader.h"
+#include "flash_io.h"
 #include "esp_log.h"
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdmmc_host.h"
 #include "esp_partition.h"
 #include "esp_ota_ops.h"
+#ifndef __SIMULATOR_BUILD__
+#include "esp_image_format.h"
+#endif
 #include "bsp/esp-bsp.h"
-#include "soc/lp_system_reg.h"
+#include "boot_request.h"
+#include "image_digest_cache.h"
+#include "ota_preerase.h"
+#include "block_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#ifndef __SIMULATOR_BUILD__
+#include "ff.h"
+#include "diskio_sdmmc.h"
+#endif
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
 #ifdef __SIMULATOR_BUILD__
 #include <stdlib.h>  // For malloc, free (only needed by simulator)
 #endif
@@ -18,9 +34,8 @@
 
 #define TAG "SD_OTA"
 
-// RTC register constants for bootloader communication (must match bootloader_custom.c)
-#define BOOT_REQUEST_RTC_REG     LP_SYSTEM_REG_LP_STORE0_REG
-#define BOOT_REQUEST_MAGIC_RTC   0x00544551  // 'BOOT' magic in ASCII
+// Chunks read ahead while the previous one is written to flash
+#define SD_OTA_READ_AHEAD 4
 
 static sd_ota_state_t g_sd_ota_state = {0};
 static bool g_sd_card_mounted = false;
@@ -30,9 +45,48 @@ static sdmmc_card_t* g_sd_card = NULL;
 static void (*g_progress_callback)(uint8_t progress) = NULL;
 static void (*g_status_callback)(const char* status) = NULL;
 
-// Pre-allocated IRAM buffer to prevent fragmentation
-static uint8_t* g_preallocated_buffer = NULL;
-static size_t g_preallocated_size = 0;
+// Throughput of the last batch
+static sd_ota_throughput_t g_throughput = {0};
+
+// One file of a batch
+typedef struct {
+    char filename[SD_OTA_NAME_MAX];
+    esp_partition_subtype_t slot;
+    size_t file_size;                   // Set by validation
+    const esp_partition_t* partition;   // Set by validation
+} sd_ota_job_t;
+
+static sd_ota_job_t g_queue[SD_OTA_QUEUE_MAX];
+static size_t g_queue_len = 0;
+
+// Backs g_sd_ota_state.filename; jobs may live on the caller's stack
+static char g_current_file[SD_OTA_NAME_MAX];
+
+// Cluster size of the mounted card, 0 if unknown
+static size_t sd_ota_cluster_size(void) {
+#ifdef __SIMULATOR_BUILD__
+    struct stat st;
+    if (stat(SD_OTA_MOUNT_POINT, &st) == 0 && st.st_blksize > 0) {
+        return (size_t)st.st_blksize;
+    }
+    return 0;
+#else
+    if (!g_sd_card) {
+        return 0;
+    }
+    char drive[3] = { (char)('0' + ff_diskio_get_pdrv_card(g_sd_card)), ':', '\0' };
+    DWORD free_clusters;
+    FATFS* fs = NULL;
+    if (f_getfree(drive, &free_clusters, &fs) != FR_OK || !fs) {
+        return 0;
+    }
+#if FF_MAX_SS != FF_MIN_SS
+    return (size_t)fs->csize * fs->ssize;
+#else
+    return (size_t)fs->csize * FF_MAX_SS;
+#endif
+#endif
+}
 
 esp_err_t sd_ota_init(void) {
     ESP_LOGI(TAG, "Initializing SD card for OTA operations using improved BSP method...");
@@ -42,18 +96,6 @@ esp_err_t sd_ota_init(void) {
         return ESP_OK;
     }
 
-    // Pre-allocate IRAM buffer early to prevent fragmentation
-    if (!g_preallocated_buffer) {
-        // Try to allocate a small buffer during initialization
-        g_preallocated_buffer = heap_caps_malloc(512, MALLOC_CAP_DMA | MALLOC_CAP_IRAM_8BIT);
-        if (g_preallocated_buffer) {
-            g_preallocated_size = 512;
-            ESP_LOGI(TAG, "Pre-allocated 512-byte IRAM buffer for OTA operations");
-        } else {
-            ESP_LOGW(TAG, "Could not pre-allocate IRAM buffer - will try during OTA");
-        }
-    }
-
     ESP_LOGI(TAG, "Using standard BSP SD card mount (handles LDO internally)...");
 
     // Use standard BSP mount - let it handle LDO configuration internally
@@ -103,6 +145,9 @@ esp_err_t sd_ota_init(void) {
     g_sd_card_mounted = true;
     ESP_LOGI(TAG, "SD card mounted successfully via BSP at %s", SD_OTA_MOUNT_POINT);
 
+    // Reads through the shared SD reader become whole clusters of this card
+    sd_reader_set_cluster_size(sd_ota_cluster_size());
+
     return ESP_OK;
 }
 
@@ -162,293 +207,392 @@ esp_err_t sd_ota_get_file_size(const char* filename, size_t* file_size) {
     return ESP_OK;
 }
 
-esp_err_t sd_ota_flash_file(const char* filename, esp_partition_subtype_t partition_subtype) {
-    if (!g_sd_card_mounted) {
-        ESP_LOGE(TAG, "SD card not mounted");
-        return ESP_ERR_INVALID_STATE;
-    }
+static uint32_t kib_per_s(uint64_t bytes, uint64_t us) {
+    return us ? (uint32_t)(bytes * 1000000 / 1024 / us) : 0;
+}
 
-    if (!filename) {
-        ESP_LOGE(TAG, "Filename is NULL");
+static void sd_ota_log_throughput(void) {
+    const sd_ota_throughput_t* t = &g_throughput;
+    uint64_t bytes = t->bytes_display + t->bytes_idle;
+    uint64_t us = t->us_display + t->us_idle;
+
+    ESP_LOGI(TAG, "SD_OTA_STATS bytes=%" PRIu64 " buffer=%" PRIu32 " cluster=%" PRIu32
+             " kib_s=%" PRIu32 " display_kib_s=%" PRIu32 " display_bytes=%" PRIu64
+             " idle_kib_s=%" PRIu32 " idle_bytes=%" PRIu64 " pages_skipped=%" PRIu32,
+             bytes, t->buffer_size, t->cluster_size, kib_per_s(bytes, us),
+             kib_per_s(t->bytes_display, t->us_display), t->bytes_display,
+             kib_per_s(t->bytes_idle, t->us_idle), t->bytes_idle, t->pages_skipped);
+}
+
+static const char* slot_name(esp_partition_subtype_t subtype) {
+    return subtype == ESP_PARTITION_SUBTYPE_APP_OTA_0 ? "OTA_0" :
+           subtype == ESP_PARTITION_SUBTYPE_APP_OTA_1 ? "OTA_1" :
+           subtype == ESP_PARTITION_SUBTYPE_APP_OTA_2 ? "OTA_2" : "OTA_X";
+}
+
+// Name and target checks shared by the queue and single-file installs. The
+// slot indexes the digest cache, pre-erase and block CRC state, so it must
+// fall within IMAGE_DIGEST_MAX_SLOTS.
+static esp_err_t check_job_args(const char* filename, esp_partition_subtype_t slot) {
+    if (!filename || strlen(filename) >= SD_OTA_NAME_MAX) {
+        ESP_LOGE(TAG, "Invalid OTA file name");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (slot < ESP_PARTITION_SUBTYPE_APP_OTA_MIN ||
+        slot >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN + IMAGE_DIGEST_MAX_SLOTS) {
+        ESP_LOGE(TAG, "Not an OTA slot: %d", slot);
         return ESP_ERR_INVALID_ARG;
     }
+    return ESP_OK;
+}
 
-    // Check if file exists first
-    esp_err_t ret = sd_ota_check_file(filename);
-    if (ret != ESP_OK) {
-        return ret;
+// Check every job before any flash is touched; fills in sizes and partitions
+static esp_err_t validate_jobs(sd_ota_job_t* jobs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        sd_ota_job_t* job = &jobs[i];
+
+        esp_err_t ret = sd_ota_check_file(job->filename);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        ret = sd_ota_get_file_size(job->filename, &job->file_size);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (job->file_size == 0) {
+            ESP_LOGE(TAG, "OTA file is empty: %s", job->filename);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        job->partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, job->slot, NULL);
+        if (!job->partition) {
+            ESP_LOGE(TAG, "Target OTA partition not found (subtype: %d)", job->slot);
+            return ESP_ERR_NOT_FOUND;
+        }
     }
 
-    // Find target OTA partition
-    const esp_partition_t* partition = esp_partition_find_first(
-        ESP_PARTITION_TYPE_APP, partition_subtype, NULL);
+    // Files queued for the same slot are concatenated into one image
+    for (size_t i = 0; i < count; i++) {
+        size_t slot_total = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (jobs[j].partition == jobs[i].partition) {
+                slot_total += jobs[j].file_size;
+            }
+        }
+        if (slot_total > jobs[i].partition->size) {
+            ESP_LOGE(TAG, "Files for %s too large for partition: %zu bytes > %zu bytes",
+                     slot_name(jobs[i].slot), slot_total, (size_t)jobs[i].partition->size);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    return ESP_OK;
+}
 
-    if (!partition) {
-        ESP_LOGE(TAG, "Target OTA partition not found (subtype: %d)", partition_subtype);
-        return ESP_ERR_NOT_FOUND;
+// Group jobs by slot in flash order; stable, so files keep their queue order
+static void order_jobs(sd_ota_job_t* jobs, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        sd_ota_job_t job = jobs[i];
+        size_t j = i;
+        while (j > 0 && jobs[j - 1].partition->address > job.partition->address) {
+            jobs[j] = jobs[j - 1];
+            j--;
+        }
+        jobs[j] = job;
     }
+}
 
-    // Get file size
-    size_t file_size;
-    ret = sd_ota_get_file_size(filename, &file_size);
+// Stream one file into the erased slot at slot_offset; chunks are written in place
+static esp_err_t stream_file(const sd_ota_job_t* job, uint32_t slot_offset,
+                             block_crc_builder_t* crc_table, int* last_percent) {
+    char filepath[256];
+    snprintf(filepath, sizeof(filepath), "%s/%s", SD_OTA_MOUNT_POINT, job->filename);
+
+    const sd_reader_config_t config = {
+        .length = job->file_size,
+        .read_ahead = SD_OTA_READ_AHEAD,
+    };
+    sd_reader_stream_t* stream;
+    esp_err_t ret = sd_reader_open(filepath, SD_READER_CLIENT_OTA, &config, &stream);
     if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open file: %s", filepath);
         return ret;
     }
 
-    ESP_LOGI(TAG, "Starting OTA flash: %s -> %s (%s at 0x%x, size: %zu bytes)",
-             filename, partition->label ? partition->label : "unknown",
-             partition_subtype == ESP_PARTITION_SUBTYPE_APP_OTA_1 ? "OTA_1" :
-             partition_subtype == ESP_PARTITION_SUBTYPE_APP_OTA_0 ? "OTA_0" :
-             partition_subtype == ESP_PARTITION_SUBTYPE_APP_OTA_2 ? "OTA_2" : "OTA_X",
-             partition->address, file_size);
+    const size_t total = g_sd_ota_state.file_size;
+    size_t done = 0;
+    while (done < job->file_size) {
+        int64_t start_us = esp_timer_get_time();
+        bool overlapped_frame = io_arbiter_display_busy();
 
-    if (file_size > partition->size) {
-        ESP_LOGE(TAG, "File too large for partition: %zu bytes > %zu bytes",
-                 file_size, partition->size);
-        return ESP_ERR_INVALID_SIZE;
-    }
+        const uint8_t* chunk;
+        size_t chunk_len;
+        ret = sd_reader_borrow(stream, &chunk, &chunk_len);
+        if (ret != ESP_OK || chunk_len == 0) {
+            ESP_LOGE(TAG, "File read error in %s at offset %zu", job->filename, done);
+            sd_reader_close(stream);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
 
-    // Initialize OTA state
-    g_sd_ota_state.filename = filename;
-    g_sd_ota_state.file_size = file_size;
-    g_sd_ota_state.target_partition = partition;
-    g_sd_ota_state.bytes_written = 0;
-    g_sd_ota_state.in_progress = true;
+        // Paced against the display and split around UI reads by flash_io
+        ret = flash_io_partition_write(FLASH_IO_PRIORITY_BULK, job->partition, slot_offset + done,
+                                       chunk, chunk_len);
+        if (ret == ESP_OK) {
+            block_crc_update(crc_table, chunk, chunk_len);
+        }
+        sd_reader_return(stream, chunk);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "OTA write error in %s at offset %zu: %s",
+                     job->filename, done, esp_err_to_name(ret));
+            sd_reader_close(stream);
+            return ret;
+        }
 
-    // Open file on SD card
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s/%s", SD_OTA_MOUNT_POINT, filename);
+        uint64_t elapsed_us = (uint64_t)(esp_timer_get_time() - start_us);
+        if (overlapped_frame || io_arbiter_display_busy()) {
+            g_throughput.bytes_display += chunk_len;
+            g_throughput.us_display += elapsed_us;
+        } else {
+            g_throughput.bytes_idle += chunk_len;
+            g_throughput.us_idle += elapsed_us;
+        }
 
-    FILE* file = fopen(filepath, "rb");
-    if (!file) {
-        ESP_LOGE(TAG, "Failed to open file: %s", filepath);
-        g_sd_ota_state.in_progress = false;
-        return ESP_ERR_NOT_FOUND;
+        done += chunk_len;
+        g_sd_ota_state.bytes_written += chunk_len;
+
+        // Progress covers the whole batch
+        int percent = (int)((uint64_t)g_sd_ota_state.bytes_written * 100 / total);
+        if (percent != *last_percent) {
+            if (percent / 10 != *last_percent / 10) {
+                ESP_LOGI(TAG, "Progress: %zu/%zu bytes (%d%%)", g_sd_ota_state.bytes_written, total, percent);
+            }
+            *last_percent = percent;
+            if (g_progress_callback) {
+                g_progress_callback((uint8_t)percent);
+            }
+        }
     }
 
-    // Prepare OTA handle
-    esp_ota_handle_t ota_handle;
-    ret = esp_ota_begin(partition, OTA_SIZE_UNKNOWN, &ota_handle);
+    sd_reader_close(stream);
+    return ESP_OK;
+}
+
+// Validate the image written to a slot, as esp_ota_end() does for a
+// session, and record the digest the validation computed
+static esp_err_t verify_slot_image(const esp_partition_t* partition, uint32_t ota_slot) {
+#ifdef __SIMULATOR_BUILD__
+    (void)ota_slot;
+    ESP_LOGD(TAG, "Image validation not available in the simulator, %s left unverified",
+             partition->label);
+    return ESP_OK;
+#else
+    const esp_partition_pos_t pos = { .offset = partition->address, .size = partition->size };
+    esp_image_metadata_t metadata = {0};
+    esp_err_t ret = esp_image_verify(ESP_IMAGE_VERIFY, &pos, &metadata);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to begin OTA operation: %s", esp_err_to_name(ret));
-        fclose(file);
-        g_sd_ota_state.in_progress = false;
-        return ret;
+        ESP_LOGE(TAG, "Image in %s failed validation: %s", partition->label, esp_err_to_name(ret));
+        return ESP_ERR_OTA_VALIDATE_FAILED;
     }
 
-    // OPTIMIZED: Try to use pre-allocated IRAM buffer first, then fall back to other strategies
-    uint8_t* buffer = NULL;
-    size_t chunk_size = 0;
-    bool is_stack_buffer = false;
-
-    // Strategy 1: Use pre-allocated IRAM buffer (if available)
-    if (g_preallocated_buffer && g_preallocated_size > 0) {
-        buffer = g_preallocated_buffer;
-        chunk_size = g_preallocated_size;
-        ESP_LOGI(TAG, "Using pre-allocated IRAM buffer (%zu bytes) - display will remain stable");
-    } else {
-        // Strategy 2: Try very small 256-byte IRAM chunks (most likely to succeed)
-        chunk_size = 256;
-        buffer = heap_caps_malloc(chunk_size, MALLOC_CAP_DMA | MALLOC_CAP_IRAM_8BIT);
-        if (buffer) {
-            ESP_LOGI(TAG, "Allocated 256-byte IRAM DMA buffer - display will remain stable");
-        } else {
-            // Strategy 3: Try 512-byte IRAM chunks
-            chunk_size = 512;
-            buffer = heap_caps_malloc(chunk_size, MALLOC_CAP_DMA | MALLOC_CAP_IRAM_8BIT);
-            if (buffer) {
-                ESP_LOGI(TAG, "Allocated 512-byte IRAM DMA buffer - display will remain stable");
-            } else {
-                // Strategy 4: Try 1KB IRAM chunks
-                chunk_size = 1024;
-                buffer = heap_caps_malloc(chunk_size, MALLOC_CAP_DMA | MALLOC_CAP_IRAM_8BIT);
-                if (buffer) {
-                    ESP_LOGI(TAG, "Allocated 1KB IRAM DMA buffer - display will remain stable");
-                } else {
-                    // Strategy 5: Use stack-allocated buffer (no heap fragmentation)
-                    static uint8_t stack_buffer[128];  // 128 bytes on stack
-                    chunk_size = 128;
-                    buffer = stack_buffer;
-                    is_stack_buffer = true;
-                    ESP_LOGW(TAG, "Using 128-byte stack buffer - minimal memory usage");
-                }
-            }
-        }
+    // Let the bootloader skip re-hashing this image on launch
+    ret = image_digest_cache_record(ota_slot, partition->address, metadata.image_len,
+                                    metadata.image_digest, metadata.image.hash_appended);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Digest not cached, bootloader will validate the image fully");
     }
+    return ESP_OK;
+#endif
+}
 
-    ESP_LOGI(TAG, "Starting optimized OTA: 32-byte SD reads, %zu-byte flash writes", chunk_size);
+// Write one claimed slot: a single erase for all of its files
+static esp_err_t write_slot(const sd_ota_job_t* jobs, size_t count, size_t job_index, size_t job_total,
+                            uint32_t ota_slot, size_t slot_total, int* last_percent) {
+    const esp_partition_t* partition = jobs[0].partition;
 
-    // IRAM buffer doesn't need cache synchronization for DMA operations
+    // Drop any cached digest before the slot is erased
+    esp_err_t ret = image_digest_cache_invalidate(ota_slot, partition->address);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
-    uint32_t chunk_count = 0;
+    // Erase only what the image needs, in flash_io steps, skipping extents
+    // the background pre-erase already blanked. No OTA session is opened:
+    // esp_ota_write_with_offset() requires a session that erased the whole
+    // slot itself, so the files are written as plain partition writes.
+    ret = ota_preerase_erase(ota_slot, partition->address, slot_total);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase %s: %s", slot_name(jobs[0].slot), esp_err_to_name(ret));
+        return ret;
+    }
 
-    // MEMORY-ISOLATED: Use PSRAM for OTA operations while display uses IRAM
-    ESP_LOGI(TAG, "Starting PSRAM-isolated OTA: Moving OTA to PSRAM, display to IRAM");
+    // Per-block CRCs for later block-level verify and repair of the slot
+    block_crc_builder_t crc_table;
+    if (block_crc_begin(&crc_table, ota_slot, partition->address) != ESP_OK) {
+        ESP_LOGW(TAG, "No block CRC table for %s", slot_name(jobs[0].slot));
+    }
 
-    // EXPLICITLY use PSRAM for OTA operations to avoid display contention
-    size_t psram_buffer_size = 4096;  // 4KB PSRAM buffer for efficient transfers
+    uint32_t slot_offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        strcpy(g_current_file, jobs[i].filename);
+        g_sd_ota_state.target_partition = partition;
 
-    // Force allocation from EXTERNAL memory (PSRAM) - NOT internal IRAM
-    uint8_t* psram_buffer = heap_caps_malloc(psram_buffer_size,
-                                           MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+        if (job_total > 1 && g_status_callback) {
+            char status[96];
+            snprintf(status, sizeof(status), "Flashing %s (%zu/%zu)...",
+                     jobs[i].filename, job_index + i + 1, job_total);
+            g_status_callback(status);
+        }
 
-    if (!psram_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate PSRAM buffer, trying fallback");
-        // Use smaller chunk size for fallback
-        psram_buffer_size = 512;
-        psram_buffer = malloc(psram_buffer_size);  // Use standard malloc
-        if (!psram_buffer) {
-            ESP_LOGE(TAG, "Failed to allocate any OTA buffer");
-            esp_ota_abort(ota_handle);
-            fclose(file);
-            g_sd_ota_state.in_progress = false;
-            return ESP_ERR_NO_MEM;
+        ret = stream_file(&jobs[i], slot_offset, &crc_table, last_percent);
+        if (ret != ESP_OK) {
+            block_crc_finish(&crc_table, false);
+            return ret;
         }
-        ESP_LOGW(TAG, "Using small fallback buffer - display may still flicker");
-    } else {
-        ESP_LOGI(TAG, "Allocated %zu-byte PSRAM buffer for OTA operations", psram_buffer_size);
-        ESP_LOGI(TAG, "Display runs from IRAM, OTA runs from PSRAM - complete memory isolation");
+        slot_offset += jobs[i].file_size;
     }
 
-    // MAXIMUM THROTTLING: Use extremely small chunks for zero display interference
-    size_t psram_chunk_size;
-    if (psram_buffer_size >= 4096) {
-        psram_chunk_size = 128;   // MAXIMUM: Extremely small chunks for complete display stability
-    } else {
-        psram_chunk_size = 16;    // MAXIMUM: Tiny fallback chunks for absolute minimum interference
+    ret = verify_slot_image(partition, ota_slot);
+    block_crc_finish(&crc_table, ret == ESP_OK);
+    if (ret != ESP_OK) {
+        return ret;
     }
-    size_t psram_buffer_pos = 0;
 
-    ESP_LOGI(TAG, "MAXIMUM THROTTLING: Using %zu-byte chunks with %zu-byte buffer", psram_chunk_size, psram_buffer_size);
-
-    // MAXIMUM VDMA PROTECTION: Extreme display protection for SD card operations
-    uint32_t display_yield_counter = 0;
-    const uint32_t display_yield_interval = 2;  // MAXIMUM: Yield every 2 chunks (was 8) for absolute safety
+    ESP_LOGI(TAG, "OTA flash completed successfully: %zu bytes written to %s",
+             slot_total, partition->label ? partition->label : "unknown");
+    return ESP_OK;
+}
 
-    while (g_sd_ota_state.bytes_written < file_size) {
-        // ENHANCED VDMA: Check if display is currently protected
-        if (vdma_is_display_protected()) {
-            // Display is currently rendering, wait for protection to be disabled
-            vTaskDelay(pdMS_TO_TICKS(5));  // Short wait for display to complete
-        }
+// Flash one slot, holding it against the background pre-erase meanwhile
+static esp_err_t flash_slot(const sd_ota_job_t* jobs, size_t count, size_t job_index, size_t job_total,
+                            int* last_percent) {
+    const esp_partition_t* partition = jobs[0].partition;
+    size_t slot_total = 0;
+    for (size_t i = 0; i < count; i++) {
+        slot_total += jobs[i].file_size;
+    }
 
-        // AGGRESSIVE: VDMA coordination before every major PSRAM operation
-        if (display_yield_counter % display_yield_interval == 0) {
-            // Ensure display refresh completes before intensive SD card operations
-            vdma_ensure_display_refresh(25);  // AGGRESSIVE: Ensure 25ms (was 16ms) for display refresh
-            vTaskDelay(pdMS_TO_TICKS(5));     // AGGRESSIVE: Additional 5ms pause for display stability
-            ESP_LOGD(TAG, "AGGRESSIVE VDMA: Extended display refresh before PSRAM operations");
-        }
+    ESP_LOGI(TAG, "Starting OTA flash: %zu file(s) -> %s (%s at 0x%x, size: %zu bytes)",
+             count, partition->label ? partition->label : "unknown", slot_name(jobs[0].slot),
+             partition->address, slot_total);
 
-        // Fill PSRAM buffer with data from SD card - VDMA-coordinated operations
-        while (psram_buffer_pos < psram_buffer_size && g_sd_ota_state.bytes_written < file_size) {
-            size_t bytes_to_read = psram_chunk_size;
-            size_t remaining = file_size - g_sd_ota_state.bytes_written;
-            if (bytes_to_read > remaining) {
-                bytes_to_read = remaining;
-            }
+    const uint32_t ota_slot = partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN;
+    esp_err_t ret = ota_preerase_claim(ota_slot, partition->address, partition->size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = write_slot(jobs, count, job_index, job_total, ota_slot, slot_total, last_percent);
+    ota_preerase_release(ota_slot, slot_total);
+    return ret;
+}
 
-            // ENHANCED VDMA: Coordinate SD card read with display protection
-            // Brief micro-yield before SD card operation to allow display DMA access
-            taskYIELD();
-
-            size_t bytes_read = fread(psram_buffer + psram_buffer_pos, 1, bytes_to_read, file);
-            if (bytes_read != bytes_to_read) {
-                ESP_LOGE(TAG, "File read error: expected %zu, got %zu", bytes_to_read, bytes_read);
-                heap_caps_free(psram_buffer);
-                if (buffer && !is_stack_buffer && buffer != g_preallocated_buffer) {
-                    heap_caps_free(buffer);
-                }
-                esp_ota_abort(ota_handle);
-                fclose(file);
-                g_sd_ota_state.in_progress = false;
-                return ESP_ERR_INVALID_RESPONSE;
-            }
+// Validate, order and flash a batch
+static esp_err_t run_jobs(sd_ota_job_t* jobs, size_t count) {
+    if (!g_sd_card_mounted) {
+        ESP_LOGE(TAG, "SD card not mounted");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
 
-            psram_buffer_pos += bytes_read;
-            g_sd_ota_state.bytes_written += bytes_read;
-            chunk_count++;
-            display_yield_counter++;
+    esp_err_t ret = validate_jobs(jobs, count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    order_jobs(jobs, count);
 
-            // CRITICAL: Micro-yield between small operations to prevent display blocking
-            if (display_yield_counter % 2 == 0) {
-                taskYIELD();  // Give display controller micro-time slices
-            }
-        }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += jobs[i].file_size;
+    }
 
-        // Write accumulated PSRAM buffer to flash in one operation
-        ret = esp_ota_write(ota_handle, psram_buffer, psram_buffer_pos);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "OTA write error at offset %zu: %s",
-                     g_sd_ota_state.bytes_written - psram_buffer_pos, esp_err_to_name(ret));
-            heap_caps_free(psram_buffer);
-            if (buffer && !is_stack_buffer && buffer != g_preallocated_buffer) {
-                heap_caps_free(buffer);
-            }
-            esp_ota_abort(ota_handle);
-            fclose(file);
-            g_sd_ota_state.in_progress = false;
-            return ret;
-        }
+    // Every file streams through the SD reader's shared buffer pool
+    sd_reader_stats_t reader;
+    sd_reader_get_stats(&reader);
 
-        // Reset buffer position for next chunk
-        psram_buffer_pos = 0;
+    memset(&g_throughput, 0, sizeof(g_throughput));
+    g_throughput.buffer_size = reader.buffer_size;
+    g_throughput.cluster_size = reader.cluster_size;
 
-        // Update progress every ~64KB processed (less frequent UI updates)
-        if (chunk_count % 64 == 0) {
-            float progress_percent = (float)g_sd_ota_state.bytes_written * 100.0f / file_size;
-            ESP_LOGI(TAG, "Progress: %zu/%zu bytes (%.1f%%)", g_sd_ota_state.bytes_written, file_size, progress_percent);
+    strcpy(g_current_file, jobs[0].filename);
+    g_sd_ota_state.filename = g_current_file;
+    g_sd_ota_state.file_size = total;
+    g_sd_ota_state.target_partition = jobs[0].partition;
+    g_sd_ota_state.bytes_written = 0;
+    g_sd_ota_state.in_progress = true;
 
-            // Call progress callback if set
-            if (g_progress_callback) {
-                g_progress_callback((uint8_t)progress_percent);
-            }
-        }
+    ESP_LOGI(TAG, "Flashing %zu file(s), %zu bytes", count, total);
 
-        // Optional: Small delay every few chunks to ensure LVGL gets CPU time
-        if (chunk_count % 16 == 0) {
-            vTaskDelay(pdMS_TO_TICKS(1));
+    const uint64_t skipped_before = flash_io_pages_skipped_total();
+    int last_percent = -1;
+    for (size_t first = 0; first < count && ret == ESP_OK; ) {
+        size_t last = first + 1;
+        while (last < count && jobs[last].partition == jobs[first].partition) {
+            last++;
         }
+        ret = flash_slot(&jobs[first], last - first, first, count, &last_percent);
+        first = last;
     }
 
-    // Clean up buffer (use appropriate free function based on allocation)
-    if (psram_buffer_size >= 4096) {
-        heap_caps_free(psram_buffer);  // Was allocated with heap_caps_malloc (PSRAM)
-    } else {
-        free(psram_buffer);  // Was allocated with malloc (fallback)
+    g_throughput.pages_skipped = (uint32_t)(flash_io_pages_skipped_total() - skipped_before);
+    sd_ota_log_throughput();
+    g_sd_ota_state.in_progress = false;
+    return ret;
+}
+
+esp_err_t sd_ota_enqueue(const char* filename, esp_partition_subtype_t slot) {
+    esp_err_t ret = check_job_args(filename, slot);
+    if (ret != ESP_OK) {
+        return ret;
     }
+    if (g_queue_len >= SD_OTA_QUEUE_MAX) {
+        ESP_LOGE(TAG, "OTA queue full (%d entries)", SD_OTA_QUEUE_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+
+    sd_ota_job_t* job = &g_queue[g_queue_len++];
+    memset(job, 0, sizeof(*job));
+    strcpy(job->filename, filename);
+    job->slot = slot;
+
+    ESP_LOGI(TAG, "Queued %s -> %s", filename, slot_name(slot));
+    return ESP_OK;
+}
 
-    // Clean up buffer (only free if heap-allocated)
-    if (buffer && !is_stack_buffer && buffer != g_preallocated_buffer) {
-        heap_caps_free(buffer);
+esp_err_t sd_ota_run_queue(void) {
+    esp_err_t ret = run_jobs(g_queue, g_queue_len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA queue failed: %s", esp_err_to_name(ret));
     }
+    g_queue_len = 0;
+    return ret;
+}
 
-    fclose(file);
+void sd_ota_clear_queue(void) {
+    g_queue_len = 0;
+}
 
-    // Finalize OTA
-    ret = esp_ota_end(ota_handle);
+esp_err_t sd_ota_flash_file(const char* filename, esp_partition_subtype_t partition_subtype) {
+    esp_err_t ret = check_job_args(filename, partition_subtype);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to finalize OTA: %s", esp_err_to_name(ret));
-        g_sd_ota_state.in_progress = false;
         return ret;
     }
 
-    ESP_LOGI(TAG, "OTA flash completed successfully: %zu bytes written to %s",
-             g_sd_ota_state.bytes_written, partition->label ? partition->label : "unknown");
+    sd_ota_job_t job = { .slot = partition_subtype };
+    strcpy(job.filename, filename);
 
-    // Set boot partition using RTC register for one-time boot (like other demos)
-    ESP_LOGI(TAG, "Setting RTC boot request for partition type 2 (OTA_1)...");
-
-    // Write boot request to RTC register for bootloader to read
-    // OTA_1 = partition_type 2 (matches bootloader_custom.c partition mapping)
-    uint32_t rtc_value = BOOT_REQUEST_MAGIC_RTC | (2 << 24);
-    REG_WRITE(BOOT_REQUEST_RTC_REG, rtc_value);
+    ret = run_jobs(&job, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
-    ESP_LOGI(TAG, "RTC register updated: 0x%08x, system will boot from OTA_1 after restart", rtc_value);
+    // One-time boot request for the freshly flashed image
+    // Partition type: 1 = OTA_0, 2 = OTA_1 (matches bootloader_custom.c partition mapping)
+    uint32_t partition_type = job.partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 1;
+    ESP_LOGI(TAG, "Setting boot request for partition type %" PRIu32 "...", partition_type);
+    boot_request_set(partition_type, false);
 
-    g_sd_ota_state.in_progress = false;
     ESP_LOGI(TAG, "Boot partition set successfully. System ready to boot from %s",
-             partition->label ? partition->label : "unknown");
+             job.partition->label ? job.partition->label : "unknown");
 
     return ESP_OK;
 }
@@ -457,6 +601,12 @@ sd_ota_state_t sd_ota_get_state(void) {
     return g_sd_ota_state;
 }
 
+void sd_ota_get_throughput(sd_ota_throughput_t* throughput) {
+    if (throughput) {
+        *throughput = g_throughput;
+    }
+}
+
 void sd_ota_cleanup(void) {
     if (g_sd_card_mounted) {
         // Use BSP unmount function
@@ -471,14 +621,6 @@ void sd_ota_cleanup(void) {
         g_sd_card = NULL;
     }
 
-    // Clean up pre-allocated buffer
-    if (g_preallocated_buffer) {
-        heap_caps_free(g_preallocated_buffer);
-        g_preallocated_buffer = NULL;
-        g_preallocated_size = 0;
-        ESP_LOGI(TAG, "Cleaned up pre-allocated IRAM buffer");
-    }
-
     // Reset OTA state
     memset(&g_sd_ota_state, 0, sizeof(g_sd_ota_state));
 }
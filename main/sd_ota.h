@@ -10,15 +10,33 @@
 #define SD_OTA_MOUNT_POINT "/sdcard"
 #define SD_OTA_FILENAME "ota1.bin"
 #define SD_OTA_MAX_FILE_SIZE (8 * 1024 * 1024)  // 8MB maximum
+#define SD_OTA_QUEUE_MAX 8     // Files per batch
+#define SD_OTA_NAME_MAX  64    // File name length, including the terminator
 
 typedef struct {
-    const char* filename;
-    size_t file_size;
+    const char* filename;       // File being written
+    size_t file_size;           // Bytes in the whole batch
     const esp_partition_t* target_partition;
-    size_t bytes_written;
+    size_t bytes_written;       // Bytes of the batch written so far
     bool in_progress;
 } sd_ota_state_t;
 
+/**
+ * @brief Throughput of the last SD OTA transfer
+ *
+ * Transfers that overlapped a display frame are counted apart from those
+ * that ran while the display was idle.
+ */
+typedef struct {
+    uint32_t buffer_size;    // Bytes per read/write
+    uint32_t cluster_size;   // FAT cluster size, 0 if unknown
+    uint64_t bytes_display;  // Moved while a frame was in flight
+    uint64_t us_display;
+    uint64_t bytes_idle;     // Moved while the display was idle
+    uint64_t us_idle;
+    uint32_t pages_skipped;  // All-0xFF pages left erased instead of programmed
+} sd_ota_throughput_t;
+
 /**
  * @brief Initialize SD card and mount filesystem
  * @return ESP_OK on success
@@ -44,16 +62,52 @@ esp_err_t sd_ota_get_file_size(const char* filename, size_t* file_size);
  * @brief Flash OTA file from SD card to target partition
  * @param filename Name of the file to flash (e.g., "ota1.bin")
  * @param partition_subtype Target OTA partition subtype (ESP_PARTITION_SUBTYPE_APP_OTA_1, etc.)
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a bad name or slot
  */
 esp_err_t sd_ota_flash_file(const char* filename, esp_partition_subtype_t partition_subtype);
 
+/**
+ * @brief Queue a file for the next sd_ota_run_queue()
+ *
+ * Several files may target the same slot; they are written back to back
+ * into one image, in the order they were queued.
+ *
+ * @param filename File name on the SD card (e.g., "ota0.bin")
+ * @param slot Target OTA partition subtype
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a bad name or slot,
+ *         ESP_ERR_NO_MEM when SD_OTA_QUEUE_MAX files are already queued
+ */
+esp_err_t sd_ota_enqueue(const char* filename, esp_partition_subtype_t slot);
+
+/**
+ * @brief Flash all queued files, then empty the queue
+ *
+ * Every file and slot is checked before any flash is erased. Slots are
+ * flashed in address order, each with a single erase and OTA session, and
+ * one transfer buffer serves the whole batch. The progress callback gets
+ * the percentage of all queued bytes. No boot request is set.
+ *
+ * @return ESP_OK on success; on failure the slot being written is left invalid
+ */
+esp_err_t sd_ota_run_queue(void);
+
+/**
+ * @brief Drop all queued files without flashing
+ */
+void sd_ota_clear_queue(void);
+
 /**
  * @brief Get OTA state for progress tracking
  * @return Current OTA state
  */
 sd_ota_state_t sd_ota_get_state(void);
 
+/**
+ * @brief Get the throughput of the last SD OTA transfer
+ * @param throughput Output counters
+ */
+void sd_ota_get_throughput(sd_ota_throughput_t* throughput);
+
 /**
  * @brief Start SD Card OTA process for ota1.bin
  * @return ESP_OK on success, error code otherwise
@@ -0,0 +1,471 @@
+/**
+ * @file sd_reader.c
+ * @brief Shared asynchronous SD card reader with read-ahead
+ */
+
+#include "sd_reader.h"
+#include "io_arbiter.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char* TAG = "sd_reader";
+
+static const char* const client_names[SD_READER_CLIENT_COUNT] = {
+    "crc",
+    "fast_crc",
+    "flasher",
+    "ota",
+};
+
+// One chunk to read, queued to the reader task
+typedef struct {
+    sd_reader_stream_t* stream;
+    uint8_t* buf;
+    uint32_t len;
+} read_request_t;
+
+// One chunk read, queued back to the stream
+typedef struct {
+    uint8_t* buf;
+    uint32_t len;
+    esp_err_t err;
+} read_result_t;
+
+struct sd_reader_stream {
+    FILE* file;
+    sd_reader_client_t client;
+    uint32_t length;
+    uint32_t chunk_size;
+    uint32_t requested;       // Bytes queued for reading so far
+    uint32_t in_flight;       // Chunks queued but not yet borrowed
+    volatile bool closing;    // Reader task skips the remaining reads
+    volatile bool failed;
+    QueueHandle_t ready;      // read_result_t, in file order
+    uint32_t buffer_count;
+    uint8_t* buffers[SD_READER_POOL_BUFFERS];  // Owned until close
+};
+
+static SemaphoreHandle_t g_stats_mutex = NULL;
+static QueueHandle_t g_pool = NULL;      // Free buffers (uint8_t*)
+static QueueHandle_t g_requests = NULL;  // read_request_t
+static bool g_started = false;
+
+static uint32_t g_buffer_size = 0;
+static uint32_t g_buffers = 0;
+static uint32_t g_cluster_size = 0;
+static uint32_t g_min_free = 0;
+static sd_reader_client_stats_t g_clients[SD_READER_CLIENT_COUNT];
+
+// Fails until sd_reader_init() has created the mutex
+static bool stats_lock(void)
+{
+    return g_stats_mutex && xSemaphoreTake(g_stats_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void stats_unlock(void)
+{
+    xSemaphoreGive(g_stats_mutex);
+}
+
+static void reader_task(void* arg)
+{
+    (void)arg;
+    read_request_t req;
+
+    while (1) {
+        if (xQueueReceive(g_requests, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        sd_reader_stream_t* stream = req.stream;
+        read_result_t result = { .buf = req.buf, .len = 0, .err = ESP_ERR_INVALID_STATE };
+
+        if (!stream->closing && !stream->failed) {
+            // Display-safe pacing happens here, once for every consumer
+            io_arbiter_acquire(IO_CLIENT_SD_READ, req.len);
+
+            int64_t start = esp_timer_get_time();
+            size_t bytes_read = fread(req.buf, 1, req.len, stream->file);
+            uint32_t read_us = (uint32_t)(esp_timer_get_time() - start);
+
+            result.len = (uint32_t)bytes_read;
+            result.err = ESP_OK;
+            if (bytes_read != req.len) {
+                ESP_LOGE(TAG, "Short read: expected %" PRIu32 ", got %zu", req.len, bytes_read);
+                result.err = ESP_ERR_INVALID_RESPONSE;
+                stream->failed = true;
+            }
+
+            if (stats_lock()) {
+                sd_reader_client_stats_t* c = &g_clients[stream->client];
+                c->reads++;
+                c->bytes += bytes_read;
+                c->read_us_total += read_us;
+                if (read_us > c->read_us_max) {
+                    c->read_us_max = read_us;
+                }
+                stats_unlock();
+            }
+        }
+
+        // The ready queue holds every buffer the stream owns, so this never blocks
+        xQueueSend(stream->ready, &result, portMAX_DELAY);
+    }
+}
+
+// Largest pool that fits; buffers are halved down to the minimum if memory is short
+static bool allocate_pool(void)
+{
+    for (uint32_t size = SD_READER_BUFFER_SIZE; size >= SD_READER_BUFFER_MIN; size /= 2) {
+        uint32_t count = 0;
+        for (; count < SD_READER_POOL_BUFFERS; count++) {
+            // PSRAM keeps internal RAM for the display; fall back to internal DMA memory
+            uint8_t* buf = heap_caps_aligned_alloc(SD_READER_BUFFER_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+            if (!buf) {
+                buf = heap_caps_aligned_alloc(SD_READER_BUFFER_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+            }
+            if (!buf) {
+                break;
+            }
+            xQueueSend(g_pool, &buf, 0);
+        }
+
+        // Half a pool of large buffers beats a full pool of small ones
+        if (count >= SD_READER_POOL_BUFFERS / 2) {
+            g_buffer_size = size;
+            g_buffers = count;
+            g_min_free = count;
+            return true;
+        }
+
+        uint8_t* buf;
+        while (xQueueReceive(g_pool, &buf, 0) == pdTRUE) {
+            heap_caps_free(buf);
+        }
+        ESP_LOGW(TAG, "No DMA memory for %d x %" PRIu32 "-byte buffers", SD_READER_POOL_BUFFERS, size);
+    }
+    return false;
+}
+
+esp_err_t sd_reader_init(void)
+{
+    if (g_started) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (!g_stats_mutex) {
+        g_stats_mutex = xSemaphoreCreateMutex();
+    }
+    g_pool = xQueueCreate(SD_READER_POOL_BUFFERS, sizeof(uint8_t*));
+    g_requests = xQueueCreate(SD_READER_POOL_BUFFERS, sizeof(read_request_t));
+    if (!g_stats_mutex || !g_pool || !g_requests) {
+        ESP_LOGE(TAG, "Failed to create reader queues");
+    } else if (!allocate_pool()) {
+        ESP_LOGE(TAG, "Failed to allocate buffer pool");
+    } else if (xTaskCreatePinnedToCore(reader_task, "sd_reader", 4096, NULL,
+                                       configMAX_PRIORITIES - 3, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create reader task");
+    } else {
+        g_started = true;
+        ret = ESP_OK;
+        ESP_LOGI(TAG, "SD reader ready: %" PRIu32 " x %" PRIu32 "-byte buffers", g_buffers, g_buffer_size);
+    }
+
+    if (ret != ESP_OK) {
+        if (g_pool) {
+            uint8_t* buf;
+            while (xQueueReceive(g_pool, &buf, 0) == pdTRUE) {
+                heap_caps_free(buf);
+            }
+            vQueueDelete(g_pool);
+            g_pool = NULL;
+        }
+        if (g_requests) {
+            vQueueDelete(g_requests);
+            g_requests = NULL;
+        }
+    }
+    return ret;
+}
+
+void sd_reader_set_cluster_size(uint32_t cluster_size)
+{
+    g_cluster_size = cluster_size;
+}
+
+// Caller is the stream's consumer
+static void queue_next(sd_reader_stream_t* stream, uint8_t* buf)
+{
+    uint32_t len = stream->length - stream->requested;
+    if (len > stream->chunk_size) {
+        len = stream->chunk_size;
+    }
+
+    read_request_t req = { .stream = stream, .buf = buf, .len = len };
+    stream->requested += len;
+    stream->in_flight++;
+    xQueueSend(g_requests, &req, portMAX_DELAY);
+}
+
+static uint32_t stream_chunk_size(const sd_reader_config_t* config)
+{
+    uint32_t chunk = config->chunk_size ? config->chunk_size : g_buffer_size;
+    if (chunk > g_buffer_size) {
+        chunk = g_buffer_size;
+    }
+    // Whole clusters let FATFS read straight into the buffer
+    if (g_cluster_size > 0 && chunk >= g_cluster_size) {
+        chunk -= chunk % g_cluster_size;
+    }
+    return chunk;
+}
+
+esp_err_t sd_reader_open(const char* path, sd_reader_client_t client,
+                         const sd_reader_config_t* config, sd_reader_stream_t** out_stream)
+{
+    if (!path || client >= SD_READER_CLIENT_COUNT || !out_stream) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_stream = NULL;
+    if (!g_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const sd_reader_config_t defaults = {0};
+    if (!config) {
+        config = &defaults;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Pool buffers are large already; stdio buffering would only add a copy
+    setvbuf(file, NULL, _IONBF, 0);
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    if (file_size < 0 || config->offset > (uint32_t)file_size ||
+        config->length > (uint32_t)file_size - config->offset) {
+        ESP_LOGE(TAG, "Range %" PRIu32 "+%" PRIu32 " outside %s (%ld bytes)",
+                 config->offset, config->length, path, file_size);
+        fclose(file);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    fseek(file, (long)config->offset, SEEK_SET);
+
+    sd_reader_stream_t* stream = calloc(1, sizeof(sd_reader_stream_t));
+    uint32_t depth = config->read_ahead ? config->read_ahead : SD_READER_DEFAULT_DEPTH;
+    if (depth > g_buffers) {
+        depth = g_buffers;
+    }
+    if (stream) {
+        stream->ready = xQueueCreate(depth, sizeof(read_result_t));
+    }
+    if (!stream || !stream->ready) {
+        free(stream);
+        fclose(file);
+        return ESP_ERR_NO_MEM;
+    }
+
+    stream->file = file;
+    stream->client = client;
+    stream->length = config->length ? config->length : (uint32_t)file_size - config->offset;
+    stream->chunk_size = stream_chunk_size(config);
+
+    uint32_t chunks = (stream->length + stream->chunk_size - 1) / stream->chunk_size;
+    if (depth > chunks) {
+        depth = chunks;
+    }
+
+    // Wait for one buffer; take more only if they are free right now
+    for (uint32_t i = 0; i < depth; i++) {
+        uint8_t* buf;
+        if (xQueueReceive(g_pool, &buf, i == 0 ? portMAX_DELAY : 0) != pdTRUE) {
+            break;
+        }
+        stream->buffers[stream->buffer_count++] = buf;
+    }
+
+    if (stats_lock()) {
+        g_clients[client].streams++;
+        uint32_t free_buffers = uxQueueMessagesWaiting(g_pool);
+        if (free_buffers < g_min_free) {
+            g_min_free = free_buffers;
+        }
+        stats_unlock();
+    }
+
+    for (uint32_t i = 0; i < stream->buffer_count; i++) {
+        queue_next(stream, stream->buffers[i]);
+    }
+
+    *out_stream = stream;
+    return ESP_OK;
+}
+
+uint32_t sd_reader_length(const sd_reader_stream_t* stream)
+{
+    return stream ? stream->length : 0;
+}
+
+esp_err_t sd_reader_borrow(sd_reader_stream_t* stream, const uint8_t** data, size_t* size)
+{
+    if (!stream || !data || !size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *data = NULL;
+    *size = 0;
+
+    if (stream->in_flight == 0) {
+        if (stream->failed) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        // Every buffer of the stream is borrowed; nothing can arrive
+        return stream->requested < stream->length ? ESP_ERR_INVALID_STATE : ESP_OK;
+    }
+
+    // An empty queue means the read-ahead did not keep up
+    bool stalled = uxQueueMessagesWaiting(stream->ready) == 0;
+    int64_t start = stalled ? esp_timer_get_time() : 0;
+
+    read_result_t result;
+    xQueueReceive(stream->ready, &result, portMAX_DELAY);
+    stream->in_flight--;
+
+    if (stalled && stats_lock()) {
+        uint32_t stall_us = (uint32_t)(esp_timer_get_time() - start);
+        sd_reader_client_stats_t* c = &g_clients[stream->client];
+        c->stalls++;
+        c->stall_us_total += stall_us;
+        if (stall_us > c->stall_us_max) {
+            c->stall_us_max = stall_us;
+        }
+        stats_unlock();
+    }
+
+    if (result.err != ESP_OK) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *data = result.buf;
+    *size = result.len;
+    return ESP_OK;
+}
+
+void sd_reader_return(sd_reader_stream_t* stream, const uint8_t* data)
+{
+    if (!stream || !data) {
+        return;
+    }
+    // The buffer stays with the stream until close; reuse it for the next chunk
+    if (!stream->closing && !stream->failed && stream->requested < stream->length) {
+        queue_next(stream, (uint8_t*)data);
+    }
+}
+
+void sd_reader_close(sd_reader_stream_t* stream)
+{
+    if (!stream) {
+        return;
+    }
+
+    // Reads not yet started are skipped; wait for the one in progress, if any
+    stream->closing = true;
+    read_result_t result;
+    while (stream->in_flight > 0) {
+        xQueueReceive(stream->ready, &result, portMAX_DELAY);
+        stream->in_flight--;
+    }
+
+    for (uint32_t i = 0; i < stream->buffer_count; i++) {
+        xQueueSend(g_pool, &stream->buffers[i], portMAX_DELAY);
+    }
+
+    fclose(stream->file);
+    vQueueDelete(stream->ready);
+    free(stream);
+}
+
+void sd_reader_get_stats(sd_reader_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!stats_lock()) {
+        return;
+    }
+    stats->buffer_size = g_buffer_size;
+    stats->buffers = g_buffers;
+    stats->buffers_min_free = g_min_free;
+    stats->cluster_size = g_cluster_size;
+    memcpy(stats->clients, g_clients, sizeof(stats->clients));
+    stats_unlock();
+}
+
+void sd_reader_format_stats(char* buf, size_t size)
+{
+    sd_reader_stats_t stats;
+    sd_reader_get_stats(&stats);
+
+    if (!buf || size == 0) {
+        return;
+    }
+
+    size_t used = snprintf(buf, size,
+                           "SD reader (%" PRIu32 " x %" PRIu32 " KiB, min free %" PRIu32 ")\n",
+                           stats.buffers, stats.buffer_size / 1024, stats.buffers_min_free);
+
+    for (int i = 0; i < SD_READER_CLIENT_COUNT && used < size; i++) {
+        const sd_reader_client_stats_t* c = &stats.clients[i];
+        uint32_t kib_s = c->read_us_total ? (uint32_t)(c->bytes * 1000000 / 1024 / c->read_us_total) : 0;
+        used += snprintf(buf + used, size - used,
+                         "  %-9s %9" PRIu64 " KiB, %" PRIu32 " KiB/s, %" PRIu32 " stalls\n",
+                         client_names[i], c->bytes / 1024, kib_s, c->stalls);
+    }
+}
+
+void sd_reader_log_stats(void)
+{
+    sd_reader_stats_t stats;
+    sd_reader_get_stats(&stats);
+
+    char line[768];
+    size_t used = snprintf(line, sizeof(line),
+                           "SD_READER_STATS buffers=%" PRIu32 " buffer_size=%" PRIu32 " min_free=%" PRIu32,
+                           stats.buffers, stats.buffer_size, stats.buffers_min_free);
+
+    for (int i = 0; i < SD_READER_CLIENT_COUNT && used < sizeof(line); i++) {
+        const sd_reader_client_stats_t* c = &stats.clients[i];
+        uint32_t read_us_avg = c->reads ? (uint32_t)(c->read_us_total / c->reads) : 0;
+        uint32_t stall_us_avg = c->stalls ? (uint32_t)(c->stall_us_total / c->stalls) : 0;
+        used += snprintf(line + used, sizeof(line) - used,
+                         " %s_streams=%" PRIu32 " %s_reads=%" PRIu32 " %s_bytes=%" PRIu64
+                         " %s_read_us_avg=%" PRIu32 " %s_read_us_max=%" PRIu32
+                         " %s_stalls=%" PRIu32 " %s_stall_us_avg=%" PRIu32 " %s_stall_us_max=%" PRIu32,
+                         client_names[i], c->streams, client_names[i], c->reads, client_names[i], c->bytes,
+                         client_names[i], read_us_avg, client_names[i], c->read_us_max,
+                         client_names[i], c->stalls, client_names[i], stall_us_avg, client_names[i], c->stall_us_max);
+    }
+
+    ESP_LOGI(TAG, "%s", line);
+
+    if (stats_lock()) {
+        memset(g_clients, 0, sizeof(g_clients));
+        g_min_free = g_pool ? uxQueueMessagesWaiting(g_pool) : 0;
+        stats_unlock();
+    }
+}
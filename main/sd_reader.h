@@ -0,0 +1,175 @@
+/**
+ * @file sd_reader.h
+ * @brief Shared asynchronous SD card reader with read-ahead
+ *
+ * All bulk SD reads (image CRCs, the firmware flasher and SD OTA) go through
+ * one reader task. A consumer opens a stream over a byte range of a file;
+ * the task keeps up to `read_ahead` chunks of it in flight, each read
+ * straight into a buffer from a shared pool of cache-line-aligned,
+ * DMA-capable buffers. The consumer borrows filled buffers in file order,
+ * works on them in place and returns them, which queues the next read.
+ * Bandwidth against the display is requested from io_arbiter by the task,
+ * so consumers never pace themselves.
+ */
+
+#ifndef SD_READER_H
+#define SD_READER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_READER_POOL_BUFFERS  8            // Buffers shared by all streams
+#define SD_READER_BUFFER_SIZE   (32 * 1024)  // Largest chunk; trimmed to whole FAT clusters
+#define SD_READER_BUFFER_MIN    (16 * 1024)  // Smallest buffer accepted when memory is short
+#define SD_READER_BUFFER_ALIGN  128          // Covers the L1/L2 cache line
+#define SD_READER_DEFAULT_DEPTH 2            // Chunks in flight per stream
+
+/**
+ * @brief Consumers, counted separately
+ */
+typedef enum {
+    SD_READER_CLIENT_CRC = 0,   // Full-file CRC (firmware_calculate_crc32)
+    SD_READER_CLIENT_FAST_CRC,  // Sampled CRC of the storage scan
+    SD_READER_CLIENT_FLASHER,   // Firmware flasher
+    SD_READER_CLIENT_OTA,       // SD OTA
+    SD_READER_CLIENT_COUNT
+} sd_reader_client_t;
+
+/**
+ * @brief Open stream
+ */
+typedef struct sd_reader_stream sd_reader_stream_t;
+
+/**
+ * @brief Range and read-ahead of a stream
+ */
+typedef struct {
+    uint32_t offset;      // First byte to read
+    uint32_t length;      // Bytes to read; 0 reads to the end of the file
+    uint32_t chunk_size;  // Bytes per buffer; 0 uses the pool buffer size
+    uint32_t read_ahead;  // Chunks in flight; 0 uses SD_READER_DEFAULT_DEPTH
+} sd_reader_config_t;
+
+/**
+ * @brief Counters of one consumer
+ */
+typedef struct {
+    uint32_t streams;       // Streams opened
+    uint32_t reads;         // Chunks read
+    uint64_t bytes;         // Bytes read
+    uint64_t read_us_total; // Time spent in fread
+    uint32_t read_us_max;
+    uint32_t stalls;        // Borrows that found no chunk ready
+    uint64_t stall_us_total;
+    uint32_t stall_us_max;
+} sd_reader_client_stats_t;
+
+/**
+ * @brief Reader counters since start-up or the last reset
+ */
+typedef struct {
+    uint32_t buffer_size;       // Size of each pool buffer
+    uint32_t buffers;           // Buffers in the pool
+    uint32_t buffers_min_free;  // Fewest buffers left in the pool
+    uint32_t cluster_size;      // FAT cluster size chunks are trimmed to, 0 if unknown
+    sd_reader_client_stats_t clients[SD_READER_CLIENT_COUNT];
+} sd_reader_stats_t;
+
+/**
+ * @brief Allocate the buffer pool and start the reader task
+ *
+ * Call once before any task that reads firmware files runs; later calls are
+ * no-ops. Streams cannot be opened until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the pool or task cannot be created
+ */
+esp_err_t sd_reader_init(void);
+
+/**
+ * @brief Set the FAT cluster size of the card; chunks become whole clusters
+ * @param cluster_size Cluster size in bytes, 0 if unknown
+ */
+void sd_reader_set_cluster_size(uint32_t cluster_size);
+
+/**
+ * @brief Open a stream and start reading ahead
+ *
+ * Blocks until at least one pool buffer is free.
+ *
+ * @param path Full file path
+ * @param client Consumer the reads are counted for
+ * @param config Range and read-ahead, or NULL for the whole file with defaults
+ * @param out_stream Output stream handle
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the file cannot be opened,
+ *         ESP_ERR_INVALID_SIZE if the range lies outside the file,
+ *         ESP_ERR_INVALID_STATE before sd_reader_init()
+ */
+esp_err_t sd_reader_open(const char* path, sd_reader_client_t client,
+                         const sd_reader_config_t* config, sd_reader_stream_t** out_stream);
+
+/**
+ * @brief Size of the range a stream covers
+ * @param stream Stream
+ * @return Bytes the stream will deliver in total
+ */
+uint32_t sd_reader_length(const sd_reader_stream_t* stream);
+
+/**
+ * @brief Borrow the next chunk, in file order
+ *
+ * The data stays valid until sd_reader_return(). At the end of the range
+ * ESP_OK is returned with *size set to 0.
+ *
+ * @param stream Stream
+ * @param data Output pointer to the chunk
+ * @param size Output chunk size
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE on a read error,
+ *         ESP_ERR_INVALID_STATE if every buffer of the stream is already borrowed
+ */
+esp_err_t sd_reader_borrow(sd_reader_stream_t* stream, const uint8_t** data, size_t* size);
+
+/**
+ * @brief Hand a borrowed chunk back; its buffer is reused for the next read
+ * @param stream Stream
+ * @param data Pointer returned by sd_reader_borrow()
+ */
+void sd_reader_return(sd_reader_stream_t* stream, const uint8_t* data);
+
+/**
+ * @brief Stop reading, wait for reads in flight and close the file
+ *
+ * Chunks still borrowed are returned implicitly.
+ *
+ * @param stream Stream, may be NULL
+ */
+void sd_reader_close(sd_reader_stream_t* stream);
+
+/**
+ * @brief Get the counters
+ * @param stats Output counters
+ */
+void sd_reader_get_stats(sd_reader_stats_t* stats);
+
+/**
+ * @brief Format the counters for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void sd_reader_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable SD_READER_STATS line and reset the counters
+ */
+void sd_reader_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_READER_H
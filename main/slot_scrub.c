@@ -0,0 +1,510 @@
+/**
+ * @file slot_scrub.c
+ * @brief Background integrity scrub of installed OTA slots
+ */
+
+#include "slot_scrub.h"
+#include "block_crc.h"
+#include "flash_io.h"
+#include "config_log.h"
+#include "image_digest_cache.h"
+#include "ota_preerase.h"
+#include "partition_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifndef __SIMULATOR_BUILD__
+#include "mbedtls/sha256.h"
+#endif
+
+static const char* TAG = "slot_scrub";
+
+#define SCRUB_MAGIC     0x5353  // "SS"
+#define SCRUB_VERSION   1
+#define STEP_SIZE       BLOCK_CRC_SIZE
+#define IDLE_POLL_MS    500
+
+typedef struct __attribute__((packed)) {
+    uint32_t generation;  // Image digest generation the verdict is for
+    uint8_t state;        // slot_scrub_state_t
+    uint8_t reserved;
+    uint16_t bad_blocks;  // Failing blocks found by the last walk
+} scrub_slot_t;
+
+// Stored as one config log record
+typedef struct __attribute__((packed)) {
+    uint16_t magic;       // SCRUB_MAGIC
+    uint8_t version;      // SCRUB_VERSION
+    uint8_t slot;         // Slot being walked
+    uint32_t generation;  // Its generation when the walk started
+    uint32_t position;    // Bytes of it already checked
+    uint16_t walk_bad;    // Failing blocks found so far in this walk
+    uint16_t reserved;
+    uint32_t passes;      // Completed walks over all slots
+    scrub_slot_t slots[IMAGE_DIGEST_MAX_SLOTS];
+} scrub_record_t;
+
+_Static_assert(sizeof(scrub_record_t) <= CONFIG_LOG_MAX_PAYLOAD, "Scrub state must fit one config log record");
+
+typedef enum {
+    REF_NONE,
+    REF_BLOCKS,   // Block CRC table
+    REF_DIGEST,   // SHA-256 of a verified digest record
+} scrub_ref_t;
+
+static SemaphoreHandle_t g_mutex = NULL;  // Record, rate and counters
+static SemaphoreHandle_t g_wake = NULL;
+static bool g_started = false;
+
+static scrub_record_t g_rec;
+static uint32_t g_rate_kib_s = SLOT_SCRUB_RATE_KIB_S;
+static uint32_t g_state_generation = 0;
+static slot_scrub_stats_t g_stats;
+
+// Task only
+static uint32_t g_unsaved = 0;  // Bytes checked since the record was last stored
+#ifndef __SIMULATOR_BUILD__
+static uint8_t* g_buf = NULL;  // Digest steps that cannot be mapped
+static mbedtls_sha256_context g_sha;
+static bool g_sha_active = false;
+#endif
+
+static bool lock(void)
+{
+    // Fails until slot_scrub_init() has created the mutex
+    return g_mutex && xSemaphoreTake(g_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(g_mutex);
+}
+
+static bool slot_digest(uint32_t slot, image_digest_record_t* record)
+{
+    return image_digest_cache_get(slot, record) == ESP_OK;
+}
+
+static uint32_t slot_generation(uint32_t slot)
+{
+    image_digest_record_t record;
+    return slot_digest(slot, &record) ? record.generation : 0;
+}
+
+static void load_record(void)
+{
+    size_t length = sizeof(g_rec);
+    if (config_log_is_ready() &&
+        config_log_read(CONFIG_LOG_KEY_SCRUB_STATE, &g_rec, &length) == ESP_OK &&
+        length == sizeof(g_rec) && g_rec.magic == SCRUB_MAGIC && g_rec.version == SCRUB_VERSION &&
+        g_rec.slot < IMAGE_DIGEST_MAX_SLOTS) {
+        ESP_LOGI(TAG, "Resuming at slot %u, %" PRIu32 " KiB checked", g_rec.slot, g_rec.position / 1024);
+        return;
+    }
+    memset(&g_rec, 0, sizeof(g_rec));
+    g_rec.magic = SCRUB_MAGIC;
+    g_rec.version = SCRUB_VERSION;
+}
+
+// Caller holds the lock
+static void store_record(void)
+{
+    g_unsaved = 0;
+    if (!config_log_is_ready()) {
+        return;  // Kept in RAM for this session only
+    }
+    esp_err_t ret = config_log_append(CONFIG_LOG_KEY_SCRUB_STATE, &g_rec, sizeof(g_rec));
+    if (ret == ESP_OK) {
+        g_stats.checkpoints++;
+    } else {
+        ESP_LOGW(TAG, "Failed to store scrub state: %s", esp_err_to_name(ret));
+    }
+}
+
+// Caller holds the lock; stores the record if the verdict changed
+static void set_state(uint32_t slot, uint32_t generation, slot_scrub_state_t state, uint16_t bad_blocks)
+{
+    scrub_slot_t* entry = &g_rec.slots[slot];
+    if (entry->generation == generation && entry->state == state && entry->bad_blocks == bad_blocks) {
+        return;
+    }
+    entry->generation = generation;
+    entry->state = state;
+    entry->bad_blocks = bad_blocks;
+    g_state_generation++;
+    store_record();
+}
+
+// Move on to the next slot; returns true when the pass is complete. Caller holds the lock
+static bool next_slot(void)
+{
+    g_rec.position = 0;
+    g_rec.generation = 0;
+    g_rec.walk_bad = 0;
+    if (++g_rec.slot < IMAGE_DIGEST_MAX_SLOTS) {
+        return false;
+    }
+    g_rec.slot = 0;
+    g_rec.passes++;
+    g_stats.passes++;
+    store_record();
+    return true;
+}
+
+// What the image in a slot can be checked against, and how many bytes that covers
+static scrub_ref_t slot_reference(uint32_t slot, uint32_t* length)
+{
+    if (block_crc_available(slot, length)) {
+        return REF_BLOCKS;
+    }
+#ifndef __SIMULATOR_BUILD__
+    // The recorded digest covers the image up to the appended SHA-256
+    image_digest_record_t record;
+    if (slot_digest(slot, &record) && (record.flags & IMAGE_DIGEST_FLAG_VERIFIED) &&
+        (record.flags & IMAGE_DIGEST_FLAG_HASH_APPENDED) && record.length > IMAGE_DIGEST_LEN) {
+        *length = record.length - IMAGE_DIGEST_LEN;
+        return REF_DIGEST;
+    }
+#endif
+    return REF_NONE;
+}
+
+static esp_err_t check_digest_step(const partition_cache_entry_t* part, uint32_t slot,
+                                   uint32_t position, uint32_t step, uint32_t length)
+{
+#ifdef __SIMULATOR_BUILD__
+    (void)part;
+    (void)slot;
+    (void)position;
+    (void)step;
+    (void)length;
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (position == 0) {
+        if (g_sha_active) {
+            mbedtls_sha256_free(&g_sha);  // Walk abandoned part-way
+        }
+        mbedtls_sha256_init(&g_sha);
+        mbedtls_sha256_starts(&g_sha, 0);
+        g_sha_active = true;
+    }
+    // Hash the step in place through the flash cache, or copy it sector by sector
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + slot, NULL);
+    flash_io_map_t map;
+    if (partition && partition->address == part->offset &&
+        flash_io_map(partition, position, step, &map) == ESP_OK) {
+        mbedtls_sha256_update(&g_sha, map.data, step);
+        flash_io_unmap(&map);
+    } else {
+        if (!g_buf && !(g_buf = malloc(FLASH_IO_SECTOR_SIZE))) {
+            mbedtls_sha256_free(&g_sha);
+            g_sha_active = false;
+            return ESP_ERR_NO_MEM;
+        }
+        for (uint32_t pos = 0; pos < step; pos += FLASH_IO_SECTOR_SIZE) {
+            uint32_t n = step - pos < FLASH_IO_SECTOR_SIZE ? step - pos : FLASH_IO_SECTOR_SIZE;
+            esp_err_t ret = flash_io_read(FLASH_IO_PRIORITY_BACKGROUND, g_buf, part->offset + position + pos, n);
+            if (ret != ESP_OK) {
+                mbedtls_sha256_free(&g_sha);
+                g_sha_active = false;
+                return ret;
+            }
+            mbedtls_sha256_update(&g_sha, g_buf, n);
+        }
+    }
+    if (position + step < length) {
+        return ESP_OK;
+    }
+
+    uint8_t digest[IMAGE_DIGEST_LEN];
+    mbedtls_sha256_finish(&g_sha, digest);
+    mbedtls_sha256_free(&g_sha);
+    g_sha_active = false;
+
+    image_digest_record_t record;
+    if (!slot_digest(slot, &record)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return memcmp(digest, record.sha256, sizeof(digest)) == 0 ? ESP_OK : ESP_ERR_INVALID_CRC;
+#endif
+}
+
+// Check the next step of the current slot. Returns false once a pass is complete
+static bool run_step(void)
+{
+    if (!lock()) {
+        return false;
+    }
+    uint32_t slot = g_rec.slot;
+    uint32_t position = g_rec.position;
+    uint32_t walk_generation = g_rec.generation;
+    uint32_t rate = g_rate_kib_s;
+    unlock();
+
+    if (rate == 0) {
+        return false;  // Paused until slot_scrub_set_rate()
+    }
+
+    partition_cache_entry_t part;
+    uint32_t generation = slot_generation(slot);
+    uint32_t length = 0;
+    scrub_ref_t ref = REF_NONE;
+    bool skip = partition_cache_find_by_subtype(ESP_PARTITION_TYPE_APP,
+                                                ESP_PARTITION_SUBTYPE_APP_OTA_MIN + slot, &part) != ESP_OK ||
+                ota_preerase_is_claimed(slot);
+    if (!skip) {
+        ref = slot_reference(slot, &length);
+    }
+
+    // A walk only continues over the image it started on
+    bool restart = position > 0 && generation != walk_generation;
+#ifndef __SIMULATOR_BUILD__
+    restart |= ref == REF_DIGEST && position > 0 && !g_sha_active;  // Hash state is lost on reboot
+#endif
+    if (restart) {
+        position = 0;
+        if (lock()) {
+            g_rec.position = 0;
+            g_rec.walk_bad = 0;
+            g_stats.restarts++;
+            unlock();
+        }
+    }
+
+    if (skip || ref == REF_NONE || length == 0) {
+        if (!lock()) {
+            return false;
+        }
+        if (!skip) {
+            set_state(slot, generation, SLOT_SCRUB_NO_REFERENCE, 0);
+        }
+        bool done = next_slot();
+        unlock();
+        return !done;
+    }
+
+    uint32_t step = length - position < STEP_SIZE ? length - position : STEP_SIZE;
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret;
+    if (ref == REF_BLOCKS) {
+        block_crc_result_t result;
+        ret = block_crc_verify(slot, position >> BLOCK_CRC_SHIFT, 1, FLASH_IO_PRIORITY_BACKGROUND, NULL, &result);
+    } else {
+        ret = check_digest_step(&part, slot, position, step, length);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    // An install that started meanwhile makes the result meaningless
+    bool interrupted = ota_preerase_is_claimed(slot) || slot_generation(slot) != generation;
+
+    if (!lock()) {
+        return false;
+    }
+    bool done = false;
+    if (interrupted) {
+        g_stats.restarts++;
+        done = next_slot();
+    } else if (ret != ESP_OK && ret != ESP_ERR_INVALID_CRC) {
+        ESP_LOGW(TAG, "Scrub of %s stopped: %s", part.label, esp_err_to_name(ret));
+        done = next_slot();
+    } else {
+        g_stats.steps++;
+        g_stats.bytes_checked += step;
+        g_rec.generation = generation;
+        g_rec.position = position + step;
+        g_unsaved += step;
+
+        if (ret == ESP_ERR_INVALID_CRC) {
+            g_rec.walk_bad++;
+            if (ref == REF_BLOCKS) {
+                ESP_LOGE(TAG, "%s: block %" PRIu32 " failed its CRC check", part.label, position >> BLOCK_CRC_SHIFT);
+            } else {
+                ESP_LOGE(TAG, "%s: image digest does not match", part.label);
+            }
+            // Flag the slot right away; the walk goes on to count the bad blocks
+            set_state(slot, generation, SLOT_SCRUB_FAILED, g_rec.walk_bad);
+        }
+
+        if (g_rec.position >= length) {
+            if (g_rec.walk_bad == 0) {
+                ESP_LOGI(TAG, "%s: %" PRIu32 " KiB intact", part.label, length / 1024);
+                g_stats.slots_ok++;
+                set_state(slot, generation, SLOT_SCRUB_OK, 0);
+            } else {
+                g_stats.slots_failed++;
+            }
+            done = next_slot();
+        } else if (g_unsaved >= SLOT_SCRUB_CHECKPOINT_BYTES) {
+            store_record();
+        }
+    }
+
+    // Space the steps out to stay under the cap
+    int64_t budget_us = (int64_t)step * 1000000 / ((int64_t)rate * 1024);
+    uint32_t wait_ms = budget_us > elapsed_us ? (uint32_t)((budget_us - elapsed_us) / 1000) : 0;
+    g_stats.throttled_ms += wait_ms;
+    unlock();
+
+    if (wait_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+    }
+    return !done;
+}
+
+static void scrub_task(void* arg)
+{
+    (void)arg;
+    while (1) {
+        while (flash_io_idle_ms(FLASH_IO_PRIORITY_BULK) < SLOT_SCRUB_IDLE_MS) {
+            vTaskDelay(pdMS_TO_TICKS(IDLE_POLL_MS));
+        }
+        if (!run_step()) {
+            // Pass complete or paused; look again later or when the cap changes
+            xSemaphoreTake(g_wake, pdMS_TO_TICKS(SLOT_SCRUB_RESCAN_MS));
+        }
+    }
+}
+
+esp_err_t slot_scrub_init(void)
+{
+    if (g_mutex) {
+        return ESP_OK;
+    }
+
+    if (!g_wake) {
+        g_wake = xSemaphoreCreateBinary();
+    }
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    if (!mutex || !g_wake) {
+        ESP_LOGE(TAG, "Failed to create scrub semaphores");
+        if (mutex) {
+            vSemaphoreDelete(mutex);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    g_mutex = mutex;
+    return ESP_OK;
+}
+
+esp_err_t slot_scrub_start(void)
+{
+    if (!lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (g_started) {
+        unlock();
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    load_record();
+    g_state_generation++;
+    if (xTaskCreatePinnedToCore(scrub_task, "slot_scrub", 4096, NULL,
+                                tskIDLE_PRIORITY + 1, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scrub task");
+    } else {
+        g_started = true;
+        ret = ESP_OK;
+        ESP_LOGI(TAG, "Background scrub started (%" PRIu32 " KiB/s)", g_rate_kib_s);
+    }
+    unlock();
+    return ret;
+}
+
+void slot_scrub_set_rate(uint32_t kib_per_s)
+{
+    if (!lock()) {
+        return;
+    }
+    g_rate_kib_s = kib_per_s;
+    unlock();
+
+    if (g_wake) {
+        xSemaphoreGive(g_wake);
+    }
+}
+
+slot_scrub_state_t slot_scrub_get_state(uint32_t slot)
+{
+    if (slot >= IMAGE_DIGEST_MAX_SLOTS || !lock()) {
+        return SLOT_SCRUB_UNCHECKED;
+    }
+    scrub_slot_t entry = g_rec.slots[slot];
+    unlock();
+
+    // A verdict for an older image says nothing about the current one
+    if (entry.generation != slot_generation(slot)) {
+        return SLOT_SCRUB_UNCHECKED;
+    }
+    return (slot_scrub_state_t)entry.state;
+}
+
+uint32_t slot_scrub_get_generation(void)
+{
+    if (!lock()) {
+        return 0;
+    }
+    uint32_t generation = g_state_generation;
+    unlock();
+    return generation;
+}
+
+void slot_scrub_get_stats(slot_scrub_stats_t* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (!lock()) {
+        return;
+    }
+    *stats = g_stats;
+    unlock();
+}
+
+void slot_scrub_format_stats(char* buf, size_t size)
+{
+    slot_scrub_stats_t stats;
+    slot_scrub_get_stats(&stats);
+
+    if (!buf || size == 0 || !lock()) {
+        return;
+    }
+    uint32_t rate = g_rate_kib_s;
+    uint32_t slot = g_rec.slot;
+    uint32_t position = g_rec.position;
+    unlock();
+
+    snprintf(buf, size,
+             "Integrity scrub (%" PRIu32 " passes, cap %" PRIu32 " KiB/s)\n"
+             "  checked %8" PRIu64 " KiB, %" PRIu32 " steps, throttled %" PRIu64 " ms\n"
+             "  slots ok %7" PRIu32 ", failed %" PRIu32 ", at slot %" PRIu32 " +%" PRIu32 " KiB\n",
+             stats.passes, rate, stats.bytes_checked / 1024, stats.steps, stats.throttled_ms,
+             stats.slots_ok, stats.slots_failed, slot, position / 1024);
+}
+
+void slot_scrub_log_stats(void)
+{
+    slot_scrub_stats_t stats;
+    slot_scrub_get_stats(&stats);
+
+    ESP_LOGI(TAG, "SCRUB_STATS passes=%" PRIu32 " steps=%" PRIu32 " bytes=%" PRIu64 " slots_ok=%" PRIu32
+             " slots_failed=%" PRIu32 " restarts=%" PRIu32 " checkpoints=%" PRIu32 " throttled_ms=%" PRIu64,
+             stats.passes, stats.steps, stats.bytes_checked, stats.slots_ok, stats.slots_failed,
+             stats.restarts, stats.checkpoints, stats.throttled_ms);
+
+    if (lock()) {
+        memset(&g_stats, 0, sizeof(g_stats));
+        unlock();
+    }
+}
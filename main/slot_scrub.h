@@ -0,0 +1,124 @@
+/**
+ * @file slot_scrub.h
+ * @brief Background integrity scrub of installed OTA slots
+ *
+ * While the device sits at the menu, a low-priority task re-reads the
+ * installed slots one 64 KiB step at a time and checks them against their
+ * block CRC table (block_crc), or, for slots without one, against the
+ * SHA-256 of a verified image digest record. Steps only start after bulk
+ * flash I/O has been idle for SLOT_SCRUB_IDLE_MS, read at background
+ * priority, and are spaced out so the scrub stays under a bandwidth cap.
+ *
+ * The walk position and the verdict for each slot are kept in one config
+ * log record, so a scrub resumes where it stopped after a reboot (slots
+ * checked by digest restart from their first byte). Verdicts are stamped
+ * with the slot's image digest generation: rewriting a slot clears its
+ * verdict. The boot menu flags slots whose check failed.
+ */
+
+#ifndef SLOT_SCRUB_H
+#define SLOT_SCRUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SLOT_SCRUB_RATE_KIB_S        256     // Default bandwidth cap
+#define SLOT_SCRUB_IDLE_MS           5000    // Bulk flash I/O must have been idle this long
+#define SLOT_SCRUB_RESCAN_MS         3600000 // Pause between passes over all slots
+#define SLOT_SCRUB_CHECKPOINT_BYTES  (1024 * 1024)  // Progress stored at least this often
+
+// Config log key of the scrub state record
+#define CONFIG_LOG_KEY_SCRUB_STATE   0x0400
+
+/**
+ * @brief Verdict for a slot
+ */
+typedef enum {
+    SLOT_SCRUB_UNCHECKED = 0,     // Not scrubbed since the image was written
+    SLOT_SCRUB_OK,                // Last full check matched
+    SLOT_SCRUB_FAILED,            // A block or the digest did not match
+    SLOT_SCRUB_NO_REFERENCE,      // No block table or verified digest to check against
+} slot_scrub_state_t;
+
+/**
+ * @brief Scrub counters since start-up or the last reset
+ */
+typedef struct {
+    uint32_t passes;          // Completed walks over all slots
+    uint32_t steps;           // Steps read and checked
+    uint64_t bytes_checked;
+    uint32_t slots_ok;        // Slot checks that passed
+    uint32_t slots_failed;    // Slot checks that failed
+    uint32_t restarts;        // Slot walks restarted because an install got in the way
+    uint32_t checkpoints;     // State records stored
+    uint64_t throttled_ms;    // Time spent waiting to stay under the cap
+} slot_scrub_stats_t;
+
+/**
+ * @brief Create the lock guarding the scrub state
+ *
+ * Call once before slot_scrub_start() or any task that reads slot states or
+ * stats runs; later calls are no-ops. Those calls fail until then.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the semaphores cannot be created
+ */
+esp_err_t slot_scrub_init(void);
+
+/**
+ * @brief Start the background task
+ *
+ * Loads the stored state and resumes the walk. Safe to call more than once.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before slot_scrub_init(),
+ *         ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t slot_scrub_start(void);
+
+/**
+ * @brief Set the bandwidth cap
+ * @param kib_per_s Maximum average read rate; 0 pauses the scrub
+ */
+void slot_scrub_set_rate(uint32_t kib_per_s);
+
+/**
+ * @brief Get the verdict for the image currently in a slot
+ * @param slot OTA slot index (0 = OTA_0)
+ * @return Verdict, SLOT_SCRUB_UNCHECKED if the slot was rewritten since
+ */
+slot_scrub_state_t slot_scrub_get_state(uint32_t slot);
+
+/**
+ * @brief Get the verdict generation
+ * @return Bumped whenever a verdict changes, for UI refresh
+ */
+uint32_t slot_scrub_get_generation(void);
+
+/**
+ * @brief Get the counters
+ * @param stats Output counters
+ */
+void slot_scrub_get_stats(slot_scrub_stats_t* stats);
+
+/**
+ * @brief Format the counters for the diagnostics screen
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void slot_scrub_format_stats(char* buf, size_t size);
+
+/**
+ * @brief Log the machine-readable SCRUB_STATS line and reset the counters
+ */
+void slot_scrub_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SLOT_SCRUB_H
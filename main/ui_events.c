@@ -0,0 +1,226 @@
+/**
+ * @file ui_events.c
+ * @brief Event ring from I/O tasks to the LVGL task
+ */
+
+#include "ui_events.h"
+#include "render_loop.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char* TAG = "ui_events";
+
+_Static_assert((UI_EVENTS_RING_SIZE & (UI_EVENTS_RING_SIZE - 1)) == 0,
+               "UI_EVENTS_RING_SIZE must be a power of two");
+
+// Free-running indices: head is written by the producer, tail by the consumer.
+// Only ordered events take ring slots
+static ui_event_t g_ring[UI_EVENTS_RING_SIZE];
+static uint32_t g_head = 0;
+static uint32_t g_tail = 0;
+
+// Newest value of each coalesced type, overwritten in place by producers.
+// `seq` is the ring head when it was posted: it goes out before ring slot
+// `seq` and after everything queued ahead of it
+typedef struct {
+    ui_event_t event;
+    uint32_t seq;
+    bool pending;
+} latest_t;
+
+static latest_t g_latest[UI_EVENT_TYPE_COUNT];
+
+// Serializes producers and guards g_latest; held only to copy an event
+static SemaphoreHandle_t g_producer_mutex = NULL;
+static ui_event_handler_t g_handlers[UI_EVENT_TYPE_COUNT];
+
+// Guarded by the producer mutex
+static uint32_t g_posted = 0;
+static uint32_t g_dropped = 0;
+static uint32_t g_high_water = 0;
+static uint32_t g_coalesced = 0;
+
+// Only the newest of these matters; a newer one replaces a pending one
+static bool is_coalesced_type(uint8_t type)
+{
+    return type == UI_EVENT_STATUS || type == UI_EVENT_PROGRESS || type == UI_EVENT_FLASH_PROGRESS;
+}
+
+esp_err_t ui_events_init(void)
+{
+    if (!g_producer_mutex) {
+        g_producer_mutex = xSemaphoreCreateMutex();
+        if (!g_producer_mutex) {
+            ESP_LOGE(TAG, "Failed to create producer mutex");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ui_events_set_handler(ui_event_type_t type, ui_event_handler_t handler)
+{
+    if (type >= UI_EVENT_TYPE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    g_handlers[type] = handler;
+    return ESP_OK;
+}
+
+static bool producer_lock(void)
+{
+    return g_producer_mutex && xSemaphoreTake(g_producer_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void producer_unlock(void)
+{
+    xSemaphoreGive(g_producer_mutex);
+}
+
+// Overwrite the pending value of a coalesced type; never waits for the consumer
+static void post_latest(const ui_event_t* event)
+{
+    latest_t* latest = &g_latest[event->type];
+    if (latest->pending) {
+        g_coalesced++;
+    }
+    latest->event = *event;
+    latest->seq = g_head;
+    latest->pending = true;
+    g_posted++;
+}
+
+// Queue an ordered event. The lock is dropped while the ring is full so the
+// consumer can drain it
+static esp_err_t post_ordered(const ui_event_t* event)
+{
+    TickType_t waited = 0;
+    for (;;) {
+        uint32_t head = g_head;
+        uint32_t depth = head - __atomic_load_n(&g_tail, __ATOMIC_ACQUIRE);
+        if (depth < UI_EVENTS_RING_SIZE) {
+            g_ring[head & (UI_EVENTS_RING_SIZE - 1)] = *event;
+            __atomic_store_n(&g_head, head + 1, __ATOMIC_RELEASE);
+            g_posted++;
+            if (depth + 1 > g_high_water) {
+                g_high_water = depth + 1;
+            }
+            return ESP_OK;
+        }
+        if (waited >= pdMS_TO_TICKS(UI_EVENTS_POST_WAIT_MS)) {
+            g_dropped++;
+            return ESP_ERR_TIMEOUT;
+        }
+
+        producer_unlock();
+        render_loop_wake();
+        vTaskDelay(1);
+        waited++;
+        if (!producer_lock()) {
+            return ESP_ERR_INVALID_STATE;  // Not reached: the mutex is never deleted
+        }
+    }
+}
+
+esp_err_t ui_events_post(const ui_event_t* event)
+{
+    if (!event || event->type >= UI_EVENT_TYPE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!producer_lock()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (is_coalesced_type(event->type)) {
+        post_latest(event);
+    } else {
+        ret = post_ordered(event);
+    }
+    producer_unlock();
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Ring full, event type %d not queued", event->type);
+    }
+    // Always notify: the consumer may have drained the ring meanwhile, and
+    // pending notifications coalesce
+    render_loop_wake();
+    return ret;
+}
+
+esp_err_t ui_events_post_text(ui_event_type_t type, const char* text)
+{
+    ui_event_t event = { .type = (uint8_t)type };
+    if (text) {
+        strncpy(event.text, text, sizeof(event.text) - 1);
+    }
+    return ui_events_post(&event);
+}
+
+static void deliver(const ui_event_t* event)
+{
+    ui_event_handler_t handler = g_handlers[event->type];
+    if (handler) {
+        handler(event);
+    }
+}
+
+// Deliver the snapshotted coalesced values posted before ring slot `seq`
+static uint32_t deliver_latest(latest_t* latest, uint32_t seq)
+{
+    uint32_t delivered = 0;
+    for (int t = 0; t < UI_EVENT_TYPE_COUNT; t++) {
+        if (latest[t].pending && (int32_t)(latest[t].seq - seq) <= 0) {
+            deliver(&latest[t].event);
+            latest[t].pending = false;
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+uint32_t ui_events_dispatch(void)
+{
+    static latest_t latest[UI_EVENT_TYPE_COUNT];
+    uint32_t delivered = 0;
+
+    // Producers hold the lock only to copy one event, so this wait is short
+    if (!producer_lock()) {
+        return 0;
+    }
+    uint32_t head = g_head;
+    memcpy(latest, g_latest, sizeof(latest));
+    for (int t = 0; t < UI_EVENT_TYPE_COUNT; t++) {
+        g_latest[t].pending = false;
+    }
+    producer_unlock();
+
+    uint32_t tail = g_tail;
+    for (; tail != head; tail++) {
+        // Keep ordering: everything posted before this event is drawn first
+        delivered += deliver_latest(latest, tail);
+        deliver(&g_ring[tail & (UI_EVENTS_RING_SIZE - 1)]);
+        delivered++;
+    }
+
+    // Hand the slots back before running the last handlers
+    __atomic_store_n(&g_tail, tail, __ATOMIC_RELEASE);
+
+    delivered += deliver_latest(latest, head);
+    return delivered;
+}
+
+void ui_events_get_stats(ui_events_stats_t* stats)
+{
+    if (!stats || !producer_lock()) {
+        return;
+    }
+    stats->posted = g_posted;
+    stats->coalesced = g_coalesced;
+    stats->dropped = g_dropped;
+    stats->high_water = g_high_water;
+    producer_unlock();
+}
@@ -0,0 +1,142 @@
+/**
+ * @file ui_events.h
+ * @brief Event ring from I/O tasks to the LVGL task
+ *
+ * Flashing and OTA tasks must not touch LVGL objects or run
+ * lv_timer_handler() themselves. They post compact events instead; the
+ * render loop drains them once per pass, before lv_timer_handler(), and
+ * hands each event to the handler registered for its type.
+ *
+ * Progress and status events are coalesced by the producer: each type has
+ * one pending slot that a newer value overwrites, so posting them never
+ * waits and only the newest value is drawn. All other events are ordered
+ * and go through a single-producer/single-consumer ring that only they use.
+ * Pending progress and status values are drawn before any ordered event
+ * posted after them.
+ *
+ * Posting from more than one task is allowed: producers are serialized by a
+ * mutex, so the ring itself only ever sees one producer. The mutex is held
+ * only to copy one event, which is all the LVGL side ever waits for.
+ */
+
+#ifndef UI_EVENTS_H
+#define UI_EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UI_EVENTS_RING_SIZE   32  // Power of two
+#define UI_EVENT_TEXT_LEN     96
+#define UI_EVENTS_POST_WAIT_MS 50  // Longest an ordered event waits on a full ring
+
+/**
+ * @brief Event types
+ */
+typedef enum {
+    UI_EVENT_STATUS = 0,        // Main status line (text), coalesced
+    UI_EVENT_PROGRESS,          // Main progress bar (progress), coalesced
+    UI_EVENT_PROGRESS_VISIBLE,  // Show/hide the main progress bar (visible)
+    UI_EVENT_OTA_STATE,         // SD OTA started/finished (visible = in progress)
+    UI_EVENT_FLASH_PROGRESS,    // Firmware flasher progress (flash_progress), coalesced
+    UI_EVENT_FLASH_STATE,       // Firmware flasher state change (flash_state, text)
+    UI_EVENT_TYPE_COUNT
+} ui_event_type_t;
+
+/**
+ * @brief One queued event
+ */
+typedef struct {
+    uint8_t type;  // ui_event_type_t
+    union {
+        struct {
+            uint8_t percent;
+        } progress;
+        struct {
+            bool visible;
+        } visibility;
+        struct {
+            uint8_t percent;
+        } flash_progress;
+        struct {
+            uint8_t state;   // flash_state_t
+            uint8_t result;  // flash_result_t
+        } flash_state;
+    };
+    char text[UI_EVENT_TEXT_LEN];
+} ui_event_t;
+
+/**
+ * @brief Handler run in the LVGL task
+ */
+typedef void (*ui_event_handler_t)(const ui_event_t* event);
+
+/**
+ * @brief Queue counters
+ */
+typedef struct {
+    uint32_t posted;      // Events accepted
+    uint32_t coalesced;   // Progress/status values superseded by a newer one before drawing
+    uint32_t dropped;     // Ordered events refused with ESP_ERR_TIMEOUT
+    uint32_t high_water;  // Deepest the ring has been
+} ui_events_stats_t;
+
+/**
+ * @brief Create the producer lock; call before any task posts
+ * @return ESP_OK on success, ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t ui_events_init(void);
+
+/**
+ * @brief Register the handler for an event type (replaces any previous one)
+ *
+ * @param type Event type
+ * @param handler Handler, or NULL to discard events of that type
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown type
+ */
+esp_err_t ui_events_set_handler(ui_event_type_t type, ui_event_handler_t handler);
+
+/**
+ * @brief Queue an event and wake the render loop; safe from any task
+ *
+ * Progress and status events replace the pending value of their type and
+ * never wait. An ordered event waits for at most UI_EVENTS_POST_WAIT_MS
+ * when the ring is full and is then refused; the caller must handle that.
+ *
+ * @param event Event to copy
+ * @return ESP_OK if queued, ESP_ERR_TIMEOUT if the ring stayed full,
+ *         ESP_ERR_INVALID_ARG for an unknown type,
+ *         ESP_ERR_INVALID_STATE before ui_events_init()
+ */
+esp_err_t ui_events_post(const ui_event_t* event);
+
+/**
+ * @brief Convenience wrapper for text-only events
+ *
+ * @param type Event type
+ * @param text Text, truncated to UI_EVENT_TEXT_LEN - 1 characters
+ * @return Same as ui_events_post()
+ */
+esp_err_t ui_events_post_text(ui_event_type_t type, const char* text);
+
+/**
+ * @brief Deliver all queued events; LVGL task only
+ * @return Number of events handed to handlers
+ */
+uint32_t ui_events_dispatch(void);
+
+/**
+ * @brief Get the queue counters
+ * @param stats Output counters
+ */
+void ui_events_get_stats(ui_events_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UI_EVENTS_H
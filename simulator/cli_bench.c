@@ -0,0 +1,599 @@
+/**
+ * @file cli_bench.c
+ * @brief Storage benchmarks run against a flash image
+ */
+
+#ifdef __SIMULATOR_BUILD__
+
+#include "cli_bench.h"
+#include "cli_inspector.h"
+#include "esp_log_mock.h"
+#include "esp_timer.h"
+#include "flash_emulator.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "../main/partition_cache.h"
+#include "../main/config_log.h"
+#include "../main/block_crc.h"
+#include "../main/flash_io.h"
+#include "../main/image_digest_cache.h"
+#include "../main/ota_preerase.h"
+#include "esp_partition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+static const char* TAG = "cli_bench";
+
+// Same size as a firmware metadata record (fw_metadata_record_t)
+#define BENCH_RECORD_SIZE   172
+// Keys cycled through by each phase, kept small so the live set fits CONFIG_LOG_MAX_KEYS
+#define BENCH_KEY_COUNT     4
+#define BENCH_LOG_KEY(i)    (0x7F00 + (i))
+#define BENCH_NVS_NAMESPACE "bench"
+
+typedef struct {
+    uint64_t total_us;
+    uint64_t min_us;
+    uint64_t max_us;
+    int ops;
+} bench_timing_t;
+
+static void timing_reset(bench_timing_t* t)
+{
+    memset(t, 0, sizeof(*t));
+    t->min_us = UINT64_MAX;
+}
+
+static void timing_add(bench_timing_t* t, uint64_t us)
+{
+    t->total_us += us;
+    t->ops++;
+    if (us < t->min_us) {
+        t->min_us = us;
+    }
+    if (us > t->max_us) {
+        t->max_us = us;
+    }
+}
+
+static void timing_print(const char* label, const bench_timing_t* t)
+{
+    if (t->ops == 0) {
+        printf("  %-22s n/a\n", label);
+        return;
+    }
+    printf("  %-22s avg %8.2f us   min %6llu us   max %6llu us\n", label,
+           (double)t->total_us / t->ops, (unsigned long long)t->min_us, (unsigned long long)t->max_us);
+}
+
+static void fill_record(uint8_t* record, int i)
+{
+    memset(record, 0, BENCH_RECORD_SIZE);
+    snprintf((char*)record, 128, "bench_firmware_%d.bin", i);
+    memcpy(record + 128, &i, sizeof(i));
+}
+
+static int bench_config_log(int iterations, bench_timing_t* append, bench_timing_t* lookup)
+{
+    uint8_t record[BENCH_RECORD_SIZE];
+
+    for (int i = 0; i < iterations; i++) {
+        fill_record(record, i);
+        uint64_t start = esp_timer_get_time();
+        esp_err_t ret = config_log_append(BENCH_LOG_KEY(i % BENCH_KEY_COUNT), record, sizeof(record));
+        timing_add(append, esp_timer_get_time() - start);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "config_log_append failed: %s", esp_err_to_name(ret));
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < iterations; i++) {
+        size_t length = sizeof(record);
+        uint64_t start = esp_timer_get_time();
+        esp_err_t ret = config_log_read(BENCH_LOG_KEY(i % BENCH_KEY_COUNT), record, &length);
+        timing_add(lookup, esp_timer_get_time() - start);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "config_log_read failed: %s", esp_err_to_name(ret));
+            return -1;
+        }
+    }
+
+    for (int k = 0; k < BENCH_KEY_COUNT; k++) {
+        config_log_delete(BENCH_LOG_KEY(k));
+    }
+    return 0;
+}
+
+static int bench_nvs(int iterations, bench_timing_t* append, bench_timing_t* lookup)
+{
+    uint8_t record[BENCH_RECORD_SIZE];
+    char key[16];
+    nvs_handle_t handle;
+
+    esp_err_t ret = nvs_open(BENCH_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    // One blob write + commit per update, as firmware_metadata does on the NVS backend
+    for (int i = 0; i < iterations; i++) {
+        fill_record(record, i);
+        snprintf(key, sizeof(key), "fw_%d", i % BENCH_KEY_COUNT);
+        uint64_t start = esp_timer_get_time();
+        ret = nvs_set_blob(handle, key, record, sizeof(record));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        timing_add(append, esp_timer_get_time() - start);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "NVS write failed: %s", esp_err_to_name(ret));
+            nvs_close(handle);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < iterations; i++) {
+        size_t length = sizeof(record);
+        snprintf(key, sizeof(key), "fw_%d", i % BENCH_KEY_COUNT);
+        uint64_t start = esp_timer_get_time();
+        ret = nvs_get_blob(handle, key, record, &length);
+        timing_add(lookup, esp_timer_get_time() - start);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "nvs_get_blob failed: %s", esp_err_to_name(ret));
+            nvs_close(handle);
+            return -1;
+        }
+    }
+
+    for (int k = 0; k < BENCH_KEY_COUNT; k++) {
+        snprintf(key, sizeof(key), "fw_%d", k);
+        nvs_erase_key(handle, key);
+    }
+    nvs_commit(handle);
+    nvs_close(handle);
+    return 0;
+}
+
+// Shared setup of the image benchmarks
+static int bench_open_image(const char* image_path)
+{
+    if (cli_load_image(image_path) != 0) {
+        return -1;
+    }
+
+    esp_err_t ret = nvs_flash_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NVS init failed: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    ret = flash_io_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Flash I/O service unavailable: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    ret = partition_cache_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Partition cache unavailable: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    if (partition_cache_load() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read partition table from image");
+        return -1;
+    }
+
+    ret = config_log_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Config log unavailable: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    // Installs claim their slot from the pre-erase service
+    ret = ota_preerase_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Pre-erase unavailable: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    ret = block_crc_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Block CRC tables unavailable: %s", esp_err_to_name(ret));
+        return -1;
+    }
+    return 0;
+}
+
+int cli_bench_store(const char* image_path, int iterations)
+{
+    if (!image_path || iterations <= 0) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+
+    if (bench_open_image(image_path) != 0) {
+        return -1;
+    }
+
+    printf("\n");
+    printf("=== Metadata store benchmark (%d ops/phase, %d-byte records, %d keys) ===\n",
+           iterations, BENCH_RECORD_SIZE, BENCH_KEY_COUNT);
+
+    bench_timing_t log_append, log_lookup, nvs_append, nvs_lookup;
+    timing_reset(&log_append);
+    timing_reset(&log_lookup);
+    timing_reset(&nvs_append);
+    timing_reset(&nvs_lookup);
+
+    config_log_stats_t before;
+    config_log_get_stats(&before);
+    flash_emulator_reset_stats();
+
+    if (bench_config_log(iterations, &log_append, &log_lookup) != 0) {
+        return -1;
+    }
+
+    config_log_stats_t after;
+    config_log_get_stats(&after);
+    flash_stats_t flash;
+    flash_emulator_get_stats(&flash);
+
+    if (bench_nvs(iterations, &nvs_append, &nvs_lookup) != 0) {
+        return -1;
+    }
+
+    printf("\nConfig log (bootloader_config, %u sectors):\n", after.sector_count);
+    timing_print("append", &log_append);
+    timing_print("lookup", &log_lookup);
+    printf("  %-22s %u bytes (%.1f per append)\n", "programmed",
+           after.bytes_appended - before.bytes_appended,
+           (double)(after.bytes_appended - before.bytes_appended) / iterations);
+    printf("  %-22s %u\n", "sectors erased", after.sectors_erased - before.sectors_erased);
+    printf("  %-22s %u (%u records relocated)\n", "compactions",
+           after.compactions - before.compactions, after.records_relocated - before.records_relocated);
+    printf("  %-22s %u bytes read, %u written, %u erased\n", "flash traffic",
+           flash.bytes_read, flash.bytes_written, flash.bytes_erased);
+
+    printf("\nNVS (set_blob + commit / get_blob):\n");
+    timing_print("append", &nvs_append);
+    timing_print("lookup", &nvs_lookup);
+    printf("  Note: the simulator NVS backend persists to a host JSON file on commit,\n");
+    printf("        so its latency reflects host I/O rather than flash page writes.\n");
+
+    printf("\n");
+    return 0;
+}
+
+// Largest synthetic image written by the repair benchmark
+#define REPAIR_IMAGE_MAX    (2 * 1024 * 1024)
+#define REPAIR_DAMAGED      3
+
+// Full reinstall of a slot from the source file, the way sd_ota writes it
+static esp_err_t bench_install(uint32_t slot, const partition_cache_entry_t* part, FILE* source, uint32_t length)
+{
+    uint8_t buf[FLASH_IO_SECTOR_SIZE];
+    esp_err_t ret = ota_preerase_claim(slot, part->offset, part->size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = image_digest_cache_invalidate(slot, part->offset);
+    if (ret == ESP_OK) {
+        ret = ota_preerase_erase(slot, part->offset, length);
+    }
+
+    block_crc_builder_t crc_table;
+    block_crc_begin(&crc_table, slot, part->offset);
+    rewind(source);
+    for (uint32_t pos = 0; ret == ESP_OK && pos < length; pos += sizeof(buf)) {
+        uint32_t n = length - pos < sizeof(buf) ? length - pos : sizeof(buf);
+        if (fread(buf, 1, n, source) != n) {
+            ret = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        ret = flash_io_write(FLASH_IO_PRIORITY_BULK, buf, part->offset + pos, n);
+        block_crc_update(&crc_table, buf, n);
+    }
+    esp_err_t table_ret = block_crc_finish(&crc_table, ret == ESP_OK);
+    ota_preerase_release(slot, length);
+    return ret != ESP_OK ? ret : table_ret;
+}
+
+// Pseudo-random source image in a temporary file named after `path_template`
+static FILE* bench_make_source(char* path_template, uint32_t length)
+{
+    int fd = mkstemp(path_template);
+    FILE* source = fd >= 0 ? fdopen(fd, "w+b") : NULL;
+    if (!source) {
+        ESP_LOGE(TAG, "Failed to create source file");
+        return NULL;
+    }
+    uint32_t seed = 0x12345678;
+    for (uint32_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        fputc(seed >> 16, source);
+    }
+    fflush(source);
+    return source;
+}
+
+// The block table lives in the image's config log
+static void bench_drop_table(void)
+{
+    for (uint32_t part = 0; part < BLOCK_CRC_MAX_PARTS; part++) {
+        config_log_delete(CONFIG_LOG_KEY_BLOCK_CRC(0, part));
+    }
+}
+
+static void print_traffic(const char* label, uint64_t us)
+{
+    flash_stats_t flash;
+    flash_emulator_get_stats(&flash);
+    printf("  %-22s %8.2f ms   %u bytes read, %u written, %u erased\n", label,
+           us / 1000.0, flash.bytes_read, flash.bytes_written, flash.bytes_erased);
+}
+
+int cli_bench_repair(const char* image_path)
+{
+    if (!image_path) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    if (bench_open_image(image_path) != 0) {
+        return -1;
+    }
+
+    partition_cache_entry_t part;
+    if (partition_cache_find_by_subtype(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, &part) != ESP_OK) {
+        ESP_LOGE(TAG, "Image has no ota_0 partition");
+        return -1;
+    }
+    const uint32_t slot = 0;
+
+    // Odd length so the last block is partial
+    uint32_t length = part.size < REPAIR_IMAGE_MAX ? part.size : REPAIR_IMAGE_MAX;
+    length -= 1234;
+    uint32_t blocks = (length + BLOCK_CRC_SIZE - 1) / BLOCK_CRC_SIZE;
+
+    char source_path[] = "/tmp/bench_repair_XXXXXX";
+    FILE* source = bench_make_source(source_path, length);
+    if (!source) {
+        return -1;
+    }
+
+    printf("\n");
+    printf("=== Block repair benchmark (%s, %u bytes, %u blocks of %u KiB) ===\n",
+           part.label, length, blocks, BLOCK_CRC_SIZE / 1024);
+
+    int rc = -1;
+    flash_emulator_reset_stats();
+    uint64_t start = esp_timer_get_time();
+    esp_err_t ret = bench_install(slot, &part, source, length);
+    uint64_t install_us = esp_timer_get_time() - start;
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Install failed: %s", esp_err_to_name(ret));
+        goto done;
+    }
+    printf("\nFull reinstall:\n");
+    print_traffic("erase + program", install_us);
+
+    flash_emulator_reset_stats();
+    block_crc_result_t result;
+    ret = block_crc_verify(slot, 0, BLOCK_CRC_MAX_BLOCKS, FLASH_IO_PRIORITY_BULK, NULL, &result);
+    printf("\nVerify intact slot:\n");
+    print_traffic(ret == ESP_OK ? "all blocks match" : "MISMATCH", result.elapsed_us);
+    if (ret != ESP_OK) {
+        goto done;
+    }
+
+    // Flip one bit in the first, a middle and the last block
+    const uint32_t damaged[REPAIR_DAMAGED] = { 0, blocks / 2, blocks - 1 };
+    for (int i = 0; i < REPAIR_DAMAGED; i++) {
+        uint32_t address = part.offset + damaged[i] * BLOCK_CRC_SIZE + 100;
+        uint8_t byte;
+        flash_emulator_read(address, &byte, 1);
+        byte ^= 0x10;
+        flash_emulator_write(address, &byte, 1);
+    }
+
+    flash_emulator_reset_stats();
+    ret = block_crc_repair(slot, source_path, &result);
+    printf("\nRepair after %d bit flips:\n", REPAIR_DAMAGED);
+    print_traffic("verify + repair", result.elapsed_us);
+    printf("  %-22s %u checked, %u bad, %u repaired\n", "blocks",
+           result.blocks_checked, result.blocks_bad, result.blocks_repaired);
+    if (ret != ESP_OK || result.blocks_bad != REPAIR_DAMAGED) {
+        ESP_LOGE(TAG, "Repair failed: %s", esp_err_to_name(ret));
+        goto done;
+    }
+
+    ret = block_crc_verify(slot, 0, BLOCK_CRC_MAX_BLOCKS, FLASH_IO_PRIORITY_BULK, NULL, &result);
+    printf("  %-22s %s\n", "verify after repair", ret == ESP_OK ? "all blocks match" : "MISMATCH");
+    if (ret != ESP_OK) {
+        goto done;
+    }
+
+    printf("  Note: host timings are memcpy-bound; on the device erase and program time\n");
+    printf("        scale with the erased/written bytes shown above.\n");
+    rc = 0;
+
+done:
+    fclose(source);
+    unlink(source_path);
+
+    bench_drop_table();
+    printf("\n");
+    return rc;
+}
+
+// Largest synthetic image verified by the verification benchmark
+#define VERIFY_IMAGE_MAX    (8 * 1024 * 1024)
+#define VERIFY_PASSES       5
+
+// Heap in use on the host, -1 where the C library cannot tell
+static int64_t heap_in_use(void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return (int64_t)mallinfo2().uordblks;
+#elif defined(__APPLE__)
+    malloc_statistics_t st;
+    malloc_zone_statistics(NULL, &st);
+    return (int64_t)st.size_in_use;
+#else
+    return -1;
+#endif
+}
+
+// Polls heap_in_use() while a verification runs; the read buffers are
+// short-lived, so the sampler spins rather than sleeps
+typedef struct {
+    volatile bool stop;
+    int64_t peak;
+} heap_sampler_t;
+
+static void* heap_sampler_task(void* arg)
+{
+    heap_sampler_t* sampler = arg;
+    while (!sampler->stop) {
+        int64_t used = heap_in_use();
+        if (used > sampler->peak) {
+            sampler->peak = used;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    double mb_per_s;
+    int64_t heap_peak;       // Bytes above the baseline, -1 if unknown
+    uint32_t bytes_copied;   // Flash bytes copied into buffers per pass
+    uint32_t bytes_mapped;   // Flash bytes read in place per pass
+} verify_run_t;
+
+static esp_err_t bench_verify_run(uint32_t slot, uint32_t length, bool mapped, verify_run_t* run)
+{
+    flash_io_set_map_enabled(mapped);
+
+    // Throughput, without the sampler competing for the allocator lock
+    block_crc_result_t result;
+    esp_err_t ret = ESP_OK;
+    uint64_t start = esp_timer_get_time();
+    for (int i = 0; i < VERIFY_PASSES && ret == ESP_OK; i++) {
+        ret = block_crc_verify(slot, 0, BLOCK_CRC_MAX_BLOCKS, FLASH_IO_PRIORITY_BULK, NULL, &result);
+    }
+    uint64_t elapsed_us = esp_timer_get_time() - start;
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    run->mb_per_s = elapsed_us ? (double)length * VERIFY_PASSES / elapsed_us : 0;
+
+    // One more pass for heap and flash traffic
+    heap_sampler_t sampler = { .stop = false, .peak = heap_in_use() };
+    int64_t baseline = sampler.peak;
+    pthread_t thread;
+    bool sampling = baseline >= 0 && pthread_create(&thread, NULL, heap_sampler_task, &sampler) == 0;
+    flash_emulator_reset_stats();
+    ret = block_crc_verify(slot, 0, BLOCK_CRC_MAX_BLOCKS, FLASH_IO_PRIORITY_BULK, NULL, &result);
+    if (sampling) {
+        sampler.stop = true;
+        pthread_join(thread, NULL);
+    }
+
+    flash_stats_t flash;
+    flash_emulator_get_stats(&flash);
+    run->heap_peak = sampling ? sampler.peak - baseline : -1;
+    run->bytes_copied = flash.bytes_read;
+    run->bytes_mapped = flash.bytes_mapped;
+    flash_io_set_map_enabled(true);
+    return ret;
+}
+
+static void print_verify_run(const char* label, const verify_run_t* run)
+{
+    char heap[32];
+    if (run->heap_peak >= 0) {
+        snprintf(heap, sizeof(heap), "%lld bytes", (long long)run->heap_peak);
+    } else {
+        snprintf(heap, sizeof(heap), "n/a");
+    }
+    printf("  %-22s %8.1f MB/s   heap peak %-12s %u bytes copied, %u mapped\n",
+           label, run->mb_per_s, heap, run->bytes_copied, run->bytes_mapped);
+}
+
+int cli_bench_verify(const char* image_path)
+{
+    if (!image_path) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    if (bench_open_image(image_path) != 0) {
+        return -1;
+    }
+
+    partition_cache_entry_t part;
+    if (partition_cache_find_by_subtype(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, &part) != ESP_OK) {
+        ESP_LOGE(TAG, "Image has no ota_0 partition");
+        return -1;
+    }
+    const uint32_t slot = 0;
+    uint32_t length = part.size < VERIFY_IMAGE_MAX ? part.size : VERIFY_IMAGE_MAX;
+
+    char source_path[] = "/tmp/bench_verify_XXXXXX";
+    FILE* source = bench_make_source(source_path, length);
+    if (!source) {
+        return -1;
+    }
+
+    printf("\n");
+    printf("=== Verification benchmark (%s, %u bytes, %d passes) ===\n", part.label, length, VERIFY_PASSES);
+
+    int rc = -1;
+    verify_run_t copied = {0};
+    verify_run_t mapped = {0};
+    esp_err_t ret = bench_install(slot, &part, source, length);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Install failed: %s", esp_err_to_name(ret));
+        goto done;
+    }
+
+    printf("\nBlock CRC verify of the whole slot:\n");
+    ret = bench_verify_run(slot, length, false, &copied);
+    if (ret == ESP_OK) {
+        print_verify_run("4 KiB buffer reads", &copied);
+        ret = bench_verify_run(slot, length, true, &mapped);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Verify failed: %s", esp_err_to_name(ret));
+        goto done;
+    }
+    print_verify_run("mapped window", &mapped);
+    if (copied.mb_per_s > 0) {
+        printf("  %-22s %8.2fx\n", "speed-up", mapped.mb_per_s / copied.mb_per_s);
+    }
+
+    printf("  Note: the heap peak includes the block table loaded by each verify.\n");
+    printf("        On the device, queued reads are bound by SPI transfer time and\n");
+    printf("        mapped reads by the flash cache; host numbers show the copy and\n");
+    printf("        queue overhead that mapping removes.\n");
+    rc = 0;
+
+done:
+    fclose(source);
+    unlink(source_path);
+    bench_drop_table();
+    printf("\n");
+    return rc;
+}
+
+#endif // __SIMULATOR_BUILD__
@@ -0,0 +1,63 @@
+/**
+ * @file cli_bench.h
+ * @brief Storage benchmarks run against a flash image
+ */
+
+#ifndef CLI_BENCH_H
+#define CLI_BENCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __SIMULATOR_BUILD__
+
+/**
+ * @brief Compare config log and NVS latency for metadata-sized records
+ *
+ * Loads the image into memory (the file is not modified), then times
+ * appends and lookups of firmware-metadata-sized records through the config
+ * log on the bootloader_config partition and through NVS blobs, and prints
+ * per-operation latency plus the flash traffic caused by the log.
+ *
+ * @param image_path Path to flash image file
+ * @param iterations Operations per phase
+ * @return 0 on success, -1 on error
+ */
+int cli_bench_store(const char* image_path, int iterations);
+
+/**
+ * @brief Compare block-level repair of a damaged slot with a full reinstall
+ *
+ * Loads the image into memory (the file is not modified), installs a
+ * synthetic image into ota_0 with its block CRC table, flips bits in a few
+ * blocks, then repairs the slot from the source file and prints the time and
+ * flash traffic of both paths.
+ *
+ * @param image_path Path to flash image file
+ * @return 0 on success, -1 on error
+ */
+int cli_bench_repair(const char* image_path);
+
+/**
+ * @brief Compare slot verification through mapped flash with buffered reads
+ *
+ * Loads the image into memory (the file is not modified), installs a
+ * synthetic image into ota_0 with its block CRC table, then verifies the
+ * slot with mapping disabled and enabled and prints the MB/s, peak heap
+ * and flash bytes copied or mapped of both paths.
+ *
+ * @param image_path Path to flash image file
+ * @return 0 on success, -1 on error
+ */
+int cli_bench_verify(const char* image_path);
+
+#endif // __SIMULATOR_BUILD__
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLI_BENCH_H
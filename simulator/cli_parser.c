@@ -22,6 +22,7 @@ static const char* TAG = "cli_parser";
 #define DEFAULT_OUTPUT_PATH         "simulated-flash.bin"
 #define DEFAULT_SDCARD_PATH         "sdcard/firmwares"
 #define DEFAULT_FLASH_SIZE_MB       16
+#define DEFAULT_BENCH_ITERATIONS    1000
 
 cli_config_t* cli_config_create(void) {
     cli_config_t* config = (cli_config_t*)calloc(1, sizeof(cli_config_t));
@@ -47,6 +48,7 @@ cli_config_t* cli_config_create(void) {
     config->trim_zeros = false;
     config->force_overwrite = false;
     config->verbose = false;
+    config->bench_iterations = DEFAULT_BENCH_ITERATIONS;
 
     return config;
 }
@@ -61,6 +63,7 @@ void cli_config_free(cli_config_t* config) {
     free(config->partition_table_path);
     free(config->factory_app_path);
     free(config->output_path);
+    free(config->bench_image_path);
 
     // Free firmware arrays
     if (config->firmware_paths) {
@@ -129,6 +132,10 @@ int cli_parse_args(int argc, char** argv, cli_config_t* config) {
         else if (strcmp(argv[i], "--create-image") == 0) {
             config->mode = MODE_CREATE_IMAGE;
         }
+        else if (strcmp(argv[i], "--self-test") == 0) {
+            config->mode = MODE_SELF_TEST;
+            return config->mode;
+        }
         else if (strcmp(argv[i], "--list-firmwares") == 0) {
             config->mode = MODE_LIST_FIRMWARES;
             return config->mode;
@@ -151,6 +158,44 @@ int cli_parse_args(int argc, char** argv, cli_config_t* config) {
             free(config->load_image_path);
             config->load_image_path = strdup(argv[++i]);
         }
+        else if (strcmp(argv[i], "--bench-store") == 0) {
+            config->mode = MODE_BENCH_STORE;
+            if (i + 1 >= argc) {
+                ESP_LOGE(TAG, "--bench-store requires argument");
+                return -1;
+            }
+            free(config->bench_image_path);
+            config->bench_image_path = strdup(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-repair") == 0) {
+            config->mode = MODE_BENCH_REPAIR;
+            if (i + 1 >= argc) {
+                ESP_LOGE(TAG, "--bench-repair requires argument");
+                return -1;
+            }
+            free(config->bench_image_path);
+            config->bench_image_path = strdup(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-verify") == 0) {
+            config->mode = MODE_BENCH_VERIFY;
+            if (i + 1 >= argc) {
+                ESP_LOGE(TAG, "--bench-verify requires argument");
+                return -1;
+            }
+            free(config->bench_image_path);
+            config->bench_image_path = strdup(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0) {
+            if (i + 1 >= argc) {
+                ESP_LOGE(TAG, "--iterations requires argument");
+                return -1;
+            }
+            config->bench_iterations = atoi(argv[++i]);
+            if (config->bench_iterations <= 0) {
+                ESP_LOGE(TAG, "Invalid iteration count: %s", argv[i]);
+                return -1;
+            }
+        }
         else if (strcmp(argv[i], "--output") == 0) {
             if (i + 1 >= argc) {
                 ESP_LOGE(TAG, "--output requires argument");
@@ -384,6 +429,13 @@ void cli_print_usage(const char* program_name) {
     printf("  --list-firmwares      List available firmware binaries\n");
     printf("  --inspect <file>      Inspect flash image file (partition table, firmware storage)\n");
     printf("  --load-image <file>   Load flash image and run simulator\n");
+    printf("  --self-test           Run checks of code shared with the device (boot request format, ...)\n");
+    printf("  --bench-store <file>  Benchmark config log vs NVS on a flash image (image file is not modified)\n");
+    printf("  --bench-repair <file> Benchmark block CRC repair vs full reinstall of ota_0 (image file is not modified)\n");
+    printf("  --bench-verify <file> Benchmark mapped vs buffered verification of ota_0 (image file is not modified)\n");
+    printf("\n");
+    printf("Bench-Store Options:\n");
+    printf("  --iterations <N>      Operations per phase (default: %d)\n", DEFAULT_BENCH_ITERATIONS);
     printf("\n");
     printf("Create-Image Options:\n");
     printf("  --output <file>       Output filename (default: %s)\n", DEFAULT_OUTPUT_PATH);
@@ -423,6 +475,15 @@ void cli_print_create_image_examples(void) {
     printf("  # Load flash image and run simulator\n");
     printf("  %s --load-image flash-image.bin\n", "simulator");
     printf("\n");
+    printf("  # Compare config log and NVS metadata write/lookup latency\n");
+    printf("  %s --bench-store flash-image.bin --iterations 500\n", "simulator");
+    printf("\n");
+    printf("  # Repair a damaged slot block by block and compare with a reinstall\n");
+    printf("  %s --bench-repair flash-image.bin\n", "simulator");
+    printf("\n");
+    printf("  # Compare slot verification through mapped flash with 4 KiB reads\n");
+    printf("  %s --bench-verify flash-image.bin\n", "simulator");
+    printf("\n");
     printf("  # Create image with 4 GUI applications\n");
     printf("  %s --create-image \\\n", "simulator");
     printf("    --from-sdcard \"App 1\" \\\n");
@@ -24,7 +24,11 @@ typedef enum {
     MODE_CREATE_IMAGE,      // Create flash image and exit
     MODE_LIST_FIRMWARES,    // List available firmwares and exit
     MODE_INSPECT_IMAGE,     // Inspect flash image file (partition table, firmware storage, etc.)
-    MODE_LOAD_AND_SIMULATE  // Load flash image from file and run simulator
+    MODE_LOAD_AND_SIMULATE, // Load flash image from file and run simulator
+    MODE_BENCH_STORE,       // Benchmark config log against NVS on a flash image
+    MODE_BENCH_REPAIR,      // Benchmark block CRC repair against a full reinstall
+    MODE_BENCH_VERIFY,      // Benchmark mapped against buffered slot verification
+    MODE_SELF_TEST          // Run host-side checks of shared device code
 } cli_mode_t;
 
 /**
@@ -53,6 +57,8 @@ typedef struct {
     // Image loading/inspection
     char* load_image_path;       // Path to flash image file to load
     char* inspect_image_path;     // Path to flash image file to inspect
+    char* bench_image_path;       // Path to flash image file to benchmark against
+    int bench_iterations;         // Operations per benchmark phase
 
     // Logging
     bool verbose;
@@ -0,0 +1,163 @@
+/**
+ * @file cli_selftest.c
+ * @brief Host-side checks of code shared with the device
+ */
+
+#ifdef __SIMULATOR_BUILD__
+
+#include "cli_selftest.h"
+#include "esp_system_mock.h"
+#include "../main/boot_request_format.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+#define CHECK(cond, ...) do { \
+    g_checks++; \
+    if (!(cond)) { \
+        g_failures++; \
+        printf("  ✗ %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+static bool request_equal(const boot_request_data_t* a, const boot_request_data_t* b)
+{
+    return a->version == b->version && a->flags == b->flags && a->target == b->target &&
+           a->attempts == b->attempts && a->max_attempts == b->max_attempts;
+}
+
+static void test_boot_request_roundtrip(void)
+{
+    const boot_request_data_t cases[] = {
+        { BOOT_REQUEST_FORMAT_VERSION, 0, BOOT_REQUEST_TARGET_FACTORY, 0, 0 },
+        { BOOT_REQUEST_FORMAT_VERSION, 0, 1, 0, 0 },
+        { BOOT_REQUEST_FORMAT_VERSION, BOOT_REQUEST_FLAG_STICKY, 3, 2, BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS },
+        { BOOT_REQUEST_FORMAT_VERSION, BOOT_REQUEST_FLAG_STICKY, 16, 255, 255 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t words[BOOT_REQUEST_WORDS];
+        boot_request_data_t decoded;
+
+        boot_request_encode(&cases[i], words);
+        CHECK(boot_request_decode(words, &decoded) == BOOT_REQUEST_DECODE_OK, "case %zu: decode failed", i);
+        CHECK(request_equal(&cases[i], &decoded), "case %zu: fields changed in round trip", i);
+    }
+}
+
+static void test_boot_request_crc(void)
+{
+    const boot_request_data_t request = { BOOT_REQUEST_FORMAT_VERSION, BOOT_REQUEST_FLAG_STICKY, 2, 1, 3 };
+    uint32_t words[BOOT_REQUEST_WORDS];
+    boot_request_encode(&request, words);
+
+    // The bootloader checks against the same CRC the ROM would compute
+    CHECK(words[3] == esp_crc32_le(0, (const uint8_t*)words, 3 * sizeof(uint32_t)),
+          "CRC differs from esp_crc32_le: 0x%08x", words[3]);
+
+    // Any single bit flip after the magic must be rejected
+    int accepted = 0;
+    for (int w = 1; w < BOOT_REQUEST_WORDS; w++) {
+        for (int bit = 0; bit < 32; bit++) {
+            uint32_t damaged[BOOT_REQUEST_WORDS];
+            boot_request_data_t decoded;
+            memcpy(damaged, words, sizeof(damaged));
+            damaged[w] ^= 1u << bit;
+            if (boot_request_decode(damaged, &decoded) != BOOT_REQUEST_DECODE_CORRUPT) {
+                accepted++;
+            }
+        }
+    }
+    CHECK(accepted == 0, "%d single-bit corruptions were accepted", accepted);
+}
+
+static void test_boot_request_legacy(void)
+{
+    uint32_t words[BOOT_REQUEST_WORDS] = { BOOT_REQUEST_V1_MAGIC | (2u << 24), 0, 0, 0 };
+    boot_request_data_t decoded;
+
+    CHECK(boot_request_decode(words, &decoded) == BOOT_REQUEST_DECODE_OK, "v1 request not decoded");
+    CHECK(decoded.version == 1 && decoded.target == 2 && decoded.flags == 0,
+          "v1 request decoded as version %u target %u flags 0x%02x",
+          decoded.version, decoded.target, decoded.flags);
+
+    memset(words, 0, sizeof(words));
+    CHECK(boot_request_decode(words, &decoded) == BOOT_REQUEST_DECODE_NONE, "cleared registers decoded as a request");
+
+    words[0] = 0xFFFFFFFF;
+    CHECK(boot_request_decode(words, &decoded) == BOOT_REQUEST_DECODE_NONE, "garbage decoded as a request");
+}
+
+// Runs the bootloader's decode/step/encode cycle over a series of resets
+static void test_boot_request_sticky_sequence(void)
+{
+    boot_request_data_t request = {
+        BOOT_REQUEST_FORMAT_VERSION, BOOT_REQUEST_FLAG_STICKY, 2, 0, BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS
+    };
+    uint32_t regs[BOOT_REQUEST_WORDS];
+    boot_request_encode(&request, regs);
+
+    for (int boot = 1; boot <= BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS + 1; boot++) {
+        boot_request_data_t decoded, next;
+        CHECK(boot_request_decode(regs, &decoded) == BOOT_REQUEST_DECODE_OK, "boot %d: request lost", boot);
+
+        bool keep = boot_request_step(&decoded, &next);
+        if (boot <= BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS) {
+            CHECK(keep && next.target == 2, "boot %d: expected sticky target 2, got %u (keep=%d)",
+                  boot, next.target, keep);
+            CHECK(next.attempts == boot, "boot %d: attempts %u", boot, next.attempts);
+            boot_request_encode(&next, regs);
+        } else {
+            CHECK(!keep && next.target == BOOT_REQUEST_TARGET_FACTORY,
+                  "boot %d: expected factory fallback, got target %u (keep=%d)", boot, next.target, keep);
+            memset(regs, 0, sizeof(regs));
+        }
+    }
+
+    // A confirmed app keeps its slot indefinitely
+    request.attempts = BOOT_REQUEST_DEFAULT_MAX_ATTEMPTS;
+    boot_request_confirmed(&request);
+    boot_request_data_t next;
+    CHECK(boot_request_step(&request, &next) && next.target == 2, "confirmed request did not boot its target");
+
+    // One-time requests boot once and are dropped
+    const boot_request_data_t once = { BOOT_REQUEST_FORMAT_VERSION, 0, 1, 0, 0 };
+    CHECK(!boot_request_step(&once, &next) && next.target == 1, "one-time request not consumed");
+
+    // max_attempts 0 means no limit
+    const boot_request_data_t unlimited = { BOOT_REQUEST_FORMAT_VERSION, BOOT_REQUEST_FLAG_STICKY, 1, 200, 0 };
+    CHECK(boot_request_step(&unlimited, &next) && next.target == 1, "unlimited sticky request fell back");
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} selftest_case_t;
+
+static const selftest_case_t s_cases[] = {
+    { "boot_request: encode/decode round trip", test_boot_request_roundtrip },
+    { "boot_request: CRC and corruption",       test_boot_request_crc },
+    { "boot_request: v1 and empty registers",   test_boot_request_legacy },
+    { "boot_request: sticky attempt limit",     test_boot_request_sticky_sequence },
+};
+
+int cli_selftest_run(void)
+{
+    printf("\n=== Self-test ===\n");
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        int failures_before = g_failures;
+        s_cases[i].run();
+        printf("%s %s\n", g_failures == failures_before ? "✓" : "✗", s_cases[i].name);
+    }
+
+    printf("\n%d checks, %d failed\n\n", g_checks, g_failures);
+    return g_failures == 0 ? 0 : -1;
+}
+
+#endif // __SIMULATOR_BUILD__
@@ -0,0 +1,28 @@
+/**
+ * @file cli_selftest.h
+ * @brief Host-side checks of code shared with the device
+ */
+
+#ifndef CLI_SELFTEST_H
+#define CLI_SELFTEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __SIMULATOR_BUILD__
+
+/**
+ * @brief Run all self-test groups and print a summary
+ *
+ * @return 0 if every check passed, -1 otherwise
+ */
+int cli_selftest_run(void);
+
+#endif // __SIMULATOR_BUILD__
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLI_SELFTEST_H
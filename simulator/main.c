@@ -19,10 +19,23 @@
 #include "platform/flash_emulator.h"
 #include "cli_parser.h"
 #include "cli_inspector.h"
+#include "cli_bench.h"
+#include "cli_selftest.h"
 
 // Bootloader headers
 #include "../main/lvgl_bootloader.h"
 #include "../main/board_init.h"
+#include "../main/boot_timing.h"
+#include "../main/firmware_catalog.h"
+#include "../main/render_loop.h"
+#include "../main/io_arbiter.h"
+#include "../main/sd_reader.h"
+#include "../main/flash_io.h"
+#include "../main/partition_cache.h"
+#include "../main/ota_preerase.h"
+#include "../main/block_crc.h"
+#include "../main/slot_scrub.h"
+#include "esp_timer.h"
 
 static const char* TAG = "simulator";
 
@@ -150,9 +163,9 @@ esp_err_t initialize_flash_image(void) {
     return ESP_OK;
 }
 
-// Initialize system
-esp_err_t initialize_simulator(void) {
-    ESP_LOGI(TAG, "=== Initializing ESP32-P4 Bootloader Simulator ===");
+// Startup work that does not need the window; mirrors the app's startup tasks
+static void startup_task(void *arg) {
+    (void)arg;
 
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
@@ -160,20 +173,56 @@ esp_err_t initialize_simulator(void) {
         ESP_LOGW(TAG, "NVS init failed: %s, erasing...", esp_err_to_name(ret));
         nvs_flash_erase();
         ret = nvs_flash_init();
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "NVS init failed after erase");
-            return ret;
-        }
     }
-    ESP_LOGI(TAG, "✅ NVS initialized");
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NVS init failed after erase");
+    } else {
+        ESP_LOGI(TAG, "✅ NVS initialized");
+    }
+    boot_timing_mark(BOOT_STAGE_APP_NVS);
+
+    // Preload the boot menu catalog in the background
+    firmware_catalog_start();
+
+    // Fill the skeleton main screen with the installed firmwares
+    lvgl_bootloader_load_installed();
+
+    ESP_LOGI(TAG, "=== Simulator Startup Tasks Complete ===\n");
+    boot_timing_mark(BOOT_STAGE_APP_READY);
+    vTaskDelete(NULL);
+}
+
+// Initialize system
+esp_err_t initialize_simulator(void) {
+    ESP_LOGI(TAG, "=== Initializing ESP32-P4 Bootloader Simulator ===");
+    boot_timing_init();
+
+    // Every flash access goes through the flash I/O service, from the first one on
+    esp_err_t ret = flash_io_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Flash I/O service unavailable");
+    }
 
-    // Initialize LVGL with SDL2
+    // Partition lookups of every module are served from the cache
+    ret = partition_cache_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Partition cache unavailable");
+    }
+
+    // Firmware file reads of the flasher, validator and SD OTA share one reader
+    ret = sd_reader_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SD reader unavailable");
+    }
+
+    // Window and skeleton UI first so the first frame does not wait for storage
     ret = init_lvgl_sdl();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize LVGL/SDL2");
         return ret;
     }
     ESP_LOGI(TAG, "✅ LVGL/SDL2 initialized");
+    boot_timing_mark(BOOT_STAGE_APP_DISPLAY);  // SDL window stands in for board_init_display()
 
     // Initialize bootloader UI
     ret = lvgl_bootloader_init();
@@ -182,9 +231,47 @@ esp_err_t initialize_simulator(void) {
         return ret;
     }
     ESP_LOGI(TAG, "✅ Bootloader UI initialized");
+    boot_timing_mark(BOOT_STAGE_APP_LVGL);
 
-    ESP_LOGI(TAG, "=== Simulator Initialization Complete ===\n");
+    // The render loop and the startup task's bulk I/O go through the arbiter
+    ret = io_arbiter_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "I/O arbiter unavailable, bulk I/O runs unthrottled");
+    }
+
+    // Installs started from the UI claim OTA slots from the pre-erase service
+    ret = ota_preerase_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Pre-erase lock unavailable");
+    }
+
+    // Installs store block CRC tables, the scrub reads them
+    ret = block_crc_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Block CRC tables unavailable");
+    }
+
+    // The boot menu and diagnostics read slot states before the scrub starts
+    ret = slot_scrub_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Slot scrub unavailable");
+    }
+
+    // Event-driven rendering; SDL events and wake-ups end the loop's wait
+    const render_loop_hooks_t hooks = {
+        .render_begin = io_arbiter_frame_begin,
+        .render_end = io_arbiter_frame_end,
+        .wake = lvgl_sdl_wake,
+    };
+    render_loop_init(&hooks);
+
+    // NVS and the firmware storage scan run while the event loop renders
+    if (xTaskCreate(startup_task, "startup", 8192, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create startup task, running inline");
+        startup_task(NULL);
+    }
 
+    ESP_LOGI(TAG, "=== Simulator Initialization Complete ===\n");
     return ESP_OK;
 }
 
@@ -192,14 +279,8 @@ esp_err_t initialize_simulator(void) {
 void event_loop(void) {
     ESP_LOGI(TAG, "Starting event loop...\n");
 
-    uint64_t iteration = 0;
+    int64_t last_stats_us = esp_timer_get_time();
     while (running) {
-        // Check running flag before potentially blocking operations
-        if (!running) {
-            ESP_LOGI(TAG, "Loop exit: running flag check 1");
-            break;
-        }
-
         // Process SDL events (returns false if quit requested)
         if (!lvgl_sdl_process_events()) {
             ESP_LOGI(TAG, "Loop exit: SDL quit event");
@@ -207,28 +288,25 @@ void event_loop(void) {
             break;
         }
 
-        // Check running flag again after SDL events
-        if (!running) {
-            ESP_LOGI(TAG, "Loop exit: running flag check 2");
-            break;
+        // Handle LVGL events, then sleep until LVGL's next deadline, an SDL
+        // event or a render_loop_wake()
+        uint32_t sleep_ms = lvgl_tick_handler();
+
+        // Same RENDER_STATS, IO_STATS, SD_READER_STATS, FLASH_IO_STATS, PREERASE_STATS and SCRUB_STATS lines as the device, every 10 seconds
+        if (esp_timer_get_time() - last_stats_us >= 10 * 1000 * 1000) {
+            last_stats_us = esp_timer_get_time();
+            render_loop_log_stats();
+            io_arbiter_log_stats();
+            sd_reader_log_stats();
+            flash_io_log_stats();
+            ota_preerase_log_stats();
+            slot_scrub_log_stats();
         }
 
-        // Check running flag before LVGL handler
         if (!running) {
-            ESP_LOGI(TAG, "Loop exit: running flag check 3");
             break;
         }
-
-        // Handle LVGL events
-        lvgl_tick_handler();
-
-        // Small delay to prevent high CPU usage
-        usleep(100);
-
-        // Log status every 10000 iterations (every ~1 second)
-        if (++iteration % 10000 == 0) {
-            ESP_LOGD(TAG, "Simulator running... (iteration %llu)", iteration);
-        }
+        lvgl_sdl_wait_events(sleep_ms);
     }
 
     ESP_LOGI(TAG, "Event loop exited");
@@ -287,6 +365,30 @@ int main(int argc, char** argv) {
         return (ret == 0) ? 0 : 1;
     }
 
+    if (mode == MODE_SELF_TEST) {
+        int ret = cli_selftest_run();
+        cli_config_free(config);
+        return (ret == 0) ? 0 : 1;
+    }
+
+    if (mode == MODE_BENCH_STORE) {
+        int ret = cli_bench_store(config->bench_image_path, config->bench_iterations);
+        cli_config_free(config);
+        return (ret == 0) ? 0 : 1;
+    }
+
+    if (mode == MODE_BENCH_REPAIR) {
+        int ret = cli_bench_repair(config->bench_image_path);
+        cli_config_free(config);
+        return (ret == 0) ? 0 : 1;
+    }
+
+    if (mode == MODE_BENCH_VERIFY) {
+        int ret = cli_bench_verify(config->bench_image_path);
+        cli_config_free(config);
+        return (ret == 0) ? 0 : 1;
+    }
+
     if (mode == MODE_CREATE_IMAGE) {
         // Validate configuration
         int ret = cli_validate_config(config);
@@ -374,6 +476,18 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Pre-erase free OTA space of the emulated flash while the UI idles
+    ret = ota_preerase_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Background pre-erase unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Scrub the installed slots of the emulated flash
+    ret = slot_scrub_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Background scrub unavailable: %s", esp_err_to_name(ret));
+    }
+
     // Run event loop
     event_loop();
 
@@ -17,6 +17,9 @@
 
     typedef void* esp_flash_t;
 
+    // Main flash chip; partitions mapped with esp_partition_mmap() must be on it
+    extern esp_flash_t* esp_flash_default_chip;
+
     // Note: Order is (chip, dst, src_addr, size) for read
     esp_err_t esp_flash_read(esp_flash_t chip, void* dst, size_t src_addr, size_t size);
 
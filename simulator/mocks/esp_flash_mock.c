@@ -10,6 +10,9 @@
 
 static const char* TAG = "esp_flash_mock";
 
+static esp_flash_t default_chip = NULL;
+esp_flash_t* esp_flash_default_chip = &default_chip;
+
 esp_err_t esp_flash_read(void* chip, void* dst, size_t src_addr, size_t size) {
     (void)chip;
 
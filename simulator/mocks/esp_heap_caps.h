@@ -0,0 +1,15 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief ESP heap capabilities wrapper for simulator
+ */
+
+#ifndef ESP_HEAP_CAPS_H_MOCK
+#define ESP_HEAP_CAPS_H_MOCK
+
+#ifdef __SIMULATOR_BUILD__
+    #include "esp_system_mock.h"
+#else
+    #include_next "esp_heap_caps.h"
+#endif
+
+#endif // ESP_HEAP_CAPS_H_MOCK
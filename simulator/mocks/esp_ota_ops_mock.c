@@ -18,6 +18,7 @@ typedef struct {
     const esp_partition_t* partition;
     uint32_t offset;
     uint32_t total_size;
+    bool erased;  // Begun with an erase (any size but OTA_WITH_SEQUENTIAL_WRITES)
     bool active;
 } ota_state_t;
 
@@ -70,6 +71,14 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, uint32_t update_size,
     ESP_LOGI(TAG, "🚀 OTA begin: partition=%s, update_size=%u bytes",
              partition->label, (unsigned int)update_size);
 
+    // Sequential sessions erase on demand in esp_ota_write(), never up front
+    const bool erased = update_size != OTA_WITH_SEQUENTIAL_WRITES;
+
+    // Size sentinels: nothing to check against at the end
+    if (update_size == OTA_SIZE_UNKNOWN || update_size == OTA_WITH_SEQUENTIAL_WRITES) {
+        update_size = 0;
+    }
+
     // Check if partition has enough space
     if (update_size > partition->size) {
         ESP_LOGE(TAG, "Update size %u exceeds partition size %u",
@@ -87,6 +96,7 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, uint32_t update_size,
     state->partition = partition;
     state->total_size = update_size;
     state->offset = 0;
+    state->erased = erased;
 
     *out_handle = state->handle;
 
@@ -135,6 +145,44 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size)
     return ESP_OK;
 }
 
+esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void* data, size_t size, uint32_t offset) {
+    ota_state_t* state = find_ota_state(handle);
+    if (!state) {
+        ESP_LOGE(TAG, "Invalid OTA handle: %u", (unsigned int)handle);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!data || size == 0) {
+        ESP_LOGE(TAG, "Invalid data or size");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (offset + size > state->partition->size) {
+        ESP_LOGE(TAG, "Write exceeds partition size: offset=%u + size=%zu > partition_size=%u",
+                 (unsigned int)offset, size, (unsigned int)state->partition->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // ESP-IDF asserts here when esp_ota_begin() erased nothing
+    if (!state->erased) {
+        ESP_LOGE(TAG, "esp_ota_write_with_offset() on a session begun with OTA_WITH_SEQUENTIAL_WRITES "
+                 "(asserts on hardware: the partition must be erased at begin)");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Like the real call: no erase, the range must be blank already
+    esp_err_t ret = flash_emulator_write(state->partition->address + offset, data, size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write to flash: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (offset + size > state->offset) {
+        state->offset = offset + size;
+    }
+    return ESP_OK;
+}
+
 esp_err_t esp_ota_end(esp_ota_handle_t handle) {
     ota_state_t* state = find_ota_state(handle);
     if (!state) {
@@ -174,6 +222,11 @@ esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
     return ESP_OK;
 }
 
+const esp_partition_t* esp_ota_get_running_partition(void) {
+    // The simulator stands in for the factory app
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+}
+
 const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
     ESP_LOGD(TAG, "Getting next update partition (start_from=%p)", start_from);
 
@@ -237,3 +290,20 @@ esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
 
     return ESP_OK;
 }
+
+esp_err_t esp_ota_get_partition_description(const esp_partition_t* partition, esp_app_desc_t* app_desc) {
+    if (!partition || !app_desc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The descriptor follows the 24-byte image header and the first 8-byte segment header
+    esp_err_t ret = esp_partition_read(partition, 24 + 8, app_desc, sizeof(*app_desc));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (app_desc->magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
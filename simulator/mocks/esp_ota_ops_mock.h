@@ -17,13 +17,33 @@ typedef uint32_t esp_ota_handle_t;
 
 // OTA size constants
 #define OTA_SIZE_UNKNOWN (0xFFFFFFFF)
+#define OTA_WITH_SEQUENTIAL_WRITES (0xFFFFFFFE)  // Erase sectors as the writes reach them
+
+// Application description embedded in every app image (esp_app_desc.h)
+#define ESP_APP_DESC_MAGIC_WORD (0xABCD5432)
+
+typedef struct {
+    uint32_t magic_word;        // ESP_APP_DESC_MAGIC_WORD
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+    uint32_t reserv2[20];
+} esp_app_desc_t;
 
 esp_err_t esp_ota_begin(const esp_partition_t* partition, uint32_t update_size, esp_ota_handle_t* out_handle);
 esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void* data, size_t size, uint32_t offset);
 esp_err_t esp_ota_end(esp_ota_handle_t handle);
 esp_err_t esp_ota_abort(esp_ota_handle_t handle);
 const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+const esp_partition_t* esp_ota_get_running_partition(void);
 esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+esp_err_t esp_ota_get_partition_description(const esp_partition_t* partition, esp_app_desc_t* app_desc);
 
 #ifdef __cplusplus
 }
@@ -4,6 +4,7 @@
  */
 
 #include "esp_partition_mock.h"
+#include "esp_flash.h"
 #include "esp_log_mock.h"
 #include "../platform/flash_emulator.h"
 #include <stdio.h>
@@ -225,6 +226,49 @@ esp_err_t esp_partition_erase_range(
     return ESP_OK;
 }
 
+esp_err_t esp_partition_mmap(
+    const esp_partition_t* partition,
+    size_t offset,
+    size_t size,
+    esp_partition_mmap_memory_t memory,
+    const void** out_ptr,
+    esp_partition_mmap_handle_t* out_handle) {
+
+    (void)memory;  // The image is one mapping for both
+
+    if (!partition || !out_ptr || !out_handle) {
+        ESP_LOGE(TAG, "NULL partition or output");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Like ESP-IDF: only partitions on the main flash chip can be mapped.
+    // Table entries are on it; hand-built descriptors must say so
+    bool from_table = partition >= mock_partitions && partition < mock_partitions + PARTITION_COUNT;
+    if (!from_table && partition->flash_chip != esp_flash_default_chip) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (offset + size > partition->size) {
+        ESP_LOGE(TAG, "Map out of bounds: offset=0x%x, size=0x%x, partition_size=0x%x",
+                 (unsigned int)offset, (unsigned int)size, (unsigned int)partition->size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Point straight into the mmap'd flash image
+    const uint8_t* ptr = flash_emulator_map(partition->address + offset, size);
+    if (!ptr) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_ptr = ptr;
+    *out_handle = partition->address + offset;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+    (void)handle;  // Nothing to release, the image stays mapped
+}
+
 esp_err_t esp_partition_get_sha256(
     const esp_partition_t* partition,
     uint8_t* sha256_out) {
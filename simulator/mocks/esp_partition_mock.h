@@ -59,6 +59,7 @@ typedef struct esp_partition_t {
     char label[17];
     uint32_t flags;
     bool encrypted;  // Encryption flag (needed by firmware_flasher.c)
+    void* flash_chip;  // esp_flash_t*; esp_flash_default_chip for the main flash
     struct esp_partition_t* next;
 } esp_partition_t;
 
@@ -111,6 +112,25 @@ esp_err_t esp_partition_erase_range(
     size_t size
 );
 
+// Memory-mapped access
+typedef enum {
+    ESP_PARTITION_MMAP_DATA,  // Map to data memory, for reading
+    ESP_PARTITION_MMAP_INST,  // Map to instruction memory
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+esp_err_t esp_partition_mmap(
+    const esp_partition_t* partition,
+    size_t offset,
+    size_t size,
+    esp_partition_mmap_memory_t memory,
+    const void** out_ptr,
+    esp_partition_mmap_handle_t* out_handle
+);
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
+
 esp_err_t esp_partition_get_sha256(
     const esp_partition_t* partition,
     uint8_t* sha256_out
@@ -26,6 +26,12 @@ void* heap_caps_malloc(size_t size, uint32_t caps) {
     return malloc(size);
 }
 
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+    (void)caps;  // Ignore capabilities in simulator
+    void* ptr = NULL;
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : NULL;
+}
+
 void heap_caps_free(void* ptr) {
     free(ptr);
 }
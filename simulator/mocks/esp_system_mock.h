@@ -26,6 +26,7 @@ typedef int esp_err_t;
 #define ESP_ERR_NOT_SUPPORTED   0x105
 #define ESP_ERR_TIMEOUT         0x107
 #define ESP_ERR_INVALID_SIZE    0x108
+#define ESP_ERR_INVALID_VERSION 0x10A
 #define ESP_ERR_NVS_NOT_FOUND   0x110  // NVS specific error
 #define ESP_ERR_NVS_INVALID_HANDLE 0x111  // NVS invalid handle
 #define ESP_ERR_NVS_NO_FREE_PAGES 0x112  // NVS no free pages
@@ -34,6 +35,7 @@ typedef int esp_err_t;
 #define ESP_ERR_NVS_TYPE_MISMATCH 0x117  // NVS type mismatch
 #define ESP_ERR_INVALID_RESPONSE 0x115     // Invalid response
 #define ESP_ERR_INVALID_CRC     0x116     // CRC verification failed
+#define ESP_ERR_NVS_INVALID_LENGTH 0x118  // NVS buffer too small
 
 // System functions
 void esp_restart(void) __attribute__((noreturn));
@@ -70,6 +72,7 @@ static inline uint32_t heap_caps_get_largest_free_block(uint32_t caps) {
 
 // Memory allocation with capabilities
 void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps);
 void heap_caps_free(void* ptr);
 
 // CRC32 calculation
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,8 +55,10 @@ static inline int esp_timer_delete(esp_timer_handle_t timer) {
 }
 
 static inline uint64_t esp_timer_get_time(void) {
-    // Return time in microseconds
-    return 0;
+    // Return monotonic time in microseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
 }
 
 #ifdef __cplusplus
@@ -132,56 +132,88 @@ void vTaskResume(TaskHandle_t xTask) {
     fprintf(stderr, "[FreeRTOS Mock] Warning: vTaskResume not fully implemented\n");
 }
 
-// Semaphore creation
-SemaphoreHandle_t xSemaphoreCreateMutex(void) {
-    pthread_mutex_t* mutex = malloc(sizeof(pthread_mutex_t));
-    if (!mutex) return NULL;
+// Semaphores: one counting semaphore on a condition variable covers the
+// mutex, binary and counting flavours (no priority inheritance or recursion)
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+} mock_semaphore_t;
+
+static SemaphoreHandle_t semaphore_create(UBaseType_t max_count, UBaseType_t initial_count) {
+    mock_semaphore_t* sem = malloc(sizeof(mock_semaphore_t));
+    if (!sem) return NULL;
+
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = initial_count;
+    sem->max_count = max_count;
+    return (SemaphoreHandle_t)sem;
+}
 
-    pthread_mutex_init(mutex, NULL);
-    return (SemaphoreHandle_t)mutex;
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_create(1, 1);
 }
 
 SemaphoreHandle_t xSemaphoreCreateBinary(void) {
-    // Binary semaphore can be implemented as a mutex
-    return xSemaphoreCreateMutex();
+    // Created empty, like FreeRTOS
+    return semaphore_create(1, 0);
 }
 
 SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount) {
-    // For now, just return a mutex (simplified)
-    fprintf(stderr, "[FreeRTOS Mock] Warning: Counting semaphores not fully implemented\n");
-    return xSemaphoreCreateMutex();
+    return semaphore_create(uxMaxCount, uxInitialCount);
 }
 
 // Semaphore operations
 BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
     if (!xSemaphore) return pdFAIL;
 
-    pthread_mutex_t* mutex = (pthread_mutex_t*)xSemaphore;
+    mock_semaphore_t* sem = (mock_semaphore_t*)xSemaphore;
+    struct timespec deadline;
+    if (xTicksToWait != portMAX_DELAY) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += xTicksToWait / 1000;
+        deadline.tv_nsec += (long)(xTicksToWait % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
 
-    if (xTicksToWait == portMAX_DELAY) {
-        pthread_mutex_lock(mutex);
-        return pdPASS;
-    } else if (xTicksToWait == 0) {
-        return pthread_mutex_trylock(mutex) == 0 ? pdPASS : pdFAIL;
-    } else {
-        // macOS doesn't have pthread_mutex_timedlock, use trylock with delay
-        // This is a simplification - for proper timed waits, we'd need a condvar
-        uint32_t elapsed = 0;
-        while (elapsed < xTicksToWait) {
-            if (pthread_mutex_trylock(mutex) == 0) {
-                return pdPASS;
-            }
-            usleep(1000);  // 1ms
-            elapsed++;
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (xTicksToWait == portMAX_DELAY) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (xTicksToWait == 0 ||
+                   pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline) != 0) {
+            break;
         }
-        return pdFAIL;
     }
+
+    BaseType_t taken = pdFAIL;
+    if (sem->count > 0) {
+        sem->count--;
+        taken = pdPASS;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken;
 }
 
 BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
     if (!xSemaphore) return pdFAIL;
-    pthread_mutex_t* mutex = (pthread_mutex_t*)xSemaphore;
-    return pthread_mutex_unlock(mutex) == 0 ? pdPASS : pdFAIL;
+
+    mock_semaphore_t* sem = (mock_semaphore_t*)xSemaphore;
+    BaseType_t given = pdFAIL;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        given = pdPASS;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return given;
 }
 
 BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t* pxHigherPriorityTaskWoken) {
@@ -191,33 +223,141 @@ BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t* pxHig
 
 void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
     if (xSemaphore) {
-        pthread_mutex_t* mutex = (pthread_mutex_t*)xSemaphore;
-        pthread_mutex_destroy(mutex);
-        free(mutex);
+        mock_semaphore_t* sem = (mock_semaphore_t*)xSemaphore;
+        pthread_cond_destroy(&sem->cond);
+        pthread_mutex_destroy(&sem->lock);
+        free(sem);
     }
 }
 
 // Queue operations
+// Queues: fixed-size ring of copied items on a mutex and two condition variables
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t* items;
+} mock_queue_t;
+
+static void deadline_after(struct timespec* deadline, TickType_t ticks) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ticks / 1000;
+    deadline->tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+// Caller holds the queue lock; false once the wait has timed out
+static bool queue_wait(mock_queue_t* queue, pthread_cond_t* cond, TickType_t ticks, const struct timespec* deadline) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, &queue->lock);
+        return true;
+    }
+    return ticks != 0 && pthread_cond_timedwait(cond, &queue->lock, deadline) == 0;
+}
+
 QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
-    // Simplified: not implementing full queue semantics
-    fprintf(stderr, "[FreeRTOS Mock] Warning: Queues not fully implemented\n");
-    return NULL;
+    if (uxQueueLength == 0 || uxItemSize == 0) return NULL;
+
+    mock_queue_t* queue = malloc(sizeof(mock_queue_t));
+    if (!queue) return NULL;
+    queue->items = malloc((size_t)uxQueueLength * uxItemSize);
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->length = uxQueueLength;
+    queue->item_size = uxItemSize;
+    queue->count = 0;
+    queue->head = 0;
+    return (QueueHandle_t)queue;
 }
 
 BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
-    return pdFAIL;
+    if (!xQueue || !pvItemToQueue) return pdFAIL;
+
+    mock_queue_t* queue = (mock_queue_t*)xQueue;
+    struct timespec deadline;
+    if (xTicksToWait != portMAX_DELAY) {
+        deadline_after(&deadline, xTicksToWait);
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (!queue_wait(queue, &queue->not_full, xTicksToWait, &deadline)) {
+            break;
+        }
+    }
+
+    BaseType_t sent = pdFAIL;
+    if (queue->count < queue->length) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + (size_t)tail * queue->item_size, pvItemToQueue, queue->item_size);
+        queue->count++;
+        sent = pdPASS;
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
 }
 
 BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
-    return pdFAIL;
+    if (!xQueue || !pvBuffer) return pdFAIL;
+
+    mock_queue_t* queue = (mock_queue_t*)xQueue;
+    struct timespec deadline;
+    if (xTicksToWait != portMAX_DELAY) {
+        deadline_after(&deadline, xTicksToWait);
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (!queue_wait(queue, &queue->not_empty, xTicksToWait, &deadline)) {
+            break;
+        }
+    }
+
+    BaseType_t received = pdFAIL;
+    if (queue->count > 0) {
+        memcpy(pvBuffer, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        received = pdPASS;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received;
 }
 
 UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
-    return 0;
+    if (!xQueue) return 0;
+
+    mock_queue_t* queue = (mock_queue_t*)xQueue;
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
 }
 
 void vQueueDelete(QueueHandle_t xQueue) {
-    // Nothing to delete
+    if (xQueue) {
+        mock_queue_t* queue = (mock_queue_t*)xQueue;
+        pthread_cond_destroy(&queue->not_full);
+        pthread_cond_destroy(&queue->not_empty);
+        pthread_mutex_destroy(&queue->lock);
+        free(queue->items);
+        free(queue);
+    }
 }
 
 // CPU ID
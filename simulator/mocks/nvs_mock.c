@@ -346,6 +346,77 @@ esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, siz
     return ESP_OK;
 }
 
+// Blobs are stored as hex strings so the JSON image stays printable
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    if (!handle || !key || (!value && length > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char* namespace_name = (const char*)handle;
+    json_object* namespace_obj = NULL;
+    if (!json_object_object_get_ex(nvs_root, namespace_name, &namespace_obj)) {
+        namespace_obj = json_object_new_object();
+        json_object_object_add(nvs_root, namespace_name, namespace_obj);
+    }
+
+    char* hex = malloc(length * 2 + 1);
+    if (!hex) {
+        return ESP_ERR_NO_MEM;
+    }
+    const uint8_t* bytes = (const uint8_t*)value;
+    for (size_t i = 0; i < length; i++) {
+        snprintf(hex + i * 2, 3, "%02x", bytes[i]);
+    }
+    hex[length * 2] = '\0';
+
+    json_object_object_add(namespace_obj, key, json_object_new_string(hex));
+    free(hex);
+    nvs_dirty = true;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    if (!handle || !key || !length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char* namespace_name = (const char*)handle;
+    json_object* namespace_obj = NULL;
+    if (!json_object_object_get_ex(nvs_root, namespace_name, &namespace_obj)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    json_object* value_obj = NULL;
+    if (!json_object_object_get_ex(namespace_obj, key, &value_obj)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    const char* hex = json_object_get_string(value_obj);
+    if (!hex || strlen(hex) % 2 != 0) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    size_t blob_len = strlen(hex) / 2;
+    if (!out_value) {
+        *length = blob_len;  // Size query, same as ESP-IDF
+        return ESP_OK;
+    }
+    if (*length < blob_len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    uint8_t* bytes = (uint8_t*)out_value;
+    for (size_t i = 0; i < blob_len; i++) {
+        unsigned int byte = 0;
+        sscanf(hex + i * 2, "%2x", &byte);
+        bytes[i] = (uint8_t)byte;
+    }
+    *length = blob_len;
+
+    return ESP_OK;
+}
+
 esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
     if (!handle || !key || !out_value) {
         return ESP_ERR_INVALID_ARG;
@@ -11,6 +11,9 @@
 
     // LP System register addresses (mocked, not used in simulator)
     #define LP_SYSTEM_REG_LP_STORE0_REG  (0x50005000)
+    #define LP_SYSTEM_REG_LP_STORE13_REG (0x50005034)
+    #define LP_SYSTEM_REG_LP_STORE14_REG (0x50005038)
+    #define LP_SYSTEM_REG_LP_STORE15_REG (0x5000503C)
 
     #define REG_WRITE(reg, val) do { \
         (void)(reg); \
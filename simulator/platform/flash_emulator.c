@@ -146,6 +146,7 @@ esp_err_t flash_emulator_read(uint32_t offset, void* buffer, size_t size) {
 
     // Read from mapped memory
     memcpy(buffer, flash_mapped_base + offset, size);
+    stats.bytes_read += size;
 
     ESP_LOGD(TAG, "Read %zu bytes @ 0x%x", size, offset);
     return ESP_OK;
@@ -174,6 +175,7 @@ esp_err_t flash_emulator_write(uint32_t offset, const void* data, size_t size) {
 
     // Flush to disk (msync)
     msync(flash_mapped_base + offset, size, MS_ASYNC);
+    stats.bytes_written += size;
 
     ESP_LOGD(TAG, "Wrote %zu bytes @ 0x%x", size, offset);
     return ESP_OK;
@@ -201,11 +203,31 @@ esp_err_t flash_emulator_erase(uint32_t offset, size_t size) {
 
     // Flush to disk
     msync(flash_mapped_base + offset, size, MS_ASYNC);
+    stats.bytes_erased += size;
 
     ESP_LOGD(TAG, "Erased %zu bytes @ 0x%x", size, offset);
     return ESP_OK;
 }
 
+const uint8_t* flash_emulator_map(uint32_t offset, size_t size) {
+    if (!flash_mapped_base) {
+        ESP_LOGE(TAG, "Flash emulator not initialized");
+        return NULL;
+    }
+
+    if (size == 0 || offset + size > flash_mapped_size) {
+        ESP_LOGE(TAG, "Map out of bounds: offset=%u + size=%zu > flash_size=%zu",
+                 offset, size, flash_mapped_size);
+        return NULL;
+    }
+
+    // The image is mmap'd already, so a mapped window is a pointer into it
+    stats.bytes_mapped += size;
+
+    ESP_LOGD(TAG, "Mapped %zu bytes @ 0x%x", size, offset);
+    return flash_mapped_base + offset;
+}
+
 void flash_emulator_set_progress_callback(flash_progress_callback_t callback) {
     progress_callback = callback;
 }
@@ -257,7 +279,6 @@ esp_err_t flash_emulator_write_partition(
                           (end.tv_usec - start.tv_usec) / 1000;
 
     if (ret == ESP_OK) {
-        stats.bytes_written += size;
         stats.operation_count++;
         stats.total_time_ms += elapsed_ms;
 
@@ -305,7 +326,6 @@ esp_err_t flash_emulator_erase_partition(
                           (end.tv_usec - start.tv_usec) / 1000;
 
     if (ret == ESP_OK) {
-        stats.bytes_erased += size;
         stats.operation_count++;
         stats.total_time_ms += elapsed_ms;
 
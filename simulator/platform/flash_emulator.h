@@ -39,6 +39,7 @@ typedef struct {
     uint32_t bytes_read;
     uint32_t bytes_written;
     uint32_t bytes_erased;
+    uint32_t bytes_mapped;     // Handed out by flash_emulator_map(), no copy
     uint32_t operation_count;
     uint32_t total_time_ms;
 } flash_stats_t;
@@ -112,6 +113,18 @@ esp_err_t flash_emulator_write(uint32_t offset, const void* data, size_t size);
  */
 esp_err_t flash_emulator_erase(uint32_t offset, size_t size);
 
+/**
+ * @brief Map a range of the flash image for reading in place
+ *
+ * Simulator counterpart of the cache-mapped window of esp_partition_mmap():
+ * returns a pointer straight into the mmap'd image, no copy is made.
+ *
+ * @param offset Offset in bytes from start of flash
+ * @param size Number of bytes to map
+ * @return Pointer to the range, NULL if out of bounds or not initialized
+ */
+const uint8_t* flash_emulator_map(uint32_t offset, size_t size);
+
 // Simulate flash write with progress tracking
 esp_err_t flash_emulator_write_partition(
     const char* partition_name,
@@ -14,6 +14,7 @@
 // LVGL headers - include after mocks
 #define LV_CONF_INCLUDE_SIMPLE
 #include <lvgl.h>
+#include "../../main/render_loop.h"
 
 static const char* TAG = "lvgl_sdl";
 
@@ -213,7 +214,7 @@ esp_err_t init_lvgl_sdl(void) {
     return ESP_OK;
 }
 
-void lvgl_tick_handler(void) {
+uint32_t lvgl_tick_handler(void) {
     static uint32_t tick_count = 0;
     static uint32_t last_handler_duration_ms = 0;
     tick_count++;
@@ -223,22 +224,14 @@ void lvgl_tick_handler(void) {
         ESP_LOGI(TAG, "LVGL tick #%u starting", tick_count);
     }
 
-    // Log every 10000 ticks (every ~1 second)
-    if (tick_count % 10000 == 0) {
-        ESP_LOGD(TAG, "LVGL tick handler %u times (last lv_timer_handler took %u ms)",
-                 tick_count, last_handler_duration_ms);
-    }
-
-    // LVGL tick is handled via callback (tick_get_cb)
-    lv_tick_inc(5);
-
     // Track how long lv_timer_handler takes - detect infinite loops
     struct timespec ts_before, ts_after;
     clock_gettime(CLOCK_MONOTONIC, &ts_before);
     uint64_t before_ms = ts_before.tv_sec * 1000 + ts_before.tv_nsec / 1000000;
 
     // This is where LVGL processes all tasks, animations, redraws, etc.
-    lv_timer_handler();
+    // (LVGL time comes from tick_get_cb)
+    uint32_t sleep_ms = render_loop_run_once();
 
     clock_gettime(CLOCK_MONOTONIC, &ts_after);
     uint64_t after_ms = ts_after.tv_sec * 1000 + ts_after.tv_nsec / 1000000;
@@ -246,7 +239,8 @@ void lvgl_tick_handler(void) {
 
     // Log first 20 ticks with timing
     if (tick_count <= 20) {
-        ESP_LOGI(TAG, "LVGL tick #%u completed in %u ms", tick_count, last_handler_duration_ms);
+        ESP_LOGI(TAG, "LVGL tick #%u completed in %u ms (next in %u ms)",
+                 tick_count, last_handler_duration_ms, sleep_ms);
     }
 
     // Warn if lv_timer_handler takes more than 100ms - indicates infinite loop
@@ -260,6 +254,20 @@ void lvgl_tick_handler(void) {
         ESP_LOGE(TAG, "🚨 CRITICAL: lv_timer_handler() took %u ms - LVGL is HUNG!",
                  last_handler_duration_ms);
     }
+
+    return sleep_ms;
+}
+
+// Block until an SDL event arrives, lvgl_sdl_wake() is called or the timeout expires
+void lvgl_sdl_wait_events(uint32_t timeout_ms) {
+    // NULL leaves the event in the queue for lvgl_sdl_process_events()
+    SDL_WaitEventTimeout(NULL, (int)timeout_ms);
+}
+
+// Wake lvgl_sdl_wait_events() from any thread
+void lvgl_sdl_wake(void) {
+    SDL_Event event = { .type = SDL_USEREVENT };
+    SDL_PushEvent(&event);
 }
 
 struct lv_display_t* lvgl_sdl_get_display(void) {
@@ -269,6 +277,7 @@ struct lv_display_t* lvgl_sdl_get_display(void) {
 // Process SDL events
 bool lvgl_sdl_process_events(void) {
     SDL_Event event;
+    bool button_changed = false;
     while (SDL_PollEvent(&event)) {
         if (event.type == SDL_QUIT) {
             return false;
@@ -282,6 +291,7 @@ bool lvgl_sdl_process_events(void) {
                 mouse_state.left_button = true;
                 mouse_state.x = event.button.x;
                 mouse_state.y = event.button.y;
+                button_changed = true;
             }
         }
         else if (event.type == SDL_MOUSEBUTTONUP) {
@@ -289,9 +299,15 @@ bool lvgl_sdl_process_events(void) {
                 mouse_state.left_button = false;
                 mouse_state.x = event.button.x;
                 mouse_state.y = event.button.y;
+                button_changed = true;
             }
         }
     }
+
+    // Read clicks right away instead of waiting for the indev poll timer
+    if (button_changed && mouse_indev) {
+        lv_indev_read(mouse_indev);
+    }
     return true;
 }
 
@@ -20,8 +20,14 @@ struct lv_display_t;
 // Initialize LVGL with SDL2 display driver
 esp_err_t init_lvgl_sdl(void);
 
-// Tick handler for LVGL
-void lvgl_tick_handler(void);
+// Run LVGL once; returns milliseconds until it needs to run again
+uint32_t lvgl_tick_handler(void);
+
+// Sleep until an SDL event, lvgl_sdl_wake() or the timeout
+void lvgl_sdl_wait_events(uint32_t timeout_ms);
+
+// Wake lvgl_sdl_wait_events() (render_loop wake hook); thread-safe
+void lvgl_sdl_wake(void);
 
 // Get the active SDL display
 struct lv_display_t* lvgl_sdl_get_display(void);
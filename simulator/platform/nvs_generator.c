@@ -42,63 +42,44 @@ int nvs_generate_firmware_metadata(
         return -1;
     }
 
-    // Clear any existing metadata
-    firmware_metadata_clear_all();
+    // Build metadata for each firmware; stored below in a single transaction
+    firmware_metadata_t entries[MAX_FIRMWARE_ENTRIES];
+    int entry_count = firmware_count < MAX_FIRMWARE_ENTRIES ? firmware_count : MAX_FIRMWARE_ENTRIES;
 
-    // Store metadata for each firmware
-    for (int i = 0; i < firmware_count; i++) {
-        firmware_metadata_t metadata;
-        memset(&metadata, 0, sizeof(metadata));
+    for (int i = 0; i < entry_count; i++) {
+        firmware_metadata_t* metadata = &entries[i];
+        memset(metadata, 0, sizeof(*metadata));
 
         // Copy filename
-        strncpy(metadata.filename, firmware_names[i], sizeof(metadata.filename) - 1);
-        metadata.filename[sizeof(metadata.filename) - 1] = '\0';
+        strncpy(metadata->filename, firmware_names[i], sizeof(metadata->filename) - 1);
+        metadata->filename[sizeof(metadata->filename) - 1] = '\0';
 
         // Set partition (all go to ota_0 for now)
-        strncpy(metadata.partition, "ota_0", sizeof(metadata.partition) - 1);
+        strncpy(metadata->partition, "ota_0", sizeof(metadata->partition) - 1);
 
-        // Set offset (firmware storage area + data offset)
-        // Firmware data starts after header (offset 0xE0)
-        metadata.offset = 0x110000 + 0xE0 + (i * sizeof(firmware_entry_t));
-
-        // For now, use the actual firmware storage offset
         // In reality, each firmware would be flashed to ota_0, not stored in firmware storage
         // But for pre-populating metadata, we mark them as available
-        metadata.offset = 0x110000;  // Firmware storage base
+        metadata->offset = 0x110000;  // Firmware storage base
 
-        metadata.size = firmware_sizes[i];
-        metadata.crc32 = firmware_crcs[i];
-        metadata.is_valid = true;
-        metadata.timestamp = 0;  // Will be set on actual flash
+        metadata->size = firmware_sizes[i];
+        metadata->crc32 = firmware_crcs[i];
+        metadata->is_valid = true;
+        metadata->timestamp = 0;  // Will be set on actual flash
 
         ESP_LOGI(TAG, "Storing metadata for firmware %d:", i);
-        ESP_LOGI(TAG, "  Name: %s", metadata.filename);
-        ESP_LOGI(TAG, "  Size: %u bytes", metadata.size);
-        ESP_LOGI(TAG, "  CRC32: 0x%08X", metadata.crc32);
-
-        ret = firmware_metadata_set(i, &metadata);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set metadata for firmware %d", i);
-            continue;
-        }
+        ESP_LOGI(TAG, "  Name: %s", metadata->filename);
+        ESP_LOGI(TAG, "  Size: %u bytes", metadata->size);
+        ESP_LOGI(TAG, "  CRC32: 0x%08X", metadata->crc32);
     }
 
-    // Set firmware count
-    ret = firmware_metadata_set_count(firmware_count);
+    // Replaces any existing metadata and sets the firmware count in one commit
+    ret = firmware_metadata_set_all(entries, (uint32_t)entry_count);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set firmware count: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to store firmware metadata: %s", esp_err_to_name(ret));
         nvs_flash_deinit();
         return -1;
     }
 
-    // Commit all NVS data
-    nvs_handle_t handle;
-    ret = nvs_open("firmware_config", NVS_READWRITE, &handle);
-    if (ret == ESP_OK) {
-        nvs_commit(handle);
-        nvs_close(handle);
-    }
-
     ESP_LOGI(TAG, "✓ NVS metadata generated for %d firmwares", firmware_count);
 
     // NOTE: In the simulator, NVS data is stored in JSON format by the mock